@@ -113,6 +113,15 @@ namespace atbus {
          */
         int push(const void* buffer, size_t s);
 
+        /**
+         * @brief 把多个数据块合并成一个数据包发送，接收端收到的是连续的数据
+         * @param buffers 数据块地址数组
+         * @param sizes 数据块长度数组
+         * @param n 数据块个数
+         * @return 0或错误码
+         */
+        int push_v(const void* const buffers[], const size_t sizes[], size_t n);
+
         /**
          * @brief 获取连接的地址
          */
@@ -144,6 +153,19 @@ namespace atbus {
 
         /** 是否正在连接、或者握手或者已连接 **/
         bool is_running() const;
+
+        /** 在这个连接上发出的未返回的ping的序号，数据连接单独测量延迟时使用 **/
+        inline void set_stat_ping(uint32_t seq) { ping_seq_ = seq; }
+        inline uint32_t get_stat_ping() const { return ping_seq_; }
+
+        /**
+         * @brief 增加一次往返延迟的采样，平滑值按1/8的权重更新
+         * @param rtt_ns 往返延迟，纳秒
+         */
+        void add_stat_rtt(uint64_t rtt_ns);
+
+        /** 平滑的往返延迟，纳秒，0表示还没有采样 **/
+        inline uint64_t get_stat_rtt() const { return rtt_ns_; }
     public:
         static void iostream_on_listen_cb(channel::io_stream_channel* channel, channel::io_stream_connection* connection, int status, void* buffer, size_t s);
         static void iostream_on_connected_cb(channel::io_stream_channel* channel, channel::io_stream_connection* connection, int status, void* buffer, size_t s);
@@ -157,19 +179,21 @@ namespace atbus {
 
         static int shm_free_fn(node& n, connection& conn);
 
-        static int shm_push_fn(connection& conn, const void* buffer, size_t s);
+        static int shm_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n);
 
         static int mem_proc_fn(node& n, connection& conn, time_t sec, time_t usec);
 
         static int mem_free_fn(node& n, connection& conn);
 
-        static int mem_push_fn(connection& conn, const void* buffer, size_t s);
+        static int mem_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n);
 
         static int ios_free_fn(node& n, connection& conn);
 
-        static int ios_push_fn(connection& conn, const void* buffer, size_t s);
+        static int ios_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n);
 
-        static bool unpack(void* res, connection& conn, atbus::protocol::msg& m, void* buffer, size_t s);
+        static bool unpack(void* arena, connection& conn, atbus::protocol::msg& m, void* buffer, size_t s);
+
+        static bool unpack_compressed(void* arena, connection& conn, atbus::protocol::msg& m);
     private:
         state_t::type state_;
         channel::channel_address_t address_;
@@ -180,6 +204,9 @@ namespace atbus {
         endpoint* binding_;
         std::weak_ptr<connection> watcher_;
 
+        uint32_t ping_seq_;
+        uint64_t rtt_ns_;
+
         typedef struct {
             channel::mem_channel* channel;
             void* buffer;
@@ -205,7 +232,7 @@ namespace atbus {
             } shared_t;
             typedef int (*proc_fn_t)(node& n, connection& conn, time_t sec, time_t usec);
             typedef int(*free_fn_t)(node& n, connection& conn);
-            typedef int(*push_fn_t)(connection& conn, const void* buffer, size_t s);
+            typedef int(*push_fn_t)(connection& conn, const void* const buffers[], const size_t sizes[], size_t n);
 
             shared_t shared;
             proc_fn_t proc_fn;
@@ -11,6 +11,7 @@
 #define LIBATBUS_ENDPOINT_H_
 
 #include <list>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <WinSock2.h>
@@ -54,6 +55,9 @@ namespace atbus {
 
                 MUTABLE_FLAGS,
                 GLOBAL_ROUTER = MUTABLE_FLAGS,  /** 全局路由表 **/
+                SHORTCUT,                       /** 按流量建立的跨子树直连 **/
+                BINARY_DATA,                    /** 对端注册时声明支持二进制编码的数据消息 **/
+                CONN_SYN_FORWARD,               /** 对端注册时声明能转发建立直连的通知 **/
                 MAX
             };
         } flag_t;
@@ -78,6 +82,19 @@ namespace atbus {
         inline int32_t get_pid() const { return pid_; };
         inline const std::string& get_hostname() const { return hostname_; };
 
+        /** 对端注册时发来的压缩算法掩码，双方都支持的算法才会用于压缩 **/
+        inline uint32_t get_compress_algorithms() const { return compress_algorithms_; }
+        inline void set_compress_algorithms(uint32_t mask) { compress_algorithms_ = mask; }
+
+        /** 对端注册时发来的提供的服务类型，有序 **/
+        inline const std::vector<uint64_t>& get_services() const { return services_; }
+        void set_services(const std::vector<uint64_t>& services);
+        bool has_service(uint64_t service) const;
+
+        /** 已经下发给这个端点的全局路由表版本号，新的端点从0开始(全量) **/
+        inline uint64_t get_sync_version() const { return sync_version_; }
+        inline void set_sync_version(uint64_t v) { sync_version_ = v; }
+
 
         bool is_child_node(bus_id_t id) const;
         bool is_brother_node(bus_id_t id, uint32_t father_mask) const;
@@ -117,6 +134,7 @@ namespace atbus {
         ptr_t watch() const;
 
         inline const std::list<std::string>& get_listen() const { return listen_address_; }
+        inline const std::list<connection::ptr_t>& get_data_connections() const { return data_conn_; }
         inline void add_listen(const std::string& addr) { listen_address_.push_back(addr); }
     private:
         static bool sort_connection_cmp_fn(const connection::ptr_t& left, const connection::ptr_t& right);
@@ -126,6 +144,16 @@ namespace atbus {
 
         connection* get_data_connection(endpoint* ep) const;
 
+        /**
+         * @brief 获取数据连接，最优的一类连接有多条时按stripe分流
+         * @param ep 目标端点
+         * @param stripe 分流值
+         * @param keep_order 为true时相同的stripe总是选中同一条连接(连接集合不变时)，用于保证同一个流的顺序
+         *                   为false时按stripe对可用连接数取模轮流使用
+         * @note 只有一条可用连接时和get_data_connection相同
+         */
+        connection* get_striped_data_connection(endpoint* ep, uint64_t stripe, bool keep_order) const;
+
         /** 增加错误计数 **/
         size_t add_stat_fault();
 
@@ -138,10 +166,48 @@ namespace atbus {
 
         void set_stat_ping_delay(time_t pd, time_t pong_tm);
 
+        /** 最近一次ping的延迟，毫秒 **/
         time_t get_stat_ping_delay() const;
 
+        /** 链路繁忙连续跳过ping的开始时间，毫秒，0表示没有在跳过 **/
+        void set_stat_ping_skip(uint64_t tick);
+
+        uint64_t get_stat_ping_skip() const;
+
+        /**
+         * @brief 增加一次往返延迟的采样，平滑延迟和抖动按RFC 6298的方式更新(权重1/8和1/4)
+         * @param conn 测量的连接，只有控制连接的采样计入端点的平滑延迟，数据连接只更新连接自己的延迟
+         * @param rtt_ns 往返延迟，纳秒
+         * @return 数据连接的优先顺序可能变化时返回true
+         */
+        bool add_stat_rtt(connection* conn, uint64_t rtt_ns);
+
+        /** 平滑的往返延迟，纳秒，0表示还没有采样 **/
+        uint64_t get_stat_rtt() const;
+
+        /** 往返延迟的平均偏差，纳秒 **/
+        uint64_t get_stat_rtt_jitter() const;
+
         time_t get_stat_last_pong() const;
 
+        void set_stat_last_active(time_t tm);
+
+        time_t get_stat_last_active() const;
+
+        void set_stat_last_recv(uint64_t tick);
+
+        /** 上一次收到这个端点的任意消息的时间，毫秒 **/
+        uint64_t get_stat_last_recv() const;
+
+        /** 收到对端PING或PONG里的负载提示，之后发给它的服务消息重新计数 **/
+        void set_stat_load(uint32_t load);
+
+        /** 发给它一个服务消息 **/
+        void add_stat_load_pending();
+
+        /** 估计的负载，对端最近一次的负载提示加上之后发给它的服务消息数 **/
+        uint64_t get_stat_load() const;
+
         inline const node* get_owner() const { return owner_; }
     private:
         bus_id_t id_;
@@ -149,6 +215,9 @@ namespace atbus {
         std::bitset<flag_t::MAX> flags_;
         std::string hostname_;
         int32_t pid_;
+        uint32_t compress_algorithms_;
+        uint64_t sync_version_;
+        std::vector<uint64_t> services_;
 
         // 这里不用智能指针是为了该值在上层对象（node）析构时仍然可用
         node* owner_;
@@ -163,7 +232,14 @@ namespace atbus {
             size_t fault_count;             // 错误容忍计数
             uint32_t unfinished_ping;       // 上一次未完成的ping的序号
             time_t ping_delay;
+            uint64_t ping_skip_tick;        // 链路繁忙连续跳过ping的开始时间，毫秒
+            uint64_t rtt_ns;                // 平滑的往返延迟，纳秒
+            uint64_t rtt_jitter_ns;         // 往返延迟的平均偏差，纳秒
             time_t last_pong_time;          // 上一次接到PONG包时间
+            time_t last_active_time;        // 上一次收发数据消息的时间，直连空闲检测用
+            uint64_t last_recv_tick;        // 上一次收到消息的时间，毫秒，收到任意消息都说明链路可用，可以推迟ping
+            uint32_t load_hint;             // 对端最近一次的负载提示
+            uint32_t load_pending;          // 收到负载提示以后发给它的服务消息数
             stat_t();
         } ;
         stat_t stat_;
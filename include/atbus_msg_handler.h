@@ -14,6 +14,8 @@
 #include <ctime>
 #include <list>
 
+#include "detail/libatbus_config.h"
+
 namespace atbus {
     namespace protocol {
         struct msg;
@@ -34,6 +36,11 @@ namespace atbus {
 
         static int send_transfer_rsp(node& n, protocol::msg&, int32_t ret_code);
 
+        /**
+         * @brief 通知tid直接连接target，target必须是直接连接的节点
+         */
+        static int send_conn_syn(node& n, ATBUS_MACRO_BUSID_TYPE tid, const endpoint& target);
+
         static int send_msg(node& n, connection& conn, const protocol::msg& m);
 
 
@@ -43,6 +50,9 @@ namespace atbus {
 
         static int on_recv_custom_cmd_req(node& n, connection* conn, protocol::msg&, int status, int errcode);
 
+        static int on_recv_group_data(node& n, connection* conn, protocol::msg&, int status, int errcode);
+        static int on_recv_service_data(node& n, connection* conn, protocol::msg&, int status, int errcode);
+
         static int on_recv_node_sync_req(node& n, connection* conn, protocol::msg&, int status, int errcode);
         static int on_recv_node_sync_rsp(node& n, connection* conn, protocol::msg&, int status, int errcode);
         static int on_recv_node_reg_req(node& n, connection* conn, protocol::msg&, int status, int errcode);
@@ -50,6 +60,7 @@ namespace atbus {
         static int on_recv_node_conn_syn(node& n, connection* conn, protocol::msg&, int status, int errcode);
         static int on_recv_node_ping(node& n, connection* conn, protocol::msg&, int status, int errcode);
         static int on_recv_node_pong(node& n, connection* conn, protocol::msg&, int status, int errcode);
+        static int on_recv_node_group_sync(node& n, connection* conn, protocol::msg&, int status, int errcode);
     };
 }
 
@@ -29,10 +29,20 @@
 #include "detail/libatbus_error.h"
 #include "detail/libatbus_config.h"
 #include "detail/libatbus_channel_export.h"
+#include "detail/libatbus_compression.h"
+#include "detail/timer_wheel.h"
+#include "detail/endpoint_index.h"
 
 #include "atbus_endpoint.h"
 
 namespace atbus {
+    namespace protocol {
+        struct node_data;
+    }
+
+    // 类型化消息的编解码规则，定义在detail/libatbus_message_traits.h
+    template<typename T>
+    struct message_traits;
 
     class node CLASS_FINAL : public util::design_pattern::noncopyable {
     public:
@@ -42,6 +52,9 @@ namespace atbus {
         struct conf_flag_t {
             enum type {
                 EN_CONF_GLOBAL_ROUTER,                  /** 全局路由表 **/
+                EN_CONF_MSGPACK_DATA,                   /** 不声明也不使用二进制编码的数据消息(默认按注册时对端声明的特性协商) **/
+                EN_CONF_DATA_UNORDERED,                 /** 数据消息不要求顺序，有多条数据连接时轮流发送(分片消息除外) **/
+                EN_CONF_AUTO_SHM,                       /** 启动时自动监听共享内存通道，同一台机器上的节点注册后数据消息改走共享内存 **/
                 EN_CONF_MAX
             };
         };
@@ -80,17 +93,50 @@ namespace atbus {
             int backlog;
             time_t first_idle_timeout;                  /** 第一个包允许的空闲时间，秒 **/
             time_t ping_interval;                       /** ping包间隔，秒 **/
+            size_t ping_skip_limit;                     /** 链路一直繁忙时最多连续跳过多少个ping间隔，之后仍然ping一次测量延迟，0则不限制 **/
             time_t retry_interval;                      /** 重试包间隔，秒 **/
             size_t fault_tolerant;                      /** 容错次数，次 **/
+            size_t data_conn_count;                     /** 和每个端点之间的io_stream数据连接数，多条时同一个(来源,类型)的消息总是走同一条连接 **/
 
             // ===== 缓冲区配置 =====
             size_t msg_size;                            /** 数据包大小 **/
             size_t recv_buffer_size;                    /** 接收缓冲区，和数据包大小有关 **/
             size_t send_buffer_size;                    /** 发送缓冲区限制 **/
             size_t send_buffer_number;                  /** 发送缓冲区静态Buffer数量限制，0则为动态缓冲区 **/
+
+            // ===== 分片配置 =====
+            size_t fragment_max_size;                   /** 超过数据包大小时分片发送，单个数据的最大长度，0则不分片。分片后要能放进send_buffer_size **/
+            size_t fragment_buffer_size;                /** 接收分片的重组缓冲区总大小限制 **/
+            time_t fragment_timeout;                    /** 分片重组超时时间，秒 **/
+
+            // ===== 压缩配置 =====
+            size_t compress_threshold;                  /** io_stream连接上不小于这个长度的数据消息压缩后发送，0则不压缩 **/
+            uint32_t compress_algorithm;                /** 压缩算法ID(compression::algorithm_t或注册的算法)，对端也支持时才会使用 **/
+
+            // ===== 直连配置 =====
+            size_t shortcut_threshold;                  /** 转发节点上同一对(来源,目标)每秒的转发次数达到这个值时通知来源直连目标，0则不建立跨子树直连 **/
+            time_t shortcut_idle_timeout;               /** 跨子树直连没有数据消息多久以后断开，秒，0则不断开 **/
+
+            // ===== 共享内存配置 =====
+            uint32_t auto_shm_key_base;                 /** EN_CONF_AUTO_SHM时共享内存key的基数，同一台机器上复用bus id的多个集群要配置不同的值 **/
         } conf_t;
 
-        typedef std::map<bus_id_t, endpoint::ptr_t> endpoint_collection_t;
+        typedef detail::endpoint_index<bus_id_t, endpoint::ptr_t> endpoint_collection_t;
+
+        /**
+         * @brief 全局路由表里的节点
+         * @note 每个节点都保存自身子树(子节点上报)，有全局路由表的节点还保存父节点下发的其他节点
+         */
+        typedef struct {
+            bus_id_t bus_id;
+            uint32_t children_mask;
+            bool has_global_tree;
+            bool removed;                               /** 已移除，所有同步对象都收到后再清理 **/
+            bus_id_t source;                            /** 来源，自身、上报的子节点或下发的父节点 **/
+            uint64_t version;                           /** 最后一次变更时路由表的版本号 **/
+            uint32_t snapshot;                          /** 最后一次全量同步的消息序号，全量同步结束时清理没有带上的节点 **/
+        } sync_node_t;
+        typedef std::map<bus_id_t, sync_node_t> sync_node_collection_t;
 
         struct evt_msg_t {
             typedef std::function<int(const node&, const endpoint*, const connection*, int, const void*, size_t)> on_recv_msg_fn_t;
@@ -103,6 +149,8 @@ namespace atbus {
             typedef std::function<int(const node&, const endpoint*, const connection*, bus_id_t, const std::vector<std::pair<const void*, size_t> >&)> on_custom_cmd_fn_t;
             typedef std::function<int(const node&, endpoint*, int)> on_add_endpoint_fn_t;
             typedef std::function<int(const node&, endpoint*, int)> on_remove_endpoint_fn_t;
+            typedef std::function<int(const node&, const endpoint*, const connection*, bus_id_t, int, uint32_t, const void*, size_t)> on_recv_call_fn_t;
+            typedef std::function<int(const node&, const endpoint*, const connection*, uint64_t, bus_id_t, int, const void*, size_t)> on_recv_group_msg_fn_t;
 
             on_recv_msg_fn_t on_recv_msg;
             on_send_data_failed_fn_t on_send_data_failed;
@@ -114,8 +162,23 @@ namespace atbus {
             on_custom_cmd_fn_t on_custom_cmd;
             on_add_endpoint_fn_t on_endpoint_added;
             on_remove_endpoint_fn_t on_endpoint_removed;
+            on_recv_call_fn_t on_recv_call;
+            on_recv_group_msg_fn_t on_recv_group_msg;
         } ;
 
+        /**
+         * @brief node::call的回调
+         * @param n 发起调用的节点
+         * @param from 回包的节点ID，即调用的目标节点，超时或本地错误时为0
+         * @param status 0或错误码，超时是EN_ATBUS_ERR_NODE_TIMEOUT，被调方node::reply的ret_code也会通过这里传回
+         * @param type 回包的自定义类型，发送失败或超时时是请求的类型
+         * @param buffer 回包数据，只在回调内有效
+         * @param s 回包数据长度
+         * @param priv_data 调用时传入的私有数据
+         * @note 使用函数指针和私有数据而不是std::function，完成调用时不需要分配内存
+         */
+        typedef void (*call_callback_fn_t)(node& n, bus_id_t from, int status, int type, const void* buffer, size_t s, void* priv_data);
+
         // ================== 用这个来取代C++继承，减少层次结构 ==================
         struct no_stream_channel_t {
             void* channel;
@@ -201,9 +264,147 @@ namespace atbus {
          * @return 0或错误码
          * @note 接收端收到的数据很可能不是地址对齐的，所以这里不建议发送内存数据
          *       如果非要发送内存数据的话，一定要memcpy，不能直接类型转换，除非手动设置了地址对齐规则
+         * @note 超过单个消息的长度限制时会自动分片发送(不超过conf.fragment_max_size)，中间节点只转发不重组
+         *       接收端重组完成后回调一次on_recv_msg，重组超时或超出缓冲区限制的数据会被丢弃
+         *       所有分片会一次性写入发送缓冲区，按每个分片一个conf.msg_size估算，超过conf.send_buffer_size时
+         *       直接返回EN_ATBUS_ERR_BUFF_LIMIT，不会发出任何分片
          */
         int send_data(bus_id_t tid, int type, const void* buffer, size_t s, bool require_rsp = false);
 
+        /**
+         * @brief 批量发送数据，同一个目标的多个小数据包合并成一个ATBUS_CMD_BATCH消息发送
+         * @param tid 发送目标ID
+         * @param type 自定义类型，将作为msg.head.type字段传递。可用于业务区分服务类型
+         * @param arr_buf 数据块地址数组
+         * @param arr_size 数据块长度数组
+         * @param arr_count 数据块个数
+         * @param require_rsp 是否强制需要回包（默认情况下如果发送成功是没有回包通知的）
+         * @return 0或错误码
+         * @note 中间节点整个转发，不会拆开。接收端对每个数据块分别回调on_recv_msg
+         *       发送失败时on_send_data_failed只会回调一次，消息会带有FLAG_BATCH标记
+         */
+        int send_data_batch(bus_id_t tid, int type, const void* arr_buf[], const size_t arr_size[], size_t arr_count, bool require_rsp = false);
+
+        /**
+         * @brief 发送类型化的消息，按message_traits<T>编码后发送
+         * @param tid 发送目标ID
+         * @param type 自定义类型，将作为msg.head.type字段传递。可用于业务区分服务类型
+         * @param v 消息
+         * @param require_rsp 是否强制需要回包（默认情况下如果发送成功是没有回包通知的）
+         * @return 0或错误码
+         * @note 使用前需要包含detail/libatbus_message_traits.h，接收端使用atbus::as<T>(buffer, len)解码
+         *       POD类型直接发送内存，msgpack类型编码到节点复用的缓冲区，都不需要业务层的临时缓冲区
+         */
+        template<typename T>
+        int send(bus_id_t tid, int type, const T& v, bool require_rsp = false) {
+            size_t len = 0;
+            const void* buffer = message_traits<T>::encode(v, send_encode_buffer_, len);
+            if (NULL == buffer) {
+                return EN_ATBUS_ERR_PACK;
+            }
+
+            return send_data(tid, type, buffer, len, require_rsp);
+        }
+
+        /**
+         * @brief 发起RPC调用
+         * @param tid 被调目标ID
+         * @param type 自定义类型，将作为msg.head.type字段传递
+         * @param buffer 请求数据地址
+         * @param s 请求数据长度，不能超过单个消息的长度限制(不会分片)
+         * @param timeout_ms 超时时间，毫秒，按proc传入的时间计算
+         * @param fn 完成回调，收到回包、发送失败通知或超时都会回调且只回调一次
+         * @param priv_data 回调的私有数据
+         * @param sequence 输出调用ID，可以为NULL
+         * @return 0或错误码，失败时不会回调
+         * @note 被调方通过set_on_recv_call_handle接收请求，并用reply回包
+         *       同时进行中的调用数量没有限制，按调用ID在开放寻址表里索引，超时用时间轮检测
+         */
+        int call(bus_id_t tid, int type, const void* buffer, size_t s, time_t timeout_ms, call_callback_fn_t fn, void* priv_data = NULL, uint32_t* sequence = NULL);
+
+        /**
+         * @brief 回复RPC调用
+         * @param tid 调用方ID，即on_recv_call回调中的from
+         * @param type 自定义类型
+         * @param sequence 调用ID，即on_recv_call回调中的sequence
+         * @param buffer 回包数据地址
+         * @param s 回包数据长度
+         * @param ret_code 返回码，调用方回调的status
+         * @return 0或错误码
+         */
+        int reply(bus_id_t tid, int type, uint32_t sequence, const void* buffer, size_t s, int ret_code = 0);
+
+        /**
+         * @brief 进行中的RPC调用数量
+         */
+        inline size_t get_call_count() const { return call_count_; }
+
+        /**
+         * @brief 加入组(订阅主题)
+         * @param gid 组ID，由业务层定义
+         * @return 0或错误码
+         * @note 子树关注的组合并后上报给父节点，组播数据只会发往有关注的子树
+         */
+        int join_group(uint64_t gid);
+
+        /**
+         * @brief 离开组(取消订阅主题)
+         * @param gid 组ID
+         * @return 0或错误码，没有加入时返回EN_ATBUS_ERR_ATNODE_NOT_FOUND
+         */
+        int leave_group(uint64_t gid);
+
+        /**
+         * @brief 是否已加入组
+         */
+        bool is_group_member(uint64_t gid) const;
+
+        /**
+         * @brief 发送组播数据
+         * @param gid 组ID
+         * @param type 自定义类型，将作为msg.head.type字段传递
+         * @param buffer 数据块地址
+         * @param s 数据块长度，不能超过单个消息的长度限制(不会分片)
+         * @return 0或错误码，所有链路都发送失败时返回最后一个错误
+         * @note 每条树上的链路只发送一份，中间节点只转发给有关注的子节点，并一直向上转发到根节点
+         *       接收端通过set_on_recv_group_handle接收，发送方自身即使加入了组也不会收到
+         *       组播不保证送达，也没有失败通知
+         */
+        int send_to_group(uint64_t gid, int type, const void* buffer, size_t s);
+
+        /**
+         * @brief 注册自身提供的服务类型
+         * @param service 服务类型，由业务层定义，不能是0
+         * @return 0或错误码
+         * @note 服务类型在注册(reg_data)时发给对端，需要在start之前调用，之后注册的只对新建立的连接生效
+         */
+        int register_service(uint64_t service);
+
+        /**
+         * @brief 设置自身的负载提示(比如排队中的请求数)，通过ping/pong告知直接连接的节点
+         */
+        void set_load_hint(uint32_t load);
+
+        /**
+         * @brief 获取自身的负载提示
+         */
+        inline uint32_t get_load_hint() const { return load_hint_; }
+
+        /**
+         * @brief 发送给任意一个提供服务的实例
+         * @param service 服务类型
+         * @param key 路由键，非0时按一致性哈希选择，相同的key总是发往同一个实例，实例增减时只有约1/N的key改变目标
+         *            为0时选择负载最低的实例，负载是实例最近一次的负载提示加上之后发给它的消息数
+         * @param type 自定义类型，将作为msg.head.type字段传递
+         * @param buffer 数据块地址
+         * @param s 数据块长度，不能超过单个消息的长度限制(不会分片)
+         * @param target 导出选中的实例，交给父节点选择时为0
+         * @return 0或错误码，没有可选的实例并且没有父节点时返回EN_ATBUS_ERR_ATNODE_NOT_FOUND
+         * @note 只在自身和直接连接的节点(父节点、兄弟节点、子节点和直连)里选择，都没有时发给父节点，由上层节点选择
+         *       上层节点也找不到实例或者转发失败时通过on_send_data_failed通知
+         */
+        int send_to_service(uint64_t service, uint64_t key, int type, const void* buffer, size_t s, bus_id_t* target = NULL);
+
         /**
          * @brief 发送数据消息
          * @param tid 发送目标ID
@@ -262,6 +463,18 @@ namespace atbus {
          */
         int send_msg(bus_id_t tid, atbus::protocol::msg& mb, endpoint::get_connection_fn_t fn, endpoint** ep_out, connection** conn_out);
 
+        /**
+         * @brief 查找发往目标的下一跳，不发送
+         * @param tid 发送目标ID
+         * @param fn 获取有效连接的接口
+         * @param use_route_cache 是否使用路由缓存
+         * @param route_ep 导出下一跳的端点，没有可用的路由时为NULL
+         * @param conn 导出下一跳的连接，可能为NULL
+         * @param cache_hit 导出是否命中路由缓存
+         * @return 0或错误码
+         */
+        int find_route(bus_id_t tid, endpoint::get_connection_fn_t fn, bool use_route_cache, endpoint*& route_ep, connection*& conn, bool& cache_hit);
+
         /**
          * @brief 根据对端ID查找直链的端点
          * @param tid 目标端点ID
@@ -292,10 +505,77 @@ namespace atbus {
         inline const endpoint_collection_t& get_children() const { return node_children_; };
 
         inline const endpoint_collection_t& get_brother() const { return node_brother_; };
+
+        inline const endpoint_collection_t& get_shortcut() const { return node_shortcut_; };
+
+        /**
+         * @brief 注册压缩算法，相同ID的算法会被替换
+         * @param codec 压缩算法，必须在node的生命周期内有效，ID必须在1到compression::algorithm_t::MAX-1之间
+         * @return 0或错误码
+         * @note 内置的compression::algorithm_t::LZ默认已注册。注册要在连接建立之前完成，注册时会把支持的算法发给对端
+         */
+        int register_compression(const compression::codec_t* codec);
+
+        /**
+         * @brief 获取已注册的压缩算法
+         * @return 未注册时返回NULL
+         */
+        const compression::codec_t* get_compression(uint32_t id) const;
+
+        /**
+         * @brief 已注册的压缩算法掩码，注册时发给对端用于协商
+         */
+        uint32_t get_compression_mask() const;
+
+        /**
+         * @brief 压缩发往连接的数据
+         * @param conn 发送的连接，只有io_stream连接才会压缩，内存和共享内存通道不压缩
+         * @param buffer 原始数据
+         * @param s 原始数据长度
+         * @param out_size 压缩后的content长度(包含压缩头)
+         * @return 压缩后的content，不需要压缩或压缩后没有变小时返回NULL
+         * @note 返回的数据在下一次调用前有效
+         */
+        const void* compress_data(const connection& conn, const void* buffer, size_t s, size_t& out_size);
+
+        /**
+         * @brief 解压带有FLAG_COMPRESSED的数据消息，解压后的数据放在解包内存池里，并去掉FLAG_COMPRESSED
+         * @param arena 解包内存池(msgpack::zone)
+         * @param m 消息
+         * @return 0或错误码
+         */
+        int decompress_data(void* arena, protocol::msg& m);
     private:
         adapter::loop_t* get_evloop(); 
         channel::io_stream_conf* get_iostream_conf();
 
+        /**
+         * @brief 分片发送超过单个消息长度限制的数据
+         * @note 所有分片使用同一个消息序号，只有最后一个分片会带上FLAG_REQUIRE_RSP
+         */
+        int send_data_fragments(bus_id_t tid, int type, const void* buffer, size_t s, bool require_rsp);
+
+        /**
+         * @brief 发送RPC的请求或回包
+         */
+        int send_call_msg(bus_id_t tid, int type, uint32_t sequence, int ret_code, int flag, const void* buffer, size_t s);
+
+        /**
+         * @brief 当前时间，毫秒，定时器和RPC超时使用
+         */
+        uint64_t get_timer_tick() const;
+
+        // RPC进行中的调用表，开放寻址，线性探测
+        size_t call_find(uint32_t sequence) const;
+        size_t call_insert(uint32_t sequence);
+        void call_erase(size_t index);
+        void call_rehash(size_t capacity);
+
+        /**
+         * @brief 完成调用，先从调用表移除再回调，回调里可以发起新的调用
+         */
+        void call_complete(size_t index, bus_id_t from, int status, int type, const void* buffer, size_t s);
+
     public:
         inline bus_id_t get_id() const { return self_? self_->get_id(): 0; }
         inline const conf_t& get_conf() const { return conf_; }
@@ -328,7 +608,36 @@ namespace atbus {
 
         void on_recv_data(const endpoint* ep, connection* conn, int type, const void* buffer, size_t s) const;
 
+        /**
+         * @brief 接收到分片消息，全部分片收到后回调on_recv_data
+         * @return 0或错误码
+         */
+        int on_recv_fragment(const endpoint* ep, connection* conn, const protocol::msg& m);
+
         void on_send_data_failed(const endpoint*, const connection*, const protocol::msg* m);
+
+        /**
+         * @brief 接收到RPC请求
+         * @return 0或错误码
+         */
+        int on_recv_call(const endpoint* ep, connection* conn, const protocol::msg& m);
+
+        /**
+         * @brief 接收到RPC回包或请求发送失败的通知
+         * @param from 回包的节点ID(forward_data::from)，不是下一跳的端点，本地错误时为0
+         * @param sequence 调用ID
+         * @param status 0或错误码
+         * @return 找不到调用(已超时)或回包不是来自调用的目标节点时返回EN_ATBUS_ERR_ATNODE_NOT_FOUND
+         * @note 调用ID是本节点分配的，其他节点可能碰巧用同一个ID回包，所以还要匹配目标节点
+         */
+        int on_call_response(bus_id_t from, uint32_t sequence, int status, int type, const void* buffer, size_t s);
+
+        /**
+         * @brief RPC请求发送失败或超时，回调的type是请求的类型
+         * @param tid 请求的目标节点
+         * @return 找不到调用或目标节点不一致时返回EN_ATBUS_ERR_ATNODE_NOT_FOUND
+         */
+        int on_call_failed(bus_id_t tid, uint32_t sequence, int status);
         
         int on_error(const char* file_path, size_t line, const endpoint*, const connection*, int, int);
         int on_disconnect(const connection*);
@@ -352,12 +661,121 @@ namespace atbus {
         inline const detail::buffer_block* get_temp_static_buffer() const { return static_buffer_; }
         inline detail::buffer_block* get_temp_static_buffer() { return static_buffer_; }
 
+        /**
+         * @brief 打包消息使用的缓冲区，大小为conf_.msg_size
+         * @note 和get_temp_static_buffer分开，因为转发时消息数据可能还引用着接收缓冲区
+         */
+        inline detail::buffer_block* get_pack_buffer() { return pack_buffer_; }
+
+        /**
+         * @brief 引用解包消息使用的内存池(msgpack::zone)
+         * @note 所有引用释放后内存池会被重置，这样每个消息处理完后都不会再分配和释放内存
+         * @return 内存池，未初始化时返回NULL
+         */
+        void* ref_decode_arena();
+
+        /**
+         * @brief 释放解包消息使用的内存池的引用
+         */
+        void unref_decode_arena();
+
         int ping_endpoint(endpoint& ep);
 
+        /**
+         * @brief 推送路由表的变更，自身子树的变更上报给有全局路由表的父节点，全局路由表的变更下发给有全局路由表的子节点
+         * @note 变更不会立即推送，而是在下一秒的proc里合并推送。每个同步对象只发送它的版本号之后的增量，新的同步对象发送全量
+         * @return 0或错误码，有同步对象没有可用连接时返回错误，proc会在retry_interval后重试
+         */
         int push_node_sync();
 
+        /**
+         * @brief 重新拉取全局路由表，会向父节点全量上报自身子树，父节点收到全量上报后会下发全量的全局路由表
+         * @return 0或错误码
+         */
         int pull_node_sync();
 
+        /**
+         * @brief 接收到节点同步消息，NODE_SYNC_REQ只接受子节点的，NODE_SYNC_RSP只接受父节点的
+         * @return 0或错误码
+         */
+        int on_recv_node_sync(endpoint& ep, const protocol::msg& m);
+
+        /**
+         * @brief 子节点上报了它的子树关注的组
+         * @return 0或错误码
+         */
+        int on_recv_group_sync(endpoint& ep, const protocol::msg& m);
+
+        /**
+         * @brief 收到组播数据，有关注时回调，然后转发给来源以外的链路
+         * @param conn 收到消息的连接
+         * @param m 组播消息，转发时会修改router
+         * @return 0或错误码
+         */
+        int on_recv_group_data(connection* conn, protocol::msg& m);
+
+        /**
+         * @brief 收到需要选择服务实例的数据，选出实例后改为DATA_TRANSFORM_REQ发出，否则继续发给父节点
+         * @param conn 收到消息的连接
+         * @param m 服务消息，转发时会修改命令字、目标和router
+         * @return 0或错误码
+         */
+        int on_recv_service_data(connection* conn, protocol::msg& m);
+
+        /**
+         * @brief 子树(包含自身)关注的组的数量
+         */
+        inline size_t get_group_count() const { return groups_.size(); }
+
+        /**
+         * @brief 全局路由表的版本号，每次变更都会增加
+         */
+        inline uint64_t get_sync_version() const { return sync_version_; }
+
+        /**
+         * @brief 全局路由表里的节点数量(包含自身)
+         */
+        inline size_t get_sync_node_count() const { return sync_node_count_; }
+
+        /**
+         * @brief 在全局路由表里查找节点
+         * @return 不存在或已移除时返回NULL
+         */
+        const sync_node_t* get_sync_node(bus_id_t id) const;
+
+        /**
+         * @brief 转发数据消息时统计(来源, 目标)的流量
+         * @return 达到shortcut_threshold，需要通知来源直连目标时返回true
+         */
+        bool on_relay_data(bus_id_t from, bus_id_t to);
+
+        /**
+         * @brief 转发子节点之间的数据消息时判定是否通知来源直连目标
+         * @note 直连建立前的消息都会经过父节点，重试间隔(retry_interval)内同一对节点只通知一次
+         * @return 需要通知时返回true
+         */
+        bool on_relay_brother_data(bus_id_t from, bus_id_t to);
+
+        /**
+         * @brief 收到PONG时记录往返延迟
+         * @param ep 对端
+         * @param conn 收到PONG的连接
+         * @param rtt_ns 往返延迟，纳秒
+         */
+        void on_recv_rtt(endpoint& ep, connection* conn, uint64_t rtt_ns);
+
+        /**
+         * @brief 有多条并行的数据连接时为数据消息选择连接
+         * @note 默认按(来源, 类型)的哈希分流，保证同一个流的顺序；开启EN_CONF_DATA_UNORDERED时轮流使用
+         */
+        connection* get_striped_data_connection(endpoint& ep, const atbus::protocol::msg& m);
+
+        /**
+         * @brief 开启EN_CONF_AUTO_SHM时监听由bus id和conf.auto_shm_key_base决定的共享内存通道，注册时随其他监听地址一起发给对端
+         * @note 这个key的共享内存已经被其他仍在运行的进程创建时返回EN_ATBUS_ERR_SHM_IN_USE，不自动监听
+         */
+        int listen_auto_shm();
+
         uint32_t alloc_msg_seq();
 
         void add_check_list(const endpoint::ptr_t& ep);
@@ -379,19 +797,49 @@ namespace atbus {
 
         void set_on_remove_endpoint_handle(evt_msg_t::on_remove_endpoint_fn_t fn);
         evt_msg_t::on_remove_endpoint_fn_t get_on_remove_endpoint_handle() const;
+
+        void set_on_recv_call_handle(evt_msg_t::on_recv_call_fn_t fn);
+        evt_msg_t::on_recv_call_fn_t get_on_recv_call_handle() const;
+
+        void set_on_recv_group_handle(evt_msg_t::on_recv_group_msg_fn_t fn);
+        evt_msg_t::on_recv_group_msg_fn_t get_on_recv_group_handle() const;
         
         void ref_object(void*);
         void unref_object(void*);
+
+        /**
+         * @brief 拓扑或者连接状态变化时调用，路由缓存全部失效
+         */
+        inline void invalidate_route_cache() { ++route_epoch_; }
         
     private:
-        static endpoint* find_child(endpoint_collection_t& coll, bus_id_t id);
+        static endpoint* find_child(const endpoint_collection_t& coll, bus_id_t id);
+
+        /**
+         * @brief 添加端点到集合
+         * @param only_self 只按端点自己的ID索引，不包含子域(跨子树直连只用于发往对端自己)
+         */
+        bool insert_child(endpoint_collection_t& coll, endpoint::ptr_t ep, bool only_self = false);
 
-        bool insert_child(endpoint_collection_t& coll, endpoint::ptr_t ep);
+        /**
+         * @brief 新的兄弟节点的子域包含已经直连的兄弟节点时，已有的节点改为跨子树直连
+         */
+        void move_nested_brother_to_shortcut(const endpoint& ep);
 
         bool remove_child(endpoint_collection_t& coll, bus_id_t id);
 
         bool remove_collection(endpoint_collection_t& coll);
 
+        /**
+         * @brief 记录目标节点的数据连接，下一次发送直接使用
+         */
+        void set_route_cache(bus_id_t tid, endpoint* ep, connection* conn);
+
+        /**
+         * @brief 断开空闲的跨子树直连，清理过期的转发流量统计
+         */
+        void proc_shortcut(time_t sec);
+
         /**
          * @brief 增加错误计数，如果超出容忍值则移除
          * @return 是否被移除
@@ -403,6 +851,70 @@ namespace atbus {
          */
         void add_ping_timer(endpoint::ptr_t& ep);
 
+        /**
+         * @brief 链路上最近收到过消息时检查是否可以跳过这一次ping
+         * @return 连续跳过未超过conf.ping_skip_limit个ping间隔时返回true，提供服务的端点总是返回false
+         */
+        bool check_ping_skip(endpoint& ep, uint64_t tick);
+
+        // 全局路由表的修改，有变更时增加版本号并合并到下一次推送
+        bool sync_set_node(bus_id_t id, uint32_t children_mask, bool has_global_tree, bus_id_t source, uint32_t snapshot);
+        void sync_remove_node(sync_node_t& sn);
+        void sync_remove_source(bus_id_t source);
+        void sync_schedule_push();
+
+        /**
+         * @brief 发送base_version之后的变更，base_version为0时发送全量，数据太多时分成多个消息
+         * @param cmd NODE_SYNC_REQ或NODE_SYNC_RSP
+         * @param ep 同步对象，来源是它的节点不会发送
+         */
+        int send_node_sync(int cmd, endpoint& ep, uint64_t base_version);
+
+        /**
+         * @brief 所有同步对象都已经收到的移除记录可以清理了
+         */
+        void sync_prune();
+
+        /**
+         * @brief 父节点下发了新的兄弟节点，有全局路由表时直接连接，以后发往兄弟子树的消息不再经过父节点
+         */
+        void sync_connect_brother(const protocol::node_data& nd);
+
+        // 组关注的修改，子树关注的组有变化时合并到下一次上报
+        void group_add_interest(uint64_t gid, bus_id_t child);
+        void group_remove_interest(uint64_t gid, bus_id_t child);
+        void group_remove_child(bus_id_t child);
+        void group_schedule_push();
+
+        /**
+         * @brief 向父节点全量上报子树关注的组
+         * @return 0或错误码，没有父节点时直接成功
+         */
+        int push_group_sync();
+
+        /**
+         * @brief 组播消息发往来源以外的有关注的子节点和父节点
+         * @param m 组播消息，router会加入自身
+         * @param from_id 上一跳的节点，自身发起时为自身ID
+         */
+        int dispatch_group_msg(protocol::msg& m, bus_id_t from_id);
+
+        /**
+         * @brief 在自身和直接连接的节点里选择服务实例
+         * @param service 服务类型
+         * @param key_hash 路由键的哈希，0表示选择负载最低的实例
+         * @return 没有可选的实例时返回NULL
+         */
+        endpoint* select_service_endpoint(uint64_t service, uint32_t key_hash);
+
+        /**
+         * @brief 服务消息发给选出的实例，没有时发给父节点
+         * @param conn 收到消息的连接，自身发起时为NULL
+         * @param m 服务消息
+         * @param target 导出选中的实例
+         */
+        int dispatch_service_msg(connection* conn, protocol::msg& m, bus_id_t* target);
+
     public:
         void stat_add_dispatch_times();
 
@@ -432,23 +944,81 @@ namespace atbus {
         typedef struct {
             template<typename TObj>
             struct timer_desc_ls {
-                typedef std::pair<time_t, TObj> pair_type;
+                typedef std::pair<uint64_t, TObj> pair_type;
                 typedef std::list<pair_type> type;
             };
 
+            template<typename TObj>
+            struct timer_desc_wheel {
+                typedef detail::timer_wheel<TObj> type;
+                typedef typename type::value_type pair_type;
+            };
+
             time_t sec;
             time_t usec;
 
             time_t node_sync_push;                                          // 节点变更推送
+            time_t group_sync_push;                                         // 组关注变更的上报
+            time_t shortcut_check;                                          // 跨子树直连的空闲检测和转发流量统计的清理
             time_t father_opr_time_point;                                   // 父节点操作时间（断线重连或Ping）
-            timer_desc_ls<std::weak_ptr<endpoint> >::type ping_list;        // 定时ping
-            timer_desc_ls<connection::ptr_t>::type connecting_list;         // 未完成连接（正在网络连接或握手）
-            std::list<endpoint::ptr_t>  pending_check_list_;                // 待检测列表
+            // 以下定时器按毫秒tick，时间轮的定时器触发时再检查对象是否仍然有效
+            timer_desc_wheel<std::weak_ptr<endpoint> >::type ping_list;     // 定时ping
+            // 未完成连接（正在网络连接或握手），超时时间相同所以按顺序排列，只需要检查队首
+            // 连接完成后要尽快释放引用，所以不放在时间轮里
+            timer_desc_ls<connection::ptr_t>::type connecting_list;
+            std::vector<endpoint::ptr_t> pending_check_list_;               // 待检测列表
+            timer_desc_wheel<std::pair<bus_id_t, uint32_t> >::type fragment_list; // 分片重组超时
+
+            // 触发的定时器的输出缓冲区，复用内存
+            std::vector<timer_desc_wheel<std::weak_ptr<endpoint> >::pair_type> ping_expired;
+            std::vector<timer_desc_wheel<std::pair<bus_id_t, uint32_t> >::pair_type> fragment_expired;
+            std::vector<endpoint::ptr_t> checking_list;
         } evt_timer_t;
         evt_timer_t event_timer_;
 
         // 轮训接收通道集
         detail::buffer_block* static_buffer_;
+        // 发送消息的打包缓冲区
+        detail::buffer_block* pack_buffer_;
+        // 批量发送和分片发送的数据打包缓冲区
+        std::vector<unsigned char> send_data_buffer_;
+        // 类型化发送的编码缓冲区
+        std::vector<unsigned char> send_encode_buffer_;
+        // 压缩缓冲区
+        std::vector<unsigned char> compress_buffer_;
+        // 已注册的压缩算法，按ID索引
+        const compression::codec_t* compression_codecs_[compression::algorithm_t::MAX];
+
+        // RPC进行中的调用，按调用ID开放寻址，容量是2的幂
+        typedef struct {
+            bool used;
+            uint32_t sequence;
+            bus_id_t target;                                                // 调用的目标节点，只接受它的回包
+            int type;
+            call_callback_fn_t callback;
+            void* priv_data;
+            uint64_t start_ns;                                              // 发起时间，统计延迟
+            uint64_t expire_tick;                                           // 超时时间，毫秒
+        } call_entry_t;
+        std::vector<call_entry_t> call_table_;
+        size_t call_count_;
+        // RPC超时，按毫秒tick，触发时用expire_tick判断调用是否还有效
+        detail::timer_wheel<uint32_t> call_timer_;
+        std::vector<detail::timer_wheel<uint32_t>::value_type> call_expired_;
+
+        // 分片重组，按(来源节点, 消息序号)索引，分片按顺序到达，recv_size即下一个分片的偏移
+        typedef std::pair<bus_id_t, uint32_t> fragment_key_t;
+        typedef struct {
+            int type;
+            size_t recv_size;
+            uint64_t expire_tick;                                           // 超时时间，毫秒，序号复用时用来区分时间轮里旧的定时器
+            std::vector<unsigned char> data;
+        } fragment_recv_t;
+        std::map<fragment_key_t, fragment_recv_t> fragment_recv_;
+        size_t fragment_recv_size_;                                         // 重组缓冲区已使用的长度
+        // 解包消息的内存池(msgpack::zone)和引用计数
+        void* decode_arena_;
+        size_t decode_arena_ref_;
         detail::auto_select_map<std::string, connection::ptr_t>::type proc_connections_;
 
         // 基于事件的通道信息
@@ -467,14 +1037,101 @@ namespace atbus {
         // 子节点
         endpoint_collection_t node_children_;
 
+        // 按流量建立的跨子树直连
+        endpoint_collection_t node_shortcut_;
+
+        // 转发流量统计，按(来源, 目标)索引
+        typedef std::pair<bus_id_t, bus_id_t> relay_pair_t;
+        typedef struct {
+            time_t window;                                                  // 统计的秒
+            size_t count;                                                   // 这一秒内的转发次数
+            time_t notify_time;                                             // 上一次通知来源直连的时间
+        } relay_traffic_t;
+        std::map<relay_pair_t, relay_traffic_t> relay_traffic_;
+
+        // 路由缓存，目标节点到数据连接，版本号和route_epoch_不一致时无效
+        typedef struct {
+            uint64_t epoch;
+            endpoint* ep;
+            connection* conn;
+        } route_cache_t;
+        typedef ATBUS_ADVANCE_TYPE_MAP(bus_id_t, route_cache_t) route_cache_collection_t;
+        route_cache_collection_t route_cache_;
+        uint64_t route_epoch_;
+        uint64_t data_stripe_seq_;                                          // 不要求顺序的数据消息轮流使用数据连接的序号
+
         // 全局路由表
+        sync_node_collection_t sync_nodes_;
+        size_t sync_node_count_;                                            // 未移除的节点数
+        uint64_t sync_version_;
+        uint64_t sync_report_version_;                                      // 已经上报给父节点的版本号，0表示下一次全量上报
+
+        // 组播，子树(包含自身)关注的组，按组ID索引
+        typedef struct {
+            bool local;                                                     // 自身是否加入
+            std::vector<bus_id_t> children;                                 // 有关注的子节点
+        } group_member_t;
+        typedef ATBUS_ADVANCE_TYPE_MAP(uint64_t, group_member_t) group_collection_t;
+        group_collection_t groups_;
+        std::map<bus_id_t, std::vector<uint64_t> > group_child_reports_;   // 子节点上一次上报的组，有序
+
+        // 服务路由
+        uint32_t load_hint_;                                                // 自身的负载提示
 
         // 统计信息
+    public:
         struct stat_info_t {
             size_t dispatch_times;
 
+            // 压缩，压缩率为compress_bytes / compress_origin_bytes
+            uint64_t compress_times;                // 压缩后发送的次数
+            uint64_t compress_skip_times;           // 压缩后没有变小而按原始数据发送的次数
+            uint64_t compress_origin_bytes;         // 压缩后发送的数据压缩前的总长度
+            uint64_t compress_bytes;                // 压缩后发送的数据压缩后的总长度
+            uint64_t compress_cost_ns;              // 压缩总耗时(包含没有变小的)，纳秒
+            uint64_t decompress_times;              // 解压次数
+            uint64_t decompress_cost_ns;            // 解压总耗时，纳秒
+
+            // RPC，延迟分布按微秒的2的幂分桶，第i个桶是[2^i, 2^(i+1))微秒，第0个桶包含1微秒以下
+            uint64_t call_times;                    // 完成的调用次数(包含失败，不包含超时)
+            uint64_t call_failed_times;             // 失败的调用次数
+            uint64_t call_timeout_times;            // 超时的调用次数
+            uint64_t call_latency_ns;               // 完成的调用的总延迟，纳秒
+            uint64_t call_latency_max_ns;           // 完成的调用的最大延迟，纳秒
+            uint64_t call_latency_histogram[ATBUS_MACRO_CALL_LATENCY_BUCKETS];
+
+            // 节点同步
+            uint64_t node_sync_send_times;          // 发送的同步消息数
+            uint64_t node_sync_full_times;          // 其中全量同步的次数(分成多个消息时只算一次)
+            uint64_t node_sync_recv_times;          // 接收的同步消息数
+
+            // 路由缓存
+            uint64_t route_cache_hit_times;         // 数据消息命中路由缓存的次数
+            uint64_t route_cache_miss_times;        // 数据消息重新查找路由的次数
+
+            // 跨子树直连
+            uint64_t shortcut_notify_times;         // 转发时通知来源直连目标的次数
+            uint64_t shortcut_idle_times;           // 因为空闲断开的直连数
+
+            // 心跳
+            uint64_t ping_times;                    // 发送的ping数
+            uint64_t ping_skip_times;               // 链路上有其他消息而跳过的ping数
+
+            // 组播
+            uint64_t group_send_times;              // 组播数据在链路上的发送次数(发起和转发)
+            uint64_t group_recv_times;              // 有关注而回调的组播数据数
+            uint64_t group_sync_send_times;         // 上报组关注的次数
+
+            // 服务路由
+            uint64_t service_send_times;            // 选出实例后发送的次数(包含发给自身的和转发时选出的)
+            uint64_t service_forward_times;         // 没有可选的实例而发给父节点的次数
+
             stat_info_t();
         };
+
+        inline const stat_info_t& get_stat() const { return stat_; }
+
+    private:
         stat_info_t stat_;
 
         // 调试辅助函数
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#ifndef LIBATBUS_DETAIL_ENDPOINT_INDEX_H_
+#define LIBATBUS_DETAIL_ENDPOINT_INDEX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace atbus {
+    namespace detail {
+        /**
+         * @brief 按子域区间索引的端点集合，区间互不重叠，按上界排序保存在连续数组里
+         * @note 查找只访问连续的(max_id, min_id, 端点地址)数组，二分查找没有分支，
+         *       持有端点的智能指针单独保存，只在增删和遍历时使用
+         *       增删是O(n)的内存移动，端点注册和下线是低频操作
+         */
+        template<typename TId, typename TPtr>
+        class endpoint_index {
+        public:
+            typedef typename TPtr::element_type element_type;
+            typedef typename std::vector<TPtr>::const_iterator const_iterator;
+
+            struct entry_t {
+                TId max_id;
+                TId min_id;
+                element_type* ptr;
+            };
+
+            inline size_t size() const { return entries_.size(); }
+            inline bool empty() const { return entries_.empty(); }
+
+            // 遍历持有的端点
+            inline const_iterator begin() const { return owners_.begin(); }
+            inline const_iterator end() const { return owners_.end(); }
+
+            inline const TPtr& at(size_t idx) const { return owners_[idx]; }
+            inline element_type* get(size_t idx) const { return entries_[idx].ptr; }
+
+            void clear() {
+                entries_.clear();
+                owners_.clear();
+            }
+
+            void swap(endpoint_index& other) {
+                entries_.swap(other.entries_);
+                owners_.swap(other.owners_);
+            }
+
+            /**
+             * @brief 第一个上界不小于id的位置，没有则返回size()
+             */
+            size_t lower_bound(TId id) const {
+                size_t n = entries_.size();
+                if (0 == n) {
+                    return 0;
+                }
+
+                // 每次比较只决定下一次的起点，编译器会生成条件传送而不是跳转
+                const entry_t* base = &entries_[0];
+                while (n > 1) {
+                    size_t half = n >> 1;
+                    base = (base[half].max_id < id) ? base + half : base;
+                    n -= half;
+                }
+
+                return static_cast<size_t>(base - &entries_[0]) + (base->max_id < id ? 1 : 0);
+            }
+
+            /**
+             * @brief 查找区间包含id的端点
+             * @return 没有则返回NULL
+             */
+            element_type* find(TId id) const {
+                size_t idx = lower_bound(id);
+                if (idx >= entries_.size() || entries_[idx].min_id > id) {
+                    return NULL;
+                }
+
+                return entries_[idx].ptr;
+            }
+
+            /**
+             * @brief 添加端点
+             * @return 和已有的区间重叠时失败
+             */
+            bool insert(TId min_id, TId max_id, const TPtr& p) {
+                if (!p || min_id > max_id) {
+                    return false;
+                }
+
+                // 前面的区间上界都小于min_id，只需要检查这一个
+                size_t idx = lower_bound(min_id);
+                if (idx < entries_.size() && entries_[idx].min_id <= max_id) {
+                    return false;
+                }
+
+                entry_t ent;
+                ent.max_id = max_id;
+                ent.min_id = min_id;
+                ent.ptr = p.get();
+                entries_.insert(entries_.begin() + idx, ent);
+                owners_.insert(owners_.begin() + idx, p);
+                return true;
+            }
+
+            void erase(size_t idx) {
+                if (idx >= entries_.size()) {
+                    return;
+                }
+
+                entries_.erase(entries_.begin() + idx);
+                owners_.erase(owners_.begin() + idx);
+            }
+
+        private:
+            std::vector<entry_t> entries_;
+            std::vector<TPtr> owners_;
+        };
+    }
+}
+
+#endif
@@ -17,6 +17,7 @@ namespace atbus {
         typedef uv_tcp_t tcp_t;
         typedef uv_handle_t handle_t;
         typedef uv_timer_t timer_t;
+        typedef uv_buf_t buf_t;
 
         typedef uv_os_fd_t fd_t;
 
@@ -32,6 +32,8 @@ namespace atbus {
         extern int mem_attach(void* buf, size_t len, mem_channel** channel, const mem_conf* conf);
         extern int mem_init(void* buf, size_t len, mem_channel** channel, const mem_conf* conf);
         extern int mem_send(mem_channel* channel, const void* buf, size_t len);
+        // 把多个数据块合并成一个数据包发送
+        extern int mem_send_v(mem_channel* channel, const void* const bufs[], const size_t lens[], size_t n);
         extern int mem_recv(mem_channel* channel, void* buf, size_t len, size_t* recv_size);
         extern std::pair<size_t, size_t> mem_last_action();
         extern void mem_show_channel(mem_channel* channel, std::ostream& out, bool need_node_status, size_t need_node_data);
@@ -41,7 +43,10 @@ namespace atbus {
         extern int shm_attach(key_t shm_key, size_t len, shm_channel** channel, const shm_conf* conf);
         extern int shm_init(key_t shm_key, size_t len, shm_channel** channel, const shm_conf* conf);
         extern int shm_close(key_t shm_key);
+        // 已存在的共享内存由其他仍在运行的进程创建时返回EN_ATBUS_ERR_SHM_IN_USE
+        extern int shm_check_owner(key_t shm_key);
         extern int shm_send(shm_channel* channel, const void* buf, size_t len);
+        extern int shm_send_v(shm_channel* channel, const void* const bufs[], const size_t lens[], size_t n);
         extern int shm_recv(shm_channel* channel, void* buf, size_t len, size_t* recv_size);
         extern std::pair<size_t, size_t> shm_last_action();
         extern void shm_show_channel(shm_channel* channel, std::ostream& out, bool need_node_status, size_t need_node_data);
@@ -66,6 +71,7 @@ namespace atbus {
         extern int io_stream_disconnect(io_stream_channel* channel, io_stream_connection* connection, io_stream_callback_t callback);
         extern int io_stream_disconnect_fd(io_stream_channel* channel, adapter::fd_t fd, io_stream_callback_t callback);
         extern int io_stream_send(io_stream_connection* connection, const void* buf, size_t len);
+        extern int io_stream_send_v(io_stream_connection* connection, const void* const bufs[], const size_t lens[], size_t n);
 
         extern void io_stream_show_channel(io_stream_channel* channel, std::ostream& out);
     }
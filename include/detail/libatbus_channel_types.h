@@ -17,6 +17,7 @@
 #include <ostream>
 #include <string>
 #include <map>
+#include <vector>
 
 #include "std/smart_ptr.h"
 #include "lock/seq_alloc.h"
@@ -95,6 +96,8 @@ namespace atbus {
                 EN_CF_LISTEN = 0,
                 EN_CF_CONNECT,
                 EN_CF_ACCEPT,
+                EN_CF_ZERO_COPY,    // 已开启SO_ZEROCOPY
+                EN_CF_PACKET,       // unixpkt连接(SOCK_SEQPACKET)，内核保证消息边界，handle是uv_poll_t
                 EN_CF_MAX,
             } flag_t;
 
@@ -129,6 +132,29 @@ namespace atbus {
             } read_head_t;
             read_head_t read_head;
             detail::buffer_manager write_buffers;           // 写数据缓冲区(两种Buffer管理方式，一种动态，一种静态)
+            size_t write_inflight;                          // 已提交给libuv但尚未回调的写请求数
+            /**
+             * @brief 有写请求未完成时新的数据包暂不提交，而是在前一个写请求回调后合并成一个writev一起提交
+             *        这样高负载时每个系统调用可以写出多个数据包，低负载时不会增加延迟
+             *        unixpkt连接这里是所有尚未发送的数据包，可写时通过sendmmsg一起发送
+             */
+            std::vector<adapter::buf_t> write_batch;
+
+            /**
+             * @brief MSG_ZEROCOPY发送状态，同一时间最多只有一个零拷贝发送的数据块
+             *        内核通过错误队列通知发送完成之前数据块不能释放，所以只在写缓冲区为空时才使用零拷贝发送
+             */
+            typedef struct {
+                void* block;            // 等待内核通知的数据块(一定是写缓冲区队首)
+                void* done_req;         // 排在零拷贝数据块后面，已经回调的最后一个写请求
+                uint32_t send_id;       // 零拷贝数据块的通知序号
+                uint32_t next_id;       // 下一次零拷贝发送的通知序号(内核对每个socket从0开始计数)
+                bool wait_notify;       // 等待内核通知
+                bool wait_write;        // 只发送了一部分，剩余的数据通过uv_write发送
+                size_t send_times;      // 零拷贝发送次数
+                size_t copied_times;    // 内核实际回退为拷贝的次数(比如本地回环)
+            } zero_copy_t;
+            zero_copy_t zero_copy;
 
             // 自定义数据区域
             void* data;
@@ -139,12 +165,16 @@ namespace atbus {
 
             bool is_noblock;
             bool is_nodelay;
+            bool is_reuse_port;         // 监听时设置SO_REUSEPORT，多个线程的channel可以监听同一个地址，由内核分配新连接
             size_t send_buffer_static;
             size_t recv_buffer_static;
             size_t send_buffer_max_size;
             size_t send_buffer_limit_size;
             size_t recv_buffer_max_size;
             size_t recv_buffer_limit_size;
+            size_t send_batch_number;   // 单次合并提交的最大数据包数量，0或1表示每个数据包立即提交
+            size_t send_zero_copy_threshold; // 不小于这个长度的数据包使用MSG_ZEROCOPY发送，0表示关闭(仅Linux下的TCP连接有效)
+            size_t recv_batch_number;   // unixpkt连接单次recvmmsg最多接收的数据包数量
 
             time_t confirm_timeout;
             int backlog;     // backlog indicates the number of connections the kernel might queue
@@ -170,6 +200,7 @@ namespace atbus {
             io_stream_callback_evt_t            evt;
 
             int error_code; // 记录外部的错误码
+            std::vector<char> recv_packet_buffer; // unixpkt连接recvmmsg的接收区，所有连接共享
             // 统计信息
             util::lock::seq_alloc_u32           active_reqs; // 正在进行的req数量
 
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#ifndef LIBATBUS_DETAIL_LIBATBUS_COMPRESSION_H_
+#define LIBATBUS_DETAIL_LIBATBUS_COMPRESSION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace atbus {
+    namespace compression {
+        struct algorithm_t {
+            enum type {
+                NONE = 0,
+                LZ = 1,         /** 内置的LZ77类算法，格式和LZ4的block格式类似 **/
+                MAX = 32,       /** 注册时ID要小于这个值，协商时按位合并成掩码 **/
+            };
+        };
+
+        /**
+         * @brief 压缩算法接口，内置的算法不够用时可以通过node::register_compression注册(比如lz4、zstd)
+         * @note 收发双方都注册了同一个ID的算法时才会使用
+         */
+        struct codec_t {
+            uint32_t id;
+            const char* name;
+
+            /**
+             * @brief 压缩
+             * @param out_len 输出缓冲区长度，压缩后超过这个长度时直接放弃
+             * @return 压缩后的长度，失败或无法压缩到out_len以内时返回0
+             */
+            size_t (*compress)(const void* in, size_t in_len, void* out, size_t out_len);
+
+            /**
+             * @brief 解压
+             * @param out_len 原始数据长度，必须正好解出这么多数据
+             * @return 成功返回true，数据错误返回false
+             */
+            bool (*decompress)(const void* in, size_t in_len, void* out, size_t out_len);
+        };
+
+        size_t lz_compress(const void* in, size_t in_len, void* out, size_t out_len);
+
+        bool lz_decompress(const void* in, size_t in_len, void* out, size_t out_len);
+
+        /**
+         * @brief 内置的LZ算法
+         */
+        const codec_t* lz_codec();
+    }
+}
+
+#endif
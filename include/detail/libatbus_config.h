@@ -26,6 +26,25 @@
 #define ATBUS_MACRO_DATA_SMALL_SIZE 512
 #endif
 
+#ifndef ATBUS_MACRO_ROUTER_MAX_DEPTH
+#define ATBUS_MACRO_ROUTER_MAX_DEPTH 32
+#endif
+
+// 路由缓存的最大目标数，超出后清空重建
+#ifndef ATBUS_MACRO_ROUTE_CACHE_SIZE
+#define ATBUS_MACRO_ROUTE_CACHE_SIZE 65536
+#endif
+
+// EN_CONF_AUTO_SHM时节点接收通道的共享内存key基数的默认值(conf.auto_shm_key_base)
+#ifndef ATBUS_MACRO_SHM_AUTO_KEY_BASE
+#define ATBUS_MACRO_SHM_AUTO_KEY_BASE 0x41420000
+#endif
+
+// RPC延迟分布的分桶数量，按微秒的2的幂分桶，默认到2^24微秒(约16秒)
+#ifndef ATBUS_MACRO_CALL_LATENCY_BUCKETS
+#define ATBUS_MACRO_CALL_LATENCY_BUCKETS 25
+#endif
+
 #if defined(__cplusplus) && (__cplusplus >= 201103L || \
         (defined(_MSC_VER) && (_MSC_VER == 1500 && defined (_HAS_TR1)) || (_MSC_VER > 1500 && defined(_HAS_CPP0X) && _HAS_CPP0X)) || \
         (defined(__GNUC__) && defined(__GXX_EXPERIMENTAL_CXX0X__)) \
@@ -45,6 +45,7 @@ typedef enum {
 
     EN_ATBUS_ERR_SHM_GET_FAILED             = -301,// 连接共享内存出错，具体错误原因可以查看errno或类似的位置
     EN_ATBUS_ERR_SHM_NOT_FOUND              = -302,// 共享内存未找到
+    EN_ATBUS_ERR_SHM_IN_USE                 = -303,// 共享内存已被其他仍在运行的进程创建
 
     EN_ATBUS_ERR_SOCK_BIND_FAILED           = -401,// 绑定地址或端口失败
     EN_ATBUS_ERR_SOCK_LISTEN_FAILED         = -402,// 监听失败
@@ -0,0 +1,198 @@
+#ifndef LIBATBUS_MESSAGE_TRAITS_H_
+#define LIBATBUS_MESSAGE_TRAITS_H_
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include <exception>
+
+#include "libatbus_config.h"
+#include "libatbus_protocol.h"
+
+#ifdef ATBUS_MACRO_ENABLE_STATIC_ASSERT
+#include <type_traits>
+#endif
+
+/**
+ * @brief 类型化消息的编解码规则，node::send<T>发送和atbus::as<T>接收时使用
+ * @note 默认使用msgpack编码，T需要有msgpack的适配(MSGPACK_DEFINE或adaptor特化)
+ *       固定内存布局的POD类型可以用ATBUS_MACRO_MESSAGE_POD_TRAITS(T)声明为直接按内存发送，
+ *       发送时不需要编码，接收时地址对齐则直接引用接收缓冲区，否则memcpy一份
+ *       POD类型按内存发送要求收发双方的字节序和结构布局一致
+ */
+
+namespace atbus {
+    namespace detail {
+        template<typename T>
+        struct message_align_of {
+            struct helper_t {
+                char c;
+                T t;
+            };
+
+            enum { value = sizeof(helper_t) - sizeof(T) };
+        };
+
+        /**
+         * @brief 把msgpack编码追加到复用的std::vector里
+         */
+        class message_vector_writer {
+        public:
+            explicit message_vector_writer(std::vector<unsigned char>& buffer): buffer_(&buffer) {}
+
+            inline void write(const char* data, size_t len) {
+                buffer_->insert(buffer_->end(), reinterpret_cast<const unsigned char*>(data), reinterpret_cast<const unsigned char*>(data) + len);
+            }
+
+        private:
+            std::vector<unsigned char>* buffer_;
+        };
+
+        inline bool message_unpack_reference_buffer(msgpack::type::object_type, size_t, void*) {
+            return true;
+        }
+    }
+
+    /**
+     * @brief msgpack编码的消息
+     */
+    template<typename T>
+    struct message_msgpack_traits {
+        /**
+         * @brief 编码消息
+         * @param v 消息
+         * @param buffer 可复用的编码缓冲区
+         * @param len 编码后的长度
+         * @return 编码后的数据地址，失败返回NULL
+         */
+        static const void* encode(const T& v, std::vector<unsigned char>& buffer, size_t& len) {
+            buffer.clear();
+            detail::message_vector_writer writer(buffer);
+            try {
+                msgpack::pack(writer, v);
+            } catch (const std::exception&) {
+                len = 0;
+                return NULL;
+            }
+
+            len = buffer.size();
+            return buffer.empty() ? NULL : &buffer[0];
+        }
+
+        /**
+         * @brief 解码消息
+         * @param buffer 接收到的数据
+         * @param len 接收到的数据长度
+         * @param storage 需要复制时的存储区
+         * @return 消息地址，失败返回NULL
+         */
+        static const T* view(const void* buffer, size_t len, T& storage) {
+            if (NULL == buffer || 0 == len) {
+                return NULL;
+            }
+
+            msgpack::zone z;
+            size_t offset = 0;
+            try {
+                msgpack::object obj = msgpack::unpack(z, reinterpret_cast<const char*>(buffer), len, offset,
+                    detail::message_unpack_reference_buffer);
+                obj.convert(storage);
+            } catch (const std::exception&) {
+                return NULL;
+            }
+
+            return &storage;
+        }
+    };
+
+    /**
+     * @brief 按内存直接发送的固定布局消息
+     */
+    template<typename T>
+    struct message_pod_traits {
+#ifdef ATBUS_MACRO_ENABLE_STATIC_ASSERT
+        static_assert(std::is_pod<T>::value, "message_pod_traits can only be used with pod type");
+#endif
+
+        static const void* encode(const T& v, std::vector<unsigned char>&, size_t& len) {
+            len = sizeof(T);
+            return &v;
+        }
+
+        static const T* view(const void* buffer, size_t len, T& storage) {
+            if (NULL == buffer || sizeof(T) != len) {
+                return NULL;
+            }
+
+            // 接收缓冲区对齐时直接引用，不需要复制
+            if (0 == reinterpret_cast<uintptr_t>(buffer) % detail::message_align_of<T>::value) {
+                return reinterpret_cast<const T*>(buffer);
+            }
+
+            memcpy(&storage, buffer, sizeof(T));
+            return &storage;
+        }
+    };
+
+    /**
+     * @brief 消息类型的编解码规则，默认使用msgpack，可以特化
+     */
+    template<typename T>
+    struct message_traits : public message_msgpack_traits<T> {};
+
+    /**
+     * @brief 接收消息的视图
+     * @note 直接引用接收缓冲区时，只在on_recv_msg回调内有效
+     */
+    template<typename T>
+    class message_view {
+    public:
+        message_view(const void* buffer, size_t len): ptr_(NULL), storage_() {
+            ptr_ = message_traits<T>::view(buffer, len, storage_);
+        }
+
+        message_view(const message_view& other): ptr_(NULL), storage_(other.storage_) {
+            ptr_ = other.ptr_ == &other.storage_ ? &storage_ : other.ptr_;
+        }
+
+        message_view& operator=(const message_view& other) {
+            storage_ = other.storage_;
+            ptr_ = other.ptr_ == &other.storage_ ? &storage_ : other.ptr_;
+            return *this;
+        }
+
+        inline const T* get() const { return ptr_; }
+        inline const T* operator->() const { return ptr_; }
+        inline const T& operator*() const { return *ptr_; }
+        inline bool valid() const { return NULL != ptr_; }
+
+    private:
+        const T* ptr_;
+        T storage_;
+    };
+
+    /**
+     * @brief 把接收到的数据按T解码
+     * @param buffer on_recv_msg回调的数据
+     * @param len on_recv_msg回调的数据长度
+     * @return 消息视图，解码失败时valid()返回false
+     */
+    template<typename T>
+    inline message_view<T> as(const void* buffer, size_t len) {
+        return message_view<T>(buffer, len);
+    }
+}
+
+/**
+ * @brief 声明T按内存直接发送，必须在全局命名空间中使用
+ */
+#define ATBUS_MACRO_MESSAGE_POD_TRAITS(T) \
+    namespace atbus { \
+        template<> \
+        struct message_traits< T > : public message_pod_traits< T > {}; \
+    }
+
+#endif // LIBATBUS_MESSAGE_TRAITS_H_
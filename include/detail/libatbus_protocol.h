@@ -6,6 +6,7 @@
 #include <cstddef>
 #include <stdint.h>
 #include <ostream>
+#include <new>
 
 #include <msgpack.hpp>
 
@@ -16,6 +17,10 @@ enum ATBUS_PROTOCOL_CMD {
     ATBUS_CMD_DATA_TRANSFORM_REQ = 1,
     ATBUS_CMD_DATA_TRANSFORM_RSP,
     ATBUS_CMD_CUSTOM_CMD_REQ,
+    ATBUS_CMD_BATCH,                    // 多个数据消息合并，body和DATA_TRANSFORM_REQ相同，content里是多个数据块
+    ATBUS_CMD_GROUP_DATA,               // 组播数据，body和DATA_TRANSFORM_REQ相同，to是组ID，沿节点树逐跳扇出
+    ATBUS_CMD_SERVICE_DATA,             // 发往任意服务实例的数据，body和DATA_TRANSFORM_REQ相同，to是服务类型，head.sequence是key的哈希
+                                        // 发送方不知道服务实例时发给父节点，选出实例的节点改为DATA_TRANSFORM_REQ转发
 
     // 节点控制协议
     ATBUS_CMD_NODE_SYNC_REQ = 9,
@@ -25,7 +30,7 @@ enum ATBUS_PROTOCOL_CMD {
     ATBUS_CMD_NODE_CONN_SYN,
     ATBUS_CMD_NODE_PING,
     ATBUS_CMD_NODE_PONG,
-
+    ATBUS_CMD_NODE_GROUP_SYNC,          // 子节点向父节点上报子树内关注的组
     ATBUS_CMD_MAX
 };
 
@@ -37,6 +42,78 @@ namespace atbus {
 #define ATBUS_MACRO_BUSID_TYPE uint64_t
 #endif
 
+#ifndef ATBUS_MACRO_ROUTER_MAX_DEPTH
+#define ATBUS_MACRO_ROUTER_MAX_DEPTH 32
+#endif
+
+        /**
+         * @brief 固定容量的数组，数据直接存放在对象内，解包时不需要分配内存
+         */
+        template<typename T, size_t MAX_SIZE>
+        class inline_array {
+        public:
+            typedef T value_type;
+            typedef T* iterator;
+            typedef const T* const_iterator;
+
+            inline_array(): size_(0) {}
+
+            inline size_t size() const { return size_; }
+            inline static size_t max_size() { return MAX_SIZE; }
+            inline bool empty() const { return 0 == size_; }
+            inline bool full() const { return size_ >= MAX_SIZE; }
+
+            inline T& operator[](size_t i) { return data_[i]; }
+            inline const T& operator[](size_t i) const { return data_[i]; }
+            inline T& front() { return data_[0]; }
+            inline const T& front() const { return data_[0]; }
+            inline T& back() { return data_[size_ - 1]; }
+            inline const T& back() const { return data_[size_ - 1]; }
+
+            inline iterator begin() { return data_; }
+            inline const_iterator begin() const { return data_; }
+            inline iterator end() { return data_ + size_; }
+            inline const_iterator end() const { return data_ + size_; }
+
+            /**
+             * @brief 追加元素
+             * @return 已满时返回false
+             */
+            bool push_back(const T& v) {
+                if (full()) {
+                    return false;
+                }
+
+                data_[size_++] = v;
+                return true;
+            }
+
+            inline void pop_back() {
+                if (size_ > 0) {
+                    --size_;
+                }
+            }
+
+            /**
+             * @brief 修改元素个数
+             * @return 超出容量时返回false且不修改
+             */
+            bool resize(size_t s) {
+                if (s > MAX_SIZE) {
+                    return false;
+                }
+
+                size_ = s;
+                return true;
+            }
+
+            inline void clear() { size_ = 0; }
+
+        private:
+            T data_[MAX_SIZE];
+            size_t size_;
+        };
+
         struct bin_data_block {
             const void* ptr;
             size_t size;
@@ -75,15 +152,26 @@ namespace atbus {
             }
         };
 
+        /**
+         * @brief 数据转发消息
+         * @note router是容量固定为ATBUS_MACRO_ROUTER_MAX_DEPTH(默认32)的inline_array，不再是std::vector，
+         *       和旧版本源码和二进制都不兼容。满了以后不能再转发，按ttl超限(EN_ATBUS_ERR_ATNODE_TTL)处理。
+         *       这个宏会改变forward_data和msg_body的大小，所有使用libatbus头文件的模块都要用相同的值编译
+         */
         struct forward_data {
             ATBUS_MACRO_BUSID_TYPE from;                // ID: 0
             ATBUS_MACRO_BUSID_TYPE to;                  // ID: 1
-            std::vector<ATBUS_MACRO_BUSID_TYPE> router; // ID: 2
+            inline_array<ATBUS_MACRO_BUSID_TYPE, ATBUS_MACRO_ROUTER_MAX_DEPTH> router; // ID: 2
             bin_data_block content;                     // ID: 3
             int flags;                                  // ID: 4 | require a response message even success
 
             enum flag_t {
                 FLAG_REQUIRE_RSP = 0,
+                FLAG_BATCH,                 // content是多个合并的数据块(ATBUS_CMD_BATCH)，失败通知里也会保留
+                FLAG_FRAGMENT,              // content是超过msg_size的数据的一个分片，开头是分片头(libatbus_protocol_binary.h)
+                FLAG_COMPRESSED,            // content是压缩后的数据，开头是压缩头(libatbus_protocol_binary.h)，只在单个io_stream连接上有效
+                FLAG_RPC_REQUEST,           // node::call发起的请求，head.sequence是调用ID
+                FLAG_RPC_RESPONSE,          // node::reply的回包，head.sequence是调用ID，head.ret是被调方的返回码
             };
 
             forward_data(): from(0), to(0), flags(0) {
@@ -91,7 +179,7 @@ namespace atbus {
                 content.ptr = NULL;
             }
 
-            inline bool check_flag(flag_t f) { return 0 != (flags & (1 << f)); }
+            inline bool check_flag(flag_t f) const { return 0 != (flags & (1 << f)); }
             inline void set_flag(flag_t f) { flags |= (1 << f); }
             inline void unset_flag(flag_t f) { flags &= ~(1 << f); }
 
@@ -141,10 +229,11 @@ namespace atbus {
             bool has_global_tree;                       // ID: 2
             ATBUS_MACRO_BUSID_TYPE children_id_mask;
             std::vector<node_data> children;
+            std::vector<channel_data> channels;         // ID: 5 | 监听地址，只有发送方的直接子节点会带上，用于兄弟节点直连
 
             node_data() : bus_id(0), overwrite(false), has_global_tree(false), children_id_mask(0){}
 
-            MSGPACK_DEFINE(bus_id, overwrite, has_global_tree, children_id_mask, children);
+            MSGPACK_DEFINE(bus_id, overwrite, has_global_tree, children_id_mask, children, channels);
 
             template<typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const node_data& mbc) {
@@ -157,6 +246,9 @@ namespace atbus {
                 for (size_t i = 0; i < mbc.children.size(); ++i) {
                     os << "      " << mbc.children[i]<< std::endl;
                 }
+                for (size_t i = 0; i < mbc.channels.size(); ++i) {
+                    os << "        channels: " << mbc.channels[i] << std::endl;
+                }
                 os << std::endl <<
                     "      }";
 
@@ -164,10 +256,19 @@ namespace atbus {
             }
         };
 
+        /**
+         * @brief 节点同步的数据，NODE_SYNC_REQ是子节点上报自身子树，NODE_SYNC_RSP是父节点下发全局路由表
+         * @note 数据太多时分成多个消息发送，所有消息使用同一个消息序号，只有最后一个消息的version不为0
+         */
         struct node_tree {
-            std::vector<node_data> nodes;               // ID: 0
+            std::vector<node_data> nodes;               // ID: 0 | 新增或变更的节点，不使用children，所有节点平铺
+            uint64_t version;                           // ID: 1 | 发送方路由表的版本号
+            uint64_t base_version;                      // ID: 2 | 增量的基准版本号，0表示全量
+            std::vector<ATBUS_MACRO_BUSID_TYPE> removed;// ID: 3 | 已移除的节点
 
-            MSGPACK_DEFINE(nodes);
+            node_tree(): version(0), base_version(0) {}
+
+            MSGPACK_DEFINE(nodes, version, base_version, removed);
 
             template<typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const node_tree& mbc) {
@@ -175,6 +276,9 @@ namespace atbus {
                 for (size_t i = 0; i < mbc.nodes.size(); ++i) {
                     os << "      nodes: " << mbc.nodes[i] << std::endl;
                 }
+                os << "      version: " << mbc.version << std::endl <<
+                    "      base_version: " << mbc.base_version << std::endl <<
+                    "      removed: (" << mbc.removed.size() << ")" << std::endl;
                     
                 os<< "    }";
 
@@ -183,22 +287,32 @@ namespace atbus {
         };
 
         struct ping_data {
-            int64_t time_point;                         // ID: 0
+            int64_t time_point;                         // ID: 0, 发送方的单调时钟，纳秒，PONG原样返回
+            uint32_t load;                              // ID: 1, 发送方的负载提示(业务设置的队列深度)，PING和PONG都是发送方自己的
 
-            ping_data(): time_point(0) {}
+            ping_data(): time_point(0), load(0) {}
 
-            MSGPACK_DEFINE(time_point);
+            MSGPACK_DEFINE(time_point, load);
 
             template<typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const ping_data& mbc) {
                 os << "{" << std::endl <<
                     "      time_point: " << mbc.time_point << std::endl <<
+                    "      load: " << mbc.load << std::endl <<
                     "    }";
 
                 return os;
             }
         };
 
+        struct reg_feature_t {
+            enum type {
+                BINARY_DATA = 0,                    // 数据转发消息可以使用固定格式的二进制编码(libatbus_protocol_binary.h)
+                CONN_SYN_FORWARD = 1,               // 能转发目标不是自己的conn_syn(conn_data::bus_id)，不支持的节点会直接连接通知里的地址
+                MAX = 32,
+            };
+        };
+
         struct reg_data {
             ATBUS_MACRO_BUSID_TYPE bus_id;          // ID: 0
             int32_t pid;                            // ID: 1
@@ -206,11 +320,13 @@ namespace atbus {
             std::vector<channel_data> channels;     // ID: 3
             uint32_t children_id_mask;              // ID: 4
             bool has_global_tree;                   // ID: 5
-            
+            uint32_t compress_algorithms;           // ID: 6 | 支持的压缩算法掩码(1 << compression::algorithm_t)
+            std::vector<uint64_t> services;         // ID: 7 | 提供的服务类型，node::send_to_service按服务类型选择实例
+            uint32_t features;                      // ID: 8 | 支持的协议特性掩码(1 << reg_feature_t)，旧节点不发送这个字段即为0
 
-            reg_data():bus_id(0), pid(0), children_id_mask(0), has_global_tree(false) {}
+            reg_data():bus_id(0), pid(0), children_id_mask(0), has_global_tree(false), compress_algorithms(0), features(0) {}
 
-            MSGPACK_DEFINE(bus_id, pid, hostname, channels, children_id_mask, has_global_tree);
+            MSGPACK_DEFINE(bus_id, pid, hostname, channels, children_id_mask, has_global_tree, compress_algorithms, services, features);
 
             template<typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const reg_data& mbc) {
@@ -223,6 +339,9 @@ namespace atbus {
                 }
                 os<< "      children_id_mask: " << mbc.children_id_mask << std::endl <<
                     "      has_global_tree: " << mbc.has_global_tree << std::endl <<
+                    "      compress_algorithms: " << mbc.compress_algorithms << std::endl <<
+                    "      services: (" << mbc.services.size() << ")" << std::endl <<
+                    "      features: " << mbc.features << std::endl <<
                     "    }";
 
                 return os;
@@ -231,66 +350,139 @@ namespace atbus {
 
         struct conn_data {
             channel_data address;                   // ID: 0
+            ATBUS_MACRO_BUSID_TYPE bus_id;          // ID: 1 | 需要建立连接的节点，不是收到的节点时沿控制消息的路由转发，0表示收到的节点
+            ATBUS_MACRO_BUSID_TYPE target;          // ID: 2 | 地址所属的节点，已经有连接时不用再连，0表示未知
 
-            MSGPACK_DEFINE(address);
+            conn_data(): bus_id(0), target(0) {}
+
+            MSGPACK_DEFINE(address, bus_id, target);
 
             template<typename CharT, typename Traits>
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const conn_data& mbc) {
                 os << "{" << std::endl <<
                     "      address: " << mbc.address << std::endl <<
+                    "      bus_id: " << mbc.bus_id << std::endl <<
+                    "      target: " << mbc.target << std::endl <<
                     "    }";
 
                 return os;
             }
         };
 
-        class msg_body {
-        public:
-            forward_data* forward;
-            node_tree* sync;
-            ping_data* ping;
-            reg_data* reg;
-            conn_data* conn;
-            custom_command_data* custom;
-
-            msg_body(): forward(NULL), sync(NULL), ping(NULL), reg(NULL), conn(NULL), custom(NULL) {}
-            ~msg_body() {
-                if (NULL != forward) {
-                    delete forward;
-                }
+        /**
+         * @brief 组关注的上报数据，每次都是发送方子树(包含自身)关注的所有组的全量
+         */
+        struct group_data {
+            std::vector<uint64_t> groups;           // ID: 0
 
-                if (NULL != sync) {
-                    delete sync;
-                }
+            MSGPACK_DEFINE(groups);
 
-                if (NULL != ping) {
-                    delete ping;
-                }
+            template<typename CharT, typename Traits>
+            friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const group_data& mbc) {
+                os << "{" << std::endl <<
+                    "      groups: (" << mbc.groups.size() << ")" << std::endl <<
+                    "    }";
 
-                if (NULL != reg) {
-                    delete reg;
-                }
+                return os;
+            }
+        };
 
-                if (NULL != conn) {
-                    delete conn;
-                }
+        struct msg_body_type_t {
+            enum type {
+                NONE = 0,
+                FORWARD,
+                SYNC,
+                PING,
+                REG,
+                CONN,
+                CUSTOM,
+                GROUP,
+            };
+        };
 
-                if (NULL != custom) {
-                    delete custom;
+        template<typename TBody>
+        struct msg_body_traits;
+
+        template<> struct msg_body_traits<forward_data> { static const msg_body_type_t::type value = msg_body_type_t::FORWARD; };
+        template<> struct msg_body_traits<node_tree> { static const msg_body_type_t::type value = msg_body_type_t::SYNC; };
+        template<> struct msg_body_traits<ping_data> { static const msg_body_type_t::type value = msg_body_type_t::PING; };
+        template<> struct msg_body_traits<reg_data> { static const msg_body_type_t::type value = msg_body_type_t::REG; };
+        template<> struct msg_body_traits<conn_data> { static const msg_body_type_t::type value = msg_body_type_t::CONN; };
+        template<> struct msg_body_traits<custom_command_data> { static const msg_body_type_t::type value = msg_body_type_t::CUSTOM; };
+        template<> struct msg_body_traits<group_data> { static const msg_body_type_t::type value = msg_body_type_t::GROUP; };
+
+        /**
+         * @brief 消息体，同一时间只会有一种数据，所以直接放在对象内的共用存储区，不再单独分配内存
+         * @note 原来的forward、sync、ping、reg、conn、custom六个指针成员已经移除(源码和二进制都不兼容)，
+         *       用make_body<T>()创建，用forward()、reg()等接口或get<T>()访问，类型不匹配时返回NULL
+         */
+        class msg_body {
+        public:
+            msg_body(): type_(msg_body_type_t::NONE) {}
+            ~msg_body() { reset(); }
+
+            inline msg_body_type_t::type get_type() const { return type_; }
+
+            void reset() {
+                switch (type_) {
+                case msg_body_type_t::FORWARD: destroy<forward_data>(); break;
+                case msg_body_type_t::SYNC: destroy<node_tree>(); break;
+                case msg_body_type_t::PING: destroy<ping_data>(); break;
+                case msg_body_type_t::REG: destroy<reg_data>(); break;
+                case msg_body_type_t::CONN: destroy<conn_data>(); break;
+                case msg_body_type_t::CUSTOM: destroy<custom_command_data>(); break;
+                case msg_body_type_t::GROUP: destroy<group_data>(); break;
+                default: break;
                 }
+
+                type_ = msg_body_type_t::NONE;
             }
 
-            template<typename TPtr> 
-            TPtr* make_body(TPtr*& p) {
-                if (NULL != p) {
-                    return p;
+            /**
+             * @brief 获取或创建消息体，如果已有其他类型的消息体会先销毁
+             */
+            template<typename TBody>
+            TBody* make_body() {
+                if (msg_body_traits<TBody>::value == type_) {
+                    return reinterpret_cast<TBody*>(&storage_);
                 }
 
-                return p = new TPtr();
+                reset();
+                TBody* ret = new (static_cast<void*>(&storage_)) TBody();
+                type_ = msg_body_traits<TBody>::value;
+                return ret;
+            }
+
+            /**
+             * @brief 获取消息体，类型不匹配时返回NULL
+             */
+            template<typename TBody>
+            TBody* get() {
+                return msg_body_traits<TBody>::value == type_ ? reinterpret_cast<TBody*>(&storage_) : NULL;
             }
 
+            template<typename TBody>
+            const TBody* get() const {
+                return msg_body_traits<TBody>::value == type_ ? reinterpret_cast<const TBody*>(&storage_) : NULL;
+            }
+
+            inline forward_data* forward() { return get<forward_data>(); }
+            inline const forward_data* forward() const { return get<forward_data>(); }
+            inline node_tree* sync() { return get<node_tree>(); }
+            inline const node_tree* sync() const { return get<node_tree>(); }
+            inline ping_data* ping() { return get<ping_data>(); }
+            inline const ping_data* ping() const { return get<ping_data>(); }
+            inline reg_data* reg() { return get<reg_data>(); }
+            inline const reg_data* reg() const { return get<reg_data>(); }
+            inline conn_data* conn() { return get<conn_data>(); }
+            inline const conn_data* conn() const { return get<conn_data>(); }
+            inline custom_command_data* custom() { return get<custom_command_data>(); }
+            inline const custom_command_data* custom() const { return get<custom_command_data>(); }
+            inline group_data* group() { return get<group_data>(); }
+            inline const group_data* group() const { return get<group_data>(); }
+
             forward_data* make_forward(ATBUS_MACRO_BUSID_TYPE from, ATBUS_MACRO_BUSID_TYPE to, const void* buffer, size_t s) {
-                forward_data* ret = make_body(forward);
+                forward_data* ret = make_body<forward_data>();
                 if (NULL == ret) {
                     return ret;
                 }
@@ -307,28 +499,32 @@ namespace atbus {
             friend std::basic_ostream<CharT, Traits>& operator<<(std::basic_ostream<CharT, Traits>& os, const msg_body& mb) {
                 os << "{" << std::endl;
 
-                if (NULL != mb.forward) {
-                    os << "    forward:" << *mb.forward << std::endl;
+                if (NULL != mb.forward()) {
+                    os << "    forward:" << *mb.forward() << std::endl;
                 }
 
-                if (NULL != mb.sync) {
-                    os << "    sync:" << *mb.sync << std::endl;
+                if (NULL != mb.sync()) {
+                    os << "    sync:" << *mb.sync() << std::endl;
                 }
 
-                if (NULL != mb.ping) {
-                    os << "    ping:" << *mb.ping << std::endl;
+                if (NULL != mb.ping()) {
+                    os << "    ping:" << *mb.ping() << std::endl;
                 }
 
-                if (NULL != mb.reg) {
-                    os << "    reg:" << *mb.reg << std::endl;
+                if (NULL != mb.reg()) {
+                    os << "    reg:" << *mb.reg() << std::endl;
                 }
 
-                if (NULL != mb.conn) {
-                    os << "    conn:" << *mb.conn << std::endl;
+                if (NULL != mb.conn()) {
+                    os << "    conn:" << *mb.conn() << std::endl;
                 }
 
-                if (NULL != mb.custom) {
-                    os << "    custom:" << *mb.custom << std::endl;
+                if (NULL != mb.custom()) {
+                    os << "    custom:" << *mb.custom() << std::endl;
+                }
+
+                if (NULL != mb.group()) {
+                    os << "    group:" << *mb.group() << std::endl;
                 }
 
                 os << "  }";
@@ -339,6 +535,29 @@ namespace atbus {
         private:
             msg_body(const msg_body&);
             msg_body& operator=(const msg_body&);
+
+            template<typename TBody>
+            void destroy() {
+                reinterpret_cast<TBody*>(&storage_)->~TBody();
+            }
+
+        private:
+            msg_body_type_t::type type_;
+            union {
+                char forward[sizeof(forward_data)];
+                char sync[sizeof(node_tree)];
+                char ping[sizeof(ping_data)];
+                char reg[sizeof(reg_data)];
+                char conn[sizeof(conn_data)];
+                char custom[sizeof(custom_command_data)];
+                char group[sizeof(group_data)];
+
+                // 对齐
+                ATBUS_MACRO_BUSID_TYPE align_busid;
+                int64_t align_i64;
+                double align_double;
+                void* align_ptr;
+            } storage_;
         };
 
         struct msg_head {
@@ -398,6 +617,49 @@ namespace msgpack {
     MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
         namespace adaptor {
 
+            template<typename T, size_t MAX_SIZE>
+            struct convert<atbus::protocol::inline_array<T, MAX_SIZE> > {
+                msgpack::object const& operator()(msgpack::object const& o, atbus::protocol::inline_array<T, MAX_SIZE>& v) const {
+                    if (o.type != msgpack::type::ARRAY) throw msgpack::type_error();
+                    if (false == v.resize(o.via.array.size)) throw msgpack::type_error();
+
+                    for (uint32_t i = 0; i < o.via.array.size; ++i) {
+                        o.via.array.ptr[i].convert(v[i]);
+                    }
+                    return o;
+                }
+            };
+
+            template<typename T, size_t MAX_SIZE>
+            struct pack<atbus::protocol::inline_array<T, MAX_SIZE> > {
+                template <typename Stream>
+                packer<Stream>& operator()(msgpack::packer<Stream>& o, atbus::protocol::inline_array<T, MAX_SIZE> const& v) const {
+                    o.pack_array(static_cast<uint32_t>(v.size()));
+                    for (size_t i = 0; i < v.size(); ++i) {
+                        o.pack(v[i]);
+                    }
+                    return o;
+                }
+            };
+
+            template<typename T, size_t MAX_SIZE>
+            struct object_with_zone<atbus::protocol::inline_array<T, MAX_SIZE> > {
+                void operator()(msgpack::object::with_zone& o, atbus::protocol::inline_array<T, MAX_SIZE> const& v) const {
+                    o.type = type::ARRAY;
+                    o.via.array.size = static_cast<uint32_t>(v.size());
+                    if (v.empty()) {
+                        o.via.array.ptr = NULL;
+                        return;
+                    }
+
+                    o.via.array.ptr = static_cast<msgpack::object*>(
+                        o.zone.allocate_align(sizeof(msgpack::object) * o.via.array.size));
+                    for (size_t i = 0; i < v.size(); ++i) {
+                        o.via.array.ptr[i] = msgpack::object(v[i], o.zone);
+                    }
+                }
+            };
+
             template<>
             struct convert<atbus::protocol::bin_data_block> {
                 msgpack::object const& operator()(msgpack::object const& o, atbus::protocol::bin_data_block& v) const {
@@ -448,35 +710,44 @@ namespace msgpack {
                         switch(v.head.cmd) {
 
                         case ATBUS_CMD_DATA_TRANSFORM_REQ:
-                        case ATBUS_CMD_DATA_TRANSFORM_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.forward));
+                        case ATBUS_CMD_DATA_TRANSFORM_RSP:
+                        case ATBUS_CMD_BATCH:
+                        case ATBUS_CMD_GROUP_DATA:
+                        case ATBUS_CMD_SERVICE_DATA: {
+                            body_obj.convert(*v.body.make_body<atbus::protocol::forward_data>());
                             break;
                         }
                         
                         case ATBUS_CMD_CUSTOM_CMD_REQ: {
-                            body_obj.convert(*v.body.make_body(v.body.custom));
+                            body_obj.convert(*v.body.make_body<atbus::protocol::custom_command_data>());
                             break;
                         }
 
+                        case ATBUS_CMD_NODE_SYNC_REQ:
                         case ATBUS_CMD_NODE_SYNC_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.sync));
+                            body_obj.convert(*v.body.make_body<atbus::protocol::node_tree>());
                             break;
                         }
 
                         case ATBUS_CMD_NODE_REG_REQ:
                         case ATBUS_CMD_NODE_REG_RSP: {
-                            body_obj.convert(*v.body.make_body(v.body.reg));
+                            body_obj.convert(*v.body.make_body<atbus::protocol::reg_data>());
                             break;
                         }
 
                         case ATBUS_CMD_NODE_CONN_SYN: {
-                            body_obj.convert(*v.body.make_body(v.body.conn));
+                            body_obj.convert(*v.body.make_body<atbus::protocol::conn_data>());
                             break;
                         }
 
                         case ATBUS_CMD_NODE_PING:
                         case ATBUS_CMD_NODE_PONG: {
-                            body_obj.convert(*v.body.make_body(v.body.ping));
+                            body_obj.convert(*v.body.make_body<atbus::protocol::ping_data>());
+                            break;
+                        }
+
+                        case ATBUS_CMD_NODE_GROUP_SYNC: {
+                            body_obj.convert(*v.body.make_body<atbus::protocol::group_data>());
                             break;
                         }
 
@@ -504,58 +775,71 @@ namespace msgpack {
                     switch (v.head.cmd) {
 
                     case ATBUS_CMD_DATA_TRANSFORM_REQ:
-                    case ATBUS_CMD_DATA_TRANSFORM_RSP: {
-                        if (NULL == v.body.forward) {
+                    case ATBUS_CMD_DATA_TRANSFORM_RSP:
+                    case ATBUS_CMD_BATCH:
+                    case ATBUS_CMD_GROUP_DATA:
+                    case ATBUS_CMD_SERVICE_DATA: {
+                        if (NULL == v.body.forward()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.forward);
+                            o.pack(*v.body.forward());
                         }
                         break;
                     }
                     
                     case ATBUS_CMD_CUSTOM_CMD_REQ: {
-                        if (NULL == v.body.custom) {
+                        if (NULL == v.body.custom()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.custom);
+                            o.pack(*v.body.custom());
                         }
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_SYNC_REQ:
                     case ATBUS_CMD_NODE_SYNC_RSP: {
-                        if (NULL == v.body.sync) {
+                        if (NULL == v.body.sync()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.sync);
+                            o.pack(*v.body.sync());
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_REG_REQ:
                     case ATBUS_CMD_NODE_REG_RSP: {
-                        if (NULL == v.body.reg) {
+                        if (NULL == v.body.reg()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.reg);
+                            o.pack(*v.body.reg());
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_CONN_SYN: {
-                        if (NULL == v.body.conn) {
+                        if (NULL == v.body.conn()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.conn);
+                            o.pack(*v.body.conn());
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_PING:
                     case ATBUS_CMD_NODE_PONG: {
-                        if (NULL == v.body.ping) {
+                        if (NULL == v.body.ping()) {
+                            o.pack_nil();
+                        } else {
+                            o.pack(*v.body.ping());
+                        }
+                        break;
+                    }
+
+                    case ATBUS_CMD_NODE_GROUP_SYNC: {
+                        if (NULL == v.body.group()) {
                             o.pack_nil();
                         } else {
-                            o.pack(*v.body.ping);
+                            o.pack(*v.body.group());
                         }
                         break;
                     }
@@ -585,58 +869,71 @@ namespace msgpack {
                     switch (v.head.cmd) {
 
                     case ATBUS_CMD_DATA_TRANSFORM_REQ:
-                    case ATBUS_CMD_DATA_TRANSFORM_RSP: {
-                        if (NULL == v.body.forward) {
+                    case ATBUS_CMD_DATA_TRANSFORM_RSP:
+                    case ATBUS_CMD_BATCH:
+                    case ATBUS_CMD_GROUP_DATA:
+                    case ATBUS_CMD_SERVICE_DATA: {
+                        if (NULL == v.body.forward()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.forward->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.forward()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
                     
                     case ATBUS_CMD_CUSTOM_CMD_REQ: {
-                        if (NULL == v.body.custom) {
+                        if (NULL == v.body.custom()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.custom->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.custom()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
 
+                    case ATBUS_CMD_NODE_SYNC_REQ:
                     case ATBUS_CMD_NODE_SYNC_RSP: {
-                        if (NULL == v.body.sync) {
+                        if (NULL == v.body.sync()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.sync->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.sync()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_REG_REQ:
                     case ATBUS_CMD_NODE_REG_RSP: {
-                        if (NULL == v.body.reg) {
+                        if (NULL == v.body.reg()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.reg->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.reg()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_CONN_SYN: {
-                        if (NULL == v.body.conn) {
+                        if (NULL == v.body.conn()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.conn->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.conn()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
 
                     case ATBUS_CMD_NODE_PING:
                     case ATBUS_CMD_NODE_PONG: {
-                        if (NULL == v.body.ping) {
+                        if (NULL == v.body.ping()) {
+                            o.via.map.ptr[1].val = msgpack::object();
+                        } else {
+                            v.body.ping()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                        }
+                        break;
+                    }
+
+                    case ATBUS_CMD_NODE_GROUP_SYNC: {
+                        if (NULL == v.body.group()) {
                             o.via.map.ptr[1].val = msgpack::object();
                         } else {
-                            v.body.ping->msgpack_object(&o.via.map.ptr[1].val, o.zone);
+                            v.body.group()->msgpack_object(&o.via.map.ptr[1].val, o.zone);
                         }
                         break;
                     }
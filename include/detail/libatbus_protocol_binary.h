@@ -0,0 +1,406 @@
+#ifndef LIBATBUS_PROTOCOL_BINARY_H_
+#define LIBATBUS_PROTOCOL_BINARY_H_
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+#include "buffer.h"
+#include "libatbus_protocol.h"
+
+/**
+ * @brief 数据转发消息(ATBUS_CMD_DATA_TRANSFORM_REQ/RSP、ATBUS_CMD_BATCH、ATBUS_CMD_GROUP_DATA和ATBUS_CMD_SERVICE_DATA)的固定格式二进制编码
+ * @note 第一个字节是编码版本，使用msgpack中保留不用的0xc1，所以不会和msgpack编码的消息(一定是map)冲突
+ *       控制协议仍然使用msgpack编码，接收方根据第一个字节选择解码方式
+ *
+ *       所有整数都是小端字节序
+ *       | 偏移 | 长度 | 内容                         |
+ *       |------|------|------------------------------|
+ *       |    0 |    1 | 版本(0xc1)                   |
+ *       |    1 |    1 | head.cmd                     |
+ *       |    2 |    1 | router数量(n)                |
+ *       |    3 |    1 | 保留(0)                      |
+ *       |    4 |    4 | head.type                    |
+ *       |    8 |    4 | head.ret                     |
+ *       |   12 |    4 | head.sequence                |
+ *       |   16 |    8 | head.src_bus_id              |
+ *       |   24 |    8 | forward.from                 |
+ *       |   32 |    8 | forward.to                   |
+ *       |   40 |    4 | forward.flags                |
+ *       |   44 |    4 | forward.content.size         |
+ *       |   48 |  8*n | forward.router               |
+ *       |48+8n |    - | forward.content              |
+ */
+
+namespace atbus {
+    namespace protocol {
+        struct binary_encoding_t {
+            enum type {
+                VERSION_1 = 0xc1,
+                HEAD_SIZE = 48,
+                ROUTER_UNIT_SIZE = 8,
+            };
+        };
+
+        namespace detail {
+            template<typename T>
+            inline void binary_write_le(unsigned char* out, T v) {
+                for (size_t i = 0; i < sizeof(T); ++i) {
+                    out[i] = static_cast<unsigned char>((static_cast<uint64_t>(v) >> (i * 8)) & 0xFF);
+                }
+            }
+
+            template<typename T>
+            inline T binary_read_le(const unsigned char* in) {
+                uint64_t ret = 0;
+                for (size_t i = 0; i < sizeof(T); ++i) {
+                    ret |= static_cast<uint64_t>(in[i]) << (i * 8);
+                }
+                return static_cast<T>(ret);
+            }
+        }
+
+        /**
+         * @brief 消息是否可以使用二进制编码
+         */
+        inline bool binary_support(const msg& m) {
+            if (ATBUS_CMD_DATA_TRANSFORM_REQ != m.head.cmd && ATBUS_CMD_DATA_TRANSFORM_RSP != m.head.cmd && ATBUS_CMD_BATCH != m.head.cmd &&
+                ATBUS_CMD_GROUP_DATA != m.head.cmd && ATBUS_CMD_SERVICE_DATA != m.head.cmd) {
+                return false;
+            }
+
+            const forward_data* fwd = m.body.forward();
+            if (NULL == fwd || fwd->router.size() > 0xFF || static_cast<uint64_t>(fwd->content.size) > 0xFFFFFFFFULL) {
+                return false;
+            }
+
+            return NULL != fwd->content.ptr || 0 == fwd->content.size;
+        }
+
+        /**
+         * @brief 二进制编码后的长度，调用前需要检查binary_support
+         */
+        inline size_t binary_packed_size(const msg& m) {
+            const forward_data* fwd = m.body.forward();
+            return binary_encoding_t::HEAD_SIZE + binary_encoding_t::ROUTER_UNIT_SIZE * fwd->router.size() + fwd->content.size;
+        }
+
+        /**
+         * @brief 只编码固定头和router，forward.content紧跟在后面，由调用方发送
+         * @note 转发消息时只需要重写这部分，原始数据可以直接作为下一个数据块发送，不需要复制
+         * @return 写入的长度，不支持二进制编码或缓冲区不足时返回0
+         */
+        inline size_t binary_pack_head(const msg& m, void* buffer, size_t len) {
+            if (NULL == buffer || !binary_support(m)) {
+                return 0;
+            }
+
+            const forward_data* fwd = m.body.forward();
+            size_t ret = binary_encoding_t::HEAD_SIZE + binary_encoding_t::ROUTER_UNIT_SIZE * fwd->router.size();
+            if (ret > len) {
+                return 0;
+            }
+
+            unsigned char* out = reinterpret_cast<unsigned char*>(buffer);
+            out[0] = static_cast<unsigned char>(binary_encoding_t::VERSION_1);
+            out[1] = static_cast<unsigned char>(m.head.cmd);
+            out[2] = static_cast<unsigned char>(fwd->router.size());
+            out[3] = 0;
+            detail::binary_write_le<uint32_t>(out + 4, static_cast<uint32_t>(m.head.type));
+            detail::binary_write_le<uint32_t>(out + 8, static_cast<uint32_t>(m.head.ret));
+            detail::binary_write_le<uint32_t>(out + 12, m.head.sequence);
+            detail::binary_write_le<uint64_t>(out + 16, static_cast<uint64_t>(m.head.src_bus_id));
+            detail::binary_write_le<uint64_t>(out + 24, static_cast<uint64_t>(fwd->from));
+            detail::binary_write_le<uint64_t>(out + 32, static_cast<uint64_t>(fwd->to));
+            detail::binary_write_le<uint32_t>(out + 40, static_cast<uint32_t>(fwd->flags));
+            detail::binary_write_le<uint32_t>(out + 44, static_cast<uint32_t>(fwd->content.size));
+
+            out += binary_encoding_t::HEAD_SIZE;
+            for (size_t i = 0; i < fwd->router.size(); ++i) {
+                detail::binary_write_le<uint64_t>(out, static_cast<uint64_t>(fwd->router[i]));
+                out += binary_encoding_t::ROUTER_UNIT_SIZE;
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief 改写binary_pack_head写入的消息头中的flags和content长度
+         * @note 发送时替换content(比如压缩)后使用，不需要重新编码整个消息头
+         */
+        inline void binary_rewrite_content_head(void* buffer, int flags, size_t content_size) {
+            unsigned char* out = reinterpret_cast<unsigned char*>(buffer);
+            detail::binary_write_le<uint32_t>(out + 40, static_cast<uint32_t>(flags));
+            detail::binary_write_le<uint32_t>(out + 44, static_cast<uint32_t>(content_size));
+        }
+
+        /**
+         * @brief 二进制编码，直接写入目标缓冲区
+         * @return 写入的长度，不支持二进制编码或缓冲区不足时返回0
+         */
+        inline size_t binary_pack(const msg& m, void* buffer, size_t len) {
+            if (NULL == buffer || !binary_support(m) || binary_packed_size(m) > len) {
+                return 0;
+            }
+
+            size_t head_size = binary_pack_head(m, buffer, len);
+            if (0 == head_size) {
+                return 0;
+            }
+
+            const forward_data* fwd = m.body.forward();
+            if (fwd->content.size > 0) {
+                memcpy(reinterpret_cast<char*>(buffer) + head_size, fwd->content.ptr, fwd->content.size);
+            }
+
+            return head_size + fwd->content.size;
+        }
+
+        /**
+         * @brief 数据是否是二进制编码的消息
+         */
+        inline bool binary_is_packed(const void* buffer, size_t len) {
+            return NULL != buffer && len > 0 &&
+                static_cast<unsigned char>(binary_encoding_t::VERSION_1) == *reinterpret_cast<const unsigned char*>(buffer);
+        }
+
+        /**
+         * @brief 二进制解码，不分配内存
+         * @note 解码后forward.content直接引用buffer，所以处理完消息前buffer必须有效
+         * @return 数据格式错误时返回false
+         */
+        inline bool binary_unpack(msg& m, const void* buffer, size_t len) {
+            if (!binary_is_packed(buffer, len) || len < binary_encoding_t::HEAD_SIZE) {
+                return false;
+            }
+
+            const unsigned char* in = reinterpret_cast<const unsigned char*>(buffer);
+            ATBUS_PROTOCOL_CMD cmd = static_cast<ATBUS_PROTOCOL_CMD>(in[1]);
+            if (ATBUS_CMD_DATA_TRANSFORM_REQ != cmd && ATBUS_CMD_DATA_TRANSFORM_RSP != cmd && ATBUS_CMD_BATCH != cmd &&
+                ATBUS_CMD_GROUP_DATA != cmd && ATBUS_CMD_SERVICE_DATA != cmd) {
+                return false;
+            }
+
+            size_t router_size = in[2];
+            size_t content_size = detail::binary_read_le<uint32_t>(in + 44);
+            size_t content_offset = binary_encoding_t::HEAD_SIZE + binary_encoding_t::ROUTER_UNIT_SIZE * router_size;
+            if (content_offset > len || content_size != len - content_offset) {
+                return false;
+            }
+
+            m.head.cmd = cmd;
+            m.head.type = static_cast<int32_t>(detail::binary_read_le<uint32_t>(in + 4));
+            m.head.ret = static_cast<int32_t>(detail::binary_read_le<uint32_t>(in + 8));
+            m.head.sequence = detail::binary_read_le<uint32_t>(in + 12);
+            m.head.src_bus_id = static_cast<ATBUS_MACRO_BUSID_TYPE>(detail::binary_read_le<uint64_t>(in + 16));
+
+            forward_data* fwd = m.body.make_body<forward_data>();
+            if (false == fwd->router.resize(router_size)) {
+                m.body.reset();
+                return false;
+            }
+
+            fwd->from = static_cast<ATBUS_MACRO_BUSID_TYPE>(detail::binary_read_le<uint64_t>(in + 24));
+            fwd->to = static_cast<ATBUS_MACRO_BUSID_TYPE>(detail::binary_read_le<uint64_t>(in + 32));
+            fwd->flags = static_cast<int>(detail::binary_read_le<uint32_t>(in + 40));
+
+            const unsigned char* router = in + binary_encoding_t::HEAD_SIZE;
+            for (size_t i = 0; i < router_size; ++i) {
+                fwd->router[i] = static_cast<ATBUS_MACRO_BUSID_TYPE>(detail::binary_read_le<uint64_t>(router));
+                router += binary_encoding_t::ROUTER_UNIT_SIZE;
+            }
+
+            fwd->content.ptr = 0 == content_size ? NULL : in + content_offset;
+            fwd->content.size = content_size;
+            return true;
+        }
+
+        /**
+         * @brief ATBUS_CMD_BATCH的content编码后的长度
+         * @note content里每个数据块的格式是 [varint长度][数据]
+         */
+        inline size_t batch_packed_size(const size_t lens[], size_t n) {
+            size_t ret = 0;
+            char vint[16];
+            for (size_t i = 0; i < n; ++i) {
+                ret += ::atbus::detail::fn::write_vint(lens[i], vint, sizeof(vint)) + lens[i];
+            }
+
+            return ret;
+        }
+
+        /**
+         * @brief 编码ATBUS_CMD_BATCH的content
+         * @return 写入的长度，缓冲区不足时返回0
+         */
+        inline size_t batch_pack(void* buffer, size_t len, const void* const bufs[], const size_t lens[], size_t n) {
+            char* out = reinterpret_cast<char*>(buffer);
+            size_t left = len;
+            for (size_t i = 0; i < n; ++i) {
+                size_t vint_len = ::atbus::detail::fn::write_vint(lens[i], out, left);
+                if (0 == vint_len || left - vint_len < lens[i]) {
+                    return 0;
+                }
+
+                if (lens[i] > 0) {
+                    memcpy(out + vint_len, bufs[i], lens[i]);
+                }
+                out += vint_len + lens[i];
+                left -= vint_len + lens[i];
+            }
+
+            return len - left;
+        }
+
+        /**
+         * @brief 依次取出ATBUS_CMD_BATCH的content中的数据块
+         * @param data 剩余数据的地址，取出后会后移
+         * @param left 剩余数据的长度，取出后会减少
+         * @param item 取出的数据块地址，直接引用原始数据
+         * @param item_len 取出的数据块长度
+         * @return 成功返回true，没有数据或数据格式错误时返回false(格式错误时left不为0)
+         */
+        inline bool batch_unpack_next(const void*& data, size_t& left, const void*& item, size_t& item_len) {
+            if (0 == left || NULL == data) {
+                return false;
+            }
+
+            uint64_t len = 0;
+            size_t vint_len = ::atbus::detail::fn::read_vint(len, data, left);
+            if (0 == vint_len || len > left - vint_len) {
+                return false;
+            }
+
+            item = reinterpret_cast<const char*>(data) + vint_len;
+            item_len = static_cast<size_t>(len);
+            data = reinterpret_cast<const char*>(item) + item_len;
+            left -= vint_len + item_len;
+            return true;
+        }
+
+        /**
+         * @brief 分片消息(forward_data::FLAG_FRAGMENT)的content格式
+         * @note 所有分片使用相同的head.sequence，接收端按(forward.from, head.sequence)重组
+         *       | 偏移 | 长度 | 内容                         |
+         *       |------|------|------------------------------|
+         *       |    0 |    4 | 完整数据的长度               |
+         *       |    4 |    4 | 这个分片在完整数据中的偏移   |
+         *       |    8 |    - | 分片数据                     |
+         */
+        struct fragment_encoding_t {
+            enum type {
+                HEAD_SIZE = 8,
+                // 给消息头和转发时增加的router预留的空间，msgpack编码时每个router最多9字节
+                RESERVE_SIZE = binary_encoding_t::HEAD_SIZE + 16 * ATBUS_MACRO_ROUTER_MAX_DEPTH + 256,
+            };
+        };
+
+        /**
+         * @brief 每个分片最多可以携带的数据长度
+         * @param msg_size 单个消息的长度限制
+         * @return 可携带的数据长度，msg_size太小无法分片时返回0
+         */
+        inline size_t fragment_data_size(size_t msg_size) {
+            if (msg_size <= fragment_encoding_t::RESERVE_SIZE + fragment_encoding_t::HEAD_SIZE) {
+                return 0;
+            }
+
+            return msg_size - fragment_encoding_t::RESERVE_SIZE - fragment_encoding_t::HEAD_SIZE;
+        }
+
+        /**
+         * @brief 写入分片头，buffer至少要有fragment_encoding_t::HEAD_SIZE
+         */
+        inline void fragment_pack_head(void* buffer, uint32_t total_size, uint32_t offset) {
+            unsigned char* out = reinterpret_cast<unsigned char*>(buffer);
+            detail::binary_write_le<uint32_t>(out, total_size);
+            detail::binary_write_le<uint32_t>(out + 4, offset);
+        }
+
+        /**
+         * @brief 解析分片消息的content
+         * @param buffer content地址
+         * @param len content长度
+         * @param total_size 完整数据的长度
+         * @param offset 这个分片在完整数据中的偏移
+         * @param data 分片数据地址，直接引用buffer
+         * @param data_len 分片数据长度
+         * @return 数据格式错误时返回false
+         */
+        inline bool fragment_unpack(const void* buffer, size_t len, uint32_t& total_size, uint32_t& offset, const void*& data, size_t& data_len) {
+            if (NULL == buffer || len < fragment_encoding_t::HEAD_SIZE) {
+                return false;
+            }
+
+            const unsigned char* in = reinterpret_cast<const unsigned char*>(buffer);
+            total_size = detail::binary_read_le<uint32_t>(in);
+            offset = detail::binary_read_le<uint32_t>(in + 4);
+            data = in + fragment_encoding_t::HEAD_SIZE;
+            data_len = len - fragment_encoding_t::HEAD_SIZE;
+
+            return offset <= total_size && data_len <= static_cast<size_t>(total_size - offset);
+        }
+
+        /**
+         * @brief 压缩消息(forward_data::FLAG_COMPRESSED)的content格式
+         * @note | 偏移 | 长度 | 内容                         |
+         *       |------|------|------------------------------|
+         *       |    0 |    1 | 压缩算法ID                   |
+         *       |    1 |    - | 原始数据长度(varint)         |
+         *       |    - |    - | 压缩后的数据                 |
+         */
+        struct compress_encoding_t {
+            enum type {
+                MAX_HEAD_SIZE = 11,
+            };
+        };
+
+        /**
+         * @brief 写入压缩头
+         * @return 写入的长度，缓冲区不足时返回0
+         */
+        inline size_t compress_pack_head(void* buffer, size_t len, uint32_t algorithm, size_t origin_size) {
+            if (NULL == buffer || len < 1) {
+                return 0;
+            }
+
+            unsigned char* out = reinterpret_cast<unsigned char*>(buffer);
+            out[0] = static_cast<unsigned char>(algorithm);
+            size_t vint_len = ::atbus::detail::fn::write_vint(origin_size, out + 1, len - 1);
+            return 0 == vint_len ? 0 : vint_len + 1;
+        }
+
+        /**
+         * @brief 解析压缩消息的content
+         * @param buffer content地址
+         * @param len content长度
+         * @param algorithm 压缩算法ID
+         * @param origin_size 原始数据长度
+         * @param data 压缩后的数据地址，直接引用buffer
+         * @param data_len 压缩后的数据长度
+         * @return 数据格式错误时返回false
+         */
+        inline bool compress_unpack_head(const void* buffer, size_t len, uint32_t& algorithm, size_t& origin_size, const void*& data, size_t& data_len) {
+            if (NULL == buffer || len < 2) {
+                return false;
+            }
+
+            const unsigned char* in = reinterpret_cast<const unsigned char*>(buffer);
+            algorithm = in[0];
+            uint64_t vint = 0;
+            size_t vint_len = ::atbus::detail::fn::read_vint(vint, in + 1, len - 1);
+            if (0 == vint_len) {
+                return false;
+            }
+
+            origin_size = static_cast<size_t>(vint);
+            data = in + 1 + vint_len;
+            data_len = len - 1 - vint_len;
+            return true;
+        }
+    }
+}
+
+#endif // LIBATBUS_PROTOCOL_BINARY_H_
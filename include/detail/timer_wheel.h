@@ -0,0 +1,228 @@
+﻿#pragma once
+
+#ifndef LIBATBUS_DETAIL_TIMER_WHEEL_H_
+#define LIBATBUS_DETAIL_TIMER_WHEEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace atbus {
+    namespace detail {
+        /**
+         * @brief 分层时间轮，每层2^slot_bits个槽，第k层的一个槽对应2^(slot_bits*k)个tick
+         * @note 定时器放在和当前tick最高的不同位所在的层，推进到高层槽的边界时整槽下放到低层，
+         *       所以每个定时器最多被移动level_num次，推进的开销只和触发的定时器数量有关
+         *       超过最高层范围的定时器留在最高层的槽里等下一圈
+         *       不支持删除，定时器触发后由调用方检查对象是否仍然有效(惰性删除)，取消只需要让检查失败
+         *       槽和输出缓冲区的内存都会复用，稳定运行后添加和触发定时器都不会再分配内存
+         */
+        template<typename T>
+        class timer_wheel {
+        public:
+            typedef std::pair<uint64_t, T> value_type; // (触发的tick, 数据)
+
+            explicit timer_wheel(size_t slot_bits = 8, size_t level_num = 4)
+                : slot_bits_(slot_bits), slot_mask_((static_cast<uint64_t>(1) << slot_bits) - 1), levels_(level_num < 1 ? 1 : level_num),
+                  current_(0), size_(0) {
+                for (size_t i = 0; i < levels_.size(); ++i) {
+                    levels_[i].size = 0;
+                    levels_[i].slots.resize(static_cast<size_t>(1) << slot_bits);
+                }
+            }
+
+            inline uint64_t get_current_tick() const { return current_; }
+            inline size_t size() const { return size_; }
+            inline bool empty() const { return 0 == size_; }
+
+            /**
+             * @brief 清空所有定时器并设置当前tick
+             */
+            void reset(uint64_t tick) {
+                for (size_t i = 0; i < levels_.size(); ++i) {
+                    for (size_t j = 0; j < levels_[i].slots.size(); ++j) {
+                        levels_[i].slots[j].clear();
+                    }
+                    levels_[i].size = 0;
+                }
+
+                current_ = tick;
+                size_ = 0;
+            }
+
+            /**
+             * @brief 输出所有未触发的定时器，不会清空
+             */
+            void collect(std::vector<value_type>& out) const {
+                out.clear();
+                for (size_t i = 0; i < levels_.size(); ++i) {
+                    if (0 == levels_[i].size) {
+                        continue;
+                    }
+
+                    for (size_t j = 0; j < levels_[i].slots.size(); ++j) {
+                        out.insert(out.end(), levels_[i].slots[j].begin(), levels_[i].slots[j].end());
+                    }
+                }
+            }
+
+            /**
+             * @brief 添加定时器，已经过期的定时器会在下一个tick触发
+             */
+            void add(uint64_t expire_tick, const T& v) {
+                if (expire_tick <= current_) {
+                    expire_tick = current_ + 1;
+                }
+
+                insert(value_type(expire_tick, v));
+                ++size_;
+            }
+
+            /**
+             * @brief 推进到tick，取出所有到期的定时器
+             * @param tick 当前tick，小于等于上一次的tick时不做任何事
+             * @param expired 输出到期的定时器，会先清空，可以复用
+             * @return 到期的定时器数量
+             */
+            size_t advance(uint64_t tick, std::vector<value_type>& expired) {
+                expired.clear();
+                if (tick <= current_) {
+                    return 0;
+                }
+
+                if (0 == size_) {
+                    current_ = tick;
+                    return 0;
+                }
+
+                // 跨越超过整个时间轮时全部重新分配
+                size_t total_bits = slot_bits_ * levels_.size();
+                if (total_bits < 64 && tick - current_ >= (static_cast<uint64_t>(1) << total_bits)) {
+                    collect(cascade_);
+                    reset(tick);
+                    for (size_t i = 0; i < cascade_.size(); ++i) {
+                        if (cascade_[i].first <= tick) {
+                            expired.push_back(cascade_[i]);
+                        } else {
+                            insert(std::move(cascade_[i]));
+                            ++size_;
+                        }
+                    }
+
+                    cascade_.clear();
+                    return expired.size();
+                }
+
+                while (current_ < tick && size_ > expired.size()) {
+                    // 低层没有定时器时直接跳到第一个非空层的下一个槽的边界
+                    size_t lv = 0;
+                    while (lv + 1 < levels_.size() && 0 == levels_[lv].size) {
+                        ++lv;
+                    }
+
+                    // 第0层一圈以内不需要下放，逐个槽取出
+                    if (0 == lv && (current_ & slot_mask_) != slot_mask_) {
+                        uint64_t end = current_ | slot_mask_;
+                        if (end > tick) {
+                            end = tick;
+                        }
+
+                        while (current_ < end && 0 != levels_[0].size) {
+                            ++current_;
+                            pop_slot(expired);
+                        }
+                        continue;
+                    }
+
+                    uint64_t next = ((current_ >> (slot_bits_ * lv)) + 1) << (slot_bits_ * lv);
+                    if (next > tick) {
+                        break;
+                    }
+                    current_ = next;
+
+                    // 从高层往低层下放，高层下放的定时器可能正好落在低层当前的槽里
+                    size_t top = 0;
+                    while (top + 1 < levels_.size() && 0 == (current_ & ((static_cast<uint64_t>(1) << (slot_bits_ * (top + 1))) - 1))) {
+                        ++top;
+                    }
+                    for (size_t i = top; i > 0; --i) {
+                        cascade(i);
+                    }
+
+                    pop_slot(expired);
+                }
+
+                current_ = tick;
+                size_ -= expired.size();
+                return expired.size();
+            }
+
+        private:
+            struct level_t {
+                size_t size;
+                std::vector<std::vector<value_type> > slots;
+            };
+
+            void pop_slot(std::vector<value_type>& expired) {
+                level_t& level0 = levels_[0];
+                std::vector<value_type>& slot = level0.slots[static_cast<size_t>(current_ & slot_mask_)];
+                if (!slot.empty()) {
+                    expired.insert(expired.end(), std::make_move_iterator(slot.begin()), std::make_move_iterator(slot.end()));
+                    level0.size -= slot.size();
+                    slot.clear();
+                }
+            }
+
+            void insert(value_type&& v) {
+                size_t lv = find_level(v.first);
+                uint64_t tick = v.first > current_ ? v.first : current_;
+                levels_[lv].slots[static_cast<size_t>((tick >> (slot_bits_ * lv)) & slot_mask_)].push_back(std::move(v));
+                ++levels_[lv].size;
+            }
+
+            void insert(const value_type& v) {
+                size_t lv = find_level(v.first);
+                uint64_t tick = v.first > current_ ? v.first : current_;
+                levels_[lv].slots[static_cast<size_t>((tick >> (slot_bits_ * lv)) & slot_mask_)].push_back(v);
+                ++levels_[lv].size;
+            }
+
+            size_t find_level(uint64_t expire_tick) const {
+                // 找到和当前tick相同前缀的最低层，过期的放在第0层当前的槽里马上触发
+                size_t lv = 0;
+                while (lv + 1 < levels_.size() && (expire_tick >> (slot_bits_ * (lv + 1))) != (current_ >> (slot_bits_ * (lv + 1)))) {
+                    ++lv;
+                }
+                return lv;
+            }
+
+            void cascade(size_t lv) {
+                level_t& level = levels_[lv];
+                std::vector<value_type>& slot = level.slots[static_cast<size_t>((current_ >> (slot_bits_ * lv)) & slot_mask_)];
+                if (slot.empty()) {
+                    return;
+                }
+
+                // 最高层下一圈的定时器会重新放回同一个槽，先换出来
+                cascade_.clear();
+                cascade_.swap(slot);
+                level.size -= cascade_.size();
+                for (size_t i = 0; i < cascade_.size(); ++i) {
+                    insert(std::move(cascade_[i]));
+                }
+                cascade_.clear();
+            }
+
+            size_t slot_bits_;
+            uint64_t slot_mask_;
+            std::vector<level_t> levels_;
+            std::vector<value_type> cascade_;
+            uint64_t current_;
+            size_t size_;
+        };
+    }
+}
+
+#endif
@@ -12,3 +12,4 @@ add_compiler_define(ATBUS_MACRO_HUGETLB_SIZE=${ATBUS_MACRO_HUGETLB_SIZE})
 add_compiler_define(ATBUS_MACRO_MSG_LIMIT=${ATBUS_MACRO_MSG_LIMIT})
 add_compiler_define(ATBUS_MACRO_CONNECTION_CONFIRM_TIMEOUT=${ATBUS_MACRO_CONNECTION_CONFIRM_TIMEOUT})
 add_compiler_define(ATBUS_MACRO_CONNECTION_BACKLOG=${ATBUS_MACRO_CONNECTION_BACKLOG})
+add_compiler_define(ATBUS_MACRO_ROUTER_MAX_DEPTH=${ATBUS_MACRO_ROUTER_MAX_DEPTH})
@@ -12,6 +12,7 @@ set(ATBUS_MACRO_HUGETLB_SIZE 4194304 CACHE STRING "大页表分页大小（用
 set(ATBUS_MACRO_MSG_LIMIT 65536 CACHE STRING "默认消息体大小限制")
 set(ATBUS_MACRO_CONNECTION_CONFIRM_TIMEOUT 30 CACHE STRING "默认连接确认时限")
 set(ATBUS_MACRO_CONNECTION_BACKLOG 128 CACHE STRING "默认握手队列的最大连接数")
+set(ATBUS_MACRO_ROUTER_MAX_DEPTH 32 CACHE STRING "转发消息记录的最大路由深度（ttl不能超过这个值）")
 
 # libuv选项
 set(LIBUV_ROOT "" CACHE STRING "libuv root directory")
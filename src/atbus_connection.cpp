@@ -14,6 +14,7 @@
 #include "atbus_connection.h"
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
 
 namespace atbus {
     namespace detail {
@@ -51,9 +52,36 @@ namespace atbus {
                 return *this;
             }
         };
+
+        /**
+         * @brief 解包和处理一个消息期间持有node的解包内存池，结束后释放引用
+         */
+        class decode_arena_guard {
+        public:
+            decode_arena_guard(node& n): owner_node_(n), arena_(n.ref_decode_arena()) {}
+
+            ~decode_arena_guard() {
+                if (NULL != arena_) {
+                    owner_node_.unref_decode_arena();
+                }
+            }
+
+            inline void* get() const { return arena_; }
+
+        private:
+            decode_arena_guard(const decode_arena_guard&);
+            decode_arena_guard& operator=(const decode_arena_guard&);
+
+            node& owner_node_;
+            void* arena_;
+        };
+
+        static bool unpack_reference_buffer(msgpack::type::object_type, size_t, void*) {
+            return true;
+        }
     }
 
-    connection::connection():state_(state_t::DISCONNECTED), owner_(NULL), binding_(NULL){
+    connection::connection():state_(state_t::DISCONNECTED), owner_(NULL), binding_(NULL), ping_seq_(0), rtt_ns_(0){
         flags_.reset();
         memset(&conn_data_, 0, sizeof(conn_data_));
     }
@@ -241,6 +269,8 @@ namespace atbus {
             conn_data_.shared.mem.buffer = reinterpret_cast<void*>(ad);
             conn_data_.shared.mem.len = conf.recv_buffer_size;
             flags_.set(flag_t::REG_PROC, true);
+            flags_.set(flag_t::ACCESS_SHARE_ADDR, true);
+            flags_.set(flag_t::ACCESS_SHARE_HOST, true);
             if (NULL == binding_) {
                 state_ = state_t::HANDSHAKING;
             } else {
@@ -271,6 +301,7 @@ namespace atbus {
             conn_data_.shared.shm.len = conf.recv_buffer_size;
 
             flags_.set(flag_t::REG_PROC, true);
+            flags_.set(flag_t::ACCESS_SHARE_HOST, true);
             if (NULL == binding_) {
                 state_ = state_t::HANDSHAKING;
             } else {
@@ -335,6 +366,12 @@ namespace atbus {
     }
 
     int connection::push(const void* buffer, size_t s) {
+        const void* buffers[1] = { buffer };
+        size_t sizes[1] = { s };
+        return push_v(buffers, sizes, 1);
+    }
+
+    int connection::push_v(const void* const buffers[], const size_t sizes[], size_t n) {
         if (state_t::CONNECTED != state_ && state_t::HANDSHAKING != state_) {
             return EN_ATBUS_ERR_NOT_INITED;
         }
@@ -343,7 +380,7 @@ namespace atbus {
             return EN_ATBUS_ERR_ACCESS_DENY;
         }
 
-        return conn_data_.push_fn(*this, buffer, s);
+        return conn_data_.push_fn(*this, buffers, sizes, n);
     }
 
     bool connection::is_connected() const {
@@ -372,6 +409,14 @@ namespace atbus {
         return state_t::CONNECTING == state_ || state_t::HANDSHAKING == state_ || state_t::CONNECTED == state_;
     }
 
+    void connection::add_stat_rtt(uint64_t rtt_ns) {
+        if (0 == rtt_ns_) {
+            rtt_ns_ = rtt_ns;
+        } else {
+            rtt_ns_ = rtt_ns_ - (rtt_ns_ >> 3) + (rtt_ns >> 3);
+        }
+    }
+
     void connection::iostream_on_listen_cb(channel::io_stream_channel* channel, channel::io_stream_connection* connection, int status, void* buffer, size_t s) {
         detail::connection_async_data* async_data = reinterpret_cast<detail::connection_async_data*>(buffer);
         assert(NULL != async_data);
@@ -414,6 +459,8 @@ namespace atbus {
                 async_data->conn->state_ = state_t::HANDSHAKING;
             } else {
                 async_data->conn->state_ = state_t::CONNECTED;
+                // 已经绑定的数据连接连上以后可能比现在使用的连接更快
+                async_data->owner_node->invalidate_route_cache();
             }
 
             async_data->conn->conn_data_.shared.ios_fd.channel = channel;
@@ -449,9 +496,9 @@ namespace atbus {
         }
 
         // unpack
-        msgpack::unpacked result;
+        detail::decode_arena_guard arena(*_this);
         protocol::msg m;
-        if (false == unpack(&result, *conn, m, buffer, s)) {
+        if (false == unpack(arena.get(), *conn, m, buffer, s)) {
             return;
         }
         _this->on_recv(conn, &m, status, channel->error_code);
@@ -526,9 +573,9 @@ namespace atbus {
                 break;
             } else {
                 // unpack
-                msgpack::unpacked result;
+                detail::decode_arena_guard arena(n);
                 protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
+                if (false == unpack(arena.get(), conn, m, static_buffer->data(), recv_len)) {
                     continue;
                 }
 
@@ -544,8 +591,8 @@ namespace atbus {
         return channel::shm_close(conn.conn_data_.shared.shm.shm_key);
     }
 
-    int connection::shm_push_fn(connection& conn, const void* buffer, size_t s) {
-        return channel::shm_send(conn.conn_data_.shared.shm.channel, buffer, s);
+    int connection::shm_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n) {
+        return channel::shm_send_v(conn.conn_data_.shared.shm.channel, buffers, sizes, n);
     }
 
     int connection::mem_proc_fn(node& n, connection& conn, time_t sec, time_t usec) {
@@ -576,9 +623,9 @@ namespace atbus {
                 break;
             } else {
                 // unpack
-                msgpack::unpacked result;
+                detail::decode_arena_guard arena(n);
                 protocol::msg m;
-                if (false == unpack(&result, conn, m, static_buffer->data(), recv_len)) {
+                if (false == unpack(arena.get(), conn, m, static_buffer->data(), recv_len)) {
                     continue;
                 }
 
@@ -594,8 +641,8 @@ namespace atbus {
         return 0;
     }
 
-    int connection::mem_push_fn(connection& conn, const void* buffer, size_t s) {
-        return channel::mem_send(conn.conn_data_.shared.mem.channel, buffer, s);
+    int connection::mem_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n) {
+        return channel::mem_send_v(conn.conn_data_.shared.mem.channel, buffers, sizes, n);
     }
 
     int connection::ios_free_fn(node& n, connection& conn) {
@@ -606,20 +653,53 @@ namespace atbus {
         return ret;
     }
 
-    int connection::ios_push_fn(connection& conn, const void* buffer, size_t s) {
-        return channel::io_stream_send(conn.conn_data_.shared.ios_fd.conn, buffer, s);
+    int connection::ios_push_fn(connection& conn, const void* const buffers[], const size_t sizes[], size_t n) {
+        return channel::io_stream_send_v(conn.conn_data_.shared.ios_fd.conn, buffers, sizes, n);
     }
 
-    bool connection::unpack(void* res, connection& conn, atbus::protocol::msg& m, void* buffer, size_t s) {
-        msgpack::unpacked* result = reinterpret_cast<msgpack::unpacked*>(res);
-        msgpack::unpack(*result, reinterpret_cast<const char*>(buffer), s);
-        msgpack::object obj = result->get();
-        if (obj.is_nil()) {
+    bool connection::unpack(void* arena, connection& conn, atbus::protocol::msg& m, void* buffer, size_t s) {
+        // 二进制编码的数据转发消息
+        if (protocol::binary_is_packed(buffer, s)) {
+            if (false == protocol::binary_unpack(m, buffer, s)) {
+                ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
+                return false;
+            }
+
+            return unpack_compressed(arena, conn, m);
+        }
+
+        if (NULL == arena) {
+            ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_NOT_INITED, 0);
+            return false;
+        }
+
+        try {
+            // 二进制和字符串直接引用接收缓冲区，内存池只用来存放msgpack::object
+            size_t offset = 0;
+            msgpack::object obj = msgpack::unpack(*reinterpret_cast<msgpack::zone*>(arena),
+                reinterpret_cast<const char*>(buffer), s, offset, detail::unpack_reference_buffer);
+            if (obj.is_nil()) {
+                ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
+                return false;
+            }
+
+            obj.convert(m);
+        } catch (const std::exception&) {
             ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, EN_ATBUS_ERR_UNPACK, EN_ATBUS_ERR_UNPACK);
             return false;
         }
 
-        obj.convert(m);
+        return unpack_compressed(arena, conn, m);
+    }
+
+    bool connection::unpack_compressed(void* arena, connection& conn, atbus::protocol::msg& m) {
+        // 压缩只在单个连接上有效，收到后马上解压，转发时再按下一个连接决定是否压缩
+        int res = conn.owner_->decompress_data(arena, m);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(*conn.owner_, conn.binding_, &conn, res, EN_ATBUS_ERR_UNPACK);
+            return false;
+        }
+
         return true;
     }
 }
@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 
 #include "detail/buffer.h"
 
@@ -35,7 +36,7 @@ namespace atbus {
         return ret;
     }
 
-    endpoint::endpoint():id_(0), children_mask_(0), pid_(0), owner_(NULL) {
+    endpoint::endpoint():id_(0), children_mask_(0), pid_(0), compress_algorithms_(0), sync_version_(0), owner_(NULL) {
         flags_.reset();
     }
 
@@ -52,6 +53,10 @@ namespace atbus {
         }
         flags_.set(flag_t::RESETTING, true);
 
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
+
         // 需要临时给自身加引用计数，否则后续移除的过程中可能导致数据被提前释放
         ptr_t tmp_holder = watcher_.lock();
 
@@ -77,6 +82,16 @@ namespace atbus {
         }
     }
 
+    void endpoint::set_services(const std::vector<uint64_t>& services) {
+        services_ = services;
+        std::sort(services_.begin(), services_.end());
+        services_.erase(std::unique(services_.begin(), services_.end()), services_.end());
+    }
+
+    bool endpoint::has_service(uint64_t service) const {
+        return std::binary_search(services_.begin(), services_.end(), service);
+    }
+
     bool endpoint::is_child_node(bus_id_t id) const {
         // 目前id是整数，直接位运算即可
         bus_id_t mask = ~((1 << children_mask_) - 1);
@@ -136,6 +151,11 @@ namespace atbus {
         if (connection::state_t::HANDSHAKING == conn->get_status()) {
             conn->state_ = connection::state_t::CONNECTED;
         }
+
+        // 新的连接可能更快，重新选择
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
         return true;
     }
 
@@ -160,6 +180,10 @@ namespace atbus {
 
         assert(this == conn->binding_);
 
+        if (NULL != owner_) {
+            owner_->invalidate_route_cache();
+        }
+
         // 重置流程会在reset里清理对象，不需要再进行一次查找
         if (flags_.test(flag_t::RESETTING)) {
             conn->binding_ = NULL;
@@ -228,6 +252,19 @@ namespace atbus {
             return left->check_flag(connection::flag_t::ACCESS_SHARE_HOST);
         }
 
+        // 同类的连接按测量的延迟排序，还没有测量的排在后面
+        if (left->get_stat_rtt() != right->get_stat_rtt()) {
+            if (0 == right->get_stat_rtt()) {
+                return true;
+            }
+
+            if (0 == left->get_stat_rtt()) {
+                return false;
+            }
+
+            return left->get_stat_rtt() < right->get_stat_rtt();
+        }
+
         return false;
     }
 
@@ -291,7 +328,66 @@ namespace atbus {
         return get_ctrl_connection(ep);
     }
 
-    endpoint::stat_t::stat_t(): fault_count(0), unfinished_ping(0), ping_delay(0), last_pong_time(0){}
+    connection* endpoint::get_striped_data_connection(endpoint* ep, uint64_t stripe, bool keep_order) const {
+        connection* best = get_data_connection(ep);
+        if (NULL == best || ep->data_conn_.size() <= 1 || best == ep->ctrl_conn_.get()) {
+            return best;
+        }
+
+        // 和最优连接同一类(共享标记相同)的已连接的数据连接才参与分流
+        bool share_addr = best->check_flag(connection::flag_t::ACCESS_SHARE_ADDR);
+        bool share_host = best->check_flag(connection::flag_t::ACCESS_SHARE_HOST);
+        connection* ret = best;
+        size_t count = 0;
+        uint64_t max_weight = 0;
+        for (std::list<connection::ptr_t>::iterator iter = ep->data_conn_.begin(); iter != ep->data_conn_.end(); ++iter) {
+            connection* conn = (*iter).get();
+            if (connection::state_t::CONNECTED != conn->get_status() ||
+                share_addr != conn->check_flag(connection::flag_t::ACCESS_SHARE_ADDR) ||
+                share_host != conn->check_flag(connection::flag_t::ACCESS_SHARE_HOST)) {
+                continue;
+            }
+
+            ++count;
+            if (keep_order) {
+                // 最高随机权重(rendezvous)哈希，和连接的排序无关，连接增减时只有相关的流会换连接
+                uint64_t weight = stripe ^ static_cast<uint64_t>(reinterpret_cast<uintptr_t>(conn));
+                weight ^= weight >> 33;
+                weight *= static_cast<uint64_t>(0xff51afd7ed558ccdULL);
+                weight ^= weight >> 33;
+                weight *= static_cast<uint64_t>(0xc4ceb9fe1a85ec53ULL);
+                weight ^= weight >> 33;
+                if (1 == count || weight > max_weight) {
+                    max_weight = weight;
+                    ret = conn;
+                }
+            }
+        }
+
+        if (keep_order || count <= 1) {
+            return ret;
+        }
+
+        size_t idx = static_cast<size_t>(stripe % count);
+        for (std::list<connection::ptr_t>::iterator iter = ep->data_conn_.begin(); iter != ep->data_conn_.end(); ++iter) {
+            connection* conn = (*iter).get();
+            if (connection::state_t::CONNECTED != conn->get_status() ||
+                share_addr != conn->check_flag(connection::flag_t::ACCESS_SHARE_ADDR) ||
+                share_host != conn->check_flag(connection::flag_t::ACCESS_SHARE_HOST)) {
+                continue;
+            }
+
+            if (0 == idx) {
+                return conn;
+            }
+            --idx;
+        }
+
+        return ret;
+    }
+
+    endpoint::stat_t::stat_t(): fault_count(0), unfinished_ping(0), ping_delay(0), ping_skip_tick(0), rtt_ns(0), rtt_jitter_ns(0), last_pong_time(0), last_active_time(0), last_recv_tick(0),
+        load_hint(0), load_pending(0) {}
 
     /** 增加错误计数 **/
     size_t endpoint::add_stat_fault() {
@@ -320,7 +416,84 @@ namespace atbus {
         return stat_.ping_delay;
     }
 
+    void endpoint::set_stat_ping_skip(uint64_t tick) {
+        stat_.ping_skip_tick = tick;
+    }
+
+    uint64_t endpoint::get_stat_ping_skip() const {
+        return stat_.ping_skip_tick;
+    }
+
+    bool endpoint::add_stat_rtt(connection* conn, uint64_t rtt_ns) {
+        // 数据连接的延迟差别可能很大(比如共享内存和跨机器的TCP)，混在一起的话端点的延迟取决于采样的连接
+        if (NULL == conn || ctrl_conn_.get() == conn) {
+            if (0 == stat_.rtt_ns) {
+                stat_.rtt_ns = rtt_ns;
+                stat_.rtt_jitter_ns = rtt_ns / 2;
+            } else {
+                uint64_t diff = stat_.rtt_ns > rtt_ns ? stat_.rtt_ns - rtt_ns : rtt_ns - stat_.rtt_ns;
+                stat_.rtt_jitter_ns = stat_.rtt_jitter_ns - (stat_.rtt_jitter_ns >> 2) + (diff >> 2);
+                stat_.rtt_ns = stat_.rtt_ns - (stat_.rtt_ns >> 3) + (rtt_ns >> 3);
+            }
+        }
+
+        if (NULL == conn || conn->get_binding() != this) {
+            return false;
+        }
+
+        conn->add_stat_rtt(rtt_ns);
+
+        // 有多个数据连接时需要按新的延迟重新排序
+        if (data_conn_.size() > 1) {
+            for (std::list<connection::ptr_t>::iterator iter = data_conn_.begin(); iter != data_conn_.end(); ++iter) {
+                if ((*iter).get() == conn) {
+                    flags_.set(flag_t::CONNECTION_SORTED, false);
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    uint64_t endpoint::get_stat_rtt() const {
+        return stat_.rtt_ns;
+    }
+
+    uint64_t endpoint::get_stat_rtt_jitter() const {
+        return stat_.rtt_jitter_ns;
+    }
+
     time_t endpoint::get_stat_last_pong() const {
         return stat_.last_pong_time;
     }
+
+    void endpoint::set_stat_last_active(time_t tm) {
+        stat_.last_active_time = tm;
+    }
+
+    time_t endpoint::get_stat_last_active() const {
+        return stat_.last_active_time;
+    }
+
+    void endpoint::set_stat_last_recv(uint64_t tick) {
+        stat_.last_recv_tick = tick;
+    }
+
+    uint64_t endpoint::get_stat_last_recv() const {
+        return stat_.last_recv_tick;
+    }
+
+    void endpoint::set_stat_load(uint32_t load) {
+        stat_.load_hint = load;
+        stat_.load_pending = 0;
+    }
+
+    void endpoint::add_stat_load_pending() {
+        ++stat_.load_pending;
+    }
+
+    uint64_t endpoint::get_stat_load() const {
+        return static_cast<uint64_t>(stat_.load_hint) + stat_.load_pending;
+    }
 }
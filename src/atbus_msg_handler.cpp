@@ -8,6 +8,7 @@
 #include "atbus_msg_handler.h"
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
 
 namespace atbus {
 
@@ -22,6 +23,9 @@ namespace atbus {
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_DATA_TRANSFORM_RSP);
 
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_CUSTOM_CMD_REQ);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_BATCH);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_GROUP_DATA);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_SERVICE_DATA);
 
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_SYNC_REQ);
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_SYNC_RSP);
@@ -30,6 +34,7 @@ namespace atbus {
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_CONN_SYN);
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_PING);
                 ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_PONG);
+                ATBUS_CMD_REG_NAME(ATBUS_CMD_NODE_GROUP_SYNC);
 
                 for (int i = 0; i < ATBUS_CMD_MAX; ++i) {
                     if (fn_names[i].empty()) {
@@ -50,6 +55,56 @@ namespace atbus {
 
             return fn_names[cmd].c_str();
         }
+
+        /**
+         * @brief 打包到固定长度缓冲区的msgpack输出流，避免每次打包都分配内存
+         * @note 超出长度后不再写入，只记录总长度，由调用方判定
+         */
+        class msg_pack_writer {
+        public:
+            msg_pack_writer(void* buffer, size_t capacity): buffer_(reinterpret_cast<char*>(buffer)), capacity_(capacity), used_(0) {}
+
+            void write(const char* data, size_t len) {
+                if (used_ + len <= capacity_) {
+                    memcpy(buffer_ + used_, data, len);
+                }
+                used_ += len;
+            }
+
+            inline const char* data() const { return buffer_; }
+            inline size_t size() const { return used_; }
+            inline bool overflow() const { return used_ > capacity_; }
+
+        private:
+            char* buffer_;
+            size_t capacity_;
+            size_t used_;
+        };
+
+        /**
+         * @brief 记录对端注册时声明的压缩算法、服务类型和协议特性
+         */
+        static void set_reg_options(endpoint* ep, const protocol::reg_data& reg) {
+            ep->set_compress_algorithms(reg.compress_algorithms);
+            ep->set_services(reg.services);
+            ep->set_flag(endpoint::flag_t::BINARY_DATA, 0 != (reg.features & (1 << protocol::reg_feature_t::BINARY_DATA)));
+            ep->set_flag(endpoint::flag_t::CONN_SYN_FORWARD, 0 != (reg.features & (1 << protocol::reg_feature_t::CONN_SYN_FORWARD)));
+        }
+
+        /**
+         * @brief 发往tid的conn_syn的下一跳是tid自己，或者声明了能转发conn_syn时才能发送
+         * @note 老版本的节点不认识conn_data::bus_id，收到以后会直接连接通知里的地址
+         */
+        static bool can_send_conn_syn(node& n, ATBUS_MACRO_BUSID_TYPE tid) {
+            endpoint* route_ep = NULL;
+            connection* conn = NULL;
+            bool cache_hit = false;
+            if (n.find_route(tid, &endpoint::get_ctrl_connection, false, route_ep, conn, cache_hit) < 0 || NULL == route_ep) {
+                return false;
+            }
+
+            return route_ep->get_id() == tid || route_ep->get_flag(endpoint::flag_t::CONN_SYN_FORWARD);
+        }
     }
 
     int msg_handler::dispatch_msg(node& n, connection* conn, protocol::msg* m, int status, int errcode) {
@@ -59,6 +114,10 @@ namespace atbus {
             fns[ATBUS_CMD_DATA_TRANSFORM_RSP] = msg_handler::on_recv_data_transfer_rsp;
 
             fns[ATBUS_CMD_CUSTOM_CMD_REQ] = msg_handler::on_recv_custom_cmd_req;
+            // 批量数据消息的转发流程和普通数据消息一样，只有接收端需要拆开
+            fns[ATBUS_CMD_BATCH] = msg_handler::on_recv_data_transfer_req;
+            fns[ATBUS_CMD_GROUP_DATA] = msg_handler::on_recv_group_data;
+            fns[ATBUS_CMD_SERVICE_DATA] = msg_handler::on_recv_service_data;
 
             fns[ATBUS_CMD_NODE_SYNC_REQ] = msg_handler::on_recv_node_sync_req;
             fns[ATBUS_CMD_NODE_SYNC_RSP] = msg_handler::on_recv_node_sync_rsp;
@@ -67,6 +126,7 @@ namespace atbus {
             fns[ATBUS_CMD_NODE_CONN_SYN] = msg_handler::on_recv_node_conn_syn;
             fns[ATBUS_CMD_NODE_PING] = msg_handler::on_recv_node_ping;
             fns[ATBUS_CMD_NODE_PONG] = msg_handler::on_recv_node_pong;
+            fns[ATBUS_CMD_NODE_GROUP_SYNC] = msg_handler::on_recv_node_group_sync;
         }
 
         if (NULL == m) {
@@ -94,12 +154,14 @@ namespace atbus {
     int msg_handler::send_ping(node& n, connection& conn, uint32_t seq) {
         protocol::msg m;
         m.init(n.get_id(), ATBUS_CMD_NODE_PING, 0, 0, seq);
-        protocol::ping_data* ping = m.body.make_body(m.body.ping);
+        protocol::ping_data* ping = m.body.make_body<protocol::ping_data>();
         if (NULL == ping) {
             return EN_ATBUS_ERR_MALLOC;
         }
 
-        ping->time_point = (n.get_timer_sec() / 1000) * 1000 + (n.get_timer_usec() / 1000) % 1000;
+        // 用单调时钟，对端原样返回，不受系统时间调整和proc时间精度的影响
+        ping->time_point = static_cast<int64_t>(uv_hrtime());
+        ping->load = n.get_load_hint();
 
         return send_msg(n, conn, m);
     }
@@ -113,7 +175,7 @@ namespace atbus {
         protocol::msg m;
         m.init(n.get_id(), static_cast<ATBUS_PROTOCOL_CMD>(msg_id), 0, ret_code, 0 == seq? n.alloc_msg_seq(): seq);
 
-        protocol::reg_data* reg = m.body.make_body(m.body.reg);
+        protocol::reg_data* reg = m.body.make_body<protocol::reg_data>();
         if (NULL == reg) {
             return EN_ATBUS_ERR_MALLOC;
         }
@@ -129,24 +191,69 @@ namespace atbus {
 
         reg->children_id_mask = n.get_self_endpoint()->get_children_mask();
         reg->has_global_tree = n.get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER);
+        reg->compress_algorithms = n.get_compression_mask();
+        reg->services = n.get_self_endpoint()->get_services();
+        if (false == n.get_conf().flags.test(node::conf_flag_t::EN_CONF_MSGPACK_DATA)) {
+            reg->features |= 1 << protocol::reg_feature_t::BINARY_DATA;
+        }
+        reg->features |= 1 << protocol::reg_feature_t::CONN_SYN_FORWARD;
 
         return send_msg(n, conn, m);
     }
 
     int msg_handler::send_transfer_rsp(node& n, protocol::msg& m, int32_t ret_code) {
         m.init(n.get_id(), ATBUS_CMD_DATA_TRANSFORM_RSP, 0, ret_code, m.head.sequence);
-        m.body.forward->to = m.body.forward->from;
-        m.body.forward->from = n.get_id();
+        m.body.forward()->to = m.body.forward()->from;
+        m.body.forward()->from = n.get_id();
+        // 回包是新的路径，router满了(比如ttl超限)时保留请求的路由会导致回包也发不出去
+        m.body.forward()->router.clear();
 
-        return n.send_ctrl_msg(m.body.forward->to, m);
+        return n.send_ctrl_msg(m.body.forward()->to, m);
     }
 
     int msg_handler::send_msg(node& n, connection& conn, const protocol::msg& m) {
-        std::stringstream ss;
-        msgpack::pack(ss, m);
-        std::string packed_buffer = ss.str();
+        detail::buffer_block* pack_buffer = n.get_pack_buffer();
+        if (NULL == pack_buffer) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        // 对端注册时声明了支持的话，数据转发消息优先使用固定格式的二进制编码，否则(未注册或旧节点)使用msgpack
+        // 只打包消息头和router，数据部分直接作为第二个数据块发送，转发时不需要重新复制数据
+        const endpoint* peer = conn.get_binding();
+        if (NULL != peer && peer->get_flag(endpoint::flag_t::BINARY_DATA) &&
+            false == n.get_conf().flags.test(node::conf_flag_t::EN_CONF_MSGPACK_DATA) && protocol::binary_support(m)) {
+            size_t head_size = protocol::binary_pack_head(m, pack_buffer->data(), pack_buffer->size());
+            size_t packed_size = head_size + m.body.forward()->content.size;
+            if (0 == head_size || packed_size >= n.get_conf().msg_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            ATBUS_FUNC_NODE_DEBUG(n, conn.get_binding(), &conn, &m,
+                "node send binary msg(cmd=%s, type=%d, sequence=%u, ret=%d, length=%llu)",
+                detail::get_cmd_name(m.head.cmd),
+                m.head.type, m.head.sequence, m.head.ret,
+                static_cast<unsigned long long>(packed_size)
+            );
+            const void* buffers[2] = { pack_buffer->data(), m.body.forward()->content.ptr };
+            size_t sizes[2] = { head_size, m.body.forward()->content.size };
+
+            // io_stream连接上的大数据压缩后发送，只改写消息头里的flags和content长度
+            size_t compressed_size = 0;
+            const void* compressed = n.compress_data(conn, buffers[1], sizes[1], compressed_size);
+            if (NULL != compressed) {
+                protocol::binary_rewrite_content_head(pack_buffer->data(),
+                    m.body.forward()->flags | (1 << protocol::forward_data::FLAG_COMPRESSED), compressed_size);
+                buffers[1] = compressed;
+                sizes[1] = compressed_size;
+            }
+            return conn.push_v(buffers, sizes, 0 == sizes[1] ? 1 : 2);
+        }
+
+        // 通道发送时会复制数据，所以打包缓冲区可以复用
+        detail::msg_pack_writer packed_buffer(pack_buffer->data(), pack_buffer->size());
+        msgpack::pack(packed_buffer, m);
 
-        if (packed_buffer.size() >= n.get_conf().msg_size) {
+        if (packed_buffer.overflow() || packed_buffer.size() >= n.get_conf().msg_size) {
             return EN_ATBUS_ERR_BUFF_LIMIT;
         }
 
@@ -161,26 +268,67 @@ namespace atbus {
     }
 
     int msg_handler::on_recv_data_transfer_req(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
-        if (NULL == m.body.forward || NULL == conn) {
+        if (NULL == m.body.forward() || NULL == conn) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn? NULL: conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        if (m.body.forward->to == n.get_id()) {
+        if (m.body.forward()->to == n.get_id()) {
             ATBUS_FUNC_NODE_DEBUG(
                 n, (NULL == conn?NULL: conn->get_binding()), conn, 
                 &m, 
-                "node recv data length = %lld", static_cast<unsigned long long>(m.body.forward->content.size)
+                "node recv data length = %lld", static_cast<unsigned long long>(m.body.forward()->content.size)
             );
-            n.on_recv_data(conn->get_binding(), conn, m.head.type, m.body.forward->content.ptr, m.body.forward->content.size);
 
-            if (m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
+            // 跨子树直连的空闲检测
+            if (NULL != conn->get_binding() && conn->get_binding()->get_flag(endpoint::flag_t::SHORTCUT)) {
+                conn->get_binding()->set_stat_last_active(n.get_timer_sec());
+            }
+
+            if (m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_RPC_RESPONSE)) {
+                // RPC回包，找不到调用说明已经超时，直接丢弃。回包方是原始来源，不是转发的下一跳
+                n.on_call_response(m.body.forward()->from, m.head.sequence, m.head.ret, m.head.type,
+                    m.body.forward()->content.ptr, m.body.forward()->content.size);
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            if (m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_RPC_REQUEST)) {
+                return n.on_recv_call(conn->get_binding(), conn, m);
+            }
+
+            if (m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_FRAGMENT)) {
+                // 分片消息先重组，全部收到后再回调
+                int res = n.on_recv_fragment(conn->get_binding(), conn, m);
+                if (res < 0) {
+                    ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+                    return send_transfer_rsp(n, m, res);
+                }
+            } else if (ATBUS_CMD_BATCH == m.head.cmd) {
+                // 批量数据消息拆开后逐个回调
+                const void* data = m.body.forward()->content.ptr;
+                size_t left = m.body.forward()->content.size;
+                const void* item = NULL;
+                size_t item_len = 0;
+                while (protocol::batch_unpack_next(data, left, item, item_len)) {
+                    n.on_recv_data(conn->get_binding(), conn, m.head.type, item, item_len);
+                }
+
+                if (0 != left) {
+                    ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+                    return EN_ATBUS_ERR_BAD_DATA;
+                }
+            } else {
+                n.on_recv_data(conn->get_binding(), conn, m.head.type, m.body.forward()->content.ptr, m.body.forward()->content.size);
+            }
+
+            if (m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
                 return send_transfer_rsp(n, m, EN_ATBUS_ERR_SUCCESS);
             }
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        if (m.body.forward->router.size() >= static_cast<size_t>(n.get_conf().ttl)) {
+        // router的容量是固定的(ATBUS_MACRO_ROUTER_MAX_DEPTH)，满了也按ttl处理
+        if (m.body.forward()->router.size() >= static_cast<size_t>(n.get_conf().ttl) || m.body.forward()->router.full()) {
             return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_TTL);
         }
 
@@ -189,41 +337,45 @@ namespace atbus {
         // 转发数据
         node::bus_id_t direct_from_bus_id = m.head.src_bus_id;
 
-        res = n.send_data_msg(m.body.forward->to, m, &to_ep, NULL);
+        res = n.send_data_msg(m.body.forward()->to, m, &to_ep, NULL);
 
         // 子节点转发成功
-        if (res >= 0 && n.is_child_node(m.body.forward->to)) {
-            // 如果来源和目标消息都来自于子节点，则通知建立直连
-            if (NULL != to_ep && n.is_child_node(direct_from_bus_id) && n.is_child_node(to_ep->get_id())) {
-                protocol::msg conn_syn_m;
-                conn_syn_m.init(n.get_id(), ATBUS_CMD_NODE_CONN_SYN, 0, 0, n.alloc_msg_seq());
-                protocol::conn_data* new_conn = conn_syn_m.body.make_body(conn_syn_m.body.conn);
-                if (NULL == new_conn) {
-                    ATBUS_FUNC_NODE_ERROR(n, NULL, NULL, EN_ATBUS_ERR_MALLOC, 0);
-                    return send_transfer_rsp(n, m, EN_ATBUS_ERR_MALLOC);
+        if (res >= 0 && n.is_child_node(m.body.forward()->to)) {
+            // 如果来源和目标消息都来自于子节点，则通知建立直连，建立完成前转发的消息不重复通知
+            if (NULL != to_ep && n.is_child_node(direct_from_bus_id) && n.is_child_node(to_ep->get_id()) &&
+                n.on_relay_brother_data(direct_from_bus_id, to_ep->get_id())) {
+                int syn_res = send_conn_syn(n, direct_from_bus_id, *to_ep);
+                if (EN_ATBUS_ERR_MALLOC == syn_res) {
+                    return send_transfer_rsp(n, m, syn_res);
                 }
 
-                const std::list<std::string>& listen_addrs = to_ep->get_listen();
-                for (std::list<std::string>::const_iterator iter = listen_addrs.begin(); iter != listen_addrs.end(); ++ iter) {
-                    // 通知连接控制通道，控制通道不能是（共享）内存通道
-                    if (0 != UTIL_STRFUNC_STRNCASE_CMP("mem", iter->c_str(), 3) &&
-                        0 != UTIL_STRFUNC_STRNCASE_CMP("shm", iter->c_str(), 3)) {
-                        new_conn->address.address = *iter;
-                        break;
-                    }
-                }
+                return syn_res;
+            }
+        }
 
-                if (!new_conn->address.address.empty()) {
-                    return n.send_ctrl_msg(direct_from_bus_id, conn_syn_m);
-                }
+        // 最后一跳的转发节点知道目标的地址，来源不是直接连接的节点并且流量达到阈值时，通知来源直连目标
+        /*
+        //       F1 ------------ F2
+        //      /  \            /  \
+        //    C11  C12        C21  C22
+        // C11发往C21的数据由F2统计，通过F1把C21的地址通知给C11
+        */
+        if (res >= 0 && NULL != to_ep && to_ep->get_id() == m.body.forward()->to &&
+            m.body.forward()->from != direct_from_bus_id && false == to_ep->is_child_node(m.body.forward()->from) &&
+            n.on_relay_data(m.body.forward()->from, m.body.forward()->to)) {
+            int syn_res = send_conn_syn(n, m.body.forward()->from, *to_ep);
+            if (syn_res < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, to_ep, NULL, syn_res, 0);
             }
+        }
 
+        if (res >= 0 && n.is_child_node(m.body.forward()->to)) {
             return res;
         }
 
         // 直接兄弟节点转发失败，并且不来自于父节点，则转发送给父节点(父节点也会被判定为兄弟节点)
         // 如果失败可能是兄弟节点的连接未完成，但是endpoint已建立，所以直接发给父节点
-        if (res < 0 && false == n.is_parent_node(m.head.src_bus_id) && n.is_brother_node(m.body.forward->to)) {
+        if (res < 0 && false == n.is_parent_node(m.head.src_bus_id) && n.is_brother_node(m.body.forward()->to)) {
             // 如果失败的发送目标已经是父节点则不需要重发
             const endpoint* parent_ep = n.get_parent_endpoint();
             if (NULL != parent_ep && (NULL == to_ep || false == n.is_parent_node(to_ep->get_id()))) {
@@ -232,7 +384,7 @@ namespace atbus {
         }
 
         // 只有失败或请求方要求回包，才下发通知，类似ICMP协议
-        if (res < 0 || m.body.forward->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
+        if (res < 0 || m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP)) {
             res = send_transfer_rsp(n, m, res);
         }
         
@@ -243,39 +395,133 @@ namespace atbus {
         return res;
     }
 
+    int msg_handler::send_conn_syn(node& n, ATBUS_MACRO_BUSID_TYPE tid, const endpoint& target) {
+        protocol::msg conn_syn_m;
+        conn_syn_m.init(n.get_id(), ATBUS_CMD_NODE_CONN_SYN, 0, 0, n.alloc_msg_seq());
+        protocol::conn_data* new_conn = conn_syn_m.body.make_body<protocol::conn_data>();
+        if (NULL == new_conn) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL, NULL, EN_ATBUS_ERR_MALLOC, 0);
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        const std::list<std::string>& listen_addrs = target.get_listen();
+        for (std::list<std::string>::const_iterator iter = listen_addrs.begin(); iter != listen_addrs.end(); ++ iter) {
+            // 通知连接控制通道，控制通道不能是（共享）内存通道
+            if (0 != UTIL_STRFUNC_STRNCASE_CMP("mem", iter->c_str(), 3) &&
+                0 != UTIL_STRFUNC_STRNCASE_CMP("shm", iter->c_str(), 3)) {
+                new_conn->address.address = *iter;
+                break;
+            }
+        }
+
+        if (new_conn->address.address.empty()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // tid不是直接连接的节点时由中间节点转发
+        if (false == detail::can_send_conn_syn(n, tid)) {
+            ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &conn_syn_m, "next hop to 0x%llx can not forward conn_syn, skip it",
+                static_cast<unsigned long long>(tid));
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        new_conn->bus_id = tid;
+        new_conn->target = target.get_id();
+        return n.send_ctrl_msg(tid, conn_syn_m);
+    }
+
     int msg_handler::on_recv_data_transfer_rsp(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
-        if (NULL == m.body.forward || NULL == conn) {
+        if (NULL == m.body.forward() || NULL == conn) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
         ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, m.head.ret, 0);
+
+        // RPC请求发送失败直接完成调用，不需要等到超时
+        if (m.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_RPC_REQUEST) && m.head.ret < 0) {
+            n.on_call_failed(m.body.forward()->to, m.head.sequence, m.head.ret);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
         n.on_send_data_failed(conn->get_binding(), conn, &m);
 
         return EN_ATBUS_ERR_SUCCESS;
     }
 
     int msg_handler::on_recv_custom_cmd_req(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
-        if (NULL == m.body.custom) {
+        if (NULL == m.body.custom()) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
         std::vector<std::pair<const void*, size_t> > cmd_args;
-        cmd_args.reserve(m.body.custom->commands.size());
-        for (size_t i = 0; i < m.body.custom->commands.size(); ++i) {
-            cmd_args.push_back(std::make_pair(m.body.custom->commands[i].ptr, m.body.custom->commands[i].size));
+        cmd_args.reserve(m.body.custom()->commands.size());
+        for (size_t i = 0; i < m.body.custom()->commands.size(); ++i) {
+            cmd_args.push_back(std::make_pair(m.body.custom()->commands[i].ptr, m.body.custom()->commands[i].size));
         }
 
-        return n.on_custom_cmd(NULL == conn ? NULL : conn->get_binding(), conn, m.body.custom->from, cmd_args);
+        return n.on_custom_cmd(NULL == conn ? NULL : conn->get_binding(), conn, m.body.custom()->from, cmd_args);
     }
 
-    int msg_handler::on_recv_node_sync_req(node& n, connection* conn, protocol::msg&, int status, int errcode) {
+    int msg_handler::on_recv_group_data(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
+        if (NULL == m.body.forward() || NULL == conn) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        // 组播没有失败通知，转发失败已经记录错误，不计入来源链路的错误次数
+        n.on_recv_group_data(conn, m);
         return EN_ATBUS_ERR_SUCCESS;
     }
 
-    int msg_handler::on_recv_node_sync_rsp(node& n, connection* conn, protocol::msg&, int status, int errcode) {
-        return EN_ATBUS_ERR_SUCCESS;
+    int msg_handler::on_recv_service_data(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
+        if (NULL == m.body.forward() || NULL == conn) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        // router的容量是固定的(ATBUS_MACRO_ROUTER_MAX_DEPTH)，满了也按ttl处理
+        if (m.body.forward()->router.size() >= static_cast<size_t>(n.get_conf().ttl) || m.body.forward()->router.full()) {
+            return send_transfer_rsp(n, m, EN_ATBUS_ERR_ATNODE_TTL);
+        }
+
+        int res = n.on_recv_service_data(conn, m);
+        if (res < 0) {
+            // 选不出实例或者转发失败，通知发送方
+            ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+            return send_transfer_rsp(n, m, res);
+        }
+
+        return res;
+    }
+
+    int msg_handler::on_recv_node_sync_req(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
+        // 子节点上报的子树
+        if (NULL == m.body.sync() || NULL == conn || NULL == conn->get_binding()) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        int res = n.on_recv_node_sync(*conn->get_binding(), m);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+        }
+        return res;
+    }
+
+    int msg_handler::on_recv_node_sync_rsp(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
+        // 父节点下发的全局路由表
+        if (NULL == m.body.sync() || NULL == conn || NULL == conn->get_binding()) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        int res = n.on_recv_node_sync(*conn->get_binding(), m);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+        }
+        return res;
     }
 
     int msg_handler::on_recv_node_reg_req(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
@@ -284,7 +530,7 @@ namespace atbus {
         int32_t rsp_code = EN_ATBUS_ERR_SUCCESS;
 
         do {
-            if (NULL == m.body.reg || NULL == conn) {
+            if (NULL == m.body.reg() || NULL == conn) {
                 rsp_code = EN_ATBUS_ERR_BAD_DATA;
                 break;
             }
@@ -292,28 +538,31 @@ namespace atbus {
             // 如果连接已经设定了端点，不需要再绑定到endpoint
             if (conn->is_connected()) {
                 ep = conn->get_binding();
-                if (NULL == ep || ep->get_id() != m.body.reg->bus_id) {
+                if (NULL == ep || ep->get_id() != m.body.reg()->bus_id) {
                     ATBUS_FUNC_NODE_ERROR(n, ep, conn, EN_ATBUS_ERR_ATNODE_BUS_ID_NOT_MATCH, 0);
                     conn->reset();
                     rsp_code = EN_ATBUS_ERR_ATNODE_BUS_ID_NOT_MATCH;
                     break;
                 }
 
+                detail::set_reg_options(ep, *m.body.reg());
                 ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "connection already connected recv req");
                 break;
             }
 
             // 老端点新增连接不需要创建新连接
-            ep = n.get_endpoint(m.body.reg->bus_id);
+            ep = n.get_endpoint(m.body.reg()->bus_id);
             if (NULL != ep) {
                 // 检测机器名和进程号必须一致
-                if (ep->get_pid() != m.body.reg->pid || ep->get_hostname() != m.body.reg->hostname) {
+                if (ep->get_pid() != m.body.reg()->pid || ep->get_hostname() != m.body.reg()->hostname) {
                     res = EN_ATBUS_ERR_ATNODE_ID_CONFLICT;
                     ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
                 } else if (false == ep->add_connection(conn, conn->check_flag(connection::flag_t::ACCESS_SHARE_HOST))) {
                     // 有共享物理机限制的连接只能加为数据节点（一般就是内存通道或者共享内存通道）
                     res = EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
                     ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
+                } else {
+                    detail::set_reg_options(ep, *m.body.reg());
                 }
                 rsp_code = res;
 
@@ -322,8 +571,8 @@ namespace atbus {
             }
 
             // 创建新端点时需要判定全局路由表权限
-            if (n.is_child_node(m.body.reg->bus_id)) {
-                if(m.body.reg->has_global_tree && false == n.get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            if (n.is_child_node(m.body.reg()->bus_id)) {
+                if(m.body.reg()->has_global_tree && false == n.get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
                     rsp_code = EN_ATBUS_ERR_ACCESS_DENY;
 
                     ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "self has no global tree, children reg access deny");
@@ -331,7 +580,7 @@ namespace atbus {
                 }
 
                 // 子节点域范围必须小于自身
-                if (n.get_self_endpoint()->get_children_mask() <= m.body.reg->children_id_mask) {
+                if (n.get_self_endpoint()->get_children_mask() <= m.body.reg()->children_id_mask) {
                     rsp_code = EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
 
                     ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "child mask must be greater than child node");
@@ -339,13 +588,15 @@ namespace atbus {
                 }
             }
 
-            endpoint::ptr_t new_ep = endpoint::create(&n, m.body.reg->bus_id, m.body.reg->children_id_mask, m.body.reg->pid, m.body.reg->hostname);
+            endpoint::ptr_t new_ep = endpoint::create(&n, m.body.reg()->bus_id, m.body.reg()->children_id_mask, m.body.reg()->pid, m.body.reg()->hostname);
             if (!new_ep) {
                 ATBUS_FUNC_NODE_ERROR(n, NULL, conn, EN_ATBUS_ERR_MALLOC, 0);
                 rsp_code = EN_ATBUS_ERR_MALLOC;
                 break;
             }
             ep = new_ep.get();
+            // 添加前设置，子节点加入全局路由表时需要
+            ep->set_flag(endpoint::flag_t::GLOBAL_ROUTER, m.body.reg()->has_global_tree);
 
             res = n.add_endpoint(new_ep);
             if (res < 0) {
@@ -353,18 +604,41 @@ namespace atbus {
                 rsp_code = res;
                 break;
             }
-            ep->set_flag(endpoint::flag_t::GLOBAL_ROUTER, m.body.reg->has_global_tree);
+            detail::set_reg_options(ep, *m.body.reg());
 
             ATBUS_FUNC_NODE_DEBUG(n, ep, conn, &m, "node add a new endpoint, res: %d", res);
             // 新的endpoint要建立所有连接
             ep->add_connection(conn, false);
             bool has_data_conn = false;
-            for (size_t i = 0; i < m.body.reg->channels.size(); ++i) {
-                const protocol::channel_data& chan = m.body.reg->channels[i];
-                res = n.connect(chan.address.c_str(), ep);
-                if (res < 0) {
-                    ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
-                } else {
+            for (size_t i = 0; i < m.body.reg()->channels.size(); ++i) {
+                const protocol::channel_data& chan = m.body.reg()->channels[i];
+                bool is_mem = 0 == UTIL_STRFUNC_STRNCASE_CMP("mem:", chan.address.c_str(), 4);
+                bool is_shm = 0 == UTIL_STRFUNC_STRNCASE_CMP("shm:", chan.address.c_str(), 4);
+                // 共享内存通道只在同一台机器上可用，内存通道还必须是同一个进程
+                if ((is_mem || is_shm) && m.body.reg()->hostname != n.get_hostname()) {
+                    continue;
+                }
+                if (is_mem && m.body.reg()->pid != n.get_pid()) {
+                    continue;
+                }
+
+                // io_stream通道按配置建立多条并行的数据连接，内存和共享内存通道只需要一条
+                size_t conn_num = 1;
+                if (!is_mem && !is_shm && n.get_conf().data_conn_count > 1) {
+                    conn_num = n.get_conf().data_conn_count;
+                }
+
+                bool chan_connected = false;
+                for (size_t j = 0; j < conn_num; ++j) {
+                    res = n.connect(chan.address.c_str(), ep);
+                    if (res < 0) {
+                        ATBUS_FUNC_NODE_ERROR(n, ep, conn, res, 0);
+                    } else {
+                        chan_connected = true;
+                    }
+                }
+
+                if (chan_connected) {
                     ep->add_listen(chan.address);
                     has_data_conn = true;
                 }
@@ -415,16 +689,22 @@ namespace atbus {
             }
             
             return m.head.ret;
-        } else if(node::state_t::CONNECTING_PARENT == n.get_state()) {
+        }
+
+        if (NULL != ep && NULL != m.body.reg()) {
+            detail::set_reg_options(ep, *m.body.reg());
+        }
+
+        if(node::state_t::CONNECTING_PARENT == n.get_state()) {
             // 父节点返回的rsp成功则可以上线
             // 这时候父节点的endpoint不一定初始化完毕
-            if (n.is_parent_node(m.body.reg->bus_id)) {
+            if (n.is_parent_node(m.body.reg()->bus_id)) {
                 n.on_parent_reg_done();
                 n.on_actived();
             } else {
-                node::bus_id_t min_c = endpoint::get_children_min_id(m.body.reg->bus_id, m.body.reg->children_id_mask);
-                node::bus_id_t max_c = endpoint::get_children_max_id(m.body.reg->bus_id, m.body.reg->children_id_mask);
-                if (n.get_id() != m.body.reg->bus_id && n.get_id() >= min_c && n.get_id() <= max_c) {
+                node::bus_id_t min_c = endpoint::get_children_min_id(m.body.reg()->bus_id, m.body.reg()->children_id_mask);
+                node::bus_id_t max_c = endpoint::get_children_max_id(m.body.reg()->bus_id, m.body.reg()->children_id_mask);
+                if (n.get_id() != m.body.reg()->bus_id && n.get_id() >= min_c && n.get_id() <= max_c) {
                     n.on_parent_reg_done();
                 }
             }
@@ -434,13 +714,37 @@ namespace atbus {
     }
 
     int msg_handler::on_recv_node_conn_syn(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
-        if (NULL == m.body.conn || NULL == conn) {
+        if (NULL == m.body.conn() || NULL == conn) {
             ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "node recv conn_syn and prepare connect to %s", m.body.conn->address.address.c_str());
-        int ret = n.connect(m.body.conn->address.address.c_str());
+        // 不是发给自己的沿路由转发给需要建立连接的节点
+        if (0 != m.body.conn()->bus_id && n.get_id() != m.body.conn()->bus_id) {
+            if (false == detail::can_send_conn_syn(n, m.body.conn()->bus_id)) {
+                ATBUS_FUNC_NODE_DEBUG(n, conn->get_binding(), conn, &m, "next hop to 0x%llx can not forward conn_syn, drop it",
+                    static_cast<unsigned long long>(m.body.conn()->bus_id));
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            int ret = n.send_ctrl_msg(m.body.conn()->bus_id, m);
+            if (ret < 0) {
+                ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, ret, 0);
+            }
+            return ret;
+        }
+
+        // 已经和目标连通时不再重复连接，连接中的重复通知由转发节点按重试间隔限制
+        if (0 != m.body.conn()->target) {
+            endpoint* target = n.get_endpoint(m.body.conn()->target);
+            if (NULL != target && target->get_id() == m.body.conn()->target &&
+                NULL != n.get_self_endpoint()->get_data_connection(target)) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(n, NULL, NULL, &m, "node recv conn_syn and prepare connect to %s", m.body.conn()->address.address.c_str());
+        int ret = n.connect(m.body.conn()->address.address.c_str());
         if (ret < 0) {
             ATBUS_FUNC_NODE_ERROR(n, n.get_self_endpoint(), NULL, ret, 0);
         }
@@ -451,15 +755,19 @@ namespace atbus {
         // 复制sequence
         m.init(n.get_id(), ATBUS_CMD_NODE_PONG, 0, 0, m.head.sequence);
 
-        if (NULL == m.body.ping) {
+        if (NULL == m.body.ping()) {
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        if (NULL != conn) {
-            endpoint* ep = conn->get_binding();
-            if (NULL != ep) {
-                return n.send_ctrl_msg(ep->get_id(), m);
-            }
+        // 记录对端的负载提示，PONG里换成自己的
+        if (NULL != conn && NULL != conn->get_binding()) {
+            conn->get_binding()->set_stat_load(m.body.ping()->load);
+        }
+        m.body.ping()->load = n.get_load_hint();
+
+        // 从收到的连接原路返回，发送方才能测量每个连接的延迟
+        if (NULL != conn && NULL != conn->get_binding()) {
+            return send_msg(n, *conn, m);
         }
 
         return EN_ATBUS_ERR_SUCCESS;
@@ -467,21 +775,46 @@ namespace atbus {
 
     int msg_handler::on_recv_node_pong(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
 
-        if (NULL == m.body.ping) {
+        if (NULL == m.body.ping()) {
             return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        if (NULL != conn) {
-            endpoint* ep = conn->get_binding();
+        if (NULL == conn || NULL == conn->get_binding()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        endpoint* ep = conn->get_binding();
+        ep->set_stat_load(m.body.ping()->load);
 
-            if (NULL != ep && m.head.sequence == ep->get_stat_ping()) {
-                ep->set_stat_ping(0);
+        int64_t rtt_ns = static_cast<int64_t>(uv_hrtime()) - m.body.ping()->time_point;
+        if (m.head.sequence == ep->get_stat_ping()) {
+            ep->set_stat_ping(0);
+        } else if (0 != m.head.sequence && m.head.sequence == conn->get_stat_ping()) {
+            conn->set_stat_ping(0);
+        } else {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
 
-                time_t time_point = (n.get_timer_sec() / 1000) * 1000 + (n.get_timer_usec() / 1000) % 1000;
-                ep->set_stat_ping_delay(time_point - m.body.ping->time_point, n.get_timer_sec());
-            }
+        if (m.body.ping()->time_point <= 0 || rtt_ns < 0) {
+            return EN_ATBUS_ERR_SUCCESS;
         }
 
+        ep->set_stat_ping_delay(static_cast<time_t>(rtt_ns / 1000000), n.get_timer_sec());
+        n.on_recv_rtt(*ep, conn, static_cast<uint64_t>(rtt_ns));
         return EN_ATBUS_ERR_SUCCESS;
     }
+
+    int msg_handler::on_recv_node_group_sync(node& n, connection* conn, protocol::msg& m, int status, int errcode) {
+        // 子节点上报的子树关注的组
+        if (NULL == m.body.group() || NULL == conn || NULL == conn->get_binding()) {
+            ATBUS_FUNC_NODE_ERROR(n, NULL == conn ? NULL : conn->get_binding(), conn, EN_ATBUS_ERR_BAD_DATA, 0);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        int res = n.on_recv_group_sync(*conn->get_binding(), m);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(n, conn->get_binding(), conn, res, 0);
+        }
+        return res;
+    }
 }
@@ -21,6 +21,7 @@
 #include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
 
 #include <common/string_oprs.h>
 
@@ -31,6 +32,7 @@
 #include "atbus_node.h"
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
 
 namespace atbus {
     namespace detail {
@@ -42,13 +44,19 @@ namespace atbus {
         };
     }
 
-    node::node(): state_(state_t::CREATED), ev_loop_(NULL), static_buffer_(NULL), on_debug(NULL){
+    node::node(): state_(state_t::CREATED), ev_loop_(NULL), static_buffer_(NULL), pack_buffer_(NULL), call_count_(0), fragment_recv_size_(0), decode_arena_(NULL), decode_arena_ref_(0),
+        route_epoch_(0), data_stripe_seq_(0), sync_node_count_(0), sync_version_(0), sync_report_version_(0), load_hint_(0), on_debug(NULL){
         event_timer_.sec = 0;
         event_timer_.usec = 0;
         event_timer_.node_sync_push = 0;
+        event_timer_.group_sync_push = 0;
+        event_timer_.shortcut_check = 0;
         event_timer_.father_opr_time_point = 0;
 
         flags_.reset();
+
+        memset(compression_codecs_, 0, sizeof(compression_codecs_));
+        register_compression(compression::lz_codec());
     }
 
     node::~node() {
@@ -67,15 +75,29 @@ namespace atbus {
 
         conf->first_idle_timeout = ATBUS_MACRO_CONNECTION_CONFIRM_TIMEOUT;
         conf->ping_interval = 60;
+        conf->ping_skip_limit = 5;
         conf->retry_interval = 3;
         conf->fault_tolerant = 3;
+        conf->data_conn_count = 1;
         conf->backlog = ATBUS_MACRO_CONNECTION_BACKLOG;
 
         conf->msg_size = ATBUS_MACRO_MSG_LIMIT;
         conf->recv_buffer_size = ATBUS_MACRO_MSG_LIMIT * 32; // default for 3 times of ATBUS_MACRO_MSG_LIMIT = 2MB
-        conf->send_buffer_size = ATBUS_MACRO_MSG_LIMIT;
+        conf->send_buffer_size = ATBUS_MACRO_MSG_LIMIT * 32; // 2MB
         conf->send_buffer_number = 0;
 
+        conf->fragment_max_size = ATBUS_MACRO_MSG_LIMIT * 16; // 1MB, 所有分片要能一起放进发送缓冲区
+        conf->fragment_buffer_size = ATBUS_MACRO_MSG_LIMIT * 512; // 32MB
+        conf->fragment_timeout = 30;
+
+        conf->compress_threshold = 0;
+        conf->compress_algorithm = compression::algorithm_t::LZ;
+
+        conf->shortcut_threshold = 0;
+        conf->shortcut_idle_timeout = 60;
+
+        conf->auto_shm_key_base = ATBUS_MACRO_SHM_AUTO_KEY_BASE;
+
         conf->flags.reset();
     }
 
@@ -107,8 +129,14 @@ namespace atbus {
         }
         // 复制全局路由表配置
         self_->set_flag(endpoint::flag_t::GLOBAL_ROUTER, conf_.flags.test(conf_flag_t::EN_CONF_GLOBAL_ROUTER));
+        // 全局路由表里总是有自身
+        sync_set_node(id, conf_.children_mask, self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER), id, 0);
 
         static_buffer_ = detail::buffer_block::malloc(conf_.msg_size + detail::buffer_block::head_size(conf_.msg_size) + 16); // 预留crc32长度和vint长度);
+        pack_buffer_ = detail::buffer_block::malloc(conf_.msg_size);
+        // 内存池每块的大小和消息长度一致，一般一个消息只会用到第一块
+        decode_arena_ = new msgpack::zone(conf_.msg_size);
+        decode_arena_ref_ = 0;
 
         state_ = state_t::INITED;
         return EN_ATBUS_ERR_SUCCESS;
@@ -118,6 +146,14 @@ namespace atbus {
         // 初始化时间
         event_timer_.sec = time(NULL);
 
+        // 共享内存通道要在注册前监听，才能随注册消息发给对端
+        if (conf_.flags.test(conf_flag_t::EN_CONF_AUTO_SHM)) {
+            int res = listen_auto_shm();
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, self_.get(), NULL, res, 0);
+            }
+        }
+
         // 连接父节点
         if (!conf_.father_address.empty()) {
             if(!node_father_.node_) {
@@ -144,14 +180,16 @@ namespace atbus {
         }
         flags_.set(flag_t::EN_FT_RESETTING, true);
 
-        // 所有连接断开
-        for (detail::auto_select_map<std::string, connection::ptr_t>::type::iterator iter = proc_connections_.begin(); 
-            iter != proc_connections_.end(); ++ iter) {
+        // 所有连接断开，断开时会从proc_connections_里移除自身，所以先移出来再遍历
+        detail::auto_select_map<std::string, connection::ptr_t>::type proc_connections;
+        proc_connections.swap(proc_connections_);
+        for (detail::auto_select_map<std::string, connection::ptr_t>::type::iterator iter = proc_connections.begin(); 
+            iter != proc_connections.end(); ++ iter) {
             if (iter->second) {
                 iter->second->reset();
             }
         }
-        proc_connections_.clear();
+        proc_connections.clear();
 
         // 销毁endpoint
         if (node_father_.node_) {
@@ -160,10 +198,51 @@ namespace atbus {
         // endpoint 不应该游离在node以外，所以这里就应该要触发endpoint::reset
         remove_collection(node_brother_);
         remove_collection(node_children_);
+        remove_collection(node_shortcut_);
+        relay_traffic_.clear();
+        event_timer_.shortcut_check = 0;
+
+        route_cache_.clear();
+        invalidate_route_cache();
+
+        // 清空全局路由表
+        sync_nodes_.clear();
+        sync_node_count_ = 0;
+        sync_version_ = 0;
+        sync_report_version_ = 0;
+        event_timer_.node_sync_push = 0;
+
+        // 清空组播的关注
+        groups_.clear();
+        group_child_reports_.clear();
+        event_timer_.group_sync_push = 0;
+        load_hint_ = 0;
 
         // 清空检测列表和ping列表
         event_timer_.pending_check_list_.clear();
-        event_timer_.ping_list.clear();
+        event_timer_.checking_list.clear();
+        event_timer_.ping_list.reset(get_timer_tick());
+        event_timer_.ping_expired.clear();
+
+        // 清空未完成的分片重组
+        fragment_recv_.clear();
+        fragment_recv_size_ = 0;
+        event_timer_.fragment_list.reset(get_timer_tick());
+        event_timer_.fragment_expired.clear();
+
+        // 未完成的RPC调用全部回调失败，重置期间不能发起新的调用
+        for (size_t i = 0; i < call_table_.size() && call_count_ > 0; ) {
+            if (call_table_[i].used) {
+                on_call_failed(call_table_[i].target, call_table_[i].sequence, EN_ATBUS_ERR_CHANNEL_CLOSING);
+            } else {
+                ++i;
+            }
+        }
+        {
+            std::vector<call_entry_t> empty_call_table;
+            call_table_.swap(empty_call_table);
+        }
+        call_timer_.reset(0);
 
         // 清空正在连接或握手的列表
         // 必须显式指定断开，以保证会主动断开正在进行的连接
@@ -199,6 +278,32 @@ namespace atbus {
             detail::buffer_block::free(static_buffer_);
             static_buffer_ = NULL;
         }
+
+        if (NULL != pack_buffer_) {
+            detail::buffer_block::free(pack_buffer_);
+            pack_buffer_ = NULL;
+        }
+
+        {
+            std::vector<unsigned char> empty_send_data_buffer;
+            send_data_buffer_.swap(empty_send_data_buffer);
+        }
+
+        {
+            std::vector<unsigned char> empty_send_encode_buffer;
+            send_encode_buffer_.swap(empty_send_encode_buffer);
+        }
+
+        {
+            std::vector<unsigned char> empty_compress_buffer;
+            compress_buffer_.swap(empty_compress_buffer);
+        }
+
+        if (NULL != decode_arena_) {
+            delete reinterpret_cast<msgpack::zone*>(decode_arena_);
+            decode_arena_ = NULL;
+            decode_arena_ref_ = 0;
+        }
         
         conf_.flags.reset();
         state_ = state_t::CREATED;
@@ -236,10 +341,12 @@ namespace atbus {
 
         ret += static_cast<int>(stat_.dispatch_times - stat_dispatch);
 
+        uint64_t tick = get_timer_tick();
+
         // connection超时下线
         while (!event_timer_.connecting_list.empty()) {
             evt_timer_t::timer_desc_ls<connection::ptr_t>::pair_type& top = event_timer_.connecting_list.front();
-            if (top.first < sec || (top.second && top.second->is_connected())) {
+            if (top.first <= tick || (top.second && top.second->is_connected())) {
                 // 已无效对象则忽略
                 if (top.second && false == top.second->is_connected()) {
                     if (event_msg_.on_invalid_connection) {
@@ -276,6 +383,13 @@ namespace atbus {
                     event_timer_.father_opr_time_point = sec + conf_.first_idle_timeout;
                     state_ = state_t::CONNECTING_PARENT;
                 }
+            } else if (0 != node_father_.node_->get_stat_last_recv() &&
+                static_cast<time_t>(node_father_.node_->get_stat_last_recv() / 1000) + conf_.ping_interval >= sec &&
+                check_ping_skip(*node_father_.node_, tick)) {
+                // 和子节点一样，一个ping间隔内收到过父节点的消息就跳过ping
+                node_father_.node_->set_stat_ping(0);
+                ++stat_.ping_skip_times;
+                event_timer_.father_opr_time_point = static_cast<time_t>(node_father_.node_->get_stat_last_recv() / 1000) + conf_.ping_interval;
             } else {
                 int res = ping_endpoint(*node_father_.node_);
                 if (res < 0) {
@@ -287,16 +401,29 @@ namespace atbus {
             }
         }
 
-        // Ping包
-        while(!event_timer_.ping_list.empty() && event_timer_.ping_list.front().first < sec) {
-            endpoint::ptr_t ep = event_timer_.ping_list.front().second.lock();
-            event_timer_.ping_list.pop_front();
+        // Ping包，只有到期的定时器才需要检查对象
+        if (event_timer_.ping_list.advance(tick, event_timer_.ping_expired) > 0) {
+            for (size_t i = 0; i < event_timer_.ping_expired.size(); ++i) {
+                endpoint::ptr_t ep = event_timer_.ping_expired[i].second.lock();
+
+                // 已移除对象则忽略
+                if (!ep) {
+                    continue;
+                }
+
+                // 一个ping间隔内收到过消息的链路不需要ping，定时器推迟到空闲满一个间隔的时候
+                // 在上一次ping之后收到过消息的话，未返回的ping也不算错误
+                uint64_t idle_tick = ep->get_stat_last_recv() + static_cast<uint64_t>(conf_.ping_interval) * 1000;
+                if (0 != ep->get_stat_last_recv() && idle_tick > tick && check_ping_skip(*ep, tick)) {
+                    ep->set_stat_ping(0);
+                    ++stat_.ping_skip_times;
+                    event_timer_.ping_list.add(idle_tick, ep);
+                    continue;
+                }
 
-            // 已移除对象则忽略
-            if (ep) {
                 // 忽略错误
                 ping_endpoint(*ep);
-                event_timer_.ping_list.push_back(std::make_pair(sec + conf_.ping_interval, ep));
+                add_ping_timer(ep);
             }
         }
 
@@ -311,22 +438,66 @@ namespace atbus {
             }
         }
 
+        // 组关注的上报，延迟会影响新订阅收到数据的时间，所以不等到下一秒
+        if (0 != event_timer_.group_sync_push && event_timer_.group_sync_push <= sec) {
+            if (push_group_sync() < 0) {
+                event_timer_.group_sync_push = sec + conf_.retry_interval;
+            } else {
+                event_timer_.group_sync_push = 0;
+            }
+        }
+
+        // 跨子树直连的空闲检测，每秒一次
+        if (event_timer_.shortcut_check < sec && (!node_shortcut_.empty() || !relay_traffic_.empty())) {
+            event_timer_.shortcut_check = sec;
+            proc_shortcut(sec);
+        }
+
+
+        // RPC超时
+        if (call_timer_.advance(tick, call_expired_) > 0) {
+            for (size_t i = 0; i < call_expired_.size(); ++i) {
+                // 已完成的调用会留在时间轮里，调用ID被复用时超时时间也不一样
+                size_t index = call_find(call_expired_[i].second);
+                if (index >= call_table_.size() || call_table_[index].expire_tick != call_expired_[i].first) {
+                    continue;
+                }
+
+                ++ stat_.call_timeout_times;
+                call_complete(index, 0, EN_ATBUS_ERR_NODE_TIMEOUT, call_table_[index].type, NULL, 0);
+            }
+        }
+
+        // 分片重组超时
+        if (event_timer_.fragment_list.advance(tick, event_timer_.fragment_expired) > 0) {
+            for (size_t i = 0; i < event_timer_.fragment_expired.size(); ++i) {
+                std::map<fragment_key_t, fragment_recv_t>::iterator iter = fragment_recv_.find(event_timer_.fragment_expired[i].second);
+
+                // 已完成重组或者序号已被新的重组复用则忽略
+                if (iter != fragment_recv_.end() && iter->second.expire_tick == event_timer_.fragment_expired[i].first) {
+                    ATBUS_FUNC_NODE_ERROR(*this, NULL, NULL, EN_ATBUS_ERR_NODE_TIMEOUT, 0);
+                    fragment_recv_size_ -= iter->second.data.size();
+                    fragment_recv_.erase(iter);
+                }
+            }
+        }
 
         // 检测队列
         if (!event_timer_.pending_check_list_.empty()) {
-            std::list<endpoint::ptr_t> checked;
+            std::vector<endpoint::ptr_t>& checked = event_timer_.checking_list;
             checked.swap(event_timer_.pending_check_list_);
 
-            for (std::list<endpoint::ptr_t>::iterator iter = checked.begin(); iter != checked.end(); ++ iter) {
-                if (*iter) {
-                    if(false == (*iter)->is_available()) {
-                        (*iter)->reset();
-                        remove_endpoint((*iter)->get_id());
+            for (size_t i = 0; i < checked.size(); ++i) {
+                if (checked[i]) {
+                    if(false == checked[i]->is_available()) {
+                        checked[i]->reset();
+                        remove_endpoint(checked[i]->get_id());
                     }
                 }
             }
 
             // 再清理一次，因为endpoint::reset可能触发进入pending_check_list_
+            checked.clear();
             event_timer_.pending_check_list_.clear();
         }
 
@@ -416,6 +587,8 @@ namespace atbus {
         if (node_father_.node_ && id == node_father_.node_->get_id()) {
             node_father_.node_->reset();
             node_father_.node_.reset();
+            invalidate_route_cache();
+            sync_remove_source(id);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -423,9 +596,15 @@ namespace atbus {
         if (NULL != ep && ep->get_id() == id) {
             ep->reset();
 
-            // 移除连接关系
+            // 移除连接关系，兄弟节点的信息来自父节点，不需要移除全局表
             remove_child(node_brother_, id);
-            // TODO 移除全局表
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        ep = find_child(node_shortcut_, id);
+        if (NULL != ep && ep->get_id() == id) {
+            ep->reset();
+            remove_child(node_shortcut_, id);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -433,9 +612,10 @@ namespace atbus {
         if (NULL != ep && ep->get_id() == id) {
             ep->reset();
 
-            // 移除连接关系
-            remove_child(node_brother_, id);
-            // TODO 移除全局表
+            // 移除连接关系和它上报的子树
+            remove_child(node_children_, id);
+            sync_remove_source(id);
+            group_remove_child(id);
             return EN_ATBUS_ERR_SUCCESS;
         }
 
@@ -443,7 +623,9 @@ namespace atbus {
     }
 
     int node::send_data(bus_id_t tid, int type, const void* buffer, size_t s, bool require_rsp) {
-        if (s >= conf_.msg_size) {
+        size_t fragment_data_size = atbus::protocol::fragment_data_size(conf_.msg_size);
+        bool use_fragment = 0 != fragment_data_size && s > fragment_data_size && s <= conf_.fragment_max_size && s <= 0xFFFFFFFFULL;
+        if (s >= conf_.msg_size && false == use_fragment) {
             return EN_ATBUS_ERR_BUFF_LIMIT;
         }
 
@@ -453,609 +635,2084 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
+        if (use_fragment) {
+            // 所有分片一次性写入发送缓冲区，中途放不下会在接收端留下不完整的重组，所以先按每个分片一个完整数据包估算
+            size_t fragment_count = (s + fragment_data_size - 1) / fragment_data_size;
+            if (0 != conf_.send_buffer_size && fragment_count * conf_.msg_size > conf_.send_buffer_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            return send_data_fragments(tid, type, buffer, s, require_rsp);
+        }
+
         atbus::protocol::msg m;
         m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, alloc_msg_seq());
 
-        if (NULL == m.body.make_body(m.body.forward)) {
+        if (NULL == m.body.make_body<atbus::protocol::forward_data>()) {
             return EN_ATBUS_ERR_MALLOC;
         }
 
-        m.body.forward->from = get_id();
-        m.body.forward->to = tid;
-        m.body.forward->content.ptr = buffer;
-        m.body.forward->content.size = s;
+        m.body.forward()->from = get_id();
+        m.body.forward()->to = tid;
+        m.body.forward()->content.ptr = buffer;
+        m.body.forward()->content.size = s;
         if (require_rsp) {
-            m.body.forward->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+            m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
         }
 
         return send_data_msg(tid, m);
     }
 
-    int node::send_data_msg(bus_id_t tid, atbus::protocol::msg& mb) {
-        return send_data_msg(tid, mb, NULL, NULL);
-    }
+    int node::call(bus_id_t tid, int type, const void* buffer, size_t s, time_t timeout_ms, call_callback_fn_t fn, void* priv_data, uint32_t* sequence) {
+        if (NULL == fn || (NULL == buffer && s > 0)) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
 
-    int node::send_data_msg(bus_id_t tid, atbus::protocol::msg& mb, endpoint** ep_out, connection** conn_out) {
-        return send_msg(tid, mb, &endpoint::get_data_connection, ep_out, conn_out);
-    }
-    
-    int node::send_custom_cmd(bus_id_t tid, const void* arr_buf[], size_t arr_size[], size_t arr_count) {
-        size_t sum_len = sizeof(atbus::protocol::custom_command_data);
-        for (size_t i = 0; i < arr_count; ++ i) {
-            sum_len += arr_size[i];
+        if (flags_.test(flag_t::EN_FT_RESETTING)) {
+            return EN_ATBUS_ERR_CHANNEL_CLOSING;
         }
-        
-        if (sum_len >= conf_.msg_size) {
+
+        if (s >= conf_.msg_size) {
             return EN_ATBUS_ERR_BUFF_LIMIT;
         }
-        
-        atbus::protocol::msg m;
-        m.init(get_id(), ATBUS_CMD_CUSTOM_CMD_REQ, 0, 0, alloc_msg_seq());
 
-        if (NULL == m.body.make_body(m.body.custom)) {
-            return EN_ATBUS_ERR_MALLOC;
+        // 调用ID回绕后可能和还没完成的调用冲突，跳过即可
+        uint32_t seq = alloc_msg_seq();
+        while (call_find(seq) < call_table_.size()) {
+            seq = alloc_msg_seq();
         }
-        
-        m.body.custom->from = get_id();
-        m.body.custom->commands.reserve(arr_count);
-        
-        for (size_t i = 0; i < arr_count; ++ i) {
-            atbus::protocol::bin_data_block cmd;
-            cmd.ptr = arr_buf[i];
-            cmd.size = arr_size[i];
-            
-            m.body.custom->commands.push_back(cmd);
-        }
-        
-        return send_data_msg(tid, m);
-    }
-
-    int node::send_ctrl_msg(bus_id_t tid, atbus::protocol::msg& mb) {
-        return send_ctrl_msg(tid, mb, NULL, NULL);
-    }
 
-    int node::send_ctrl_msg(bus_id_t tid, atbus::protocol::msg& mb, endpoint** ep_out, connection** conn_out) {
-        return send_msg(tid, mb, &endpoint::get_ctrl_connection, ep_out, conn_out);
-    }
+        size_t index = call_insert(seq);
+        call_entry_t& entry = call_table_[index];
+        entry.target = tid;
+        entry.type = type;
+        entry.callback = fn;
+        entry.priv_data = priv_data;
+        entry.start_ns = uv_hrtime();
 
-    int node::send_msg(bus_id_t tid, atbus::protocol::msg& m, endpoint::get_connection_fn_t fn, endpoint** ep_out, connection** conn_out) {
-        if (tid == get_id()) {
-            // 发送给自己的数据直接回调数据接口
-            on_recv(NULL, &m, 0, 0);
-            return EN_ATBUS_ERR_SUCCESS;
+        // 时间轮会把已经过期的时间推迟到下一个tick，这里保持一致，触发时才能匹配上
+        entry.expire_tick = get_timer_tick() + static_cast<uint64_t>(timeout_ms > 0 ? timeout_ms : 0);
+        if (entry.expire_tick <= call_timer_.get_current_tick()) {
+            entry.expire_tick = call_timer_.get_current_tick() + 1;
         }
+        call_timer_.add(entry.expire_tick, seq);
 
-        #define ASSIGN_EPCONN(tar_var) { \
-            if (NULL != ep_out) *ep_out = tar_var; \
-            if (NULL != conn_out) *conn_out = conn;\
+        if (NULL != sequence) {
+            *sequence = seq;
         }
 
-        connection* conn = NULL;
-        do {
-            // 父节点单独判定，防止父节点被判定为兄弟节点
-            if (node_father_.node_ && is_parent_node(tid)) {
-                endpoint* target = node_father_.node_.get();
-                conn = (self_.get()->*fn)(target);
-
-                ASSIGN_EPCONN(target);
-                break;
-            }
-
-            // 兄弟节点(父节点会被判为可能是兄弟节点)
-            if (is_brother_node(tid)) {
-                endpoint* target = find_child(node_brother_, tid);
-                if (NULL != target && target->is_child_node(tid)) {
-                    conn = (self_.get()->*fn)(target);
-
-                    ASSIGN_EPCONN(target);
-                    break;
-                } else if (false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && node_father_.node_) {
-                    // 如果没有全量表则发给父节点
-                    /*                        
-                    //       F1 
-                    //      /  \   
-                    //    C11  C12 
-                    // 当C11发往C12时触发这种情况
-                    */
-                    endpoint* target = node_father_.node_.get();
-                    conn = (self_.get()->*fn)(target);
-
-                    ASSIGN_EPCONN(target);
-                    break;
-                }
-                return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        if (tid == get_id()) {
+            // 调用自己直接回调，reply也会直接完成调用
+            atbus::protocol::msg m;
+            m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, seq);
+            if (NULL == m.body.make_forward(get_id(), tid, buffer, s)) {
+                call_erase(index);
+                return EN_ATBUS_ERR_MALLOC;
             }
+            m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_RPC_REQUEST);
 
-            // 子节点
-            if (is_child_node(tid)) {
-                endpoint* target = find_child(node_children_, tid);
-                if (NULL != target && target->is_child_node(tid)) {
-                    conn = (self_.get()->*fn)(target);
+            on_recv_call(get_self_endpoint(), NULL, m);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
 
-                    ASSIGN_EPCONN(target);
-                    break;
-                }
-                return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        int res = send_call_msg(tid, type, seq, 0, atbus::protocol::forward_data::FLAG_RPC_REQUEST, buffer, s);
+        if (res < 0) {
+            // 发送失败时不回调，直接移除
+            index = call_find(seq);
+            if (index < call_table_.size()) {
+                call_erase(index);
             }
+        }
 
-            // 其他情况,如果没有全量表则发给父节点
-            /*                        
-            //       F1 ------------ F2
-            //      /  \            /  \
-            //    C11  C12        C21  C22
-            // 当C11发往C21或C22时触发这种情况
-            */
-            if (node_father_.node_ && false == get_self_endpoint()->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
-                endpoint* target = node_father_.node_.get();
-                conn = (self_.get()->*fn)(target);
-
-                ASSIGN_EPCONN(target);
-                break;
-            }
-        } while (false);
+        return res;
+    }
 
-        if (NULL == conn) {
-            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+    int node::reply(bus_id_t tid, int type, uint32_t sequence, const void* buffer, size_t s, int ret_code) {
+        if (NULL == buffer && s > 0) {
+            return EN_ATBUS_ERR_PARAMS;
         }
 
-        if (NULL != m.body.forward) {
-            m.body.forward->router.push_back(get_id());
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
         }
 
-        // head 里永远是发起方bus_id
-        m.head.src_bus_id = get_id();
+        if (tid == get_id()) {
+            return on_call_response(get_id(), sequence, ret_code, type, buffer, s);
+        }
 
-        #undef ASSIGN_EPCONN
-        return msg_handler::send_msg(*this, *conn, m);
+        return send_call_msg(tid, type, sequence, ret_code, atbus::protocol::forward_data::FLAG_RPC_RESPONSE, buffer, s);
     }
 
-    endpoint* node::get_endpoint(bus_id_t tid) {
-        if (is_parent_node(tid)) {
-            return node_father_.node_.get();
-        }
+    int node::send_call_msg(bus_id_t tid, int type, uint32_t sequence, int ret_code, int flag, const void* buffer, size_t s) {
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, ret_code, sequence);
 
-        // 直连兄弟节点
-        if (is_brother_node(tid)) {
-            endpoint* res = find_child(node_brother_, tid);
-            if (NULL != res && res->get_id() == tid) {
-                return res;
-            }
-            return NULL;
+        if (NULL == m.body.make_forward(get_id(), tid, buffer, s)) {
+            return EN_ATBUS_ERR_MALLOC;
         }
+        m.body.forward()->set_flag(static_cast<atbus::protocol::forward_data::flag_t>(flag));
 
-        // 直连子节点
-        if (is_child_node(tid)) {
-            endpoint* res = find_child(node_children_, tid);
-            if (NULL != res && res->get_id() == tid) {
-                return res;
-            }
-            return NULL;
-        }
+        return send_data_msg(tid, m);
+    }
 
-        return NULL;
+    uint64_t node::get_timer_tick() const {
+        return static_cast<uint64_t>(event_timer_.sec) * 1000 + static_cast<uint64_t>(event_timer_.usec) / 1000;
     }
 
-    int node::add_endpoint(endpoint::ptr_t ep) {
-        if(!ep) {
-            return EN_ATBUS_ERR_PARAMS;
+    namespace detail {
+        static inline size_t call_hash(uint32_t sequence) {
+            // 连续的调用ID乘奇数后低位仍然各不相同，正好均匀分布在表里
+            return static_cast<size_t>(sequence * 2654435761U);
         }
+    }
 
-        if (this != ep->get_owner()) {
-            return EN_ATBUS_ERR_PARAMS;
+    size_t node::call_find(uint32_t sequence) const {
+        if (call_table_.empty()) {
+            return 0;
         }
 
-        // 父节点单独判定，由于防止测试兄弟节点
-        if (ep->get_children_mask() > self_->get_children_mask() && ep->is_child_node(get_id())) {
-            if (!node_father_.node_) {
-                node_father_.node_ = ep;
-                add_ping_timer(ep);
-                
-                if ((state_t::LOST_PARENT == get_state() || state_t::CONNECTING_PARENT == get_state()) && 
-                    check(flag_t::EN_FT_PARENT_REG_DONE)) {
-                    on_actived();
-                }
-
-                // event
-                if (event_msg_.on_endpoint_added) {
-                    event_msg_.on_endpoint_added(*this, ep.get(), EN_ATBUS_ERR_SUCCESS);
-                }
-                
-                return EN_ATBUS_ERR_SUCCESS;
-            } else {
-                // 父节点只能有一个
-                return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        size_t mask = call_table_.size() - 1;
+        for (size_t i = detail::call_hash(sequence) & mask; call_table_[i].used; i = (i + 1) & mask) {
+            if (call_table_[i].sequence == sequence) {
+                return i;
             }
         }
 
-        // 兄弟节点(父节点会被判为可能是兄弟节点)
-        if (is_brother_node(ep->get_id())) {
-            // event will be triggered in insert_child()
-            if (insert_child(node_brother_, ep)) {
-                add_ping_timer(ep);
+        return call_table_.size();
+    }
 
-                return EN_ATBUS_ERR_SUCCESS;
-            } else {
-                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
-            }
+    size_t node::call_insert(uint32_t sequence) {
+        // 负载不超过1/2，探测长度很短，也保证一定有空位
+        if ((call_count_ + 1) * 2 > call_table_.size()) {
+            call_rehash(call_table_.empty() ? 64 : call_table_.size() * 2);
         }
 
-        // 子节点
-        if (is_child_node(ep->get_id())) {
-            // event will be triggered in insert_child()
-            if(insert_child(node_children_, ep)) {
-                add_ping_timer(ep);
-
-                // TODO 子节点上线上报
-                return EN_ATBUS_ERR_SUCCESS;
-            } else {
-                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
-            }
+        size_t mask = call_table_.size() - 1;
+        size_t i = detail::call_hash(sequence) & mask;
+        while (call_table_[i].used) {
+            i = (i + 1) & mask;
         }
 
-        return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        memset(&call_table_[i], 0, sizeof(call_entry_t));
+        call_table_[i].used = true;
+        call_table_[i].sequence = sequence;
+        ++ call_count_;
+        return i;
     }
 
-    int node::remove_endpoint(bus_id_t tid) {
-        // 父节点单独判定，由于防止测试兄弟节点
-        if (is_parent_node(tid)) {
-            endpoint::ptr_t ep = node_father_.node_;
-            
-            node_father_.node_.reset();
-            state_ = state_t::LOST_PARENT;
+    void node::call_erase(size_t index) {
+        size_t mask = call_table_.size() - 1;
+        call_table_[index].used = false;
+        -- call_count_;
 
-            // set reconnect to father into retry interval
-            event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
-            
-            // event
-            if (event_msg_.on_endpoint_removed) {
-                event_msg_.on_endpoint_removed(*this, ep.get(), EN_ATBUS_ERR_SUCCESS);
+        // 后移删除，不需要墓碑标记，后面同一串里能放到空位的都往前移
+        size_t hole = index;
+        for (size_t i = (index + 1) & mask; call_table_[i].used; i = (i + 1) & mask) {
+            size_t home = detail::call_hash(call_table_[i].sequence) & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                call_table_[hole] = call_table_[i];
+                call_table_[i].used = false;
+                hole = i;
             }
-            return EN_ATBUS_ERR_SUCCESS;
         }
+    }
 
-        // 兄弟节点(父节点会被判为可能是兄弟节点)
-        if (is_brother_node(tid)) {
-            // event will be triggered in remove_child()
-            if (remove_child(node_brother_, tid)) {
-                return EN_ATBUS_ERR_SUCCESS;
-            } else {
-                return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+    void node::call_rehash(size_t capacity) {
+        std::vector<call_entry_t> old_table;
+        old_table.swap(call_table_);
+
+        call_entry_t empty_entry;
+        memset(&empty_entry, 0, sizeof(empty_entry));
+        call_table_.resize(capacity, empty_entry);
+
+        size_t mask = capacity - 1;
+        for (size_t i = 0; i < old_table.size(); ++i) {
+            if (!old_table[i].used) {
+                continue;
             }
-        }
 
-        // 子节点
-        if (is_child_node(tid)) {
-            // event will be triggered in remove_child()
-            if (remove_child(node_children_, tid)) {
-                // TODO 子节点下线上报
-                return EN_ATBUS_ERR_SUCCESS;
-            } else {
-                return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+            size_t j = detail::call_hash(old_table[i].sequence) & mask;
+            while (call_table_[j].used) {
+                j = (j + 1) & mask;
             }
+            call_table_[j] = old_table[i];
         }
+    }
 
-        return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+    void node::call_complete(size_t index, bus_id_t from, int status, int type, const void* buffer, size_t s) {
+        call_callback_fn_t fn = call_table_[index].callback;
+        void* priv_data = call_table_[index].priv_data;
+        call_erase(index);
+
+        if (NULL != fn) {
+            fn(*this, from, status, type, buffer, s, priv_data);
+        }
     }
 
-    adapter::loop_t* node::get_evloop() {
-        if (NULL != ev_loop_) {
-            return ev_loop_;
+    int node::send_data_fragments(bus_id_t tid, int type, const void* buffer, size_t s, bool require_rsp) {
+        size_t fragment_data_size = atbus::protocol::fragment_data_size(conf_.msg_size);
+        if (0 == fragment_data_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
         }
 
-        if (NULL != conf_.ev_loop) {
-            return ev_loop_ = conf_.ev_loop;
+        // 发送缓冲区复用，只会在第一次或者变大时分配
+        if (send_data_buffer_.size() < atbus::protocol::fragment_encoding_t::HEAD_SIZE + fragment_data_size) {
+            send_data_buffer_.resize(atbus::protocol::fragment_encoding_t::HEAD_SIZE + fragment_data_size);
         }
 
-        ev_loop_ = uv_default_loop();
-        return ev_loop_;
-    }
+        uint32_t sequence = alloc_msg_seq();
+        for (size_t offset = 0; offset < s; offset += fragment_data_size) {
+            size_t len = s - offset;
+            if (len > fragment_data_size) {
+                len = fragment_data_size;
+            }
 
-    bool node::is_child_node(bus_id_t id) const {
-        return self_->is_child_node(id);
-    }
+            atbus::protocol::fragment_pack_head(&send_data_buffer_[0], static_cast<uint32_t>(s), static_cast<uint32_t>(offset));
+            memcpy(&send_data_buffer_[atbus::protocol::fragment_encoding_t::HEAD_SIZE], reinterpret_cast<const char*>(buffer) + offset, len);
 
-    bool node::is_brother_node(bus_id_t id) const {
+            atbus::protocol::msg m;
+            m.init(get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, type, 0, sequence);
+
+            if (NULL == m.body.make_body<atbus::protocol::forward_data>()) {
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            m.body.forward()->from = get_id();
+            m.body.forward()->to = tid;
+            m.body.forward()->content.ptr = &send_data_buffer_[0];
+            m.body.forward()->content.size = atbus::protocol::fragment_encoding_t::HEAD_SIZE + len;
+            m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_FRAGMENT);
+            if (require_rsp && offset + len >= s) {
+                m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+            }
+
+            // 通道发送时会复制数据，所以每个分片都可以复用发送缓冲区
+            int res = send_data_msg(tid, m);
+            if (res < 0) {
+                return res;
+            }
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::send_data_batch(bus_id_t tid, int type, const void* arr_buf[], const size_t arr_size[], size_t arr_count, bool require_rsp) {
+        if (0 == arr_count || NULL == arr_buf || NULL == arr_size) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (1 == arr_count) {
+            return send_data(tid, type, arr_buf[0], arr_size[0], require_rsp);
+        }
+
+        if (tid == get_id()) {
+            // 发送给自己的数据直接逐个回调数据接口
+            for (size_t i = 0; i < arr_count; ++i) {
+                on_recv_data(get_self_endpoint(), NULL, type, arr_buf[i], arr_size[i]);
+            }
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        size_t sum_len = atbus::protocol::batch_packed_size(arr_size, arr_count);
+        if (sum_len >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        // 发送缓冲区复用，只会在第一次或者变大时分配
+        if (send_data_buffer_.size() < sum_len) {
+            send_data_buffer_.resize(sum_len);
+        }
+
+        if (sum_len != atbus::protocol::batch_pack(&send_data_buffer_[0], send_data_buffer_.size(), arr_buf, arr_size, arr_count)) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_BATCH, type, 0, alloc_msg_seq());
+
+        if (NULL == m.body.make_body<atbus::protocol::forward_data>()) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        m.body.forward()->from = get_id();
+        m.body.forward()->to = tid;
+        m.body.forward()->content.ptr = &send_data_buffer_[0];
+        m.body.forward()->content.size = sum_len;
+        m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_BATCH);
+        if (require_rsp) {
+            m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+        }
+
+        return send_data_msg(tid, m);
+    }
+
+    int node::join_group(uint64_t gid) {
+        if (!self_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        group_add_interest(gid, get_id());
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::leave_group(uint64_t gid) {
+        if (false == is_group_member(gid)) {
+            return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+        }
+
+        group_remove_interest(gid, get_id());
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    bool node::is_group_member(uint64_t gid) const {
+        group_collection_t::const_iterator iter = groups_.find(gid);
+        return iter != groups_.end() && iter->second.local;
+    }
+
+    int node::send_to_group(uint64_t gid, int type, const void* buffer, size_t s) {
+        if (!self_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_GROUP_DATA, type, 0, alloc_msg_seq());
+        if (NULL == m.body.make_forward(get_id(), gid, buffer, s)) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        return dispatch_group_msg(m, get_id());
+    }
+
+    int node::register_service(uint64_t service) {
+        if (!self_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (0 == service) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        std::vector<uint64_t> services = self_->get_services();
+        services.push_back(service);
+        self_->set_services(services);
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    void node::set_load_hint(uint32_t load) {
+        load_hint_ = load;
+
+        // 选择实例时自身的负载直接用最新的值
+        if (self_) {
+            self_->set_stat_load(load);
+        }
+    }
+
+    namespace detail {
+        static inline uint64_t service_mix(uint64_t v) {
+            v ^= v >> 33;
+            v *= static_cast<uint64_t>(0xff51afd7ed558ccdULL);
+            v ^= v >> 33;
+            v *= static_cast<uint64_t>(0xc4ceb9fe1a85ec53ULL);
+            v ^= v >> 33;
+            return v;
+        }
+
+        static inline uint32_t service_key_hash(uint64_t key) {
+            if (0 == key) {
+                return 0;
+            }
+
+            // 放在head.sequence里传递，0表示按负载选择
+            uint64_t h = service_mix(key);
+            uint32_t ret = static_cast<uint32_t>(h ^ (h >> 32));
+            return 0 == ret ? 1 : ret;
+        }
+    }
+
+    int node::send_to_service(uint64_t service, uint64_t key, int type, const void* buffer, size_t s, bus_id_t* target) {
+        if (NULL != target) {
+            *target = 0;
+        }
+
+        if (!self_) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        if (s >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_SERVICE_DATA, type, 0, detail::service_key_hash(key));
+        if (NULL == m.body.make_forward(get_id(), service, buffer, s)) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        return dispatch_service_msg(NULL, m, target);
+    }
+
+    int node::send_data_msg(bus_id_t tid, atbus::protocol::msg& mb) {
+        return send_data_msg(tid, mb, NULL, NULL);
+    }
+
+    int node::send_data_msg(bus_id_t tid, atbus::protocol::msg& mb, endpoint** ep_out, connection** conn_out) {
+        return send_msg(tid, mb, &endpoint::get_data_connection, ep_out, conn_out);
+    }
+    
+    int node::send_custom_cmd(bus_id_t tid, const void* arr_buf[], size_t arr_size[], size_t arr_count) {
+        size_t sum_len = sizeof(atbus::protocol::custom_command_data);
+        for (size_t i = 0; i < arr_count; ++ i) {
+            sum_len += arr_size[i];
+        }
+        
+        if (sum_len >= conf_.msg_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+        
+        atbus::protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_CUSTOM_CMD_REQ, 0, 0, alloc_msg_seq());
+
+        if (NULL == m.body.make_body<atbus::protocol::custom_command_data>()) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+        
+        m.body.custom()->from = get_id();
+        m.body.custom()->commands.reserve(arr_count);
+        
+        for (size_t i = 0; i < arr_count; ++ i) {
+            atbus::protocol::bin_data_block cmd;
+            cmd.ptr = arr_buf[i];
+            cmd.size = arr_size[i];
+            
+            m.body.custom()->commands.push_back(cmd);
+        }
+        
+        return send_data_msg(tid, m);
+    }
+
+    int node::send_ctrl_msg(bus_id_t tid, atbus::protocol::msg& mb) {
+        return send_ctrl_msg(tid, mb, NULL, NULL);
+    }
+
+    int node::send_ctrl_msg(bus_id_t tid, atbus::protocol::msg& mb, endpoint** ep_out, connection** conn_out) {
+        return send_msg(tid, mb, &endpoint::get_ctrl_connection, ep_out, conn_out);
+    }
+
+    int node::send_msg(bus_id_t tid, atbus::protocol::msg& m, endpoint::get_connection_fn_t fn, endpoint** ep_out, connection** conn_out) {
+        if (tid == get_id()) {
+            // 发送给自己的数据直接回调数据接口
+            on_recv(NULL, &m, 0, 0);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        connection* conn = NULL;
+        endpoint* route_ep = NULL;
+        // 只缓存数据连接，控制连接的消息很少
+        bool use_route_cache = &endpoint::get_data_connection == fn;
+        bool route_cache_hit = false;
+        int res = find_route(tid, fn, use_route_cache, route_ep, conn, route_cache_hit);
+        if (res < 0) {
+            return res;
+        }
+
+        if (NULL != ep_out) *ep_out = route_ep;
+        if (NULL != conn_out) *conn_out = conn;
+
+        if (NULL == conn) {
+            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+        }
+
+        // 跨子树直连的空闲检测
+        if (route_ep->get_flag(endpoint::flag_t::SHORTCUT)) {
+            route_ep->set_stat_last_active(event_timer_.sec);
+        }
+
+        if (use_route_cache) {
+            if (route_cache_hit) {
+                ++stat_.route_cache_hit_times;
+            } else {
+                ++stat_.route_cache_miss_times;
+                set_route_cache(tid, route_ep, conn);
+            }
+        }
+
+        // 有多条并行的数据连接时分流，路由缓存只记录目标端点和最优的连接
+        if (use_route_cache && route_ep->get_data_connections().size() > 1) {
+            connection* stripe_conn = get_striped_data_connection(*route_ep, m);
+            if (NULL != stripe_conn) {
+                conn = stripe_conn;
+                if (NULL != conn_out) *conn_out = conn;
+            }
+        }
+
+        if (NULL != m.body.forward() && false == m.body.forward()->router.push_back(get_id())) {
+            return EN_ATBUS_ERR_ATNODE_TTL;
+        }
+
+        // head 里永远是发起方bus_id
+        m.head.src_bus_id = get_id();
+
+        return msg_handler::send_msg(*this, *conn, m);
+    }
+
+    int node::find_route(bus_id_t tid, endpoint::get_connection_fn_t fn, bool use_route_cache, endpoint*& route_ep, connection*& conn, bool& cache_hit) {
+        route_ep = NULL;
+        conn = NULL;
+        cache_hit = false;
+
+        // 热点目标直接使用路由缓存，拓扑或者连接变化以后版本号不一致，需要重新查找
+        if (use_route_cache) {
+            route_cache_collection_t::iterator iter = route_cache_.find(tid);
+            if (iter != route_cache_.end() && iter->second.epoch == route_epoch_ &&
+                connection::state_t::CONNECTED == iter->second.conn->get_status()) {
+                conn = iter->second.conn;
+                cache_hit = true;
+
+                route_ep = iter->second.ep;
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+        }
+
+        // 父节点单独判定，防止父节点被判定为兄弟节点
+        if (node_father_.node_ && is_parent_node(tid)) {
+            endpoint* target = node_father_.node_.get();
+            conn = (self_.get()->*fn)(target);
+
+            route_ep = target;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 跨子树直连只索引对端自己的ID，可能在兄弟节点的子域内，所以先查找
+        if (!node_shortcut_.empty()) {
+            endpoint* target = find_child(node_shortcut_, tid);
+            if (NULL != target) {
+                conn = (self_.get()->*fn)(target);
+                if (NULL != conn) {
+                    route_ep = target;
+                    return EN_ATBUS_ERR_SUCCESS;
+                }
+            }
+        }
+
+        // 兄弟节点(父节点会被判为可能是兄弟节点)
+        if (is_brother_node(tid)) {
+            endpoint* target = find_child(node_brother_, tid);
+            // 有直连时不改走父节点，否则父节点每次转发都会通知建立直连。延迟只用于选择目标自己的连接
+            if (NULL != target && target->is_child_node(tid)) {
+                conn = (self_.get()->*fn)(target);
+
+                route_ep = target;
+                return EN_ATBUS_ERR_SUCCESS;
+            } else if (node_father_.node_) {
+                // 没有直连则发给父节点，有全局路由表时会在同步时直连兄弟节点，父节点转发时也会通知建立直连
+                /*                        
+                //       F1 
+                //      /  \   
+                //    C11  C12 
+                // 当C11发往C12时触发这种情况
+                */
+                endpoint* target = node_father_.node_.get();
+                conn = (self_.get()->*fn)(target);
+
+                route_ep = target;
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+            return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        }
+
+        // 子节点
+        if (is_child_node(tid)) {
+            endpoint* target = find_child(node_children_, tid);
+            if (NULL != target && target->is_child_node(tid)) {
+                conn = (self_.get()->*fn)(target);
+
+                route_ep = target;
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+            return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        }
+
+        // 其他情况只能发给父节点，不能直连非兄弟节点，按流量建立的跨子树直连除外
+        /*                        
+        //       F1 ------------ F2
+        //      /  \            /  \
+        //    C11  C12        C21  C22
+        // 当C11发往C21或C22时触发这种情况
+        */
         if (node_father_.node_) {
-            return self_->is_brother_node(id, node_father_.node_->get_children_mask());
-        } else {
-            return self_->is_brother_node(id, 0);
+            endpoint* target = node_father_.node_.get();
+            conn = (self_.get()->*fn)(target);
+
+            route_ep = target;
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    endpoint* node::get_endpoint(bus_id_t tid) {
+        if (is_parent_node(tid)) {
+            return node_father_.node_.get();
+        }
+
+        // 跨子树直连，父节点变化以后可能会被判定为兄弟节点，所以先查找
+        if (!node_shortcut_.empty()) {
+            endpoint* res = find_child(node_shortcut_, tid);
+            if (NULL != res && res->get_id() == tid) {
+                return res;
+            }
+        }
+
+        // 直连兄弟节点
+        if (is_brother_node(tid)) {
+            endpoint* res = find_child(node_brother_, tid);
+            if (NULL != res && res->get_id() == tid) {
+                return res;
+            }
+            return NULL;
+        }
+
+        // 直连子节点
+        if (is_child_node(tid)) {
+            endpoint* res = find_child(node_children_, tid);
+            if (NULL != res && res->get_id() == tid) {
+                return res;
+            }
+            return NULL;
+        }
+
+        return NULL;
+    }
+
+    int node::add_endpoint(endpoint::ptr_t ep) {
+        if(!ep) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (this != ep->get_owner()) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        // 父节点单独判定，由于防止测试兄弟节点
+        if (ep->get_children_mask() > self_->get_children_mask() && ep->is_child_node(get_id())) {
+            if (!node_father_.node_) {
+                node_father_.node_ = ep;
+                invalidate_route_cache();
+                add_ping_timer(ep);
+
+                // 新的父节点需要全量上报
+                sync_report_version_ = 0;
+                sync_schedule_push();
+                if (!groups_.empty()) {
+                    group_schedule_push();
+                }
+                
+                if ((state_t::LOST_PARENT == get_state() || state_t::CONNECTING_PARENT == get_state()) && 
+                    check(flag_t::EN_FT_PARENT_REG_DONE)) {
+                    on_actived();
+                }
+
+                // event
+                if (event_msg_.on_endpoint_added) {
+                    event_msg_.on_endpoint_added(*this, ep.get(), EN_ATBUS_ERR_SUCCESS);
+                }
+                
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                // 父节点只能有一个
+                return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+            }
+        }
+
+        // 兄弟节点(父节点会被判为可能是兄弟节点)
+        // 已经直连的兄弟节点的子域包含新节点时，新节点是兄弟节点的下级，允许跨子树直连时按跨子树直连处理
+        endpoint* brother_owner = NULL;
+        if (is_brother_node(ep->get_id())) {
+            brother_owner = find_child(node_brother_, ep->get_id());
+        }
+
+        if (is_brother_node(ep->get_id()) &&
+            (NULL == brother_owner || brother_owner->get_id() == ep->get_id() || 0 == conf_.shortcut_threshold)) {
+            if (conf_.shortcut_threshold > 0 && NULL == brother_owner) {
+                move_nested_brother_to_shortcut(*ep);
+            }
+
+            // event will be triggered in insert_child()
+            if (insert_child(node_brother_, ep)) {
+                add_ping_timer(ep);
+
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
+            }
+        }
+
+        // 子节点
+        if (is_child_node(ep->get_id())) {
+            // event will be triggered in insert_child()
+            if(insert_child(node_children_, ep)) {
+                add_ping_timer(ep);
+
+                // 子节点上线，随下一次同步推送
+                sync_set_node(ep->get_id(), ep->get_children_mask(), ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER), ep->get_id(), 0);
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
+            }
+        }
+
+        // 按流量建立的跨子树直连，对端的子域不能包含自己
+        if (conf_.shortcut_threshold > 0 && false == ep->is_child_node(get_id())) {
+            // event will be triggered in insert_child()
+            if (insert_child(node_shortcut_, ep, true)) {
+                ep->set_flag(endpoint::flag_t::SHORTCUT, true);
+                ep->set_stat_last_active(get_timer_sec());
+                add_ping_timer(ep);
+
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_MASK_CONFLICT;
+            }
+        }
+
+        return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+    }
+
+    int node::remove_endpoint(bus_id_t tid) {
+        // 父节点单独判定，由于防止测试兄弟节点
+        if (is_parent_node(tid)) {
+            endpoint::ptr_t ep = node_father_.node_;
+            
+            node_father_.node_.reset();
+            invalidate_route_cache();
+            state_ = state_t::LOST_PARENT;
+            sync_remove_source(tid);
+
+            // set reconnect to father into retry interval
+            event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
+            
+            // event
+            if (event_msg_.on_endpoint_removed) {
+                event_msg_.on_endpoint_removed(*this, ep.get(), EN_ATBUS_ERR_SUCCESS);
+            }
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 跨子树直连，父节点变化以后可能会被判定为兄弟节点，所以先查找
+        if (remove_child(node_shortcut_, tid)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 兄弟节点(父节点会被判为可能是兄弟节点)
+        if (is_brother_node(tid)) {
+            // event will be triggered in remove_child()
+            if (remove_child(node_brother_, tid)) {
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+            }
+        }
+
+        // 子节点
+        if (is_child_node(tid)) {
+            // event will be triggered in remove_child()
+            if (remove_child(node_children_, tid)) {
+                // 子节点下线，它上报的子树也一起移除，随下一次同步推送
+                sync_remove_source(tid);
+                group_remove_child(tid);
+                return EN_ATBUS_ERR_SUCCESS;
+            } else {
+                return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+            }
+        }
+
+        return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+    }
+
+    adapter::loop_t* node::get_evloop() {
+        if (NULL != ev_loop_) {
+            return ev_loop_;
+        }
+
+        if (NULL != conf_.ev_loop) {
+            return ev_loop_ = conf_.ev_loop;
+        }
+
+        ev_loop_ = uv_default_loop();
+        return ev_loop_;
+    }
+
+    bool node::is_child_node(bus_id_t id) const {
+        return self_->is_child_node(id);
+    }
+
+    bool node::is_brother_node(bus_id_t id) const {
+        if (node_father_.node_) {
+            return self_->is_brother_node(id, node_father_.node_->get_children_mask());
+        } else {
+            return self_->is_brother_node(id, 0);
+        }
+    }
+
+    bool node::is_parent_node(bus_id_t id) const {
+        if (node_father_.node_) {
+            return self_->is_parent_node(id, node_father_.node_->get_id(), node_father_.node_->get_children_mask());
+        }
+
+        return false;
+    }
+
+    int node::get_pid() {
+#ifdef _MSC_VER
+        return _getpid();
+#else
+        return getpid();
+#endif
+    }
+
+    static std::string& host_name_buffer() {
+        static std::string server_addr;
+        return server_addr;
+    }
+
+    const std::string& node::get_hostname() {
+        std::string& hn = host_name_buffer();
+        if (!hn.empty()) {
+            return hn;
+        }
+
+        // @see man gethostname
+        char buffer[256] = {0};
+        if(0 == gethostname(buffer, sizeof(buffer))) {
+            hn = buffer;
+        }
+#ifdef _MSC_VER
+        else {
+            if (WSANOTINITIALISED == WSAGetLastError()) {
+                WSADATA wsaData;
+                WORD version = MAKEWORD(2, 0);
+                if(0 == WSAStartup(version, &wsaData) && 0 == gethostname(buffer, sizeof(buffer))) {
+                    hn = buffer;
+                }
+            }
+        }
+#endif
+
+        return hn;
+    }
+
+    bool node::set_hostname(const std::string& hn) {
+        std::string& h = host_name_buffer();
+        if (h.empty()) {
+            h = hn;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool node::add_proc_connection(connection::ptr_t conn) {
+        if(!conn || conn->get_address().address.empty() || proc_connections_.end() != proc_connections_.find(conn->get_address().address)) {
+            return false;
+        }
+
+        proc_connections_[conn->get_address().address] = conn;
+        return true;
+    }
+
+    bool node::remove_proc_connection(const std::string& conn_key) {
+        detail::auto_select_map<std::string, connection::ptr_t>::type::iterator iter = proc_connections_.find(conn_key);
+        if (iter == proc_connections_.end()) {
+            return false;
+        }
+
+        proc_connections_.erase(iter);
+        return true;
+    }
+
+    bool node::add_connection_timer(connection::ptr_t conn) {
+        if (!conn) {
+            return false;
+        }
+
+        // 如果处于握手阶段，发送节点关系逻辑并加入握手连接池并加入超时判定池
+        if (false == conn->is_connected()) {
+            event_timer_.connecting_list.push_back(std::make_pair(get_timer_tick() + static_cast<uint64_t>(conf_.first_idle_timeout) * 1000, conn));
+        }
+        return true;
+    }
+
+    time_t node::get_timer_sec() const {
+        return event_timer_.sec;
+    }
+
+    time_t node::get_timer_usec() const {
+        return event_timer_.usec;
+    }
+
+    void node::on_recv(connection* conn, protocol::msg* m, int status, int errcode) {
+        if (status < 0 || errcode < 0) {
+            ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, status, errcode);
+
+            if (NULL != conn) {
+                endpoint* ep = conn->get_binding();
+                if(NULL != ep) {
+                    add_endpoint_fault(*ep);
+                }
+            }
+            return;
+        }
+
+        // 内部协议处理
+        int res = msg_handler::dispatch_msg(*this, conn, m, status, errcode);
+        if (res < 0) {
+            if (NULL != conn) {
+                endpoint* ep = conn->get_binding();
+                if (NULL != ep) {
+                    add_endpoint_fault(*ep);
+                }
+            }
+
+            return;
+        }
+
+        if (NULL == m) {
+            return;
+        }
+
+        if (NULL != conn) {
+            endpoint* ep = conn->get_binding();
+            if (NULL != ep) {
+                if (m->head.ret < 0) {
+                    add_endpoint_fault(*ep);
+                } else {
+                    ep->clear_stat_fault();
+                    // 收到消息就说明链路可用，推迟下一次ping
+                    ep->set_stat_last_recv(get_timer_tick());
+                }
+            }
+        }
+    }
+
+    void node::on_recv_data(const endpoint* ep, connection* conn, int type, const void* buffer, size_t s) const {
+        if (NULL == ep && NULL != conn) {
+            ep = conn->get_binding();
+        }
+
+        if (event_msg_.on_recv_msg) {
+            event_msg_.on_recv_msg(*this, ep, conn, type, buffer, s);
+        }
+    }
+    
+    int node::on_recv_fragment(const endpoint* ep, connection* conn, const protocol::msg& m) {
+        const protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        uint32_t total_size = 0;
+        uint32_t offset = 0;
+        const void* data = NULL;
+        size_t data_len = 0;
+        if (!protocol::fragment_unpack(fwd->content.ptr, fwd->content.size, total_size, offset, data, data_len)) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        if (total_size > conf_.fragment_max_size) {
+            return EN_ATBUS_ERR_BUFF_LIMIT;
+        }
+
+        fragment_key_t key = std::make_pair(fwd->from, m.head.sequence);
+        std::map<fragment_key_t, fragment_recv_t>::iterator iter = fragment_recv_.find(key);
+        if (iter == fragment_recv_.end()) {
+            // 分片按顺序发送，没有重组记录时只能是第一个分片
+            if (0 != offset) {
+                return EN_ATBUS_ERR_BAD_DATA;
+            }
+
+            // 重组缓冲区有总大小限制，超出后直接丢弃
+            if (fragment_recv_size_ + total_size > conf_.fragment_buffer_size) {
+                return EN_ATBUS_ERR_BUFF_LIMIT;
+            }
+
+            iter = fragment_recv_.insert(std::make_pair(key, fragment_recv_t())).first;
+            iter->second.type = m.head.type;
+            iter->second.recv_size = 0;
+            iter->second.expire_tick = get_timer_tick() + static_cast<uint64_t>(conf_.fragment_timeout) * 1000;
+            if (iter->second.expire_tick <= event_timer_.fragment_list.get_current_tick()) {
+                iter->second.expire_tick = event_timer_.fragment_list.get_current_tick() + 1;
+            }
+            iter->second.data.resize(total_size);
+            fragment_recv_size_ += total_size;
+
+            event_timer_.fragment_list.add(iter->second.expire_tick, key);
+        } else if (iter->second.data.size() != total_size) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        if (offset != iter->second.recv_size) {
+            // 完全落在已收到部分里的重复分片直接忽略
+            if (static_cast<size_t>(offset) + data_len <= iter->second.recv_size) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 重叠或者中间有缺失，重组的数据已经不可信，整个丢弃
+            fragment_recv_size_ -= iter->second.data.size();
+            fragment_recv_.erase(iter);
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        if (data_len > 0) {
+            memcpy(&iter->second.data[offset], data, data_len);
+        }
+        iter->second.recv_size += data_len;
+
+        if (iter->second.recv_size < total_size) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 先移出重组表再回调，回调里可能会再次发送或重置节点
+        fragment_recv_t done;
+        done.type = iter->second.type;
+        done.data.swap(iter->second.data);
+        fragment_recv_size_ -= done.data.size();
+        fragment_recv_.erase(iter);
+
+        on_recv_data(ep, conn, done.type, done.data.empty() ? NULL : &done.data[0], done.data.size());
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_recv_call(const endpoint* ep, connection* conn, const protocol::msg& m) {
+        const protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        if (NULL == ep && NULL != conn) {
+            ep = conn->get_binding();
+        }
+
+        // 没有处理函数时直接回复错误，调用方不需要等到超时
+        if (!event_msg_.on_recv_call) {
+            return reply(fwd->from, m.head.type, m.head.sequence, NULL, 0, EN_ATBUS_ERR_NOT_INITED);
+        }
+
+        return event_msg_.on_recv_call(*this, ep, conn, fwd->from, m.head.type, m.head.sequence, fwd->content.ptr, fwd->content.size);
+    }
+
+    int node::on_call_response(bus_id_t from, uint32_t sequence, int status, int type, const void* buffer, size_t s) {
+        size_t index = call_find(sequence);
+        if (index >= call_table_.size()) {
+            return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+        }
+
+        // 不是调用目标的回包直接丢弃，不能完成别人的调用
+        if (0 != from && from != call_table_[index].target) {
+            ATBUS_FUNC_NODE_DEBUG(*this, NULL, NULL, NULL, "drop call response(sequence=%u) from 0x%llx, expect 0x%llx",
+                sequence, static_cast<unsigned long long>(from), static_cast<unsigned long long>(call_table_[index].target));
+            return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+        }
+
+        uint64_t cost_ns = uv_hrtime() - call_table_[index].start_ns;
+        ++ stat_.call_times;
+        if (status < 0) {
+            ++ stat_.call_failed_times;
+        }
+        stat_.call_latency_ns += cost_ns;
+        if (cost_ns > stat_.call_latency_max_ns) {
+            stat_.call_latency_max_ns = cost_ns;
+        }
+
+        size_t bucket = 0;
+        for (uint64_t cost_us = cost_ns / 1000; cost_us > 1 && bucket + 1 < ATBUS_MACRO_CALL_LATENCY_BUCKETS; cost_us >>= 1) {
+            ++ bucket;
+        }
+        ++ stat_.call_latency_histogram[bucket];
+
+        call_complete(index, from, status, type, buffer, s);
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_call_failed(bus_id_t tid, uint32_t sequence, int status) {
+        size_t index = call_find(sequence);
+        if (index >= call_table_.size() || tid != call_table_[index].target) {
+            return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+        }
+
+        return on_call_response(0, sequence, status, call_table_[index].type, NULL, 0);
+    }
+
+    void node::on_send_data_failed(const endpoint* ep, const connection* conn, const protocol::msg* m) {
+        if (event_msg_.on_send_data_failed) {
+            event_msg_.on_send_data_failed(*this, ep, conn, m);
+        }
+    }
+
+    int node::on_error(const char* file_path, size_t line, const endpoint* ep, const connection* conn, int status, int errcode) {
+        if (NULL == ep && NULL != conn) {
+            ep = conn->get_binding();
+        }
+
+        if (event_msg_.on_error) {
+            event_msg_.on_error(*this, ep, conn, status, errcode);
+        }
+
+        return status;
+    }
+
+    int node::on_disconnect(const connection* conn) {
+        if (NULL == conn) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+        
+        // 父节点断线逻辑则重置状态
+        if (state_t::CONNECTING_PARENT == state_ && !conf_.father_address.empty() && conf_.father_address == conn->get_address().address) {
+            state_ = state_t::LOST_PARENT;
+
+            // set reconnect to father into retry interval
+            event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
+        }
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_new_connection(connection* conn) {
+        if (NULL == conn) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        // 如果ID有效，则发送注册协议
+        // ID为0则是临时节点，不需要注册
+        if (get_id()) {
+            int ret = msg_handler::send_reg(ATBUS_CMD_NODE_REG_REQ, *this, *conn, 0, 0);
+            if (ret < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, ret, 0);
+                conn->reset();
+                return ret;
+            }
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_shutdown(int reason) {
+
+        if (!flags_.test(flag_t::EN_FT_ACTIVED)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+        // flags_.set(flag_t::EN_FT_ACTIVED, false); // will be reset in reset()
+
+        if (event_msg_.on_node_down) {
+            event_msg_.on_node_down(*this, reason);
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_reg(const endpoint* ep, const connection* conn, int status) {
+        if (event_msg_.on_reg) {
+            event_msg_.on_reg(*this, ep, conn, status);
+        }
+        
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_actived() {
+        state_ = state_t::RUNNING;
+
+        if (flags_.test(flag_t::EN_FT_ACTIVED)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        flags_.set(flag_t::EN_FT_ACTIVED, true);
+        if (event_msg_.on_node_up) {
+            event_msg_.on_node_up(*this, EN_ATBUS_ERR_SUCCESS);
+        }
+
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_parent_reg_done() {
+        flags_.set(flag_t::EN_FT_PARENT_REG_DONE, true);
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::on_custom_cmd(const endpoint* ep, const connection* conn, bus_id_t from, const std::vector<std::pair<const void*, size_t> >& cmd_args) {
+        if (event_msg_.on_custom_cmd) {
+            event_msg_.on_custom_cmd(*this, ep, conn, from, cmd_args);
+        }
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    int node::shutdown(int reason) {
+        int ret = on_shutdown(reason);
+        if (0 == ret) {
+            flags_.set(flag_t::EN_FT_SHUTDOWN, true);
+        }
+        return ret;
+    }
+
+    void* node::ref_decode_arena() {
+        if (NULL == decode_arena_) {
+            return NULL;
+        }
+
+        ++decode_arena_ref_;
+        return decode_arena_;
+    }
+
+    void node::unref_decode_arena() {
+        if (NULL == decode_arena_ || 0 == decode_arena_ref_) {
+            return;
+        }
+
+        // 处理消息的过程中可能会嵌套解包其他消息，所以只在最外层释放后重置
+        if (0 == --decode_arena_ref_) {
+            reinterpret_cast<msgpack::zone*>(decode_arena_)->clear();
+        }
+    }
+
+    int node::ping_endpoint(endpoint& ep) {
+        ep.set_stat_ping_skip(0);
+
+        // 检测上一次ping是否返回
+        if (0 != ep.get_stat_ping()) {
+            if (add_endpoint_fault(ep)) {
+                return EN_ATBUS_ERR_ATNODE_FAULT_TOLERANT;
+            }
+        }
+
+
+        // 允许跳过未连接或握手完成的endpoint
+        connection* ctl_conn = self_->get_ctrl_connection(&ep);
+        if (NULL == ctl_conn) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 出错则增加错误计数
+        uint32_t ping_seq = msg_seq_alloc_.inc();
+        int res = msg_handler::send_ping(*this, *ctl_conn, ping_seq);
+        if (res < 0) {
+            add_endpoint_fault(ep);
+            return res;
+        }
+
+        ep.set_stat_ping(ping_seq);
+        ++stat_.ping_times;
+
+        // 有多个数据连接时分别测量延迟，用来选择延迟最低的连接
+        // 内存和共享内存通道是单工的，PONG不能原路返回，不需要测量
+        const std::list<connection::ptr_t>& data_conns = ep.get_data_connections();
+        if (data_conns.size() > 1) {
+            for (std::list<connection::ptr_t>::const_iterator iter = data_conns.begin(); iter != data_conns.end(); ++iter) {
+                if (ctl_conn == (*iter).get() || connection::state_t::CONNECTED != (*iter)->get_status() ||
+                    (*iter)->check_flag(connection::flag_t::ACCESS_SHARE_HOST)) {
+                    continue;
+                }
+
+                uint32_t data_ping_seq = msg_seq_alloc_.inc();
+                if (msg_handler::send_ping(*this, *(*iter), data_ping_seq) >= 0) {
+                    (*iter)->set_stat_ping(data_ping_seq);
+                    ++stat_.ping_times;
+                }
+            }
         }
+
+        return EN_ATBUS_ERR_SUCCESS;
     }
 
-    bool node::is_parent_node(bus_id_t id) const {
-        if (node_father_.node_) {
-            return self_->is_parent_node(id, node_father_.node_->get_id(), node_father_.node_->get_children_mask());
+    void node::on_recv_rtt(endpoint& ep, connection* conn, uint64_t rtt_ns) {
+        // 连接的优先顺序变化了，缓存的路由要重新查找
+        if (ep.add_stat_rtt(conn, rtt_ns)) {
+            invalidate_route_cache();
         }
+    }
 
-        return false;
+    int node::listen_auto_shm() {
+        // 低31位直接使用，31位以内的bus id和key一一对应；更高的位散列后混入，只差高位的bus id不会简单地冲突
+        uint64_t id = static_cast<uint64_t>(get_id());
+        uint32_t key = (static_cast<uint32_t>(id) ^ (static_cast<uint32_t>(id >> 31) * 2654435761U) ^ conf_.auto_shm_key_base) & 0x7fffffff;
+        if (0 == key) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        char addr[32] = {0};
+        UTIL_STRFUNC_SNPRINTF(addr, sizeof(addr), "shm://%u", key);
+        for (std::list<std::string>::const_iterator iter = get_listen_list().begin(); iter != get_listen_list().end(); ++iter) {
+            if (*iter == addr) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+        }
+
+        // key冲突(其他集群或者散列冲突的bus id)时不能共用同一个接收通道，否则会收到别人的消息
+        int res = channel::shm_check_owner(static_cast<key_t>(key));
+        if (res < 0) {
+            return res;
+        }
+
+        return listen(addr);
     }
 
-    int node::get_pid() {
-#ifdef _MSC_VER
-        return _getpid();
-#else
-        return getpid();
-#endif
+    connection* node::get_striped_data_connection(endpoint& ep, const atbus::protocol::msg& m) {
+        const atbus::protocol::forward_data* fwd = m.body.forward();
+        // 分片必须按顺序重组，不参与轮流发送
+        if (conf_.flags.test(conf_flag_t::EN_CONF_DATA_UNORDERED) &&
+            (NULL == fwd || false == fwd->check_flag(atbus::protocol::forward_data::FLAG_FRAGMENT))) {
+            return self_->get_striped_data_connection(&ep, data_stripe_seq_++, false);
+        }
+
+        // 转发节点上也用原始来源计算，整条路径上同一个流都走同一条连接
+        uint64_t from = m.head.src_bus_id;
+        if (NULL != fwd) {
+            from = fwd->from;
+        } else if (NULL != m.body.custom()) {
+            from = m.body.custom()->from;
+        }
+
+        uint64_t stripe = static_cast<uint64_t>(from) * static_cast<uint64_t>(0x9e3779b97f4a7c15ULL);
+        stripe ^= static_cast<uint64_t>(static_cast<uint32_t>(m.head.type));
+        return self_->get_striped_data_connection(&ep, stripe, true);
     }
 
-    static std::string& host_name_buffer() {
-        static std::string server_addr;
-        return server_addr;
+    int node::push_node_sync() {
+        int ret = EN_ATBUS_ERR_SUCCESS;
+
+        // 自身子树的变更上报给父节点，父节点没有全局路由表时不需要
+        if (node_father_.node_ && node_father_.node_->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && sync_report_version_ < sync_version_) {
+            int res = send_node_sync(ATBUS_CMD_NODE_SYNC_REQ, *node_father_.node_, sync_report_version_);
+            if (res < 0) {
+                ret = res;
+            } else {
+                sync_report_version_ = sync_version_;
+            }
+        }
+
+        // 全局路由表的变更下发给有全局路由表的子节点
+        for (endpoint_collection_t::const_iterator iter = node_children_.begin(); iter != node_children_.end(); ++iter) {
+            endpoint* ep = iter->get();
+            if (false == ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER) || ep->get_sync_version() >= sync_version_) {
+                continue;
+            }
+
+            int res = send_node_sync(ATBUS_CMD_NODE_SYNC_RSP, *ep, ep->get_sync_version());
+            if (res < 0) {
+                ret = res;
+            } else {
+                ep->set_sync_version(sync_version_);
+            }
+        }
+
+        sync_prune();
+
+        if (ret < 0) {
+            ATBUS_FUNC_NODE_ERROR(*this, NULL, NULL, ret, 0);
+        }
+        return ret;
     }
 
-    const std::string& node::get_hostname() {
-        std::string& hn = host_name_buffer();
-        if (!hn.empty()) {
-            return hn;
+    int node::pull_node_sync() {
+        if (!node_father_.node_) {
+            return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
         }
 
-        // @see man gethostname
-        char buffer[256] = {0};
-        if(0 == gethostname(buffer, sizeof(buffer))) {
-            hn = buffer;
+        if (false == node_father_.node_->get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+            return EN_ATBUS_ERR_ACCESS_DENY;
         }
-#ifdef _MSC_VER
-        else {
-            if (WSANOTINITIALISED == WSAGetLastError()) {
-                WSADATA wsaData;
-                WORD version = MAKEWORD(2, 0);
-                if(0 == WSAStartup(version, &wsaData) && 0 == gethostname(buffer, sizeof(buffer))) {
-                    hn = buffer;
+
+        // 父节点收到全量上报后会重新下发全量的全局路由表
+        sync_report_version_ = 0;
+        int res = send_node_sync(ATBUS_CMD_NODE_SYNC_REQ, *node_father_.node_, 0);
+        if (res >= 0) {
+            sync_report_version_ = sync_version_;
+        }
+
+        return res;
+    }
+
+    int node::on_recv_node_sync(endpoint& ep, const protocol::msg& m) {
+        const protocol::node_tree* tree = m.body.sync();
+        if (NULL == tree) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        // 只接受父节点的下发和直接子节点的上报
+        bool from_parent = ATBUS_CMD_NODE_SYNC_RSP == m.head.cmd;
+        if (from_parent) {
+            if (node_father_.node_.get() != &ep) {
+                return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+            }
+        } else if (find_child(node_children_, ep.get_id()) != &ep) {
+            return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        }
+
+        ++ stat_.node_sync_recv_times;
+
+        bus_id_t source = ep.get_id();
+        uint32_t snapshot = 0 == tree->base_version ? m.head.sequence : 0;
+        for (size_t i = 0; i < tree->nodes.size(); ++i) {
+            const protocol::node_data& nd = tree->nodes[i];
+            // 自身子树以子节点的上报为准，子节点也只能上报它自己的子树
+            if (from_parent ? is_child_node(nd.bus_id) : false == ep.is_child_node(nd.bus_id)) {
+                continue;
+            }
+
+            if (sync_set_node(nd.bus_id, static_cast<uint32_t>(nd.children_id_mask), nd.has_global_tree, source, snapshot) && from_parent) {
+                sync_connect_brother(nd);
+            }
+        }
+
+        for (size_t i = 0; i < tree->removed.size(); ++i) {
+            sync_node_collection_t::iterator iter = sync_nodes_.find(tree->removed[i]);
+            if (iter != sync_nodes_.end() && iter->second.source == source) {
+                sync_remove_node(iter->second);
+            }
+        }
+
+        // 全量同步的最后一个消息，这次没有带上的节点都已经不存在了
+        if (0 == tree->base_version && 0 != tree->version) {
+            for (sync_node_collection_t::iterator iter = sync_nodes_.begin(); iter != sync_nodes_.end(); ++iter) {
+                if (iter->second.source == source && iter->second.snapshot != snapshot) {
+                    sync_remove_node(iter->second);
                 }
             }
+
+            // 子节点全量上报说明是新的同步关系或者主动拉取，也要全量下发
+            if (!from_parent && ep.get_flag(endpoint::flag_t::GLOBAL_ROUTER)) {
+                ep.set_sync_version(0);
+                sync_schedule_push();
+            }
         }
-#endif
 
-        return hn;
+        return EN_ATBUS_ERR_SUCCESS;
     }
 
-    bool node::set_hostname(const std::string& hn) {
-        std::string& h = host_name_buffer();
-        if (h.empty()) {
-            h = hn;
-            return true;
+    const node::sync_node_t* node::get_sync_node(bus_id_t id) const {
+        sync_node_collection_t::const_iterator iter = sync_nodes_.find(id);
+        if (iter == sync_nodes_.end() || iter->second.removed) {
+            return NULL;
         }
 
-        return false;
+        return &iter->second;
     }
 
-    bool node::add_proc_connection(connection::ptr_t conn) {
-        if(!conn || conn->get_address().address.empty() || proc_connections_.end() != proc_connections_.find(conn->get_address().address)) {
+    bool node::on_relay_data(bus_id_t from, bus_id_t to) {
+        if (0 == conf_.shortcut_threshold) {
             return false;
         }
 
-        proc_connections_[conn->get_address().address] = conn;
+        time_t sec = get_timer_sec();
+        relay_traffic_t& rt = relay_traffic_[relay_pair_t(from, to)];
+        if (rt.window != sec) {
+            rt.window = sec;
+            rt.count = 0;
+        }
+
+        if (++rt.count < conf_.shortcut_threshold) {
+            return false;
+        }
+
+        // 通知以后等待来源建立连接，重试间隔内不再重复通知
+        if (0 != rt.notify_time && rt.notify_time + conf_.retry_interval > sec) {
+            return false;
+        }
+
+        // 有全局路由表时可以排除来源是目标的上级节点的情况，这时候不能直连
+        const sync_node_t* sn = get_sync_node(from);
+        if (NULL != sn && endpoint::get_children_min_id(from, sn->children_mask) <= to && 
+            endpoint::get_children_max_id(from, sn->children_mask) >= to) {
+            return false;
+        }
+
+        rt.notify_time = sec;
+        ++stat_.shortcut_notify_times;
         return true;
     }
 
-    bool node::remove_proc_connection(const std::string& conn_key) {
-        detail::auto_select_map<std::string, connection::ptr_t>::type::iterator iter = proc_connections_.find(conn_key);
-        if (iter == proc_connections_.end()) {
+    bool node::on_relay_brother_data(bus_id_t from, bus_id_t to) {
+        // 通知以后等待来源建立连接，重试间隔内不再重复通知
+        time_t sec = get_timer_sec();
+        relay_traffic_t& rt = relay_traffic_[relay_pair_t(from, to)];
+        if (0 != rt.notify_time && rt.notify_time + conf_.retry_interval > sec) {
             return false;
         }
 
-        proc_connections_.erase(iter);
+        rt.notify_time = sec;
         return true;
     }
 
-    bool node::add_connection_timer(connection::ptr_t conn) {
-        if (!conn) {
+    void node::proc_shortcut(time_t sec) {
+        // 清理过期的转发流量统计，重试间隔内通知过的要保留，防止重复通知
+        for (std::map<relay_pair_t, relay_traffic_t>::iterator iter = relay_traffic_.begin(); iter != relay_traffic_.end();) {
+            if (iter->second.window < sec && iter->second.notify_time + conf_.retry_interval < sec) {
+                relay_traffic_.erase(iter++);
+            } else {
+                ++iter;
+            }
+        }
+
+        if (conf_.shortcut_idle_timeout <= 0 || node_shortcut_.empty()) {
+            return;
+        }
+
+        // 空闲的直连断开，以后的消息重新经过父节点转发
+        std::vector<bus_id_t> idle_ids;
+        for (endpoint_collection_t::const_iterator iter = node_shortcut_.begin(); iter != node_shortcut_.end(); ++iter) {
+            if ((*iter)->get_stat_last_active() + conf_.shortcut_idle_timeout < sec) {
+                idle_ids.push_back((*iter)->get_id());
+            }
+        }
+
+        for (size_t i = 0; i < idle_ids.size(); ++i) {
+            ATBUS_FUNC_NODE_DEBUG(*this, get_endpoint(idle_ids[i]), NULL, NULL, "shortcut idle and disconnect");
+            ++stat_.shortcut_idle_times;
+            disconnect(idle_ids[i]);
+        }
+    }
+
+    bool node::sync_set_node(bus_id_t id, uint32_t children_mask, bool has_global_tree, bus_id_t source, uint32_t snapshot) {
+        sync_node_collection_t::iterator iter = sync_nodes_.find(id);
+        if (iter == sync_nodes_.end()) {
+            sync_node_t sn;
+            sn.bus_id = id;
+            sn.children_mask = children_mask;
+            sn.has_global_tree = has_global_tree;
+            sn.removed = true;
+            sn.source = source;
+            sn.version = 0;
+            sn.snapshot = 0;
+            iter = sync_nodes_.insert(std::make_pair(id, sn)).first;
+        }
+
+        sync_node_t& sn = iter->second;
+        if (0 != snapshot) {
+            sn.snapshot = snapshot;
+        }
+
+        if (!sn.removed && sn.children_mask == children_mask && sn.has_global_tree == has_global_tree && sn.source == source) {
             return false;
         }
 
-        // 如果处于握手阶段，发送节点关系逻辑并加入握手连接池并加入超时判定池
-        if (false == conn->is_connected()) {
-            event_timer_.connecting_list.push_back(std::make_pair(event_timer_.sec + conf_.first_idle_timeout, conn));
+        bool added = sn.removed;
+        if (added) {
+            ++ sync_node_count_;
         }
-        return true;
+
+        sn.children_mask = children_mask;
+        sn.has_global_tree = has_global_tree;
+        sn.removed = false;
+        sn.source = source;
+        sn.version = ++ sync_version_;
+        sync_schedule_push();
+        return added;
     }
 
-    time_t node::get_timer_sec() const {
-        return event_timer_.sec;
+    void node::sync_remove_node(sync_node_t& sn) {
+        if (sn.removed) {
+            return;
+        }
+
+        // 保留移除记录，所有同步对象都收到后再清理
+        sn.removed = true;
+        sn.version = ++ sync_version_;
+        -- sync_node_count_;
+        sync_schedule_push();
     }
 
-    time_t node::get_timer_usec() const {
-        return event_timer_.usec;
+    void node::sync_remove_source(bus_id_t source) {
+        for (sync_node_collection_t::iterator iter = sync_nodes_.begin(); iter != sync_nodes_.end(); ++iter) {
+            if (iter->second.source == source) {
+                sync_remove_node(iter->second);
+            }
+        }
     }
 
-    void node::on_recv(connection* conn, protocol::msg* m, int status, int errcode) {
-        if (status < 0 || errcode < 0) {
-            ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, status, errcode);
+    void node::sync_schedule_push() {
+        // 同一秒内的变更合并到下一秒推送，启动前没有时间不需要推送
+        if (0 == event_timer_.node_sync_push) {
+            event_timer_.node_sync_push = event_timer_.sec;
+        }
+    }
 
-            if (NULL != conn) {
-                endpoint* ep = conn->get_binding();
-                if(NULL != ep) {
-                    add_endpoint_fault(*ep);
+    int node::send_node_sync(int cmd, endpoint& ep, uint64_t base_version) {
+        connection* conn = self_->get_ctrl_connection(&ep);
+        if (NULL == conn) {
+            return EN_ATBUS_ERR_ATNODE_NO_CONNECTION;
+        }
+
+        protocol::msg m;
+        m.init(get_id(), static_cast<ATBUS_PROTOCOL_CMD>(cmd), 0, 0, alloc_msg_seq());
+        protocol::node_tree* tree = m.body.make_body<protocol::node_tree>();
+        if (NULL == tree) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+        tree->base_version = base_version;
+
+        // 按估算的打包长度分成多个消息，留一半给编码的额外开销
+        size_t limit = conf_.msg_size / 2;
+        size_t packed_size = 0;
+        bool has_sent = false;
+        for (sync_node_collection_t::iterator iter = sync_nodes_.begin(); iter != sync_nodes_.end(); ++iter) {
+            const sync_node_t& sn = iter->second;
+            if (sn.source == ep.get_id() || sn.version <= base_version) {
+                continue;
+            }
+
+            if (sn.removed) {
+                // 全量同步不需要移除记录
+                if (0 != base_version) {
+                    tree->removed.push_back(sn.bus_id);
+                    packed_size += 16;
+                }
+            } else {
+                tree->nodes.push_back(protocol::node_data());
+                protocol::node_data& nd = tree->nodes.back();
+                nd.bus_id = sn.bus_id;
+                nd.has_global_tree = sn.has_global_tree;
+                nd.children_id_mask = sn.children_mask;
+                packed_size += 32;
+
+                // 直接子节点带上监听地址，下发后兄弟节点之间可以直连
+                if (ATBUS_CMD_NODE_SYNC_RSP == cmd && sn.source == sn.bus_id && sn.bus_id != get_id()) {
+                    endpoint* child = find_child(node_children_, sn.bus_id);
+                    if (NULL != child && child->get_id() == sn.bus_id) {
+                        for (std::list<std::string>::const_iterator addr = child->get_listen().begin(); addr != child->get_listen().end(); ++addr) {
+                            nd.channels.push_back(protocol::channel_data());
+                            nd.channels.back().address = *addr;
+                            packed_size += addr->size() + 8;
+                        }
+                    }
                 }
             }
-            return;
+
+            if (packed_size >= limit) {
+                int res = msg_handler::send_msg(*this, *conn, m);
+                if (res < 0) {
+                    return res;
+                }
+
+                ++ stat_.node_sync_send_times;
+                has_sent = true;
+                tree->nodes.clear();
+                tree->removed.clear();
+                packed_size = 0;
+            }
         }
 
-        // 内部协议处理
-        int res = msg_handler::dispatch_msg(*this, conn, m, status, errcode);
+        // 没有变更的增量不需要发送，全量同步的最后一个消息即使是空的也要发送，接收方要清理没有带上的节点
+        if (0 != base_version && !has_sent && tree->nodes.empty() && tree->removed.empty()) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        tree->version = sync_version_;
+        int res = msg_handler::send_msg(*this, *conn, m);
         if (res < 0) {
-            if (NULL != conn) {
-                endpoint* ep = conn->get_binding();
-                if (NULL != ep) {
-                    add_endpoint_fault(*ep);
-                }
+            return res;
+        }
+
+        ++ stat_.node_sync_send_times;
+        if (0 == base_version) {
+            ++ stat_.node_sync_full_times;
+        }
+
+        ATBUS_FUNC_NODE_DEBUG(*this, &ep, conn, &m, "node sync to 0x%llx, version: %llu, base version: %llu",
+            static_cast<unsigned long long>(ep.get_id()), static_cast<unsigned long long>(sync_version_),
+            static_cast<unsigned long long>(base_version));
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    void node::sync_prune() {
+        // 所有同步对象都已经收到的版本号，还没有同步过的对象会收到全量，不需要移除记录
+        uint64_t min_version = sync_version_;
+        if (node_father_.node_ && node_father_.node_->get_flag(endpoint::flag_t::GLOBAL_ROUTER) &&
+            0 != sync_report_version_ && sync_report_version_ < min_version) {
+            min_version = sync_report_version_;
+        }
+
+        for (endpoint_collection_t::const_iterator iter = node_children_.begin(); iter != node_children_.end(); ++iter) {
+            endpoint* ep = iter->get();
+            if (ep->get_flag(endpoint::flag_t::GLOBAL_ROUTER) && 0 != ep->get_sync_version() && ep->get_sync_version() < min_version) {
+                min_version = ep->get_sync_version();
+            }
+        }
+
+        for (sync_node_collection_t::iterator iter = sync_nodes_.begin(); iter != sync_nodes_.end();) {
+            if (iter->second.removed && iter->second.version <= min_version) {
+                sync_nodes_.erase(iter++);
+            } else {
+                ++iter;
             }
+        }
+    }
 
+    void node::sync_connect_brother(const protocol::node_data& nd) {
+        // 只有全局路由表需要直连兄弟节点，只有父节点的直接子节点会带上监听地址
+        if (false == self_->get_flag(endpoint::flag_t::GLOBAL_ROUTER) || nd.channels.empty() || !node_father_.node_) {
             return;
         }
 
-        if (NULL == m) {
+        if (nd.bus_id == node_father_.node_->get_id() || false == is_brother_node(nd.bus_id)) {
             return;
         }
 
-        if (NULL != conn) {
-            endpoint* ep = conn->get_binding();
-            if (NULL != ep) {
-                if (m->head.ret < 0) {
-                    add_endpoint_fault(*ep);
-                } else {
-                    ep->clear_stat_fault();
-                }
+        endpoint* ep = find_child(node_brother_, nd.bus_id);
+        if (NULL != ep && ep->get_id() == nd.bus_id) {
+            return;
+        }
+
+        // 双方都有全局路由表时由ID小的一方发起连接，避免同时连接对方
+        if (nd.has_global_tree && nd.bus_id < get_id()) {
+            return;
+        }
+
+        for (size_t i = 0; i < nd.channels.size(); ++i) {
+            // 控制通道不能是（共享）内存通道，connect会拒绝
+            int res = connect(nd.channels[i].address.c_str());
+            ATBUS_FUNC_NODE_DEBUG(*this, NULL, NULL, NULL, "node sync connect to brother 0x%llx by %s, res: %d",
+                static_cast<unsigned long long>(nd.bus_id), nd.channels[i].address.c_str(), res);
+            if (res >= 0) {
+                break;
             }
         }
     }
 
-    void node::on_recv_data(const endpoint* ep, connection* conn, int type, const void* buffer, size_t s) const {
-        if (NULL == ep && NULL != conn) {
-            ep = conn->get_binding();
+    int node::on_recv_group_sync(endpoint& ep, const protocol::msg& m) {
+        const protocol::group_data* gd = m.body.group();
+        if (NULL == gd) {
+            return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        if (event_msg_.on_recv_msg) {
-            event_msg_.on_recv_msg(*this, ep, conn, type, buffer, s);
+        // 只接受子节点的上报
+        if (find_child(node_children_, ep.get_id()) != &ep) {
+            return EN_ATBUS_ERR_ATNODE_INVALID_ID;
         }
-    }
-    
-    void node::on_send_data_failed(const endpoint* ep, const connection* conn, const protocol::msg* m) {
-        if (event_msg_.on_send_data_failed) {
-            event_msg_.on_send_data_failed(*this, ep, conn, m);
+
+        std::vector<uint64_t> groups(gd->groups.begin(), gd->groups.end());
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+
+        // 上报的是全量，和上一次上报的有序列表比较，只修改有变化的组
+        std::vector<uint64_t>& old_groups = group_child_reports_[ep.get_id()];
+        size_t i = 0, j = 0;
+        while (i < old_groups.size() || j < groups.size()) {
+            if (j >= groups.size() || (i < old_groups.size() && old_groups[i] < groups[j])) {
+                group_remove_interest(old_groups[i++], ep.get_id());
+            } else if (i >= old_groups.size() || groups[j] < old_groups[i]) {
+                group_add_interest(groups[j++], ep.get_id());
+            } else {
+                ++i;
+                ++j;
+            }
+        }
+
+        if (groups.empty()) {
+            group_child_reports_.erase(ep.get_id());
+        } else {
+            old_groups.swap(groups);
         }
+        return EN_ATBUS_ERR_SUCCESS;
     }
 
-    int node::on_error(const char* file_path, size_t line, const endpoint* ep, const connection* conn, int status, int errcode) {
-        if (NULL == ep && NULL != conn) {
-            ep = conn->get_binding();
+    int node::on_recv_group_data(connection* conn, protocol::msg& m) {
+        protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd) {
+            return EN_ATBUS_ERR_BAD_DATA;
         }
 
-        if (event_msg_.on_error) {
-            event_msg_.on_error(*this, ep, conn, status, errcode);
+        // 组播只沿节点树转发，上一跳只能是父节点或子节点，这样就不会出现环路
+        bus_id_t from_id = m.head.src_bus_id;
+        endpoint* from_ep = NULL;
+        if (node_father_.node_ && node_father_.node_->get_id() == from_id) {
+            from_ep = node_father_.node_.get();
+        } else {
+            from_ep = find_child(node_children_, from_id);
+            if (NULL != from_ep && from_ep->get_id() != from_id) {
+                from_ep = NULL;
+            }
+        }
+
+        if (NULL == from_ep) {
+            ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, EN_ATBUS_ERR_ATNODE_INVALID_ID, 0);
+            return EN_ATBUS_ERR_ATNODE_INVALID_ID;
+        }
+
+        if (is_group_member(fwd->to)) {
+            ++stat_.group_recv_times;
+            if (event_msg_.on_recv_group_msg) {
+                event_msg_.on_recv_group_msg(*this, from_ep, conn, fwd->to, fwd->from, m.head.type, fwd->content.ptr, fwd->content.size);
+            }
+        }
+
+        // router的容量是固定的(ATBUS_MACRO_ROUTER_MAX_DEPTH)，满了也按ttl处理
+        if (fwd->router.size() >= static_cast<size_t>(conf_.ttl) || fwd->router.full()) {
+            ATBUS_FUNC_NODE_ERROR(*this, from_ep, conn, EN_ATBUS_ERR_ATNODE_TTL, 0);
+            return EN_ATBUS_ERR_ATNODE_TTL;
         }
 
-        return status;
+        // 每条链路的发送错误在分发时已经记录
+        return dispatch_group_msg(m, from_id);
     }
 
-    int node::on_disconnect(const connection* conn) {
-        if (NULL == conn) {
-            return EN_ATBUS_ERR_PARAMS;
+    void node::group_add_interest(uint64_t gid, bus_id_t child) {
+        group_collection_t::iterator iter = groups_.find(gid);
+        if (iter == groups_.end()) {
+            group_member_t gm;
+            gm.local = false;
+            iter = groups_.insert(group_collection_t::value_type(gid, gm)).first;
+
+            // 子树新关注的组，需要上报
+            group_schedule_push();
         }
-        
-        // 父节点断线逻辑则重置状态
-        if (state_t::CONNECTING_PARENT == state_ && !conf_.father_address.empty() && conf_.father_address == conn->get_address().address) {
-            state_ = state_t::LOST_PARENT;
 
-            // set reconnect to father into retry interval
-            event_timer_.father_opr_time_point = get_timer_sec() + conf_.retry_interval;
+        // 自身用自己的ID表示
+        if (child == get_id()) {
+            iter->second.local = true;
+        } else if (std::find(iter->second.children.begin(), iter->second.children.end(), child) == iter->second.children.end()) {
+            iter->second.children.push_back(child);
         }
-        return EN_ATBUS_ERR_SUCCESS;
     }
 
-    int node::on_new_connection(connection* conn) {
-        if (NULL == conn) {
-            return EN_ATBUS_ERR_PARAMS;
+    void node::group_remove_interest(uint64_t gid, bus_id_t child) {
+        group_collection_t::iterator iter = groups_.find(gid);
+        if (iter == groups_.end()) {
+            return;
         }
 
-        // 如果ID有效，则发送注册协议
-        // ID为0则是临时节点，不需要注册
-        if (get_id()) {
-            int ret = msg_handler::send_reg(ATBUS_CMD_NODE_REG_REQ, *this, *conn, 0, 0);
-            if (ret < 0) {
-                ATBUS_FUNC_NODE_ERROR(*this, NULL, conn, ret, 0);
-                conn->reset();
-                return ret;
+        if (child == get_id()) {
+            iter->second.local = false;
+        } else {
+            std::vector<bus_id_t>& children = iter->second.children;
+            std::vector<bus_id_t>::iterator child_iter = std::find(children.begin(), children.end(), child);
+            if (child_iter != children.end()) {
+                *child_iter = children.back();
+                children.pop_back();
             }
         }
 
-        return EN_ATBUS_ERR_SUCCESS;
+        // 子树不再关注的组，需要上报
+        if (false == iter->second.local && iter->second.children.empty()) {
+            groups_.erase(iter);
+            group_schedule_push();
+        }
     }
 
-    int node::on_shutdown(int reason) {
-
-        if (!flags_.test(flag_t::EN_FT_ACTIVED)) {
-            return EN_ATBUS_ERR_SUCCESS;
+    void node::group_remove_child(bus_id_t child) {
+        std::map<bus_id_t, std::vector<uint64_t> >::iterator iter = group_child_reports_.find(child);
+        if (iter == group_child_reports_.end()) {
+            return;
         }
-        // flags_.set(flag_t::EN_FT_ACTIVED, false); // will be reset in reset()
 
-        if (event_msg_.on_node_down) {
-            event_msg_.on_node_down(*this, reason);
+        for (size_t i = 0; i < iter->second.size(); ++i) {
+            group_remove_interest(iter->second[i], child);
         }
-
-        return EN_ATBUS_ERR_SUCCESS;
+        group_child_reports_.erase(iter);
     }
 
-    int node::on_reg(const endpoint* ep, const connection* conn, int status) {
-        if (event_msg_.on_reg) {
-            event_msg_.on_reg(*this, ep, conn, status);
+    void node::group_schedule_push() {
+        // 多次变更合并到下一次proc上报，启动前加入的组在连上父节点时上报
+        if (0 == event_timer_.group_sync_push) {
+            event_timer_.group_sync_push = 0 == event_timer_.sec ? 1 : event_timer_.sec;
         }
-        
-        return EN_ATBUS_ERR_SUCCESS;
     }
 
-    int node::on_actived() {
-        state_ = state_t::RUNNING;
-
-        if (flags_.test(flag_t::EN_FT_ACTIVED)) {
+    int node::push_group_sync() {
+        if (!node_father_.node_) {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        flags_.set(flag_t::EN_FT_ACTIVED, true);
-        if (event_msg_.on_node_up) {
-            event_msg_.on_node_up(*this, EN_ATBUS_ERR_SUCCESS);
+        protocol::msg m;
+        m.init(get_id(), ATBUS_CMD_NODE_GROUP_SYNC, 0, 0, alloc_msg_seq());
+        protocol::group_data* gd = m.body.make_body<protocol::group_data>();
+        if (NULL == gd) {
+            return EN_ATBUS_ERR_MALLOC;
         }
 
-        return EN_ATBUS_ERR_SUCCESS;
-    }
+        gd->groups.reserve(groups_.size());
+        for (group_collection_t::const_iterator iter = groups_.begin(); iter != groups_.end(); ++iter) {
+            gd->groups.push_back(iter->first);
+        }
+        std::sort(gd->groups.begin(), gd->groups.end());
 
-    int node::on_parent_reg_done() {
-        flags_.set(flag_t::EN_FT_PARENT_REG_DONE, true);
-        return EN_ATBUS_ERR_SUCCESS;
+        int res = send_ctrl_msg(node_father_.node_->get_id(), m);
+        if (res < 0) {
+            ATBUS_FUNC_NODE_ERROR(*this, node_father_.node_.get(), NULL, res, 0);
+            return res;
+        }
+
+        ++stat_.group_sync_send_times;
+        return res;
     }
 
-    int node::on_custom_cmd(const endpoint* ep, const connection* conn, bus_id_t from, const std::vector<std::pair<const void*, size_t> >& cmd_args) {
-        if (event_msg_.on_custom_cmd) {
-            event_msg_.on_custom_cmd(*this, ep, conn, from, cmd_args);
+    int node::dispatch_group_msg(protocol::msg& m, bus_id_t from_id) {
+        protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd) {
+            return EN_ATBUS_ERR_BAD_DATA;
         }
-        return EN_ATBUS_ERR_SUCCESS;
+
+        if (false == fwd->router.push_back(get_id())) {
+            return EN_ATBUS_ERR_ATNODE_TTL;
+        }
+        m.head.src_bus_id = get_id();
+
+        // 每条链路只发送一份，二进制编码时只重新打包消息头，数据直接引用原来的缓冲区
+        int ret = EN_ATBUS_ERR_SUCCESS;
+        size_t sent = 0;
+        group_collection_t::const_iterator iter = groups_.find(fwd->to);
+        size_t children_count = iter == groups_.end() ? 0 : iter->second.children.size();
+        for (size_t i = 0; i <= children_count; ++i) {
+            endpoint* ep = NULL;
+            if (i < children_count) {
+                bus_id_t child = iter->second.children[i];
+                if (child == from_id) {
+                    continue;
+                }
+                ep = find_child(node_children_, child);
+                if (NULL == ep || ep->get_id() != child) {
+                    continue;
+                }
+            } else {
+                // 父节点不知道其他子树的关注，所以来自子树的消息要一直向上转发
+                if (!node_father_.node_ || node_father_.node_->get_id() == from_id) {
+                    continue;
+                }
+                ep = node_father_.node_.get();
+            }
+
+            connection* conn = self_->get_data_connection(ep);
+            if (NULL != conn && ep->get_data_connections().size() > 1) {
+                connection* stripe_conn = get_striped_data_connection(*ep, m);
+                if (NULL != stripe_conn) {
+                    conn = stripe_conn;
+                }
+            }
+
+            int res = NULL == conn ? EN_ATBUS_ERR_ATNODE_NO_CONNECTION : msg_handler::send_msg(*this, *conn, m);
+            if (res < 0) {
+                ATBUS_FUNC_NODE_ERROR(*this, ep, conn, res, 0);
+                ret = res;
+            } else {
+                ++sent;
+                ++stat_.group_send_times;
+            }
+        }
+
+        return 0 == sent ? ret : EN_ATBUS_ERR_SUCCESS;
     }
 
-    int node::shutdown(int reason) {
-        int ret = on_shutdown(reason);
-        if (0 == ret) {
-            flags_.set(flag_t::EN_FT_SHUTDOWN, true);
+    int node::on_recv_service_data(connection* conn, protocol::msg& m) {
+        if (NULL == m.body.forward()) {
+            return EN_ATBUS_ERR_BAD_DATA;
         }
-        return ret;
+
+        return dispatch_service_msg(conn, m, NULL);
     }
 
-    int node::ping_endpoint(endpoint& ep) {
-        // 检测上一次ping是否返回
-        if (0 != ep.get_stat_ping()) {
-            if (add_endpoint_fault(ep)) {
-                return EN_ATBUS_ERR_ATNODE_FAULT_TOLERANT;
+    namespace detail {
+        struct service_selector_t {
+            endpoint* self;
+            uint64_t service;
+            uint32_t key_hash;
+            endpoint* ret;
+            uint64_t best;
+
+            service_selector_t(endpoint* s, uint64_t svc, uint32_t h): self(s), service(svc), key_hash(h), ret(NULL), best(0) {}
+
+            void check(endpoint* ep) {
+                if (NULL == ep || false == ep->has_service(service)) {
+                    return;
+                }
+
+                // 对端要有可用的数据连接
+                if (ep != self && NULL == self->get_data_connection(ep)) {
+                    return;
+                }
+
+                if (0 != key_hash) {
+                    // 最高随机权重(rendezvous)哈希，实例增减时只有原来或者新选中这个实例的key会改变目标
+                    uint64_t score = service_mix(((static_cast<uint64_t>(key_hash) << 32) | key_hash) ^
+                        (static_cast<uint64_t>(ep->get_id()) * static_cast<uint64_t>(0x9e3779b97f4a7c15ULL)));
+                    if (NULL == ret || score > best) {
+                        best = score;
+                        ret = ep;
+                    }
+                } else {
+                    uint64_t load = ep->get_stat_load();
+                    if (NULL == ret || load < best) {
+                        best = load;
+                        ret = ep;
+                    }
+                }
+            }
+
+            void check(const node::endpoint_collection_t& coll) {
+                for (size_t i = 0; i < coll.size(); ++i) {
+                    check(coll.get(i));
+                }
             }
+        };
+    }
+
+    endpoint* node::select_service_endpoint(uint64_t service, uint32_t key_hash) {
+        if (!self_) {
+            return NULL;
         }
 
+        // 同一个节点只会出现在其中一个集合里
+        detail::service_selector_t selector(self_.get(), service, key_hash);
+        selector.check(self_.get());
+        selector.check(node_father_.node_.get());
+        selector.check(node_brother_);
+        selector.check(node_children_);
+        selector.check(node_shortcut_);
 
-        // 允许跳过未连接或握手完成的endpoint
-        connection* ctl_conn = self_->get_ctrl_connection(&ep);
-        if (NULL == ctl_conn) {
-            return EN_ATBUS_ERR_SUCCESS;
+        // 下一次负载提示到来之前，按发出的消息数估算排队的请求
+        if (NULL != selector.ret && 0 == key_hash) {
+            selector.ret->add_stat_load_pending();
         }
 
-        // 出错则增加错误计数
-        uint32_t ping_seq = msg_seq_alloc_.inc();
-        int res = msg_handler::send_ping(*this, *ctl_conn, ping_seq);
-        if (res < 0) {
-            add_endpoint_fault(ep);
+        return selector.ret;
+    }
+
+    int node::dispatch_service_msg(connection* conn, protocol::msg& m, bus_id_t* target) {
+        protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd) {
+            return EN_ATBUS_ERR_BAD_DATA;
+        }
+
+        endpoint* ep = select_service_endpoint(fwd->to, m.head.sequence);
+        if (NULL == ep) {
+            // 不知道服务的实例，交给父节点选择
+            if (!node_father_.node_) {
+                return EN_ATBUS_ERR_ATNODE_NOT_FOUND;
+            }
+
+            int res = send_data_msg(node_father_.node_->get_id(), m);
+            if (res >= 0) {
+                ++stat_.service_forward_times;
+            }
             return res;
         }
 
-        ep.set_stat_ping(ping_seq);
-        return EN_ATBUS_ERR_SUCCESS;
-    }
+        if (NULL != target) {
+            *target = ep->get_id();
+        }
 
-    int node::push_node_sync() {
-        // TODO 防止短时间内批量上报注册协议，所以合并上报数据包
-        
-        // TODO 给所有需要全局路由表的子节点下发数据
-        return EN_ATBUS_ERR_SUCCESS;
-    }
+        if (ep == self_.get()) {
+            ++stat_.service_send_times;
+            on_recv_data(NULL, conn, m.head.type, fwd->content.ptr, fwd->content.size);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
 
-    int node::pull_node_sync() {
-        // TODO 拉取全局节点信息表
-        return EN_ATBUS_ERR_SUCCESS;
+        // 选出实例以后就是普通的数据消息，失败通知也按数据消息发回来源
+        m.head.cmd = ATBUS_CMD_DATA_TRANSFORM_REQ;
+        fwd->to = ep->get_id();
+        int res = send_data_msg(fwd->to, m);
+        if (res >= 0) {
+            ++stat_.service_send_times;
+        }
+        return res;
     }
 
     uint32_t node::alloc_msg_seq() {
@@ -1125,6 +2782,22 @@ namespace atbus {
     node::evt_msg_t::on_remove_endpoint_fn_t node::get_on_remove_endpoint_handle() const {
         return event_msg_.on_endpoint_removed;
     }
+
+    void node::set_on_recv_call_handle(evt_msg_t::on_recv_call_fn_t fn) {
+        event_msg_.on_recv_call = fn;
+    }
+
+    node::evt_msg_t::on_recv_call_fn_t node::get_on_recv_call_handle() const {
+        return event_msg_.on_recv_call;
+    }
+
+    void node::set_on_recv_group_handle(evt_msg_t::on_recv_group_msg_fn_t fn) {
+        event_msg_.on_recv_group_msg = fn;
+    }
+
+    node::evt_msg_t::on_recv_group_msg_fn_t node::get_on_recv_group_handle() const {
+        return event_msg_.on_recv_group_msg;
+    }
     
     void node::ref_object(void* obj) {
         if (NULL == obj) {
@@ -1138,70 +2811,24 @@ namespace atbus {
         ref_objs_.erase(obj);
     }
 
-    endpoint* node::find_child(endpoint_collection_t& coll, bus_id_t id) {
-        // key 保存为子域上界，所以第一个查找的节点要么直接是value，要么是value的子节点
-        endpoint_collection_t::iterator iter = coll.lower_bound(id);
-        if (iter == coll.end()) {
-            return NULL;
-        }
-
-        if (iter->second->get_id() == id) {
-            return iter->second.get();
-        }
-
+    endpoint* node::find_child(const endpoint_collection_t& coll, bus_id_t id) {
+        // 按子域区间查找，找到的要么直接是目标节点，要么是目标节点的父节点
         // 不能直接发送到间接子节点，所以直接发给直接子节点由其转发即可
-        if (iter->second->is_child_node(id)) {
-            return iter->second.get();
-        }
-
-        return NULL;
+        return coll.find(id);
     }
 
-    bool node::insert_child(endpoint_collection_t& coll, endpoint::ptr_t ep) {
+    bool node::insert_child(endpoint_collection_t& coll, endpoint::ptr_t ep, bool only_self) {
         if (!ep) {
             return false;
         }
 
-        bus_id_t maskv = endpoint::get_children_max_id(ep->get_id(), ep->get_children_mask());
-
-        // key 保存为子域上界，所以第一个查找的节点要么目标节点的父节点，要么子节点域交叉
-        endpoint_collection_t::iterator iter = coll.lower_bound(ep->get_id());
-
-        // 如果在所有子节点域外则直接添加
-        if (iter == coll.end()) {
-            // 有可能这个节点覆盖最后一个
-            if (!coll.empty() && ep->is_child_node(coll.rbegin()->second->get_id())) {
-                return false;
-            }
-
-            coll[maskv] = ep;
-            
-            // event
-            if (event_msg_.on_endpoint_added) {
-                event_msg_.on_endpoint_added(*this, ep.get(), EN_ATBUS_ERR_SUCCESS);
-            }
-            return true;
-        }
-
-        // 如果是数据merge则出错退出
-        if (iter->second->get_id() == ep->get_id()) {
-            return false;
-        }
-
-        // 如果新节点是老节点的子节点，则失败退出
-        if (iter->second->is_child_node(ep->get_id()) || ep->is_child_node(iter->second->get_id())) {
+        // 和已有节点的子域有交叉(包括新节点是老节点的子节点或者相反)则失败退出
+        uint32_t mask = only_self ? 0 : ep->get_children_mask();
+        if (false == coll.insert(endpoint::get_children_min_id(ep->get_id(), mask),
+            endpoint::get_children_max_id(ep->get_id(), mask), ep)) {
             return false;
         }
-
-        // 如果有老节点是新节点的子节点，则失败退出
-        if (iter != coll.begin()) {
-            --iter;
-            if (iter != coll.end() && ep->is_child_node(iter->second->get_id())) {
-                return false;
-            }
-        }
-
-        coll[maskv] = ep;
+        invalidate_route_cache();
         
         // event
         if (event_msg_.on_endpoint_added) {
@@ -1210,18 +2837,41 @@ namespace atbus {
         return true;
     }
 
+    void node::move_nested_brother_to_shortcut(const endpoint& ep) {
+        bus_id_t min_id = endpoint::get_children_min_id(ep.get_id(), ep.get_children_mask());
+        bus_id_t max_id = endpoint::get_children_max_id(ep.get_id(), ep.get_children_mask());
+
+        // 子域是按掩码对齐的区间，要么包含要么不相交，下界落在新节点子域内的都是新节点的下级
+        size_t idx = node_brother_.lower_bound(min_id);
+        while (idx < node_brother_.size() && node_brother_.get(idx)->get_id() <= max_id) {
+            endpoint::ptr_t nested = node_brother_.at(idx);
+            if (false == node_shortcut_.insert(nested->get_id(), nested->get_id(), nested)) {
+                ++idx;
+                continue;
+            }
+
+            // 端点本身没有变化，只是换了集合，不触发事件
+            node_brother_.erase(idx);
+            nested->set_flag(endpoint::flag_t::SHORTCUT, true);
+            nested->set_stat_last_active(get_timer_sec());
+            invalidate_route_cache();
+            ATBUS_FUNC_NODE_DEBUG(*this, nested.get(), NULL, NULL, "nested brother moved to shortcut");
+        }
+    }
+
     bool node::remove_child(endpoint_collection_t& coll, bus_id_t id) {
-        endpoint_collection_t::iterator iter = coll.lower_bound(id);
-        if (iter == coll.end()) {
+        size_t idx = coll.lower_bound(id);
+        if (idx >= coll.size()) {
             return false;
         }
 
-        if (iter->second->get_id() != id) {
+        if (coll.get(idx)->get_id() != id) {
             return false;
         }
 
-        endpoint::ptr_t ep = iter->second;
-        coll.erase(iter);
+        endpoint::ptr_t ep = coll.at(idx);
+        coll.erase(idx);
+        invalidate_route_cache();
         
         // event
         if (event_msg_.on_endpoint_removed) {
@@ -1233,16 +2883,33 @@ namespace atbus {
     bool node::remove_collection(endpoint_collection_t& coll) {
         endpoint_collection_t ec;
         ec.swap(coll);
+        invalidate_route_cache();
 
         if (event_msg_.on_endpoint_removed) {
-            for (endpoint_collection_t::iterator iter = ec.begin(); iter != ec.end(); ++iter) {
-                event_msg_.on_endpoint_removed(*this, iter->second.get(), EN_ATBUS_ERR_SUCCESS);
+            for (endpoint_collection_t::const_iterator iter = ec.begin(); iter != ec.end(); ++iter) {
+                event_msg_.on_endpoint_removed(*this, iter->get(), EN_ATBUS_ERR_SUCCESS);
             }
         }
 
         return !ec.empty();
     }
 
+    void node::set_route_cache(bus_id_t tid, endpoint* ep, connection* conn) {
+        if (NULL == ep || NULL == conn || connection::state_t::CONNECTED != conn->get_status()) {
+            return;
+        }
+
+        // 目标太多时直接清空，过期的项在下一次发送时覆盖
+        if (route_cache_.size() >= ATBUS_MACRO_ROUTE_CACHE_SIZE && route_cache_.end() == route_cache_.find(tid)) {
+            route_cache_.clear();
+        }
+
+        route_cache_t& rc = route_cache_[tid];
+        rc.epoch = route_epoch_;
+        rc.ep = ep;
+        rc.conn = conn;
+    }
+
     bool node::add_endpoint_fault(endpoint& ep) {
         size_t fault_count = ep.add_stat_fault();
         if (fault_count > conf_.fault_tolerant) {
@@ -1262,13 +2929,149 @@ namespace atbus {
             return;
         }
         
-        event_timer_.ping_list.push_back(std::make_pair(event_timer_.sec + conf_.ping_interval, ep));
+        event_timer_.ping_list.add(get_timer_tick() + static_cast<uint64_t>(conf_.ping_interval) * 1000, ep);
+    }
+
+    bool node::check_ping_skip(endpoint& ep, uint64_t tick) {
+        // 服务实例的负载提示只随PING/PONG交换，越繁忙越需要及时更新，不能跳过
+        if (!ep.get_services().empty()) {
+            return false;
+        }
+
+        if (0 == ep.get_stat_ping_skip()) {
+            ep.set_stat_ping_skip(tick);
+            return true;
+        }
+
+        // 一直繁忙的链路也要定期ping，否则延迟不再更新，按延迟选择的连接和路由都会过时
+        if (conf_.ping_skip_limit > 0 &&
+            ep.get_stat_ping_skip() + static_cast<uint64_t>(conf_.ping_skip_limit) * static_cast<uint64_t>(conf_.ping_interval) * 1000 <= tick) {
+            return false;
+        }
+
+        return true;
     }
 
     void node::stat_add_dispatch_times() {
         ++ stat_.dispatch_times;
     }
 
+    int node::register_compression(const compression::codec_t* codec) {
+        if (NULL == codec || NULL == codec->compress || NULL == codec->decompress) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        if (codec->id <= compression::algorithm_t::NONE || codec->id >= compression::algorithm_t::MAX) {
+            return EN_ATBUS_ERR_PARAMS;
+        }
+
+        compression_codecs_[codec->id] = codec;
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
+    const compression::codec_t* node::get_compression(uint32_t id) const {
+        if (id >= compression::algorithm_t::MAX) {
+            return NULL;
+        }
+
+        return compression_codecs_[id];
+    }
+
+    uint32_t node::get_compression_mask() const {
+        uint32_t ret = 0;
+        for (uint32_t i = compression::algorithm_t::NONE + 1; i < compression::algorithm_t::MAX; ++i) {
+            if (NULL != compression_codecs_[i]) {
+                ret |= static_cast<uint32_t>(1) << i;
+            }
+        }
+
+        return ret;
+    }
+
+    const void* node::compress_data(const connection& conn, const void* buffer, size_t s, size_t& out_size) {
+        out_size = 0;
+        if (0 == conf_.compress_threshold || s < conf_.compress_threshold || NULL == buffer) {
+            return NULL;
+        }
+
+        // 只压缩io_stream连接，内存和共享内存通道在同一台物理机上，压缩只会浪费CPU
+        if (false == conn.check_flag(connection::flag_t::REG_FD) || conn.check_flag(connection::flag_t::ACCESS_SHARE_HOST)) {
+            return NULL;
+        }
+
+        // 对端注册时发来的算法掩码里也要有
+        const endpoint* ep = conn.get_binding();
+        const compression::codec_t* codec = get_compression(conf_.compress_algorithm);
+        if (NULL == ep || NULL == codec || 0 == (ep->get_compress_algorithms() & (static_cast<uint32_t>(1) << codec->id))) {
+            return NULL;
+        }
+
+        // 压缩后不小于原始长度就没必要压缩了
+        compress_buffer_.resize(s);
+        size_t head_size = protocol::compress_pack_head(&compress_buffer_[0], compress_buffer_.size(), codec->id, s);
+        if (0 == head_size || head_size >= s) {
+            return NULL;
+        }
+
+        uint64_t begin_ns = uv_hrtime();
+        size_t data_size = codec->compress(buffer, s, &compress_buffer_[head_size], s - head_size - 1);
+        stat_.compress_cost_ns += uv_hrtime() - begin_ns;
+
+        if (0 == data_size) {
+            ++ stat_.compress_skip_times;
+            return NULL;
+        }
+
+        out_size = head_size + data_size;
+        ++ stat_.compress_times;
+        stat_.compress_origin_bytes += s;
+        stat_.compress_bytes += out_size;
+        return &compress_buffer_[0];
+    }
+
+    int node::decompress_data(void* arena, protocol::msg& m) {
+        protocol::forward_data* fwd = m.body.forward();
+        if (NULL == fwd || false == fwd->check_flag(protocol::forward_data::FLAG_COMPRESSED)) {
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        if (NULL == arena) {
+            return EN_ATBUS_ERR_NOT_INITED;
+        }
+
+        uint32_t algorithm = 0;
+        size_t origin_size = 0;
+        const void* data = NULL;
+        size_t data_len = 0;
+        if (false == protocol::compress_unpack_head(fwd->content.ptr, fwd->content.size, algorithm, origin_size, data, data_len)) {
+            return EN_ATBUS_ERR_UNPACK;
+        }
+
+        // 发送端只会压缩不超过消息长度限制的数据
+        const compression::codec_t* codec = get_compression(algorithm);
+        if (NULL == codec || 0 == origin_size || origin_size > conf_.msg_size) {
+            return EN_ATBUS_ERR_UNPACK;
+        }
+
+        void* out = reinterpret_cast<msgpack::zone*>(arena)->allocate_no_align(origin_size);
+        if (NULL == out) {
+            return EN_ATBUS_ERR_MALLOC;
+        }
+
+        uint64_t begin_ns = uv_hrtime();
+        bool res = codec->decompress(data, data_len, out, origin_size);
+        stat_.decompress_cost_ns += uv_hrtime() - begin_ns;
+        if (false == res) {
+            return EN_ATBUS_ERR_UNPACK;
+        }
+
+        ++ stat_.decompress_times;
+        fwd->content.ptr = out;
+        fwd->content.size = origin_size;
+        fwd->unset_flag(protocol::forward_data::FLAG_COMPRESSED);
+        return EN_ATBUS_ERR_SUCCESS;
+    }
+
     channel::io_stream_channel* node::get_iostream_channel() {
         if(iostream_channel_) {
             return iostream_channel_.get();
@@ -1312,5 +3115,12 @@ namespace atbus {
         return iostream_conf_.get();
     }
 
-    node::stat_info_t::stat_info_t(): dispatch_times(0) {}
+    node::stat_info_t::stat_info_t(): dispatch_times(0), compress_times(0), compress_skip_times(0), compress_origin_bytes(0),
+        compress_bytes(0), compress_cost_ns(0), decompress_times(0), decompress_cost_ns(0), call_times(0), call_failed_times(0),
+        call_timeout_times(0), call_latency_ns(0), call_latency_max_ns(0), node_sync_send_times(0), node_sync_full_times(0),
+        node_sync_recv_times(0), route_cache_hit_times(0), route_cache_miss_times(0), shortcut_notify_times(0), shortcut_idle_times(0),
+        ping_times(0), ping_skip_times(0), group_send_times(0), group_recv_times(0), group_sync_send_times(0),
+        service_send_times(0), service_forward_times(0) {
+        memset(call_latency_histogram, 0, sizeof(call_latency_histogram));
+    }
 }
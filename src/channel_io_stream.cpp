@@ -11,6 +11,7 @@
 #include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
 #include <vector>
 
 #ifndef _MSC_VER
@@ -19,6 +20,20 @@
 #include <sys/stat.h>
 #endif
 
+// MSG_ZEROCOPY需要Linux 4.14及以上的内核头文件
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define ATBUS_CHANNEL_IOS_ZERO_COPY 1
+#endif
+
+// unixpkt(SOCK_SEQPACKET)需要recvmmsg/sendmmsg
+#include <sys/un.h>
+#define ATBUS_CHANNEL_IOS_PACKET 1
+#define ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX 64
+#endif
+
 #include "common/string_oprs.h"
 #include "std/smart_ptr.h"
 
@@ -134,6 +149,7 @@ namespace atbus {
             conf->keepalive = 60;
             conf->is_noblock = true;
             conf->is_nodelay = true;
+            conf->is_reuse_port = false;
             conf->send_buffer_static = 0;
             conf->recv_buffer_static = 2; // 接收一般就一个正在处理的包，所以预留2个index足够了
 
@@ -142,6 +158,9 @@ namespace atbus {
 
             conf->recv_buffer_max_size = ATBUS_MACRO_MSG_LIMIT * conf->recv_buffer_static;
             conf->recv_buffer_limit_size = ATBUS_MACRO_MSG_LIMIT;
+            conf->send_batch_number = 64;
+            conf->send_zero_copy_threshold = 0;
+            conf->recv_batch_number = 16;
 
             conf->backlog = ATBUS_MACRO_CONNECTION_BACKLOG;
         }
@@ -241,6 +260,7 @@ namespace atbus {
             }
 
             channel->ev_loop = NULL;
+            std::vector<char>().swap(channel->recv_packet_buffer);
 
             return EN_ATBUS_ERR_SUCCESS;
         }
@@ -298,6 +318,10 @@ namespace atbus {
             buf->len = swrite;
         }
 
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+        static void io_stream_zero_copy_drain(io_stream_connection* connection);
+#endif
+
         static void io_stream_on_recv_read_fn(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf){
             io_stream_connection* conn_raw_ptr = reinterpret_cast<io_stream_connection*>(stream->data);
             assert(conn_raw_ptr);
@@ -313,6 +337,12 @@ namespace atbus {
 
             // 读取完或EAGAIN或signal中断，直接忽略即可
             if (0 == nread || UV_EAGAIN == nread || UV_EAI_AGAIN == nread || UV_EINTR == nread) {
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+                // 零拷贝发送完成的通知会放在错误队列里，并以POLLERR唤醒可读事件
+                if (NULL != conn_raw_ptr->zero_copy.block) {
+                    io_stream_zero_copy_drain(conn_raw_ptr);
+                }
+#endif
                 return;
             }
 
@@ -490,6 +520,17 @@ namespace atbus {
             }
 
             io_stream_stream_init(channel, conn, reinterpret_cast<adapter::stream_t*>(handle));
+
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+            // 监听的socket不发送数据，不需要开启
+            if (NULL != conn && channel->conf.send_zero_copy_threshold > 0 && 
+                !ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, io_stream_connection::EN_CF_LISTEN)) {
+                int opt = 1;
+                if (0 == setsockopt(conn->fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt))) {
+                    ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_ZERO_COPY);
+                }
+            }
+#endif
         }
 
         static void io_stream_pipe_init(io_stream_channel* channel, io_stream_connection* conn, adapter::pipe_t* handle) {
@@ -523,6 +564,26 @@ namespace atbus {
             io_stream_stream_setup(channel, reinterpret_cast<adapter::stream_t*>(handle));
         }
 
+        // 必须在bind之前设置，所以handle必须通过uv_tcp_init_ex创建好socket
+        static int io_stream_tcp_reuse_port(adapter::tcp_t* handle) {
+#if !defined(_WIN32) && defined(SO_REUSEPORT)
+            adapter::fd_t fd;
+            int ret = uv_fileno(reinterpret_cast<const adapter::handle_t*>(handle), &fd);
+            if (0 != ret) {
+                return ret;
+            }
+
+            int opt = 1;
+            if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+                return -errno;
+            }
+
+            return 0;
+#else
+            return UV_ENOTSUP;
+#endif
+        }
+
         static void io_stream_pipe_setup(io_stream_channel* channel, adapter::pipe_t* handle) {
             if (NULL == channel || NULL == handle) {
                 return;
@@ -542,6 +603,49 @@ namespace atbus {
             size_t priv_size;
         };
 
+        // 通知写缓冲区里剩余的所有数据块发送失败，每个数据块只会通知一次
+        static void io_stream_write_release_failed(io_stream_connection* connection) {
+            void* data = NULL;
+            size_t nread, nwrite;
+
+            // 暂存队列引用了写缓冲区里的数据块
+            connection->write_batch.clear();
+            while (true) {
+                connection->write_buffers.front(data, nread, nwrite);
+                if (NULL == data) {
+                    break;
+                }
+
+                if (0 == nwrite) {
+                    connection->write_buffers.pop_front(0, true);
+                    continue;
+                }
+
+                char* buff_start = reinterpret_cast<char*>(data);
+                size_t len = nwrite;
+                if (!ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_PACKET)) {
+                    // nwrite = uv_write_t的大小+crc32+vint的大小+数据区长度
+                    buff_start += sizeof(uv_write_t) + sizeof(uint32_t);
+                    uint64_t out;
+                    size_t vint_len = detail::fn::read_vint(out, buff_start, nwrite - sizeof(uv_write_t) - sizeof(uint32_t));
+                    buff_start += vint_len;
+                    len = static_cast<size_t>(out);
+                }
+
+                io_stream_channel_callback(
+                    io_stream_callback_evt_t::EN_FN_WRITEN,
+                    connection->channel,
+                    connection,
+                    UV_ECANCELED,
+                    EN_ATBUS_ERR_WRITE_FAILED,
+                    buff_start,
+                    len
+                );
+
+                connection->write_buffers.pop_front(nwrite, true);
+            }
+        }
+
         static void io_stream_connection_on_close(uv_handle_t* handle) {
             io_stream_connection* conn_raw_ptr = reinterpret_cast<io_stream_connection*>(handle->data);
             // 连接尚未初始化完毕,或通过其他途径走过关闭流程，直接退出
@@ -559,6 +663,18 @@ namespace atbus {
             iter = channel->conn_pool.find(conn_raw_ptr->fd);
 
             if (iter != channel->conn_pool.end()) {
+                // 连接关闭后不会再收到零拷贝的通知了，数据块随连接一起释放
+                if (NULL != conn_raw_ptr->zero_copy.block) {
+                    conn_raw_ptr->zero_copy.block = NULL;
+                    conn_raw_ptr->zero_copy.done_req = NULL;
+                    --conn_raw_ptr->write_inflight;
+                    ATBUS_CHANNEL_REQ_END(channel);
+                }
+
+                // 写请求的回调都已经执行过了，写缓冲区里剩下的是没有提交成功的数据块、
+                // 等待通知的零拷贝数据块和排在它后面还没有回调的数据块
+                io_stream_write_release_failed(conn_raw_ptr);
+
                 iter->second->status = io_stream_connection::EN_ST_DISCONNECTIED;
                 io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_DISCONNECTED, channel, iter->second.get(), 0, EN_ATBUS_ERR_SUCCESS, NULL, 0);
 
@@ -660,6 +776,11 @@ namespace atbus {
             if (channel->conf.send_buffer_max_size > 0 && channel->conf.send_buffer_static > 0) {
                 ret->write_buffers.set_mode(channel->conf.send_buffer_max_size, channel->conf.send_buffer_static);
             }
+            ret->write_inflight = 0;
+            if (channel->conf.send_batch_number > 1) {
+                ret->write_batch.reserve(channel->conf.send_batch_number);
+            }
+            memset(&ret->zero_copy, 0, sizeof(ret->zero_copy));
 
             channel->conn_pool[ret->fd] = ret;
             ret->channel = channel;
@@ -667,6 +788,12 @@ namespace atbus {
             // 监听关闭事件，用于释放资源
             handle->close_cb = io_stream_connection_on_close;
 
+            // unixpkt连接由调用方启动uv_poll_t
+            if (UV_POLL == handle->type) {
+                ATBUS_CHANNEL_IOS_SET_FLAG(ret->flags, io_stream_connection::EN_CF_PACKET);
+                return ret;
+            }
+
             // 监听可读事件
             uv_read_start(handle.get(), io_stream_on_recv_alloc_fn, io_stream_on_recv_read_fn);
 
@@ -929,6 +1056,420 @@ namespace atbus {
             }
         }
 
+#ifdef ATBUS_CHANNEL_IOS_PACKET
+        // ============ unixpkt(SOCK_SEQPACKET) ============
+        // libuv不支持SOCK_SEQPACKET，所以使用uv_poll_t自己收发。内核保证了消息边界，所以不需要crc32和varint分帧
+
+        // uv_poll_t不会关闭文件描述符，所以跟着handle一起释放
+        struct io_stream_packet_handle {
+            adapter::poll_t poll;
+            adapter::fd_t fd;
+
+            io_stream_packet_handle() : fd(-1) {}
+            ~io_stream_packet_handle() {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        };
+
+        static void io_stream_all_connected_cb(uv_connect_t* req, int status);
+
+        static bool io_stream_packet_make_sockaddr(const std::string& path, sockaddr_un& sock_addr) {
+            memset(&sock_addr, 0, sizeof(sock_addr));
+            if (path.empty() || path.size() >= sizeof(sock_addr.sun_path)) {
+                return false;
+            }
+
+            sock_addr.sun_family = AF_UNIX;
+            memcpy(sock_addr.sun_path, path.c_str(), path.size());
+            return true;
+        }
+
+        static void io_stream_packet_on_read(io_stream_channel* channel, io_stream_connection* conn) {
+            size_t unit_size = channel->conf.recv_buffer_limit_size > 0 ? channel->conf.recv_buffer_limit_size : ATBUS_MACRO_MSG_LIMIT;
+            size_t batch_number = channel->conf.recv_batch_number > 0 ? channel->conf.recv_batch_number : 1;
+            if (batch_number > ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX) {
+                batch_number = ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX;
+            }
+
+            // 接收区只在回调期间使用，所以同一个channel的所有连接可以共享
+            if (channel->recv_packet_buffer.size() < unit_size * batch_number) {
+                channel->recv_packet_buffer.resize(unit_size * batch_number);
+            }
+
+            mmsghdr msgs[ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX];
+            iovec iovs[ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX];
+            memset(msgs, 0, sizeof(mmsghdr) * batch_number);
+            for (size_t i = 0; i < batch_number; ++i) {
+                iovs[i].iov_base = &channel->recv_packet_buffer[i * unit_size];
+                iovs[i].iov_len = unit_size;
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            int nmsgs = recvmmsg(conn->fd, msgs, static_cast<unsigned int>(batch_number), MSG_DONTWAIT, NULL);
+            if (nmsgs < 0) {
+                if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+                    return;
+                }
+
+                channel->error_code = -errno;
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn, channel->error_code, EN_ATBUS_ERR_READ_FAILED, NULL, 0);
+                io_stream_disconnect(channel, conn, NULL);
+                return;
+            }
+
+            for (int i = 0; i < nmsgs && io_stream_connection::EN_ST_CONNECTED == conn->status; ++i) {
+                // 长度为0表示对端已关闭，所以不允许发送空数据包
+                if (0 == msgs[i].msg_len) {
+                    channel->error_code = UV_EOF;
+                    io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn, UV_EOF, EN_ATBUS_ERR_READ_FAILED, NULL, 0);
+                    io_stream_disconnect(channel, conn, NULL);
+                    return;
+                }
+
+                channel->error_code = 0;
+                io_stream_channel_callback(
+                    io_stream_callback_evt_t::EN_FN_RECVED,
+                    channel,
+                    conn,
+                    0,
+                    (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? EN_ATBUS_ERR_INVALID_SIZE : EN_ATBUS_ERR_SUCCESS,
+                    iovs[i].iov_base,
+                    msgs[i].msg_len
+                );
+            }
+        }
+
+        static void io_stream_packet_io_cb(uv_poll_t* handle, int status, int events);
+
+        // 把暂存的数据包通过sendmmsg发送出去，发送缓冲区满时等下一次可写事件
+        static void io_stream_packet_flush(io_stream_channel* channel, io_stream_connection* conn) {
+            size_t batch_number = channel->conf.send_batch_number > 0 ? channel->conf.send_batch_number : 1;
+            if (batch_number > ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX) {
+                batch_number = ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX;
+            }
+
+            mmsghdr msgs[ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX];
+            iovec iovs[ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX];
+            adapter::buf_t sent_bufs[ATBUS_CHANNEL_IOS_PACKET_BATCH_MAX];
+            while (!conn->write_batch.empty() && io_stream_connection::EN_ST_CONNECTED == conn->status) {
+                size_t nmsgs = conn->write_batch.size() < batch_number ? conn->write_batch.size() : batch_number;
+                memset(msgs, 0, sizeof(mmsghdr) * nmsgs);
+                for (size_t i = 0; i < nmsgs; ++i) {
+                    iovs[i].iov_base = conn->write_batch[i].base;
+                    iovs[i].iov_len = conn->write_batch[i].len;
+                    msgs[i].msg_hdr.msg_iov = &iovs[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+
+                int errcode = EN_ATBUS_ERR_SUCCESS;
+                int res = sendmmsg(conn->fd, msgs, static_cast<unsigned int>(nmsgs), MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (res < 0) {
+                    if (EAGAIN == errno || EWOULDBLOCK == errno || ENOBUFS == errno) {
+                        break;
+                    }
+
+                    if (EINTR == errno) {
+                        continue;
+                    }
+
+                    // 第一个数据包发送失败(比如超出了SO_SNDBUF)，通知失败后继续发送后面的数据包
+                    channel->error_code = -errno;
+                    errcode = EN_ATBUS_ERR_WRITE_FAILED;
+                    res = 1;
+                }
+
+                // 回调里可能会继续发送，所以要先移出暂存队列
+                size_t nsent = static_cast<size_t>(res);
+                memcpy(sent_bufs, &conn->write_batch[0], sizeof(adapter::buf_t) * nsent);
+                conn->write_batch.erase(conn->write_batch.begin(), conn->write_batch.begin() + nsent);
+
+                for (size_t i = 0; i < nsent; ++i) {
+                    io_stream_channel_callback(
+                        io_stream_callback_evt_t::EN_FN_WRITEN,
+                        channel,
+                        conn,
+                        EN_ATBUS_ERR_SUCCESS == errcode ? 0 : channel->error_code,
+                        errcode,
+                        sent_bufs[i].base,
+                        sent_bufs[i].len
+                    );
+
+                    conn->write_buffers.pop_front(sent_bufs[i].len, true);
+                }
+            }
+
+            // 只有还有未发送的数据包时才需要监听可写事件
+            if (io_stream_connection::EN_ST_CONNECTED == conn->status) {
+                uv_poll_start(reinterpret_cast<adapter::poll_t*>(conn->handle.get()), 
+                    conn->write_batch.empty() ? UV_READABLE : UV_READABLE | UV_WRITABLE, io_stream_packet_io_cb);
+            }
+        }
+
+        static void io_stream_packet_io_cb(uv_poll_t* handle, int status, int events) {
+            io_stream_connection* conn_raw_ptr = reinterpret_cast<io_stream_connection*>(handle->data);
+            assert(conn_raw_ptr);
+            io_stream_channel* channel = conn_raw_ptr->channel;
+            assert(channel);
+
+            io_stream_flag_guard flag_guard(channel->flags, io_stream_channel::EN_CF_IN_CALLBACK);
+
+            // 如果正处于关闭阶段，忽略所有数据
+            if (io_stream_connection::EN_ST_CONNECTED != conn_raw_ptr->status) {
+                return;
+            }
+
+            if (status < 0) {
+                channel->error_code = status;
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_RECVED, channel, conn_raw_ptr, status, EN_ATBUS_ERR_READ_FAILED, NULL, 0);
+                io_stream_disconnect(channel, conn_raw_ptr, NULL);
+                return;
+            }
+
+            if (events & UV_READABLE) {
+                io_stream_packet_on_read(channel, conn_raw_ptr);
+            }
+
+            if ((events & UV_WRITABLE) && io_stream_connection::EN_ST_CONNECTED == conn_raw_ptr->status) {
+                io_stream_packet_flush(channel, conn_raw_ptr);
+            }
+        }
+
+        static int io_stream_packet_send(io_stream_connection* connection, const void* const bufs[], const size_t lens[], size_t n, size_t len) {
+            // 长度为0的数据包和连接关闭无法区分
+            if (0 == len) {
+                return EN_ATBUS_ERR_INVALID_SIZE;
+            }
+
+            void* data;
+            int res = connection->write_buffers.push_back(data, len);
+            if (res < 0) {
+                return res;
+            }
+
+            char* dst = reinterpret_cast<char*>(data);
+            for (size_t i = 0; i < n; ++i) {
+                memcpy(dst, bufs[i], lens[i]);
+                dst += lens[i];
+            }
+
+            // 等可写事件时一起发送，这样回调不会在io_stream_send内触发
+            connection->write_batch.push_back(uv_buf_init(reinterpret_cast<char*>(data), static_cast<unsigned int>(len)));
+            if (1 == connection->write_batch.size()) {
+                uv_poll_start(reinterpret_cast<adapter::poll_t*>(connection->handle.get()), UV_READABLE | UV_WRITABLE, io_stream_packet_io_cb);
+            }
+
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // unixpkt 收到连接
+        static void io_stream_packet_connection_cb(uv_poll_t* handle, int status, int events) {
+            io_stream_connection* conn_raw_ptr = reinterpret_cast<io_stream_connection*>(handle->data);
+            assert(conn_raw_ptr);
+            io_stream_channel* channel = conn_raw_ptr->channel;
+            assert(channel);
+            io_stream_flag_guard flag_guard(channel->flags, io_stream_channel::EN_CF_IN_CALLBACK);
+
+            // 一次处理完所有排队的连接
+            while (io_stream_connection::EN_ST_CONNECTED == conn_raw_ptr->status) {
+                channel->error_code = status;
+                int res = EN_ATBUS_ERR_SUCCESS;
+
+                std::shared_ptr<io_stream_connection> conn;
+                std::shared_ptr<adapter::stream_t> recv_conn;
+
+                do {
+                    if (0 != status) {
+                        res = EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+                        break;
+                    }
+
+                    adapter::fd_t fd = accept4(conn_raw_ptr->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) {
+                        if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+                            return;
+                        }
+
+                        channel->error_code = -errno;
+                        res = EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+                        break;
+                    }
+
+                    io_stream_packet_handle* pkt_conn = io_stream_make_stream_ptr<io_stream_packet_handle>(recv_conn);
+                    pkt_conn->fd = fd;
+                    uv_poll_init(handle->loop, &pkt_conn->poll, fd);
+
+                    // 正在关闭，新连接直接断开，要在accept后执行，以保证新连接能被正确断开
+                    if (ATBUS_CHANNEL_IOS_CHECK_FLAG(channel->flags, io_stream_channel::EN_CF_CLOSING)) {
+                        res = EN_ATBUS_ERR_CHANNEL_CLOSING;
+                        break;
+                    }
+
+                    conn = io_stream_make_connection(channel, recv_conn);
+                    if (!conn) {
+                        res = EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+                        break;
+                    }
+
+                    // 后面不会再失败了
+                    conn->status = io_stream_connection::EN_ST_CONNECTED;
+                    io_stream_stream_init(channel, conn.get(), recv_conn.get());
+                    uv_poll_start(&pkt_conn->poll, UV_READABLE, io_stream_packet_io_cb);
+
+                    sockaddr_un sock_addr;
+                    socklen_t sock_addr_len = sizeof(sock_addr);
+                    memset(&sock_addr, 0, sizeof(sock_addr));
+                    getpeername(fd, reinterpret_cast<sockaddr*>(&sock_addr), &sock_addr_len);
+                    make_address("unixpkt", sock_addr.sun_path, 0, conn->addr);
+                } while (false);
+
+                // 回调函数，如果发起连接接口调用成功一定要调用回调函数
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_ACCEPTED, channel, conn_raw_ptr, conn.get(), channel->error_code, res, NULL, 0);
+
+                if (!conn && recv_conn) {
+                    // 没什么要做的，直接关闭吧
+                    io_stream_shutdown_ev_handle(recv_conn);
+                }
+
+                // accept失败(比如文件描述符耗尽)时等下一次事件再重试
+                if (!recv_conn) {
+                    return;
+                }
+            }
+        }
+
+        // unixpkt 连接完成的回调，之后的流程和其他连接一样
+        static void io_stream_packet_connected_cb(uv_poll_t* handle, int status, int events) {
+            io_stream_connect_async_data* async_data = reinterpret_cast<io_stream_connect_async_data*>(handle->data);
+            assert(async_data);
+            uv_poll_stop(handle);
+
+            if (0 == status) {
+                int sock_err = 0;
+                socklen_t sock_err_len = sizeof(sock_err);
+                if (0 != getsockopt(reinterpret_cast<io_stream_packet_handle*>(handle)->fd, SOL_SOCKET, SO_ERROR, &sock_err, &sock_err_len)) {
+                    sock_err = errno;
+                }
+                status = -sock_err;
+            }
+
+            async_data->req.handle = reinterpret_cast<adapter::stream_t*>(handle);
+            io_stream_all_connected_cb(&async_data->req, status);
+
+            // 连接成功后开始收发，连接回调里可能已经有数据包要发送了
+            if (!uv_is_closing(reinterpret_cast<adapter::handle_t*>(handle))) {
+                io_stream_connection* conn = reinterpret_cast<io_stream_connection*>(handle->data);
+                uv_poll_start(handle, conn->write_batch.empty() ? UV_READABLE : UV_READABLE | UV_WRITABLE, io_stream_packet_io_cb);
+            }
+        }
+
+        static int io_stream_packet_listen(io_stream_channel* channel, adapter::loop_t* ev_loop, const channel_address_t& addr,
+            io_stream_callback_t callback, void* priv_data, size_t priv_size) {
+            sockaddr_un sock_addr;
+            if (!io_stream_packet_make_sockaddr(addr.host, sock_addr)) {
+                return EN_ATBUS_ERR_PIPE_BIND_FAILED;
+            }
+
+            adapter::fd_t fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                channel->error_code = -errno;
+                return EN_ATBUS_ERR_PIPE_BIND_FAILED;
+            }
+
+            std::shared_ptr<adapter::stream_t> listen_conn;
+            std::shared_ptr<io_stream_connection> conn;
+            io_stream_packet_handle* handle = io_stream_make_stream_ptr<io_stream_packet_handle>(listen_conn);
+            handle->fd = fd;
+            uv_poll_init(ev_loop, &handle->poll, fd);
+
+            int ret = EN_ATBUS_ERR_SUCCESS;
+            do {
+                if (0 != bind(fd, reinterpret_cast<const sockaddr*>(&sock_addr), sizeof(sock_addr))) {
+                    channel->error_code = -errno;
+                    ret = EN_ATBUS_ERR_PIPE_BIND_FAILED;
+                    break;
+                }
+
+                if (0 != listen(fd, channel->conf.backlog)) {
+                    channel->error_code = -errno;
+                    ret = EN_ATBUS_ERR_PIPE_LISTEN_FAILED;
+                    break;
+                }
+
+                conn = io_stream_make_connection(channel, listen_conn);
+                if (!conn) {
+                    ret = EN_ATBUS_ERR_MALLOC;
+                    break;
+                }
+
+                conn->addr = addr;
+                conn->status = io_stream_connection::EN_ST_CONNECTED;
+                ATBUS_CHANNEL_IOS_SET_FLAG(conn->flags, io_stream_connection::EN_CF_LISTEN);
+
+                io_stream_stream_init(channel, conn.get(), listen_conn.get());
+                uv_poll_start(&handle->poll, UV_READABLE, io_stream_packet_connection_cb);
+                io_stream_channel_callback(io_stream_callback_evt_t::EN_FN_CONNECTED, channel, callback, conn.get(), 0, ret, priv_data, priv_size);
+                return ret;
+            } while (false);
+
+            if (conn) {
+                io_stream_shutdown_ev_handle(conn.get());
+            } else if (listen_conn) {
+                io_stream_shutdown_ev_handle(listen_conn);
+            }
+            return ret;
+        }
+
+        static int io_stream_packet_connect(io_stream_channel* channel, adapter::loop_t* ev_loop, const channel_address_t& addr,
+            io_stream_callback_t callback, void* priv_data, size_t priv_size) {
+            sockaddr_un sock_addr;
+            if (!io_stream_packet_make_sockaddr(addr.host, sock_addr)) {
+                return EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+            }
+
+            adapter::fd_t fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) {
+                channel->error_code = -errno;
+                return EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+            }
+
+            // 本地socket的connect不会返回EINPROGRESS，失败时直接返回错误
+            if (0 != connect(fd, reinterpret_cast<const sockaddr*>(&sock_addr), sizeof(sock_addr))) {
+                channel->error_code = -errno;
+                close(fd);
+                return EN_ATBUS_ERR_PIPE_CONNECT_FAILED;
+            }
+
+            std::shared_ptr<adapter::stream_t> pkt_conn;
+            io_stream_packet_handle* handle = io_stream_make_stream_ptr<io_stream_packet_handle>(pkt_conn);
+            handle->fd = fd;
+            uv_poll_init(ev_loop, &handle->poll, fd);
+
+            io_stream_connect_async_data* async_data = new io_stream_connect_async_data();
+            if (NULL == async_data) {
+                io_stream_shutdown_ev_handle(pkt_conn);
+                return EN_ATBUS_ERR_MALLOC;
+            }
+
+            async_data->pipe = true;
+            async_data->addr = addr;
+            async_data->channel = channel;
+            async_data->callback = callback;
+            async_data->req.data = async_data;
+            async_data->stream = pkt_conn;
+            async_data->priv_data = priv_data;
+            async_data->priv_size = priv_size;
+            handle->poll.data = async_data;
+
+            // 和其他连接一样异步回调
+            ATBUS_CHANNEL_REQ_START(channel);
+            uv_poll_start(&handle->poll, UV_WRITABLE, io_stream_packet_connected_cb);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+#endif
+
         int io_stream_listen(io_stream_channel* channel, const channel_address_t& addr, 
             io_stream_callback_t callback, void* priv_data, size_t priv_size) {
             if (NULL == channel) {
@@ -955,10 +1496,18 @@ namespace atbus {
                     return EN_ATBUS_ERR_MALLOC;
                 }
 
-                uv_tcp_init(ev_loop, handle);
+                // SO_REUSEPORT要在bind前设置，所以要提前创建socket
+                if (!channel->conf.is_reuse_port || 0 != uv_tcp_init_ex(ev_loop, handle, '4' == addr.scheme[3]? AF_INET: AF_INET6)) {
+                    uv_tcp_init(ev_loop, handle);
+                }
                 int ret = EN_ATBUS_ERR_SUCCESS;
                 do {
                     io_stream_tcp_setup(channel, handle);
+
+                    if (channel->conf.is_reuse_port && 0 != (channel->error_code = io_stream_tcp_reuse_port(handle))) {
+                        ret = EN_ATBUS_ERR_SOCK_BIND_FAILED;
+                        break;
+                    }
                     
                     if ('4' == addr.scheme[3]) {
                         sockaddr_in sock_addr;
@@ -1007,6 +1556,12 @@ namespace atbus {
                     io_stream_shutdown_ev_handle(listen_conn);
                 }
                 return ret;
+            } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("unixpkt", addr.scheme.c_str(), 7)) {
+#ifdef ATBUS_CHANNEL_IOS_PACKET
+                return io_stream_packet_listen(channel, ev_loop, addr, callback, priv_data, priv_size);
+#else
+                return EN_ATBUS_ERR_SCHEME;
+#endif
             } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("unix", addr.scheme.c_str(), 4)) {
                 std::shared_ptr<adapter::stream_t> listen_conn;
                 std::shared_ptr<io_stream_connection> conn;
@@ -1262,6 +1817,12 @@ namespace atbus {
                 // 回收关闭
                 io_stream_shutdown_ev_handle(async_data);
                 return ret;
+            } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("unixpkt", addr.scheme.c_str(), 7)) {
+#ifdef ATBUS_CHANNEL_IOS_PACKET
+                return io_stream_packet_connect(channel, ev_loop, addr, callback, priv_data, priv_size);
+#else
+                return EN_ATBUS_ERR_SCHEME;
+#endif
             } else if (0 == UTIL_STRFUNC_STRNCASE_CMP("unix", addr.scheme.c_str(), 4)) {
                 std::shared_ptr<adapter::stream_t> pipe_conn;
                 adapter::pipe_t* handle = io_stream_make_stream_ptr<adapter::pipe_t>(pipe_conn);
@@ -1352,22 +1913,49 @@ namespace atbus {
             return io_stream_disconnect(channel, iter->second.get(), callback);
         }
 
-        static void io_stream_on_written_fn(uv_write_t* req, int status) {
-            // 这里之后不会再调用req，req放在缓冲区内，可以正常释放了
-            // 只要uv_write2返回0，这里都会回调。无论是否真的发送成功。所以这里必须释放内存块
+        static void io_stream_on_written_fn(uv_write_t* req, int status);
 
-            io_stream_connection* connection = reinterpret_cast<io_stream_connection*>(req->data);
-            assert(connection);
-            assert(connection->channel);
+        // 合并提交失败时数据流已经不完整了，关闭连接。未提交的数据块留在写缓冲区里，在关闭回调里统一通知失败
+        // 这里不能直接回调，否则io_stream_send内会触发EN_FN_WRITEN
+        static void io_stream_write_batch_failed(io_stream_connection* connection, int status) {
+            connection->write_batch.clear();
+            connection->channel->error_code = status;
 
-            ATBUS_CHANNEL_REQ_END(connection->channel);
-            
-            io_stream_flag_guard flag_guard(connection->channel->flags, io_stream_channel::EN_CF_IN_CALLBACK);
-            
+            if (io_stream_connection::EN_ST_CONNECTED == connection->status) {
+                connection->status = io_stream_connection::EN_ST_DISCONNECTING;
+                io_stream_shutdown_ev_handle(connection);
+            }
+        }
+
+        // 把暂存的数据包合并成一个写请求提交，使用最后一个数据块的uv_write_t作为整个写请求的req
+        static int io_stream_write_batch_flush(io_stream_connection* connection) {
+            if (connection->write_batch.empty()) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            uv_write_t* req = reinterpret_cast<uv_write_t*>(connection->write_batch.back().base - sizeof(uv_write_t));
+            req->data = connection;
+
+            // bufs[]会在libuv内部复制
+            int res = uv_write(req, connection->handle.get(), &connection->write_batch[0], static_cast<unsigned int>(connection->write_batch.size()), io_stream_on_written_fn);
+            if (0 != res) {
+                connection->channel->error_code = res;
+                io_stream_write_batch_failed(connection, res);
+                return EN_ATBUS_ERR_WRITE_FAILED;
+            }
+
+            ++connection->write_inflight;
+            ATBUS_CHANNEL_REQ_START(connection->channel);
+            connection->write_batch.clear();
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+
+        // 弹出写缓冲区中直到req(包含)的所有数据块，写请求按顺序回调，所以req之前的数据块都已经完成了
+        static void io_stream_write_release(io_stream_connection* connection, uv_write_t* req, int status) {
             void* data = NULL;
             size_t nread, nwrite;
 
-            // 弹出丢失的回调
+            // 合并提交的数据块的req->data为NULL，排在零拷贝数据块后面的写请求会延迟到这里一起弹出
             while(true) {
                 connection->write_buffers.front(data, nread, nwrite);
                 if (NULL == data) {
@@ -1379,7 +1967,6 @@ namespace atbus {
                 }
 
                 assert(0 == nread);
-                assert(req == data);
 
                 // nwrite = uv_write_t的大小+crc32+vint的大小+数据区长度
                 char* buff_start = reinterpret_cast<char*>(data);
@@ -1394,7 +1981,7 @@ namespace atbus {
                     connection->channel,
                     connection,
                     status,
-                    req == data? EN_ATBUS_ERR_SUCCESS: EN_ATBUS_ERR_NODE_TIMEOUT,
+                    EN_ATBUS_ERR_SUCCESS,
                     buff_start + vint_len,
                     out
                 );
@@ -1407,18 +1994,191 @@ namespace atbus {
                     break;
                 }
             }
+        }
+
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+        // 内核通知和剩余数据的写请求都完成后，释放零拷贝数据块和排在它后面已经回调的数据块
+        static void io_stream_zero_copy_release(io_stream_connection* connection) {
+            io_stream_connection::zero_copy_t& zc = connection->zero_copy;
+            if (NULL == zc.block || zc.wait_notify || zc.wait_write) {
+                return;
+            }
+
+            uv_write_t* req = reinterpret_cast<uv_write_t*>(NULL == zc.done_req ? zc.block : zc.done_req);
+            zc.block = NULL;
+            zc.done_req = NULL;
+
+            assert(connection->write_inflight > 0);
+            --connection->write_inflight;
+            ATBUS_CHANNEL_REQ_END(connection->channel);
+
+            io_stream_write_release(connection, req, 0);
+            io_stream_write_batch_flush(connection);
+        }
+
+        // 从错误队列中读取零拷贝发送完成的通知，通知中[ee_info, ee_data]是已完成的发送序号区间
+        static void io_stream_zero_copy_drain(io_stream_connection* connection) {
+            io_stream_connection::zero_copy_t& zc = connection->zero_copy;
+            char control[128];
+
+            while (true) {
+                msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_control = control;
+                msg.msg_controllen = sizeof(control);
+
+                if (recvmsg(connection->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                    break;
+                }
+
+                for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); NULL != cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                    if (!(SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type) &&
+                        !(SOL_IPV6 == cm->cmsg_level && IPV6_RECVERR == cm->cmsg_type)) {
+                        continue;
+                    }
+
+                    const sock_extended_err* serr = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+                    if (0 != serr->ee_errno || SO_EE_ORIGIN_ZEROCOPY != serr->ee_origin) {
+                        continue;
+                    }
+
+                    if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                        ++zc.copied_times;
+                    }
+
+                    // 序号是32位循环计数的
+                    if (NULL != zc.block && zc.wait_notify && zc.send_id - serr->ee_info <= serr->ee_data - serr->ee_info) {
+                        zc.wait_notify = false;
+                    }
+                }
+            }
+
+            io_stream_zero_copy_release(connection);
+        }
+
+        /**
+         * @brief 使用MSG_ZEROCOPY发送数据块，内核直接引用数据块的内存直到通知发送完成
+         * @return 0或错误码，内核不接受时返回1，这时候走普通的发送流程
+         */
+        static int io_stream_zero_copy_send(io_stream_connection* connection, uv_write_t* req, adapter::buf_t& buf) {
+            iovec iov;
+            iov.iov_base = buf.base;
+            iov.iov_len = buf.len;
+
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+
+            // 发送缓冲区满或者锁定内存超出限制(ENOBUFS)时都走普通的发送流程
+            ssize_t sent_len = sendmsg(connection->fd, &msg, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent_len <= 0) {
+                return 1;
+            }
+
+            io_stream_connection::zero_copy_t& zc = connection->zero_copy;
+            zc.block = req;
+            zc.done_req = NULL;
+            zc.send_id = zc.next_id++;
+            zc.wait_notify = true;
+            zc.wait_write = false;
+            ++zc.send_times;
+            ++connection->write_inflight;
+            ATBUS_CHANNEL_REQ_START(connection->channel);
+
+            if (static_cast<size_t>(sent_len) >= buf.len) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 只发送了一部分，剩余的数据交给libuv。这时候libuv的发送队列一定是空的，所以不会乱序
+            adapter::buf_t left = uv_buf_init(buf.base + sent_len, static_cast<unsigned int>(buf.len - static_cast<size_t>(sent_len)));
+            int res = uv_write(req, connection->handle.get(), &left, 1, io_stream_on_written_fn);
+            if (0 != res) {
+                // 已经有部分数据写出了，这个连接的数据流已经不完整，关闭连接
+                // 数据块是写缓冲区里唯一的数据块，直接移除并返回错误，关闭时就不会再通知一次
+                connection->channel->error_code = res;
+                zc.block = NULL;
+                zc.wait_notify = false;
+                --connection->write_inflight;
+                ATBUS_CHANNEL_REQ_END(connection->channel);
+                connection->write_buffers.pop_back(sizeof(uv_write_t) + buf.len, true);
+
+                if (io_stream_connection::EN_ST_CONNECTED == connection->status) {
+                    connection->status = io_stream_connection::EN_ST_DISCONNECTING;
+                    io_stream_shutdown_ev_handle(connection);
+                }
+                return EN_ATBUS_ERR_WRITE_FAILED;
+            }
+
+            zc.wait_write = true;
+            ++connection->write_inflight;
+            ATBUS_CHANNEL_REQ_START(connection->channel);
+            return EN_ATBUS_ERR_SUCCESS;
+        }
+#endif
+
+        static void io_stream_on_written_fn(uv_write_t* req, int status) {
+            // 这里之后不会再调用req，req放在缓冲区内，可以正常释放了
+            // 只要uv_write2返回0，这里都会回调。无论是否真的发送成功。所以这里必须释放内存块
+
+            io_stream_connection* connection = reinterpret_cast<io_stream_connection*>(req->data);
+            assert(connection);
+            assert(connection->channel);
+
+            ATBUS_CHANNEL_REQ_END(connection->channel);
+            assert(connection->write_inflight > 0);
+            --connection->write_inflight;
+            
+            io_stream_flag_guard flag_guard(connection->channel->flags, io_stream_channel::EN_CF_IN_CALLBACK);
+
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+            // 零拷贝数据块在写缓冲区队首，要等内核通知之后才能弹出
+            if (NULL != connection->zero_copy.block) {
+                if (req == connection->zero_copy.block) {
+                    connection->zero_copy.wait_write = false;
+                    io_stream_zero_copy_release(connection);
+                } else {
+                    connection->zero_copy.done_req = req;
+                }
+
+                io_stream_write_batch_flush(connection);
+                return;
+            }
+#endif
+
+            io_stream_write_release(connection, req, status);
+
             // libuv内部维护了一个发送队列，所以不需要再启动发送流程
+            // 但是暂存的数据包要在这里合并提交
+            io_stream_write_batch_flush(connection);
         }
 
         int io_stream_send(io_stream_connection* connection, const void* buf, size_t len) {
+            const void* bufs[1] = { buf };
+            size_t lens[1] = { len };
+            return io_stream_send_v(connection, bufs, lens, 1);
+        }
+
+        int io_stream_send_v(io_stream_connection* connection, const void* const bufs[], const size_t lens[], size_t n) {
             if (NULL == connection) {
                 return EN_ATBUS_ERR_PARAMS;
             }
 
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i) {
+                len += lens[i];
+            }
+
             if (connection->channel->conf.send_buffer_limit_size > 0 && len > connection->channel->conf.send_buffer_limit_size) {
                 return EN_ATBUS_ERR_INVALID_SIZE;
             }
 
+#ifdef ATBUS_CHANNEL_IOS_PACKET
+            if (ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_PACKET)) {
+                return io_stream_packet_send(connection, bufs, lens, n, len);
+            }
+#endif
+
             char vint[16];
             size_t vint_len = detail::fn::write_vint(len, vint, sizeof(vint));
             // 计算需要的内存块大小（uv_write_t的大小+crc32+vint的大小+len）
@@ -1439,23 +2199,62 @@ namespace atbus {
             // req
             buff_start += sizeof(uv_write_t);
 
+            // buffer，各数据块依次复制，同时计算crc32
+            uint32_t crc32 = 0;
+            {
+                char* dst = buff_start + sizeof(uint32_t) + vint_len;
+                for (size_t i = 0; i < n; ++i) {
+                    crc32 = atbus::detail::crc32(crc32, reinterpret_cast<const unsigned char*>(bufs[i]), lens[i]);
+                    memcpy(dst, bufs[i], lens[i]);
+                    dst += lens[i];
+                }
+            }
+
             // crc32
-            uint32_t crc32 = atbus::detail::crc32(0, reinterpret_cast<const unsigned char*>(buf), len);
             memcpy(buff_start, &crc32, sizeof(uint32_t));
 
             // vint
             memcpy(buff_start + sizeof(uint32_t), vint, vint_len);
-            // buffer
-            memcpy(buff_start + sizeof(uint32_t) + vint_len, buf, len);
 
-            // 调用写出函数，bufs[]会在libuv内部复制
-            uv_buf_t bufs[1] = { uv_buf_init(buff_start, static_cast<unsigned int>(total_buffer_size - sizeof(uv_write_t))) };
-            res = uv_write(req, connection->handle.get(), bufs, 1, io_stream_on_written_fn);
+            adapter::buf_t write_bufs[1] = { uv_buf_init(buff_start, static_cast<unsigned int>(total_buffer_size - sizeof(uv_write_t))) };
+
+#ifdef ATBUS_CHANNEL_IOS_ZERO_COPY
+            // 大数据包使用零拷贝发送，为了保证数据块按顺序释放，只有写缓冲区里只有这一个数据块时才使用
+            if (connection->channel->conf.send_zero_copy_threshold > 0 && len >= connection->channel->conf.send_zero_copy_threshold &&
+                ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, io_stream_connection::EN_CF_ZERO_COPY) &&
+                0 == connection->write_inflight && connection->write_batch.empty() && 1 == connection->write_buffers.limit().cost_number_) {
+                res = io_stream_zero_copy_send(connection, req, write_bufs[0]);
+                if (res <= 0) {
+                    return res;
+                }
+            }
+#endif
+
+            // 有未完成的写请求时先暂存，等写请求回调或暂存数量达到上限时合并提交
+            // 暂存队列非空时也必须排队，否则会打乱数据包顺序
+            if (connection->channel->conf.send_batch_number > 1 && (connection->write_inflight > 0 || !connection->write_batch.empty())) {
+                req->data = NULL;
+                connection->write_batch.push_back(write_bufs[0]);
+
+                // 提交失败时当前数据包直接返回错误，之前暂存的数据包在连接关闭时通过EN_FN_WRITEN通知
+                if (connection->write_batch.size() >= connection->channel->conf.send_batch_number) {
+                    res = io_stream_write_batch_flush(connection);
+                    if (res < 0) {
+                        connection->write_buffers.pop_back(total_buffer_size, true);
+                        return res;
+                    }
+                }
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            // 调用写出函数，write_bufs[]会在libuv内部复制
+            res = uv_write(req, connection->handle.get(), write_bufs, 1, io_stream_on_written_fn);
             if (0 != res) {
                 connection->channel->error_code = res;
                 connection->write_buffers.pop_back(total_buffer_size, true);
                 return EN_ATBUS_ERR_WRITE_FAILED;
             }
+            ++connection->write_inflight;
             ATBUS_CHANNEL_REQ_START(connection->channel);
 
             // libuv调用失败时，直接返回底层错误。因为libuv内部也维护了一个发送队列，所以不会受到TCP发送窗口的限制
@@ -1474,6 +2273,7 @@ namespace atbus {
             out << "configure:" << std::endl <<
                 "is_noblock: " << channel->conf.is_noblock << std::endl <<
                 "is_nodelay: " << channel->conf.is_nodelay << std::endl <<
+                "is_reuse_port: " << channel->conf.is_reuse_port << std::endl <<
                 "backlog: " << channel->conf.backlog << std::endl <<
                 "keepalive: " << channel->conf.keepalive << std::endl <<
                 "recv_buffer_limit_size(Bytes): " << channel->conf.recv_buffer_limit_size << std::endl <<
@@ -1482,6 +2282,9 @@ namespace atbus {
                 "send_buffer_limit_size(Bytes): " << channel->conf.send_buffer_limit_size << std::endl <<
                 "send_buffer_max_size(Bytes): " << channel->conf.send_buffer_max_size << std::endl <<
                 "send_buffer_static_max_number: " << channel->conf.send_buffer_static << std::endl <<
+                "send_batch_number: " << channel->conf.send_batch_number << std::endl <<
+                "send_zero_copy_threshold(Bytes): " << channel->conf.send_zero_copy_threshold << std::endl <<
+                "recv_batch_number: " << channel->conf.recv_batch_number << std::endl <<
                 std::endl;
 
             out << "all connections:" << std::endl;
@@ -1493,6 +2296,10 @@ namespace atbus {
                 out << "\t\twrite_buffers.cost_size: " << iter->second->write_buffers.limit().cost_size_ << std::endl;
                 out << "\t\twrite_buffers.limit_number: " << iter->second->write_buffers.limit().limit_number_ << std::endl;
                 out << "\t\twrite_buffers.limit_size: " << iter->second->write_buffers.limit().limit_size_ << std::endl;
+                out << "\t\twrite_inflight: " << iter->second->write_inflight << std::endl;
+                out << "\t\twrite_batch.size: " << iter->second->write_batch.size() << std::endl;
+                out << "\t\tzero_copy.send_times: " << iter->second->zero_copy.send_times << std::endl;
+                out << "\t\tzero_copy.copied_times: " << iter->second->zero_copy.copied_times << std::endl;
 
                 out << "\t\tread_buffers.cost_number: " << iter->second->read_buffers.limit().cost_number_ << std::endl;
                 out << "\t\tread_buffers.cost_size: " << iter->second->read_buffers.limit().cost_size_ << std::endl;
@@ -318,6 +318,11 @@ namespace atbus {
             return static_cast<data_align_type>(detail::crc_factor<sizeof(data_align_type) >= sizeof(uint64_t)>::crc(0, src, len));
         }
 
+        // 分段计算校验值，结果和整块计算相同
+        static data_align_type mem_fast_check(data_align_type prev, const void* src, size_t len) {
+            return static_cast<data_align_type>(detail::crc_factor<sizeof(data_align_type) >= sizeof(uint64_t)>::crc(prev, src, len));
+        }
+
         // 对齐单位的大小必须是2的N次方
         static_assert(0 == (sizeof(data_align_type) & (sizeof(data_align_type) - 1)), "data align size must be 2^N");
         // 节点大小必须是2的N次
@@ -388,7 +393,7 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        static int mem_send_real(mem_channel* channel, const void* buf, size_t len) {
+        static int mem_send_real(mem_channel* channel, const void* const bufs[], const size_t lens[], size_t n) {
             // 用于调试的节点编号信息
             detail::last_action_channel_begin_node_index = std::numeric_limits<size_t>::max();
             detail::last_action_channel_end_node_index = std::numeric_limits<size_t>::max();
@@ -396,6 +401,11 @@ namespace atbus {
             if (NULL == channel)
                 return EN_ATBUS_ERR_PARAMS;
 
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i) {
+                len += lens[i];
+            }
+
             if (0 == len)
                 return EN_ATBUS_ERR_SUCCESS;
 
@@ -469,18 +479,36 @@ namespace atbus {
 
             // 数据写入
             // fast_memcpy
-            // 数据有回绕
-            if (new_write_cur && new_write_cur < write_cur) {
-                size_t copy_len = len > buffer_len? buffer_len: len;
-                memcpy(buffer_start, buf, copy_len);
-
-                // 回绕nodes
-                mem_get_node_head(channel, 0, &buffer_start, NULL);
-                memcpy(buffer_start, (const char*)buf + copy_len, len - copy_len);
-            } else {
-                memcpy(buffer_start, buf, len);
+            // 数据有回绕时，超出buffer_len的部分写到回绕nodes
+            {
+                bool is_wrap = new_write_cur && new_write_cur < write_cur;
+                char* dst = reinterpret_cast<char*>(buffer_start);
+                size_t dst_left = is_wrap ? buffer_len : len;
+                data_align_type fast_check = 0;
+
+                for (size_t i = 0; i < n; ++i) {
+                    const char* src = reinterpret_cast<const char*>(bufs[i]);
+                    size_t src_left = lens[i];
+                    fast_check = mem_fast_check(fast_check, src, src_left);
+
+                    while (src_left > 0) {
+                        if (0 == dst_left) {
+                            // 回绕nodes
+                            mem_get_node_head(channel, 0, &buffer_start, NULL);
+                            dst = reinterpret_cast<char*>(buffer_start);
+                            dst_left = len;
+                        }
+
+                        size_t copy_len = src_left > dst_left ? dst_left : src_left;
+                        memcpy(dst, src, copy_len);
+                        dst += copy_len;
+                        src += copy_len;
+                        dst_left -= copy_len;
+                        src_left -= copy_len;
+                    }
+                }
+                block_head->fast_check = fast_check;
             }
-            block_head->fast_check = mem_fast_check(buf, len);
 
             // 设置首node header，数据写完标记
             {
@@ -496,14 +524,14 @@ namespace atbus {
             return EN_ATBUS_ERR_SUCCESS;
         }
 
-        int mem_send(mem_channel* channel, const void* buf, size_t len) {
+        int mem_send_v(mem_channel* channel, const void* const bufs[], const size_t lens[], size_t n) {
             if (NULL == channel)
                 return EN_ATBUS_ERR_PARAMS;
 
             int ret = 0;
             size_t left_try_times = channel->conf.write_retry_times;
             while (left_try_times -- > 0) {
-                int ret = mem_send_real(channel, buf, len);
+                int ret = mem_send_real(channel, bufs, lens, n);
 
                 // 原子操作序列冲突，重试
                 if (EN_ATBUS_ERR_NODE_BAD_BLOCK_CSEQ_ID == ret || EN_ATBUS_ERR_NODE_BAD_BLOCK_WSEQ_ID == ret)
@@ -515,6 +543,12 @@ namespace atbus {
             return ret;
         }
 
+        int mem_send(mem_channel* channel, const void* buf, size_t len) {
+            const void* bufs[1] = { buf };
+            size_t lens[1] = { len };
+            return mem_send_v(channel, bufs, lens, 1);
+        }
+
         int mem_recv(mem_channel* channel, void* buf, size_t len, size_t* recv_size) {
             // 用于调试的节点编号信息
             detail::last_action_channel_begin_node_index = std::numeric_limits<size_t>::max();
@@ -35,6 +35,8 @@
 
 #else 
 #include <unistd.h>
+#include <signal.h>
+#include <errno.h>
 #endif
 
 #ifdef ATBUS_CHANNEL_SHM
@@ -63,12 +65,14 @@ namespace atbus {
             HANDLE handle;
             LPCTSTR buffer;
             size_t size;
+            size_t ref_count;
         } shm_mapped_record_type;
         #else
         typedef struct {
             int shm_id;
             void* buffer;
             size_t size;
+            size_t ref_count;
         } shm_mapped_record_type;
         #endif
 
@@ -79,6 +83,12 @@ namespace atbus {
             if (shm_mapped_records.end() == iter)
                 return EN_ATBUS_ERR_SHM_NOT_FOUND;
 
+            // 同一个进程里的监听和连接(比如两个节点之间的自动共享内存通道)共用一份映射，最后一个关闭时才解除
+            if (iter->second.ref_count > 1) {
+                -- iter->second.ref_count;
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
             shm_mapped_record_type record = iter->second;
             shm_mapped_records.erase(iter);
 
@@ -101,6 +111,7 @@ namespace atbus {
             {
                 std::map<key_t, shm_mapped_record_type>::iterator iter = shm_mapped_records.find(shm_key);
                 if (shm_mapped_records.end() != iter) {
+                    ++ iter->second.ref_count;
                     if (data)
                         *data = (void*)iter->second.buffer;
                     if (real_size)
@@ -145,6 +156,7 @@ namespace atbus {
                     *real_size = len;
 
                 shm_record.size = len;
+                shm_record.ref_count = 1;
                 shm_mapped_records[shm_key] = shm_record;
                 return EN_ATBUS_ERR_SUCCESS;
             }
@@ -175,6 +187,7 @@ namespace atbus {
                 return EN_ATBUS_ERR_SHM_GET_FAILED;
 
             shm_record.size = len;
+            shm_record.ref_count = 1;
             shm_mapped_records[shm_key] = shm_record;
 
             if (data)
@@ -220,6 +233,7 @@ namespace atbus {
 
             // 获取地址
             shm_record.buffer = shmat(shm_record.shm_id, NULL, 0);
+            shm_record.ref_count = 1;
             shm_mapped_records[shm_key] = shm_record;
 
             if(data)
@@ -283,12 +297,42 @@ namespace atbus {
             return shm_close_buffer(shm_key);
         }
 
+        int shm_check_owner(key_t shm_key) {
+        #ifdef WIN32
+            // Windows的命名共享内存没有创建者信息
+            return EN_ATBUS_ERR_SUCCESS;
+        #else
+            int shm_id = shmget(shm_key, 0, 0);
+            if (-1 == shm_id) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            struct shmid_ds shm_info;
+            if (shmctl(shm_id, IPC_STAT, &shm_info)) {
+                return EN_ATBUS_ERR_SHM_GET_FAILED;
+            }
+
+            // 本进程或者已经退出的进程(比如重启前的自己)创建的可以复用
+            if (shm_info.shm_cpid == getpid() || (0 != kill(shm_info.shm_cpid, 0) && ESRCH == errno)) {
+                return EN_ATBUS_ERR_SUCCESS;
+            }
+
+            return EN_ATBUS_ERR_SHM_IN_USE;
+        #endif
+        }
+
         int shm_send(shm_channel* channel, const void* buf, size_t len) {
             shm_channel_switcher switcher;
             switcher.shm = channel;
             return mem_send(switcher.mem, buf, len);
         }
 
+        int shm_send_v(shm_channel* channel, const void* const bufs[], const size_t lens[], size_t n) {
+            shm_channel_switcher switcher;
+            switcher.shm = channel;
+            return mem_send_v(switcher.mem, bufs, lens, n);
+        }
+
         int shm_recv(shm_channel* channel, void* buf, size_t len, size_t* recv_size) {
             shm_channel_switcher switcher;
             switcher.shm = channel;
@@ -0,0 +1,253 @@
+﻿#include <cstring>
+
+#include "detail/libatbus_compression.h"
+
+namespace atbus {
+    namespace compression {
+        /**
+         * 数据由多个序列组成，每个序列是:
+         *   | token(1) | [字面量长度扩展] | 字面量 | 匹配偏移(2, 小端) | [匹配长度扩展] |
+         * token高4位是字面量长度，低4位是匹配长度-LZ_MIN_MATCH，为15时后面跟扩展字节，每个扩展字节累加，直到不是255
+         * 最后一个序列只有字面量，没有匹配部分
+         */
+        namespace detail {
+            enum lz_setting_t {
+                LZ_MIN_MATCH = 4,
+                LZ_LAST_LITERALS = 5,                                   // 末尾至少保留的字面量，解压时不需要处理越界
+                LZ_MF_LIMIT = LZ_LAST_LITERALS + 8,                     // 距离结尾小于这个长度时不再查找匹配
+                LZ_HASH_LOG = 12,
+                LZ_MAX_OFFSET = 65535,
+                LZ_RUN_MASK = 15,
+                LZ_SKIP_TRIGGER = 6,                                    // 连续查找不到匹配时逐步加大步长，不可压缩的数据可以快速跳过
+            };
+
+            static inline uint32_t lz_read32(const unsigned char* p) {
+                uint32_t ret;
+                memcpy(&ret, p, sizeof(ret));
+                return ret;
+            }
+
+            static inline uint32_t lz_hash(uint32_t v) {
+                return (v * 2654435761U) >> (32 - LZ_HASH_LOG);
+            }
+
+            static inline unsigned char* lz_write_length(unsigned char* op, const unsigned char* oend, size_t len) {
+                while (len >= 255) {
+                    if (op >= oend) {
+                        return NULL;
+                    }
+                    *op++ = 255;
+                    len -= 255;
+                }
+
+                if (op >= oend) {
+                    return NULL;
+                }
+                *op++ = static_cast<unsigned char>(len);
+                return op;
+            }
+
+            static inline bool lz_read_length(const unsigned char*& ip, const unsigned char* iend, size_t& len) {
+                unsigned char c;
+                do {
+                    if (ip >= iend) {
+                        return false;
+                    }
+                    c = *ip++;
+                    len += c;
+                } while (255 == c);
+
+                return true;
+            }
+
+            /**
+             * @brief 写入一个序列，match_len为0表示最后一个只有字面量的序列
+             */
+            static unsigned char* lz_write_sequence(unsigned char* op, const unsigned char* oend,
+                const unsigned char* literal, size_t literal_len, size_t offset, size_t match_len) {
+                if (op >= oend) {
+                    return NULL;
+                }
+
+                unsigned char* token = op++;
+                unsigned char t = 0;
+                if (literal_len >= LZ_RUN_MASK) {
+                    t = static_cast<unsigned char>(LZ_RUN_MASK << 4);
+                    op = lz_write_length(op, oend, literal_len - LZ_RUN_MASK);
+                    if (NULL == op) {
+                        return NULL;
+                    }
+                } else {
+                    t = static_cast<unsigned char>(literal_len << 4);
+                }
+
+                if (static_cast<size_t>(oend - op) < literal_len) {
+                    return NULL;
+                }
+                memcpy(op, literal, literal_len);
+                op += literal_len;
+
+                if (0 != match_len) {
+                    if (oend - op < 2) {
+                        return NULL;
+                    }
+                    *op++ = static_cast<unsigned char>(offset & 0xFF);
+                    *op++ = static_cast<unsigned char>((offset >> 8) & 0xFF);
+
+                    match_len -= LZ_MIN_MATCH;
+                    if (match_len >= LZ_RUN_MASK) {
+                        t |= LZ_RUN_MASK;
+                        op = lz_write_length(op, oend, match_len - LZ_RUN_MASK);
+                        if (NULL == op) {
+                            return NULL;
+                        }
+                    } else {
+                        t |= static_cast<unsigned char>(match_len);
+                    }
+                }
+
+                *token = t;
+                return op;
+            }
+        }
+
+        size_t lz_compress(const void* in, size_t in_len, void* out, size_t out_len) {
+            if (NULL == in || NULL == out || 0 == in_len) {
+                return 0;
+            }
+
+            const unsigned char* ibegin = reinterpret_cast<const unsigned char*>(in);
+            const unsigned char* iend = ibegin + in_len;
+            const unsigned char* ip = ibegin;
+            const unsigned char* anchor = ibegin;
+            unsigned char* obegin = reinterpret_cast<unsigned char*>(out);
+            unsigned char* op = obegin;
+            const unsigned char* oend = obegin + out_len;
+
+            if (in_len > static_cast<size_t>(detail::LZ_MF_LIMIT)) {
+                // 只记录相对位置，4096项放在栈上
+                uint32_t hash_table[1 << detail::LZ_HASH_LOG];
+                memset(hash_table, 0, sizeof(hash_table));
+
+                const unsigned char* mflimit = iend - detail::LZ_MF_LIMIT;
+                const unsigned char* matchlimit = iend - detail::LZ_LAST_LITERALS;
+                size_t search_times = 1 << detail::LZ_SKIP_TRIGGER;
+
+                ++ip;
+                while (ip <= mflimit) {
+                    uint32_t seq = detail::lz_read32(ip);
+                    uint32_t h = detail::lz_hash(seq);
+                    const unsigned char* ref = ibegin + hash_table[h];
+                    hash_table[h] = static_cast<uint32_t>(ip - ibegin);
+
+                    if (ref >= ip || ip - ref > detail::LZ_MAX_OFFSET || detail::lz_read32(ref) != seq) {
+                        ip += search_times++ >> detail::LZ_SKIP_TRIGGER;
+                        continue;
+                    }
+                    search_times = 1 << detail::LZ_SKIP_TRIGGER;
+
+                    // 向前扩展
+                    while (ip > anchor && ref > ibegin && ip[-1] == ref[-1]) {
+                        --ip;
+                        --ref;
+                    }
+
+                    const unsigned char* mp = ip + detail::LZ_MIN_MATCH;
+                    const unsigned char* rp = ref + detail::LZ_MIN_MATCH;
+                    while (mp < matchlimit && *mp == *rp) {
+                        ++mp;
+                        ++rp;
+                    }
+
+                    op = detail::lz_write_sequence(op, oend, anchor, static_cast<size_t>(ip - anchor),
+                        static_cast<size_t>(ip - ref), static_cast<size_t>(mp - ip));
+                    if (NULL == op) {
+                        return 0;
+                    }
+
+                    ip = mp;
+                    anchor = ip;
+                    if (ip - 2 > ibegin && ip - 2 <= mflimit) {
+                        hash_table[detail::lz_hash(detail::lz_read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - ibegin);
+                    }
+                }
+            }
+
+            op = detail::lz_write_sequence(op, oend, anchor, static_cast<size_t>(iend - anchor), 0, 0);
+            if (NULL == op) {
+                return 0;
+            }
+
+            return static_cast<size_t>(op - obegin);
+        }
+
+        bool lz_decompress(const void* in, size_t in_len, void* out, size_t out_len) {
+            if (NULL == in || NULL == out) {
+                return false;
+            }
+
+            const unsigned char* ip = reinterpret_cast<const unsigned char*>(in);
+            const unsigned char* iend = ip + in_len;
+            unsigned char* obegin = reinterpret_cast<unsigned char*>(out);
+            unsigned char* op = obegin;
+            unsigned char* oend = obegin + out_len;
+
+            while (ip < iend) {
+                unsigned char token = *ip++;
+
+                size_t literal_len = token >> 4;
+                if (detail::LZ_RUN_MASK == literal_len && false == detail::lz_read_length(ip, iend, literal_len)) {
+                    return false;
+                }
+
+                if (static_cast<size_t>(iend - ip) < literal_len || static_cast<size_t>(oend - op) < literal_len) {
+                    return false;
+                }
+                memcpy(op, ip, literal_len);
+                ip += literal_len;
+                op += literal_len;
+
+                // 最后一个序列
+                if (ip == iend) {
+                    break;
+                }
+
+                if (iend - ip < 2) {
+                    return false;
+                }
+                size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+                ip += 2;
+                if (0 == offset || offset > static_cast<size_t>(op - obegin)) {
+                    return false;
+                }
+
+                size_t match_len = token & detail::LZ_RUN_MASK;
+                if (detail::LZ_RUN_MASK == match_len && false == detail::lz_read_length(ip, iend, match_len)) {
+                    return false;
+                }
+                match_len += detail::LZ_MIN_MATCH;
+                if (static_cast<size_t>(oend - op) < match_len) {
+                    return false;
+                }
+
+                const unsigned char* ref = op - offset;
+                if (offset >= match_len) {
+                    memcpy(op, ref, match_len);
+                    op += match_len;
+                } else {
+                    // 重叠的匹配只能逐字节复制
+                    for (size_t i = 0; i < match_len; ++i) {
+                        *op++ = *ref++;
+                    }
+                }
+            }
+
+            return op == oend;
+        }
+
+        const codec_t* lz_codec() {
+            static codec_t ret = { algorithm_t::LZ, "lz", lz_compress, lz_decompress };
+            return &ret;
+        }
+    }
+}
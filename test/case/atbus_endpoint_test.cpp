@@ -26,6 +26,46 @@ CASE_TEST(atbus_endpoint, get_children_min_max)
     CASE_EXPECT_EQ(tested, 0x12340000);
 }
 
+CASE_TEST(atbus_endpoint, endpoint_index)
+{
+    typedef atbus::detail::endpoint_index<atbus::endpoint::bus_id_t, std::shared_ptr<int> > index_t;
+    index_t idx;
+    std::shared_ptr<int> v1 = std::make_shared<int>(1);
+    std::shared_ptr<int> v2 = std::make_shared<int>(2);
+    std::shared_ptr<int> v3 = std::make_shared<int>(3);
+
+    CASE_EXPECT_EQ(NULL, idx.find(0x12345678));
+    CASE_EXPECT_TRUE(idx.insert(0x12345600, 0x123456FF, v2));
+    CASE_EXPECT_TRUE(idx.insert(0x12345700, 0x123457FF, v3));
+    CASE_EXPECT_TRUE(idx.insert(0x12345500, 0x123455FF, v1));
+    CASE_EXPECT_EQ(3, idx.size());
+
+    // 区间交叉
+    CASE_EXPECT_FALSE(idx.insert(0x12345600, 0x123456FF, v1));
+    CASE_EXPECT_FALSE(idx.insert(0x12345678, 0x12345678, v1));
+    CASE_EXPECT_FALSE(idx.insert(0x12340000, 0x1234FFFF, v1));
+    CASE_EXPECT_EQ(3, idx.size());
+
+    CASE_EXPECT_EQ(v1.get(), idx.find(0x12345500));
+    CASE_EXPECT_EQ(v2.get(), idx.find(0x12345678));
+    CASE_EXPECT_EQ(v3.get(), idx.find(0x123457FF));
+    CASE_EXPECT_EQ(NULL, idx.find(0x123454FF));
+    CASE_EXPECT_EQ(NULL, idx.find(0x12345800));
+
+    // 按上界有序
+    int expect = 1;
+    for (index_t::const_iterator iter = idx.begin(); iter != idx.end(); ++iter) {
+        CASE_EXPECT_EQ(expect++, **iter);
+    }
+
+    idx.erase(idx.lower_bound(0x12345678));
+    CASE_EXPECT_EQ(2, idx.size());
+    CASE_EXPECT_EQ(NULL, idx.find(0x12345678));
+    CASE_EXPECT_EQ(v3.get(), idx.find(0x12345700));
+    CASE_EXPECT_EQ(2, v1.use_count());
+    CASE_EXPECT_EQ(1, v2.use_count());
+}
+
 CASE_TEST(atbus_endpoint, is_child)
 {
     atbus::node::conf_t conf;
@@ -3,6 +3,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
+#include <map>
+#include <set>
+#include <list>
 
 #include "common/string_oprs.h"
 
@@ -15,13 +18,24 @@
 #endif
 
 #include <atbus_node.h>
+#include <atbus_msg_handler.h>
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
+#include "detail/libatbus_message_traits.h"
 
 #include "frame/test_macros.h"
 
 #include <stdarg.h>
 
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
 static void node_msg_test_on_debug(const char* file_path, size_t line, 
     const atbus::node& n, const atbus::endpoint* ep, const atbus::connection* conn, 
     const atbus::protocol::msg* m,
@@ -89,8 +103,8 @@ static int node_msg_test_send_data_failed_fn(const atbus::node& n, const atbus::
     recv_msg_history.status = NULL == m? 0: m->head.ret;
     ++recv_msg_history.count;
 
-    if (NULL != m && NULL != m->body.forward && NULL != m->body.forward->content.ptr && m->body.forward->content.size > 0) {
-        recv_msg_history.data.assign(reinterpret_cast<const char*>(m->body.forward->content.ptr), m->body.forward->content.size);
+    if (NULL != m && NULL != m->body.forward() && NULL != m->body.forward()->content.ptr && m->body.forward()->content.size > 0) {
+        recv_msg_history.data.assign(reinterpret_cast<const char*>(m->body.forward()->content.ptr), m->body.forward()->content.size);
     } else {
         recv_msg_history.data.clear();
     }
@@ -173,6 +187,12 @@ CASE_TEST(atbus_node_reg, ping_pong)
             }
             
             if (ep1->get_stat_last_pong() > 0 && ep2->get_stat_last_pong() > 0) {
+                // 本机的往返延迟不会超过1秒
+                CASE_EXPECT_LT(0, ep1->get_stat_rtt());
+                CASE_EXPECT_LT(0, ep2->get_stat_rtt());
+                CASE_EXPECT_GT(1000000000, ep1->get_stat_rtt());
+                CASE_EXPECT_GT(1000000000, ep2->get_stat_rtt());
+                CASE_EXPECT_GT(1000, ep1->get_stat_ping_delay());
                 break;
             }
         }
@@ -182,6 +202,194 @@ CASE_TEST(atbus_node_reg, ping_pong)
     node_msg_test_setup_exit(&ev_loop);
 }
 
+// 链路上有其他消息时跳过ping
+CASE_TEST(atbus_node_reg, ping_skip)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+        }
+
+        // 每半个ping间隔互相发一次数据，不会发送ping
+        std::string send_data = "keep alive by data\n";
+        for (int i = 0; i < 6; ++i) {
+            int count = recv_msg_history.count;
+            node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size());
+            node2->send_data(node1->get_id(), 0, send_data.data(), send_data.size());
+            for (int j = 0; j < 256 && count + 2 > recv_msg_history.count; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+            CASE_EXPECT_EQ(count + 2, recv_msg_history.count);
+
+            proc_t += conf.ping_interval / 2;
+            node1->proc(proc_t, 0);
+            node2->proc(proc_t, 0);
+        }
+
+        CASE_EXPECT_EQ(0, node1->get_stat().ping_times);
+        CASE_EXPECT_EQ(0, node2->get_stat().ping_times);
+        CASE_EXPECT_LT(0, node1->get_stat().ping_skip_times);
+        CASE_EXPECT_LT(0, node2->get_stat().ping_skip_times);
+
+        // 空闲超过一个ping间隔以后恢复ping
+        proc_t += conf.ping_interval + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        CASE_EXPECT_LT(0, node1->get_stat().ping_times + node2->get_stat().ping_times);
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+            if (NULL == ep1 || NULL == ep2 || (ep1->get_stat_last_pong() > 0 || ep2->get_stat_last_pong() > 0)) {
+                break;
+            }
+        }
+
+        atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+        atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+        CASE_EXPECT_NE(NULL, ep1);
+        CASE_EXPECT_NE(NULL, ep2);
+        if (NULL != ep1 && NULL != ep2) {
+            CASE_EXPECT_TRUE(ep1->get_stat_last_pong() > 0 || ep2->get_stat_last_pong() > 0);
+        }
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 链路一直繁忙时每隔ping_skip_limit个ping间隔仍然ping一次，延迟才会更新
+CASE_TEST(atbus_node_reg, ping_skip_limit)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.ping_skip_limit = 2;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+        }
+
+        // 每半个ping间隔互相发一次数据，链路一直繁忙
+        std::string send_data = "keep alive by data\n";
+        for (int i = 0; i < 12; ++i) {
+            int count = recv_msg_history.count;
+            node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size());
+            node2->send_data(node1->get_id(), 0, send_data.data(), send_data.size());
+            for (int j = 0; j < 256 && count + 2 > recv_msg_history.count; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+            CASE_EXPECT_EQ(count + 2, recv_msg_history.count);
+
+            proc_t += conf.ping_interval / 2;
+            node1->proc(proc_t, 0);
+            node2->proc(proc_t, 0);
+        }
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+            if (NULL == ep1 || NULL == ep2 || (ep1->get_stat_rtt() > 0 && ep2->get_stat_rtt() > 0)) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_LT(0, node1->get_stat().ping_times);
+        CASE_EXPECT_LT(0, node2->get_stat().ping_times);
+        CASE_EXPECT_LT(0, node1->get_stat().ping_skip_times);
+        CASE_EXPECT_LT(0, node2->get_stat().ping_skip_times);
+
+        atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+        atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+        CASE_EXPECT_NE(NULL, ep1);
+        CASE_EXPECT_NE(NULL, ep2);
+        if (NULL != ep1 && NULL != ep2) {
+            CASE_EXPECT_LT(0, ep1->get_stat_rtt());
+            CASE_EXPECT_LT(0, ep2->get_stat_rtt());
+        }
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
 static int node_msg_test_recv_msg_test_custom_cmd_fn(const atbus::node&, const atbus::endpoint*, const atbus::connection*, atbus::node::bus_id_t, const std::vector<std::pair<const void*, size_t> >& data) {
     ++recv_msg_history.count;
     
@@ -269,8 +477,21 @@ CASE_TEST(atbus_node_reg, custom_cmd)
     node_msg_test_setup_exit(&ev_loop);
 }
 
-// 发给自己
-CASE_TEST(atbus_node_reg, reset_and_send)
+static int node_msg_test_recv_msg_test_batch_fn(const atbus::node&, const atbus::endpoint*, const atbus::connection*,
+    int status, const void* buffer, size_t len) {
+    ++recv_msg_history.count;
+    recv_msg_history.status = status;
+
+    if (NULL != buffer && len > 0) {
+        recv_msg_history.data.append(reinterpret_cast<const char*>(buffer), len);
+    }
+    recv_msg_history.data += '\0';
+
+    return 0;
+}
+
+// 批量数据消息测试
+CASE_TEST(atbus_node_reg, send_data_batch)
 {
     atbus::node::conf_t conf;
     atbus::node::default_conf(&conf);
@@ -280,221 +501,2180 @@ CASE_TEST(atbus_node_reg, reset_and_send)
 
     conf.ev_loop = &ev_loop;
 
-    {
+    do {
         atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
         node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
 
         node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
 
         CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
 
         CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
 
         time_t proc_t = time(NULL) + 1;
         node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
 
-        std::string send_data;
-        send_data.assign("self\0hello world!\n", sizeof("self\0hello world!\n") - 1);
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+        }
 
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_batch_fn);
+        recv_msg_history.data.clear();
         int count = recv_msg_history.count;
-        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
-        node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size());
 
-        CASE_EXPECT_EQ(count + 1, recv_msg_history.count)
+        char test_str[] = "hello world!";
+        const void* batch_data[3];
+        batch_data[0] = &test_str[0];
+        batch_data[1] = &test_str[6];
+        batch_data[2] = &test_str[11];
+        size_t batch_len[] = { 5, 5, 0 };
+
+        std::string send_data = "hello";
+        send_data += '\0';
+        send_data += "world";
+        send_data += '\0';
+        send_data += '\0';
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_PARAMS, node1->send_data_batch(node2->get_id(), 0, batch_data, batch_len, 0));
+        CASE_EXPECT_EQ(0, node1->send_data_batch(node2->get_id(), 0, batch_data, batch_len, 3));
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count + 3 <= recv_msg_history.count) {
+                break;
+            }
+        }
+
+        // 一个消息拆成多个数据块回调
+        CASE_EXPECT_EQ(count + 3, recv_msg_history.count);
         CASE_EXPECT_EQ(send_data, recv_msg_history.data);
-    }
+    } while(false);
 
     node_msg_test_setup_exit(&ev_loop);
 }
 
-// 父子节点消息转发测试
-CASE_TEST(atbus_node_reg, parent_and_child)
+// io_stream连接上压缩发送
+CASE_TEST(atbus_node_reg, transfer_compressed)
 {
     atbus::node::conf_t conf;
     atbus::node::default_conf(&conf);
     conf.children_mask = 16;
+    conf.compress_threshold = 1024;
     uv_loop_t ev_loop;
     uv_loop_init(&ev_loop);
 
     conf.ev_loop = &ev_loop;
 
-    {
-        atbus::node::ptr_t node_parent = atbus::node::create();
-        atbus::node::ptr_t node_child = atbus::node::create();
-        node_parent->on_debug = node_msg_test_on_debug;
-        node_child->on_debug = node_msg_test_on_debug;
+    do {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
 
-        node_parent->init(0x12345678, &conf);
-        
-        conf.children_mask = 8;
-        conf.father_address = "ipv4://127.0.0.1:16387";
-        node_child->init(0x12346789, &conf);
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
 
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_PARAMS, node1->register_compression(NULL));
+        CASE_EXPECT_TRUE(NULL != node1->get_compression(atbus::compression::algorithm_t::LZ));
+        CASE_EXPECT_TRUE(NULL == node1->get_compression(atbus::compression::algorithm_t::MAX));
 
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
 
         time_t proc_t = time(NULL) + 1;
-        // 注册成功自动会有可用的端点
-        for (int i = 0; i < 512; ++i) {
-            node_parent->proc(proc_t, 0);
-            node_child->proc(proc_t, 0);
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
 
-            atbus::endpoint* ep1 = node_child->get_endpoint(node_parent->get_id());
-            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child->get_id());
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
 
             if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
                 break;
             }
+        }
 
-            uv_run(conf.ev_loop, UV_RUN_ONCE);
-            
-            ++ proc_t;
+        atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+        CASE_EXPECT_TRUE(NULL != ep2);
+        if (NULL == ep2) {
+            break;
         }
-        
-        node_child->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
-        node_parent->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
-        
+        CASE_EXPECT_EQ(node2->get_compression_mask(), ep2->get_compress_algorithms());
+
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // 小于阈值的数据不压缩
         int count = recv_msg_history.count;
-        
-        // 发消息啦 -  parent to child
-        {
-            std::string send_data;
-            send_data.assign("parent to child\0hello world!\n", sizeof("parent to child\0hello world!\n") - 1);
-            
-            node_parent->send_data(node_child->get_id(), 0, send_data.data(), send_data.size());
-            for (int i = 0; i < 256; ++i) {
-                uv_run(conf.ev_loop, UV_RUN_ONCE);
-                CASE_THREAD_SLEEP_MS(16);
-                if (count != recv_msg_history.count) {
-                    break;
+        std::string send_data = "hello world!";
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count + 1 <= recv_msg_history.count) {
+                break;
+            }
+        }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(0, node1->get_stat().compress_times);
+
+        send_data.clear();
+        for (int i = 0; i < 512; ++i) {
+            send_data += "{\"id\":";
+            send_data += static_cast<char>('0' + i % 10);
+            send_data += ",\"name\":\"player\",\"level\":100},";
+        }
+
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count + 1 <= recv_msg_history.count) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(1, node1->get_stat().compress_times);
+        CASE_EXPECT_EQ(send_data.size(), node1->get_stat().compress_origin_bytes);
+        CASE_EXPECT_LT(node1->get_stat().compress_bytes, node1->get_stat().compress_origin_bytes);
+        CASE_EXPECT_EQ(1, node2->get_stat().decompress_times);
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 对端注册时没有声明二进制编码(旧节点)时数据消息回退到msgpack编码
+CASE_TEST(atbus_node_reg, transfer_msgpack_fallback)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.compress_threshold = 1024;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        conf.flags.set(atbus::node::conf_flag_t::EN_CONF_MSGPACK_DATA, true);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+        }
+
+        atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+        atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+        CASE_EXPECT_TRUE(NULL != ep1 && NULL != ep2);
+        if (NULL == ep1 || NULL == ep2) {
+            break;
+        }
+        CASE_EXPECT_TRUE(ep1->get_flag(atbus::endpoint::flag_t::BINARY_DATA));
+        CASE_EXPECT_FALSE(ep2->get_flag(atbus::endpoint::flag_t::BINARY_DATA));
+
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // 压缩只在二进制编码下生效，所以发给node2的大数据不会被压缩
+        std::string send_data;
+        for (int i = 0; i < 512; ++i) {
+            send_data += "{\"id\":";
+            send_data += static_cast<char>('0' + i % 10);
+            send_data += ",\"name\":\"player\",\"level\":100},";
+        }
+
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count + 1 <= recv_msg_history.count) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(0, node1->get_stat().compress_times);
+
+        count = recv_msg_history.count;
+        send_data = "hello world!";
+        CASE_EXPECT_EQ(0, node2->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count + 1 <= recv_msg_history.count) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_stripe_record_t {
+    std::map<int, int> next_seq;                                // 每个类型下一个期望的序号
+    std::map<int, std::set<const atbus::connection*> > conns;   // 每个类型收到消息的连接
+    std::set<const atbus::connection*> all_conns;
+    int out_of_order;
+    int count;
+
+    node_msg_test_stripe_record_t(): out_of_order(0), count(0) {}
+};
+
+static node_msg_test_stripe_record_t stripe_history;
+
+static int node_msg_test_recv_msg_test_stripe_fn(const atbus::node&, const atbus::endpoint*, const atbus::connection* conn,
+    int type, const void* buffer, size_t len) {
+    int seq = 0;
+    if (NULL != buffer && sizeof(seq) == len) {
+        memcpy(&seq, buffer, sizeof(seq));
+    }
+
+    if (stripe_history.next_seq[type] != seq) {
+        ++stripe_history.out_of_order;
+    }
+    stripe_history.next_seq[type] = seq + 1;
+    stripe_history.conns[type].insert(conn);
+    stripe_history.all_conns.insert(conn);
+    ++stripe_history.count;
+    return 0;
+}
+
+static size_t node_msg_test_count_connected(const atbus::endpoint* ep) {
+    size_t ret = 0;
+    if (NULL == ep) {
+        return ret;
+    }
+
+    for (std::list<atbus::connection::ptr_t>::const_iterator iter = ep->get_data_connections().begin(); iter != ep->get_data_connections().end(); ++iter) {
+        if (atbus::connection::state_t::CONNECTED == (*iter)->get_status()) {
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+// 多条并行的数据连接，同一个(来源,类型)保持顺序，不要求顺序时轮流发送
+CASE_TEST(atbus_node_reg, transfer_striped)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.data_conn_count = 3;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        // node2发出的消息要求顺序，node1发出的消息不要求顺序
+        node2->init(0x12356789, &conf);
+        conf.flags.set(atbus::node::conf_flag_t::EN_CONF_DATA_UNORDERED);
+        node1->init(0x12345678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 512; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+
+            if (6 == node_msg_test_count_connected(node2->get_endpoint(node1->get_id())) &&
+                6 == node_msg_test_count_connected(node1->get_endpoint(node2->get_id()))) {
+                break;
+            }
+        }
+
+        // 两个节点都收到对方的注册，各自按配置建立3条数据连接
+        CASE_EXPECT_EQ(6, node_msg_test_count_connected(node2->get_endpoint(node1->get_id())));
+        CASE_EXPECT_EQ(6, node_msg_test_count_connected(node1->get_endpoint(node2->get_id())));
+
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_stripe_fn);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_stripe_fn);
+
+        // 16种类型各32个消息，同一个类型总是走同一条连接并且按顺序到达
+        stripe_history = node_msg_test_stripe_record_t();
+        for (int seq = 0; seq < 32; ++seq) {
+            for (int type = 0; type < 16; ++type) {
+                CASE_EXPECT_EQ(0, node2->send_data(node1->get_id(), type, &seq, sizeof(seq)));
+            }
+        }
+
+        for (int i = 0; i < 512 && stripe_history.count < 16 * 32; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        CASE_EXPECT_EQ(16 * 32, stripe_history.count);
+        CASE_EXPECT_EQ(0, stripe_history.out_of_order);
+        for (int type = 0; type < 16; ++type) {
+            CASE_EXPECT_EQ(1, stripe_history.conns[type].size());
+        }
+        CASE_EXPECT_GT(stripe_history.all_conns.size(), 1);
+
+        // 不要求顺序时同一个类型的消息轮流使用所有的数据连接
+        stripe_history = node_msg_test_stripe_record_t();
+        for (int seq = 0; seq < 12; ++seq) {
+            CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, &seq, sizeof(seq)));
+        }
+
+        for (int i = 0; i < 512 && stripe_history.count < 12; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        CASE_EXPECT_EQ(12, stripe_history.count);
+        CASE_EXPECT_EQ(6, stripe_history.conns[0].size());
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 同一台机器上的节点通过io_stream注册后，数据消息自动改走共享内存通道
+CASE_TEST(atbus_node_reg, transfer_auto_shm)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.recv_buffer_size = 256 * 1024;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_AUTO_SHM);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        // 启动时自动监听了共享内存通道
+        CASE_EXPECT_EQ(2, node1->get_listen_list().size());
+        CASE_EXPECT_EQ(2, node2->get_listen_list().size());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        atbus::connection* conn1 = NULL;
+        atbus::connection* conn2 = NULL;
+        for (int i = 0; i < 512; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+            conn1 = NULL == ep1 ? NULL : node2->get_self_endpoint()->get_data_connection(ep1);
+            conn2 = NULL == ep2 ? NULL : node1->get_self_endpoint()->get_data_connection(ep2);
+            if (NULL != conn1 && NULL != conn2 && conn1->check_flag(atbus::connection::flag_t::ACCESS_SHARE_HOST) &&
+                conn2->check_flag(atbus::connection::flag_t::ACCESS_SHARE_HOST)) {
+                break;
+            }
+        }
+
+        // 两端都优先选择共享内存通道
+        CASE_EXPECT_TRUE(NULL != conn1 && conn1->check_flag(atbus::connection::flag_t::ACCESS_SHARE_HOST));
+        CASE_EXPECT_TRUE(NULL != conn2 && conn2->check_flag(atbus::connection::flag_t::ACCESS_SHARE_HOST));
+        if (NULL == conn1 || NULL == conn2) {
+            break;
+        }
+        CASE_EXPECT_EQ(std::string("shm"), conn2->get_address().scheme);
+
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        std::string send_data = "hello shm!";
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && count == recv_msg_history.count; ++i) {
+            node2->proc(proc_t, 0);
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        // 共享内存通道是单工的，收到的连接是node2自己的接收通道
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(node2.get(), recv_msg_history.n);
+        CASE_EXPECT_TRUE(NULL != recv_msg_history.conn && recv_msg_history.conn->check_flag(atbus::connection::flag_t::ACCESS_SHARE_HOST));
+
+        send_data = "hello shm back!";
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node2->send_data(node1->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && count == recv_msg_history.count; ++i) {
+            node1->proc(proc_t, 0);
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(node1.get(), recv_msg_history.n);
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_group_record_t {
+    std::map<atbus::node::bus_id_t, int> recv_count;
+    atbus::node::bus_id_t from;
+    uint64_t gid;
+    std::string data;
+    int count;
+
+    node_msg_test_group_record_t(): from(0), gid(0), count(0) {}
+};
+
+static node_msg_test_group_record_t recv_group_history;
+
+static int node_msg_test_recv_group_fn(const atbus::node& n, const atbus::endpoint*, const atbus::connection*,
+    uint64_t gid, atbus::node::bus_id_t from, int, const void* buffer, size_t len) {
+    ++recv_group_history.recv_count[n.get_id()];
+    recv_group_history.from = from;
+    recv_group_history.gid = gid;
+    recv_group_history.data.assign(reinterpret_cast<const char*>(buffer), len);
+    ++recv_group_history.count;
+    return 0;
+}
+
+#ifndef _WIN32
+static void node_msg_test_remove_shm(const std::string& addr) {
+    key_t shm_key = static_cast<key_t>(strtoul(addr.c_str() + sizeof("shm://") - 1, NULL, 10));
+    int shm_id = shmget(shm_key, 0, 0);
+    if (-1 != shm_id) {
+        shmctl(shm_id, IPC_RMID, NULL);
+    }
+}
+
+// 自动共享内存的key基数可以配置，key已经被其他仍在运行的进程占用时不监听
+CASE_TEST(atbus_node_reg, auto_shm_key_in_use)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.recv_buffer_size = 256 * 1024;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_AUTO_SHM);
+    conf.auto_shm_key_base = 0x41430000;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    std::string shm_addr;
+    std::string other_addr;
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        conf.auto_shm_key_base = 0x41440000;
+        node2->init(0x12345678, &conf);
+        conf.auto_shm_key_base = 0x41430000;
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+        CASE_EXPECT_EQ(1, node1->get_listen_list().size());
+        CASE_EXPECT_EQ(1, node2->get_listen_list().size());
+
+        // 相同的bus id，不同的key基数
+        if (!node1->get_listen_list().empty() && !node2->get_listen_list().empty()) {
+            shm_addr = node1->get_listen_list().front();
+            other_addr = node2->get_listen_list().front();
+            CASE_EXPECT_NE(shm_addr, other_addr);
+        }
+    }
+    if (shm_addr.empty() || other_addr.empty()) {
+        node_msg_test_setup_exit(&ev_loop);
+        return;
+    }
+    node_msg_test_remove_shm(shm_addr);
+    node_msg_test_remove_shm(other_addr);
+
+    // 子进程创建同一个key的共享内存并保持运行
+    int sync_fds[2];
+    CASE_EXPECT_EQ(0, pipe(sync_fds));
+    pid_t child = fork();
+    if (0 == child) {
+        key_t shm_key = static_cast<key_t>(strtoul(shm_addr.c_str() + sizeof("shm://") - 1, NULL, 10));
+        char c = -1 == shmget(shm_key, conf.recv_buffer_size, IPC_CREAT | 0666) ? 0 : 1;
+        if (write(sync_fds[1], &c, 1) < 0) {
+            _exit(1);
+        }
+        pause();
+        _exit(0);
+    }
+
+    char created = 0;
+    CASE_EXPECT_EQ(1, read(sync_fds[0], &created, 1));
+    CASE_EXPECT_EQ(1, created);
+    close(sync_fds[0]);
+    close(sync_fds[1]);
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(0, node1->get_listen_list().size());
+    }
+
+    // 创建者退出以后(比如节点重启)可以复用
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(1, node1->get_listen_list().size());
+        if (!node1->get_listen_list().empty()) {
+            CASE_EXPECT_EQ(shm_addr, node1->get_listen_list().front());
+        }
+    }
+    node_msg_test_remove_shm(shm_addr);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+#endif
+
+// 组播，父节点只转发给有关注的子节点，每条链路只发送一份
+CASE_TEST(atbus_node_reg, send_to_group)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_3 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_child_3->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+        node_child_3->init(0x12347890, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->listen("ipv4://127.0.0.1:16390"));
+
+        // 启动前加入的组在连上父节点以后上报
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->join_group(0x100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->join_group(0x100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->join_group(0x200));
+        CASE_EXPECT_TRUE(node_child_1->is_group_member(0x100));
+        CASE_EXPECT_FALSE(node_child_2->is_group_member(0x100));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->start());
+
+        node_parent->set_on_recv_group_handle(node_msg_test_recv_group_fn);
+        node_child_1->set_on_recv_group_handle(node_msg_test_recv_group_fn);
+        node_child_2->set_on_recv_group_handle(node_msg_test_recv_group_fn);
+        node_child_3->set_on_recv_group_handle(node_msg_test_recv_group_fn);
+
+        // 等待注册和组关注的上报完成
+        time_t proc_t = time(NULL) + 1;
+        for (int i = 0; i < 512; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            node_child_3->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_parent->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* ep3 = node_parent->get_endpoint(node_child_3->get_id());
+            const atbus::endpoint* self_ep = node_parent->get_self_endpoint();
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != self_ep->get_data_connection(ep1) &&
+                NULL != self_ep->get_data_connection(ep2) && NULL != self_ep->get_data_connection(ep3) &&
+                NULL != node_child_2->get_self_endpoint()->get_data_connection(node_child_2->get_endpoint(node_parent->get_id())) &&
+                2 == node_parent->get_group_count()) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+            ++proc_t;
+        }
+        CASE_EXPECT_EQ(2, node_parent->get_group_count());
+
+        // C2没有关注，父节点只转发给C1和C3
+        std::string send_data = "group data from child 2";
+        recv_group_history = node_msg_test_group_record_t();
+        uint64_t parent_send_times = node_parent->get_stat().group_send_times;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->send_to_group(0x100, 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && recv_group_history.count < 2; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        CASE_EXPECT_EQ(2, recv_group_history.count);
+        CASE_EXPECT_EQ(1, recv_group_history.recv_count[node_child_1->get_id()]);
+        CASE_EXPECT_EQ(1, recv_group_history.recv_count[node_child_3->get_id()]);
+        CASE_EXPECT_EQ(0, recv_group_history.recv_count[node_child_2->get_id()]);
+        CASE_EXPECT_EQ(0x100, recv_group_history.gid);
+        CASE_EXPECT_EQ(node_child_2->get_id(), recv_group_history.from);
+        CASE_EXPECT_EQ(send_data, recv_group_history.data);
+        CASE_EXPECT_EQ(parent_send_times + 2, node_parent->get_stat().group_send_times);
+
+        // 发送方自身不会收到
+        recv_group_history = node_msg_test_group_record_t();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_to_group(0x100, 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && recv_group_history.count < 1; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(1, recv_group_history.count);
+        CASE_EXPECT_EQ(1, recv_group_history.recv_count[node_child_3->get_id()]);
+
+        // 父节点自身加入的组
+        recv_group_history = node_msg_test_group_record_t();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->send_to_group(0x200, 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && recv_group_history.count < 1; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(1, recv_group_history.recv_count[node_parent->get_id()]);
+
+        // C3离开以后父节点不再转发给C3
+        uint64_t c3_sync_times = node_child_3->get_stat().group_sync_send_times;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->leave_group(0x100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_NOT_FOUND, node_child_3->leave_group(0x100));
+        for (int i = 0; i < 256 && c3_sync_times == node_child_3->get_stat().group_sync_send_times; ++i) {
+            node_child_3->proc(proc_t, 0);
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        recv_group_history = node_msg_test_group_record_t();
+        parent_send_times = node_parent->get_stat().group_send_times;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->send_to_group(0x100, 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && recv_group_history.count < 1; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(1, recv_group_history.count);
+        CASE_EXPECT_EQ(1, recv_group_history.recv_count[node_child_1->get_id()]);
+        CASE_EXPECT_EQ(0, recv_group_history.recv_count[node_child_3->get_id()]);
+        CASE_EXPECT_EQ(parent_send_times + 1, node_parent->get_stat().group_send_times);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_service_record_t {
+    std::map<atbus::node::bus_id_t, int> recv_count;
+    std::map<std::string, atbus::node::bus_id_t> receiver;
+    int count;
+
+    node_msg_test_service_record_t(): count(0) {}
+};
+
+static node_msg_test_service_record_t recv_service_history;
+
+static int node_msg_test_recv_service_fn(const atbus::node& n, const atbus::endpoint*, const atbus::connection*,
+    int, const void* buffer, size_t len) {
+    ++recv_service_history.recv_count[n.get_id()];
+    recv_service_history.receiver[std::string(reinterpret_cast<const char*>(buffer), len)] = n.get_id();
+    ++recv_service_history.count;
+    return 0;
+}
+
+static void node_msg_test_wait_service(uv_loop_t* ev_loop, int expect) {
+    for (int i = 0; i < 512 && recv_service_history.count < expect; ++i) {
+        uv_run(ev_loop, UV_RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+}
+
+// 服务路由，相同的key总是发往同一个实例，key为0时选择负载最低的实例，不知道实例时交给父节点选择
+CASE_TEST(atbus_node_reg, send_to_service)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_3 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+        node_child_3->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+        node_child_3->init(0x12347890, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->listen("ipv4://127.0.0.1:16390"));
+
+        // C1和C2提供服务，服务类型在注册时发给父节点
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_PARAMS, node_child_1->register_service(0));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->register_service(0x300));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->register_service(0x300));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->register_service(0x300));
+        CASE_EXPECT_EQ(1, node_child_2->get_self_endpoint()->get_services().size());
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->start());
+
+        node_parent->set_on_recv_handle(node_msg_test_recv_service_fn);
+        node_child_1->set_on_recv_handle(node_msg_test_recv_service_fn);
+        node_child_2->set_on_recv_handle(node_msg_test_recv_service_fn);
+        node_child_3->set_on_recv_handle(node_msg_test_recv_service_fn);
+        node_child_3->set_on_send_data_failed_handle(node_msg_test_send_data_failed_fn);
+
+        time_t proc_t = time(NULL) + 1;
+        for (int i = 0; i < 512; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            node_child_3->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_parent->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* ep3 = node_parent->get_endpoint(node_child_3->get_id());
+            const atbus::endpoint* self_ep = node_parent->get_self_endpoint();
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != self_ep->get_data_connection(ep1) &&
+                NULL != self_ep->get_data_connection(ep2) && NULL != self_ep->get_data_connection(ep3) &&
+                NULL != node_child_3->get_self_endpoint()->get_data_connection(node_child_3->get_endpoint(node_parent->get_id()))) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+            ++proc_t;
+        }
+
+        atbus::endpoint* parent_ep1 = node_parent->get_endpoint(node_child_1->get_id());
+        atbus::endpoint* parent_ep2 = node_parent->get_endpoint(node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, parent_ep1);
+        CASE_EXPECT_NE(NULL, parent_ep2);
+        if (NULL == parent_ep1 || NULL == parent_ep2) {
+            break;
+        }
+        CASE_EXPECT_TRUE(parent_ep1->has_service(0x300));
+        CASE_EXPECT_TRUE(parent_ep2->has_service(0x300));
+        CASE_EXPECT_FALSE(node_parent->get_endpoint(node_child_3->get_id())->has_service(0x300));
+
+        // C3不知道实例，交给父节点按key选择
+        const int key_count = 64;
+        char key_data[32] = {0};
+        recv_service_history = node_msg_test_service_record_t();
+        uint64_t forward_times = node_child_3->get_stat().service_forward_times;
+        for (int i = 1; i <= key_count; ++i) {
+            atbus::node::bus_id_t target = 1;
+            UTIL_STRFUNC_SNPRINTF(key_data, sizeof(key_data), "key %d", i);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->send_to_service(0x300, static_cast<uint64_t>(i), 0, key_data, strlen(key_data), &target));
+            CASE_EXPECT_EQ(0, target);
+        }
+        node_msg_test_wait_service(conf.ev_loop, key_count);
+        CASE_EXPECT_EQ(key_count, recv_service_history.count);
+        CASE_EXPECT_EQ(forward_times + key_count, node_child_3->get_stat().service_forward_times);
+        CASE_EXPECT_LT(0, recv_service_history.recv_count[node_child_1->get_id()]);
+        CASE_EXPECT_LT(0, recv_service_history.recv_count[node_child_2->get_id()]);
+        CASE_EXPECT_EQ(key_count, recv_service_history.recv_count[node_child_1->get_id()] + recv_service_history.recv_count[node_child_2->get_id()]);
+
+        // 父节点直接发送时选出的实例相同
+        std::map<std::string, atbus::node::bus_id_t> first_receiver = recv_service_history.receiver;
+        recv_service_history = node_msg_test_service_record_t();
+        for (int i = 1; i <= key_count; ++i) {
+            atbus::node::bus_id_t target = 0;
+            UTIL_STRFUNC_SNPRINTF(key_data, sizeof(key_data), "key %d", i);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_to_service(0x300, static_cast<uint64_t>(i), 0, key_data, strlen(key_data), &target));
+            CASE_EXPECT_EQ(first_receiver[key_data], target);
+        }
+        node_msg_test_wait_service(conf.ev_loop, key_count);
+        CASE_EXPECT_EQ(key_count, recv_service_history.count);
+        CASE_EXPECT_TRUE(first_receiver == recv_service_history.receiver);
+
+        // key为0时轮流发给负载最低的实例
+        recv_service_history = node_msg_test_service_record_t();
+        for (int i = 0; i < key_count; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_to_service(0x300, 0, 0, key_data, strlen(key_data)));
+        }
+        node_msg_test_wait_service(conf.ev_loop, key_count);
+        CASE_EXPECT_EQ(key_count, recv_service_history.count);
+        CASE_EXPECT_EQ(key_count / 2, recv_service_history.recv_count[node_child_1->get_id()]);
+        CASE_EXPECT_EQ(key_count / 2, recv_service_history.recv_count[node_child_2->get_id()]);
+
+        // C1的负载提示通过ping/pong告知父节点，之后都发给C2
+        node_child_1->set_load_hint(1000);
+        CASE_EXPECT_EQ(1000, node_child_1->get_load_hint());
+        for (int i = 0; i < 512 && parent_ep1->get_stat_load() < 1000; ++i) {
+            proc_t += conf.ping_interval;
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            node_child_3->proc(proc_t, 0);
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_LE(1000, parent_ep1->get_stat_load());
+
+        recv_service_history = node_msg_test_service_record_t();
+        for (int i = 0; i < 16; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_to_service(0x300, 0, 0, key_data, strlen(key_data)));
+        }
+        node_msg_test_wait_service(conf.ev_loop, 16);
+        CASE_EXPECT_EQ(16, recv_service_history.recv_count[node_child_2->get_id()]);
+        CASE_EXPECT_EQ(0, recv_service_history.recv_count[node_child_1->get_id()]);
+
+        // 自身提供的服务直接回调
+        recv_service_history = node_msg_test_service_record_t();
+        atbus::node::bus_id_t self_target = 0;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->send_to_service(0x300, 1, 0, key_data, strlen(key_data), &self_target));
+        CASE_EXPECT_EQ(node_child_1->get_id(), self_target);
+        CASE_EXPECT_EQ(1, recv_service_history.recv_count[node_child_1->get_id()]);
+
+        // 没有实例的服务，根节点直接失败，转发时通知来源
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_NOT_FOUND, node_parent->send_to_service(0x400, 1, 0, key_data, strlen(key_data)));
+
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_3->send_to_service(0x400, 1, 0, key_data, strlen(key_data)));
+        for (int i = 0; i < 512 && count == recv_msg_history.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_NOT_FOUND, recv_msg_history.status);
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_call_record_t {
+    atbus::node::bus_id_t from;
+    int status;
+    int type;
+    std::string data;
+    int count;
+
+    node_msg_test_call_record_t(): from(0), status(0), type(0), count(0) {}
+};
+
+static void node_msg_test_call_fn(atbus::node&, atbus::node::bus_id_t from, int status, int type, const void* buffer, size_t s, void* priv_data) {
+    node_msg_test_call_record_t* record = reinterpret_cast<node_msg_test_call_record_t*>(priv_data);
+    record->from = from;
+    record->status = status;
+    record->type = type;
+    record->data.assign(reinterpret_cast<const char*>(buffer), s);
+    ++record->count;
+}
+
+// type为0时回复请求数据加上后缀，否则不回复
+static int node_msg_test_recv_call_fn(const atbus::node& n, const atbus::endpoint*, const atbus::connection*,
+    atbus::node::bus_id_t from, int type, uint32_t sequence, const void* buffer, size_t s) {
+    if (0 != type) {
+        return 0;
+    }
+
+    std::string rsp(reinterpret_cast<const char*>(buffer), s);
+    rsp += " rsp";
+    return const_cast<atbus::node&>(n).reply(from, type, sequence, rsp.data(), rsp.size());
+}
+
+// 链路一直繁忙时服务实例的负载提示仍然按ping间隔更新
+CASE_TEST(atbus_node_reg, send_to_service_busy)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->register_service(0x300));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        node_parent->set_on_recv_handle(node_msg_test_recv_service_fn);
+        node_child->set_on_recv_handle(node_msg_test_recv_service_fn);
+
+        time_t proc_t = time(NULL) + 1;
+        for (int i = 0; i < 512; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+
+            atbus::endpoint* ep = node_parent->get_endpoint(node_child->get_id());
+            if (NULL != ep && NULL != node_parent->get_self_endpoint()->get_data_connection(ep) && ep->has_service(0x300)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+            ++proc_t;
+        }
+
+        atbus::endpoint* parent_ep = node_parent->get_endpoint(node_child->get_id());
+        CASE_EXPECT_NE(NULL, parent_ep);
+        if (NULL == parent_ep) {
+            break;
+        }
+
+        // 每半个ping间隔双向都有消息，ping会被跳过，但是负载提示不能一直停在注册时
+        node_child->set_load_hint(1000);
+        std::string send_data = "busy service\n";
+        uint64_t sent = 0;
+        for (int i = 0; i < 8; ++i) {
+            recv_service_history = node_msg_test_service_record_t();
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->send_to_service(0x300, 0, 0, send_data.data(), send_data.size()));
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size()));
+            ++sent;
+            node_msg_test_wait_service(conf.ev_loop, 2);
+            CASE_EXPECT_EQ(2, recv_service_history.count);
+
+            proc_t += conf.ping_interval / 2;
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+        }
+
+        for (int i = 0; i < 256 && parent_ep->get_stat_load() < 1000; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+
+        CASE_EXPECT_LT(0, node_child->get_stat().ping_skip_times);
+        CASE_EXPECT_LE(1000, parent_ep->get_stat_load());
+        CASE_EXPECT_GT(1000 + sent, parent_ep->get_stat_load());
+    } while (false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// RPC调用
+CASE_TEST(atbus_node_reg, call)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    do {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+        }
+
+        // 被调方没有处理函数时直接回复错误
+        node_msg_test_call_record_t no_handler;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_PARAMS, node1->call(node2->get_id(), 0, "req", 3, 1000, NULL));
+        CASE_EXPECT_EQ(0, node1->call(node2->get_id(), 0, "req", 3, 1000, node_msg_test_call_fn, &no_handler));
+        for (int i = 0; i < 256 && 0 == no_handler.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+        CASE_EXPECT_EQ(1, no_handler.count);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_NOT_INITED, no_handler.status);
+
+        // 同时发起多个调用
+        node2->set_on_recv_call_handle(node_msg_test_recv_call_fn);
+        node_msg_test_call_record_t records[200];
+        for (int i = 0; i < 200; ++i) {
+            char req[32] = {0};
+            UTIL_STRFUNC_SNPRINTF(req, sizeof(req), "req %d", i);
+            CASE_EXPECT_EQ(0, node1->call(node2->get_id(), 0, req, strlen(req), 1000, node_msg_test_call_fn, &records[i]));
+        }
+        CASE_EXPECT_EQ(200, node1->get_call_count());
+
+        for (int i = 0; i < 256 && node1->get_call_count() > 0; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+
+        CASE_EXPECT_EQ(0, node1->get_call_count());
+        for (int i = 0; i < 200; ++i) {
+            char rsp[32] = {0};
+            UTIL_STRFUNC_SNPRINTF(rsp, sizeof(rsp), "req %d rsp", i);
+            CASE_EXPECT_EQ(1, records[i].count);
+            CASE_EXPECT_EQ(node2->get_id(), records[i].from);
+            CASE_EXPECT_EQ(0, records[i].status);
+            CASE_EXPECT_EQ(std::string(rsp), records[i].data);
+        }
+        CASE_EXPECT_EQ(201, node1->get_stat().call_times);
+
+        uint64_t histogram_total = 0;
+        for (size_t i = 0; i < ATBUS_MACRO_CALL_LATENCY_BUCKETS; ++i) {
+            histogram_total += node1->get_stat().call_latency_histogram[i];
+        }
+        CASE_EXPECT_EQ(201, histogram_total);
+
+        // 调用自己
+        node1->set_on_recv_call_handle(node_msg_test_recv_call_fn);
+        node_msg_test_call_record_t self_record;
+        CASE_EXPECT_EQ(0, node1->call(node1->get_id(), 0, "self", 4, 1000, node_msg_test_call_fn, &self_record));
+        CASE_EXPECT_EQ(1, self_record.count);
+        CASE_EXPECT_EQ(std::string("self rsp"), self_record.data);
+
+        // 不回复的调用超时
+        node_msg_test_call_record_t timeout_record;
+        CASE_EXPECT_EQ(0, node1->call(node2->get_id(), 1, "timeout", 7, 100, node_msg_test_call_fn, &timeout_record));
+        for (int i = 0; i < 16; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+        node1->proc(proc_t, 50000);
+        CASE_EXPECT_EQ(0, timeout_record.count);
+        node1->proc(proc_t, 200000);
+        CASE_EXPECT_EQ(1, timeout_record.count);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_NODE_TIMEOUT, timeout_record.status);
+        CASE_EXPECT_EQ(1, timeout_record.type);
+        CASE_EXPECT_EQ(0, timeout_record.from);
+        CASE_EXPECT_EQ(1, node1->get_stat().call_timeout_times);
+
+        // 只接受调用目标的回包，其他节点用同一个调用ID回包不能完成调用
+        node_msg_test_call_record_t target_record;
+        uint32_t target_seq = 0;
+        CASE_EXPECT_EQ(0, node1->call(node2->get_id(), 1, "target", 6, 1000, node_msg_test_call_fn, &target_record, &target_seq));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_NOT_FOUND, node1->reply(node1->get_id(), 1, target_seq, "fake", 4));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_NOT_FOUND, node1->on_call_failed(node1->get_id(), target_seq, EN_ATBUS_ERR_ATNODE_TTL));
+        CASE_EXPECT_EQ(0, target_record.count);
+
+        CASE_EXPECT_EQ(0, node2->reply(node1->get_id(), 1, target_seq, "real", 4));
+        for (int i = 0; i < 256 && 0 == target_record.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+        CASE_EXPECT_EQ(1, target_record.count);
+        CASE_EXPECT_EQ(node2->get_id(), target_record.from);
+        CASE_EXPECT_EQ(std::string("real"), target_record.data);
+
+        // 重置时未完成的调用回调失败
+        node_msg_test_call_record_t reset_record;
+        CASE_EXPECT_EQ(0, node1->call(node2->get_id(), 1, "reset", 5, 1000, node_msg_test_call_fn, &reset_record));
+        node1->reset();
+        CASE_EXPECT_EQ(1, reset_record.count);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_CHANNEL_CLOSING, reset_record.status);
+    } while(false);
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 发给自己
+CASE_TEST(atbus_node_reg, reset_and_send)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+
+        std::string send_data;
+        send_data.assign("self\0hello world!\n", sizeof("self\0hello world!\n") - 1);
+
+        int count = recv_msg_history.count;
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->send_data(node1->get_id(), 0, send_data.data(), send_data.size());
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count)
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+struct node_msg_test_pod_msg_t {
+    uint32_t id;
+    uint16_t level;
+    char name[10];
+};
+
+ATBUS_MACRO_MESSAGE_POD_TRAITS(node_msg_test_pod_msg_t)
+
+struct node_msg_test_msgpack_msg_t {
+    int32_t id;
+    std::string name;
+    std::vector<int32_t> items;
+
+    MSGPACK_DEFINE(id, name, items);
+};
+
+// 类型化消息发送和解码
+CASE_TEST(atbus_node_reg, send_typed)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // POD类型直接按内存发送
+        node_msg_test_pod_msg_t pod_msg;
+        memset(&pod_msg, 0, sizeof(pod_msg));
+        pod_msg.id = 123;
+        pod_msg.level = 45;
+        strncpy(pod_msg.name, "pod", sizeof(pod_msg.name) - 1);
+
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send(node1->get_id(), 1, pod_msg));
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(sizeof(pod_msg), recv_msg_history.data.size());
+
+        atbus::message_view<node_msg_test_pod_msg_t> pod_view = atbus::as<node_msg_test_pod_msg_t>(recv_msg_history.data.data(), recv_msg_history.data.size());
+        CASE_EXPECT_TRUE(pod_view.valid());
+        if (pod_view.valid()) {
+            CASE_EXPECT_EQ(123, pod_view->id);
+            CASE_EXPECT_EQ(45, pod_view->level);
+            CASE_EXPECT_EQ(std::string("pod"), std::string(pod_view->name));
+        }
+
+        CASE_EXPECT_FALSE(atbus::as<node_msg_test_pod_msg_t>(recv_msg_history.data.data(), recv_msg_history.data.size() - 1).valid());
+
+        // msgpack类型编码后发送
+        node_msg_test_msgpack_msg_t mp_msg;
+        mp_msg.id = 678;
+        mp_msg.name = "msgpack";
+        mp_msg.items.push_back(1);
+        mp_msg.items.push_back(2);
+        mp_msg.items.push_back(3);
+
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send(node1->get_id(), 2, mp_msg));
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+
+        atbus::message_view<node_msg_test_msgpack_msg_t> mp_view = atbus::as<node_msg_test_msgpack_msg_t>(recv_msg_history.data.data(), recv_msg_history.data.size());
+        CASE_EXPECT_TRUE(mp_view.valid());
+        if (mp_view.valid()) {
+            CASE_EXPECT_EQ(678, mp_view->id);
+            CASE_EXPECT_EQ(mp_msg.name, mp_view->name);
+            CASE_EXPECT_EQ(3, mp_view->items.size());
+        }
+
+        CASE_EXPECT_FALSE(atbus::as<node_msg_test_msgpack_msg_t>(pod_view.get(), 0).valid());
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 父子节点消息转发测试
+CASE_TEST(atbus_node_reg, parent_and_child)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+        
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child->start());
+
+        time_t proc_t = time(NULL) + 1;
+        // 注册成功自动会有可用的端点
+        for (int i = 0; i < 512; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child->get_endpoint(node_parent->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            
+            ++ proc_t;
+        }
+        
+        node_child->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        
+        int count = recv_msg_history.count;
+        
+        // 发消息啦 -  parent to child
+        {
+            std::string send_data;
+            send_data.assign("parent to child\0hello world!\n", sizeof("parent to child\0hello world!\n") - 1);
+            
+            node_parent->send_data(node_child->get_id(), 0, send_data.data(), send_data.size());
+            for (int i = 0; i < 256; ++i) {
+                uv_run(conf.ev_loop, UV_RUN_ONCE);
+                CASE_THREAD_SLEEP_MS(16);
+                if (count != recv_msg_history.count) {
+                    break;
+                }
+            }
+
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        }
+        
+        // 发消息啦 - child to parent
+        {
+            std::string send_data;
+            send_data.assign("child to parent\0hello world!\n", sizeof("child to parent\0hello world!\n") - 1);
+            
+            count = recv_msg_history.count;
+            node_child->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size());
+            for (int i = 0; i < 256; ++i) {
+                uv_run(conf.ev_loop, UV_RUN_ONCE);
+                CASE_THREAD_SLEEP_MS(16);
+                if (count != recv_msg_history.count) {
+                    break;
+                }
+            }
+
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        }
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 兄弟节点通过父节点转发消息并建立直连测试（测试路由）
+CASE_TEST(atbus_node_reg, transfer_and_connect)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+    
+    // 只有发生冲突才会注册不成功，否则会无限重试注册父节点，直到其上线
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+        
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+        
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        
+        // wait for register finished
+        for (int i = 0; i < 256; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep3 = node_parent->get_endpoint(node_child_2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep3)) {
+                break;
+            }
+            
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            ++ proc_t;
+        }
+        
+        // 转发消息
+        std::string send_data;
+        send_data.assign("transfer through parent\n", sizeof("transfer through parent\n") - 1);
+        
+        int count = recv_msg_history.count;
+        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+            if (count != recv_msg_history.count) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        
+        // 自动直连测试
+        for (int i = 0; i < 512 && NULL == node_child_1->get_endpoint(node_child_2->get_id()); ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, ep1);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 兄弟节点直连的延迟高于经过父节点时仍然直连，重复的直连通知不会创建新连接
+CASE_TEST(atbus_node_reg, transfer_latency_aware)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        node_child_2->init(0x12346890, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        // wait for register finished
+        for (int i = 0; i < 256; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep3 = node_parent->get_endpoint(node_child_2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep3)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            ++ proc_t;
+        }
+
+        // 转发触发兄弟节点直连
+        std::string send_data = "transfer latency aware\n";
+        int count = recv_msg_history.count;
+        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+        for (int i = 0; i < 256 && count == recv_msg_history.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+        }
+
+        for (int i = 0; i < 512; ++i) {
+            atbus::endpoint* ep = node_child_1->get_endpoint(node_child_2->get_id());
+            if (NULL != ep && NULL != node_child_1->get_self_endpoint()->get_data_connection(ep)) {
+                break;
+            }
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+
+        atbus::endpoint* father_ep = node_child_1->get_endpoint(node_parent->get_id());
+        atbus::endpoint* brother_ep = node_child_1->get_endpoint(node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, father_ep);
+        CASE_EXPECT_NE(NULL, brother_ep);
+        if (NULL != father_ep && NULL != brother_ep) {
+            atbus::protocol::msg m;
+            m.init(node_child_1->get_id(), ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, node_child_1->alloc_msg_seq());
+            m.body.make_forward(node_child_1->get_id(), node_child_2->get_id(), send_data.data(), send_data.size());
+
+            // 没有延迟采样时直连
+            atbus::endpoint* route_ep = NULL;
+            atbus::connection* route_conn = NULL;
+            CASE_EXPECT_EQ(0, node_child_1->send_data_msg(node_child_2->get_id(), m, &route_ep, &route_conn));
+            CASE_EXPECT_EQ(brother_ep, route_ep);
+
+            // 直连的延迟超过经过父节点的估算值，改走父节点的话父节点每次转发都会通知直连
+            node_child_1->on_recv_rtt(*father_ep, NULL, 100000);
+            node_child_1->on_recv_rtt(*brother_ep, NULL, 500000);
+            CASE_EXPECT_EQ(100000, father_ep->get_stat_rtt());
+            CASE_EXPECT_EQ(500000, brother_ep->get_stat_rtt());
+
+            m.body.forward()->router.clear();
+            CASE_EXPECT_EQ(0, node_child_1->send_data_msg(node_child_2->get_id(), m, &route_ep, &route_conn));
+            CASE_EXPECT_EQ(brother_ep, route_ep);
+
+            // 平滑值逐渐接近采样
+            for (int i = 0; i < 32; ++i) {
+                node_child_1->on_recv_rtt(*brother_ep, NULL, 50000);
+            }
+            CASE_EXPECT_GT(200000, brother_ep->get_stat_rtt_jitter());
+
+            // 已经直连的目标再收到直连通知时不再发起连接，先等反向的数据连接也建立完
+            for (int i = 0; i < 64; ++i) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+
+            size_t conn_count_1 = brother_ep->get_data_connections().size();
+            atbus::endpoint* child_2_ep = node_parent->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* child_1_ep = node_child_2->get_endpoint(node_child_1->get_id());
+            CASE_EXPECT_NE(NULL, child_2_ep);
+            CASE_EXPECT_NE(NULL, child_1_ep);
+            if (NULL != child_2_ep && NULL != child_1_ep) {
+                size_t conn_count_2 = child_1_ep->get_data_connections().size();
+                for (int i = 0; i < 4; ++i) {
+                    CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::msg_handler::send_conn_syn(*node_parent, node_child_1->get_id(), *child_2_ep));
+                }
+
+                for (int i = 0; i < 64; ++i) {
+                    uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                    CASE_THREAD_SLEEP_MS(4);
                 }
+
+                CASE_EXPECT_EQ(conn_count_1, brother_ep->get_data_connections().size());
+                CASE_EXPECT_EQ(conn_count_2, child_1_ep->get_data_connections().size());
+            }
+
+            // 父节点在重试间隔内对同一对子节点只通知一次
+            CASE_EXPECT_TRUE(node_parent->on_relay_brother_data(node_child_2->get_id(), node_child_1->get_id()));
+            CASE_EXPECT_FALSE(node_parent->on_relay_brother_data(node_child_2->get_id(), node_child_1->get_id()));
+        }
+
+        for (int i = 0; i < 64; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 路由缓存测试，拓扑变化后缓存失效
+CASE_TEST(atbus_node_reg, route_cache)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node1->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
             }
+        }
 
-            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        std::string send_data;
+        send_data.assign("route cache\n", sizeof("route cache\n") - 1);
+
+        // 第一次查找，以后命中缓存
+        uint64_t hit_times = node1->get_stat().route_cache_hit_times;
+        uint64_t miss_times = node1->get_stat().route_cache_miss_times;
+        int count = recv_msg_history.count;
+        for (int i = 0; i < 3; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        }
+        for (int i = 0; i < 256 && count + 3 > recv_msg_history.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(count + 3, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        CASE_EXPECT_EQ(miss_times + 1, node1->get_stat().route_cache_miss_times);
+        CASE_EXPECT_EQ(hit_times + 2, node1->get_stat().route_cache_hit_times);
+
+        // 缓存失效以后重新查找
+        node1->invalidate_route_cache();
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && count == recv_msg_history.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
         }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(miss_times + 2, node1->get_stat().route_cache_miss_times);
+
+        // 断开以后不能再使用缓存的连接
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->disconnect(node2->get_id()));
+        CASE_EXPECT_EQ(NULL, node1->get_endpoint(node2->get_id()));
+        CASE_EXPECT_NE(EN_ATBUS_ERR_SUCCESS, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(hit_times + 2, node1->get_stat().route_cache_hit_times);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 兄弟节点通过多层父节点转发消息并不会建立直连测试
+CASE_TEST(atbus_node_reg, transfer_only)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+    
+    // 只有发生冲突才会注册不成功，否则会无限重试注册父节点，直到其上线
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_msg_test_on_debug;
+        node_parent_2->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
         
-        // 发消息啦 - child to parent
-        {
-            std::string send_data;
-            send_data.assign("child to parent\0hello world!\n", sizeof("child to parent\0hello world!\n") - 1);
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+        
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+        
+        // wait for register finished
+        for (int i = 0; i < 512; ++i) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent_1->get_id());
+            atbus::endpoint* ep2 = node_parent_1->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep3 = node_child_2->get_endpoint(node_parent_2->get_id());
+            atbus::endpoint* ep4 = node_parent_2->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* ep5 = node_parent_1->get_endpoint(node_parent_2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep4 && NULL != ep5 && 
+                NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1) &&
+                NULL != ep3->get_data_connection(ep4) && NULL != ep4->get_data_connection(ep3) &&
+                NULL != ep5->get_data_connection(ep3)) {
+                break;
+            }
             
-            count = recv_msg_history.count;
-            node_child->send_data(node_parent->get_id(), 0, send_data.data(), send_data.size());
-            for (int i = 0; i < 256; ++i) {
-                uv_run(conf.ev_loop, UV_RUN_ONCE);
-                CASE_THREAD_SLEEP_MS(16);
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            ++ proc_t;
+        }
+        
+        // 转发消息
+        std::string send_data;
+        send_data.assign("transfer through parent only\n", sizeof("transfer through parent only\n") - 1);
+        
+        int count = recv_msg_history.count;
+        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+        for (int i = 0; i < 512; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+            if (count != recv_msg_history.count) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+        for (int i = 0; i < 128; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+        
+        // 非直接子节点互相不建立直连
+        atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
+        CASE_EXPECT_EQ(NULL, ep1);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 跨子树的转发流量超过阈值后建立直连，空闲后断开
+CASE_TEST(atbus_node_reg, transfer_shortcut)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.shortcut_threshold = 4;
+    conf.shortcut_idle_timeout = 8;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent_1 = atbus::node::create();
+        atbus::node::ptr_t node_parent_2 = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        atbus::node::ptr_t node_child_2 = atbus::node::create();
+        node_parent_1->on_debug = node_msg_test_on_debug;
+        node_parent_2->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+        node_child_2->on_debug = node_msg_test_on_debug;
+
+        node_parent_1->init(0x12345678, &conf);
+        node_parent_2->init(0x12356789, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_child_2->init(0x12354678, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16390"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_parent_1->connect("ipv4://127.0.0.1:16388");
+
+        // wait for register finished
+        for (int i = 0; i < 512; ++i) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent_1->get_id());
+            atbus::endpoint* ep2 = node_parent_1->get_endpoint(node_child_1->get_id());
+            atbus::endpoint* ep3 = node_child_2->get_endpoint(node_parent_2->get_id());
+            atbus::endpoint* ep4 = node_parent_2->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* ep5 = node_parent_1->get_endpoint(node_parent_2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep4 && NULL != ep5 &&
+                NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1) &&
+                NULL != ep3->get_data_connection(ep4) && NULL != ep4->get_data_connection(ep3) &&
+                NULL != ep5->get_data_connection(ep3)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            ++ proc_t;
+        }
+
+        // 注册时声明能转发conn_syn
+        atbus::endpoint* fwd_ep = node_parent_2->get_endpoint(node_parent_1->get_id());
+        CASE_EXPECT_NE(NULL, fwd_ep);
+        if (NULL != fwd_ep) {
+            CASE_EXPECT_TRUE(fwd_ep->get_flag(atbus::endpoint::flag_t::CONN_SYN_FORWARD));
+        }
+
+        // 同一秒内的转发次数达到阈值，由最后一跳的父节点通知来源建立直连
+        std::string send_data;
+        send_data.assign("transfer through shortcut\n", sizeof("transfer through shortcut\n") - 1);
+        for (size_t i = 0; i < conf.shortcut_threshold; ++i) {
+            int count = recv_msg_history.count;
+            node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+            for (int j = 0; j < 512; ++j) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
                 if (count != recv_msg_history.count) {
                     break;
                 }
             }
-
             CASE_EXPECT_EQ(send_data, recv_msg_history.data);
         }
+        CASE_EXPECT_LT(0, node_parent_2->get_stat().shortcut_notify_times);
+
+        for (int i = 0; i < 512; ++i) {
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
+            atbus::endpoint* ep2 = node_child_2->get_endpoint(node_child_1->get_id());
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+        }
+
+        atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
+        atbus::endpoint* ep2 = node_child_2->get_endpoint(node_child_1->get_id());
+        CASE_EXPECT_NE(NULL, ep1);
+        CASE_EXPECT_NE(NULL, ep2);
+        if (NULL != ep1 && NULL != ep2) {
+            CASE_EXPECT_TRUE(ep1->get_flag(atbus::endpoint::flag_t::SHORTCUT));
+            CASE_EXPECT_TRUE(ep2->get_flag(atbus::endpoint::flag_t::SHORTCUT));
+        }
+        CASE_EXPECT_EQ(1, node_child_1->get_shortcut().size());
+        CASE_EXPECT_EQ(1, node_child_2->get_shortcut().size());
+
+        // 直连以后不再经过父节点
+        uint64_t relay_times = node_parent_2->get_stat().shortcut_notify_times;
+        int count = recv_msg_history.count;
+        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+        for (int i = 0; i < 512; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+            if (count != recv_msg_history.count) {
+                break;
+            }
+        }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(relay_times, node_parent_2->get_stat().shortcut_notify_times);
+
+        // 超过空闲时间后断开直连
+        proc_t += conf.shortcut_idle_timeout + 2;
+        for (int i = 0; i < 64; ++i) {
+            node_parent_1->proc(proc_t, 0);
+            node_parent_2->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+            node_child_2->proc(proc_t, 0);
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
+
+            if (node_child_1->get_shortcut().empty() && node_child_2->get_shortcut().empty()) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_TRUE(node_child_1->get_shortcut().empty());
+        CASE_EXPECT_TRUE(node_child_2->get_shortcut().empty());
+        CASE_EXPECT_LT(0, node_child_1->get_stat().shortcut_idle_times + node_child_2->get_stat().shortcut_idle_times);
+
+        // 下一跳不能转发conn_syn时不发送，老版本的节点会直接连接通知里的地址
+        fwd_ep = node_parent_2->get_endpoint(node_parent_1->get_id());
+        atbus::endpoint* target_ep = node_parent_2->get_endpoint(node_child_2->get_id());
+        CASE_EXPECT_NE(NULL, fwd_ep);
+        CASE_EXPECT_NE(NULL, target_ep);
+        if (NULL != fwd_ep && NULL != target_ep) {
+            fwd_ep->set_flag(atbus::endpoint::flag_t::CONN_SYN_FORWARD, false);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::msg_handler::send_conn_syn(*node_parent_2, node_child_1->get_id(), *target_ep));
+            for (int i = 0; i < 64; ++i) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+            CASE_EXPECT_EQ(NULL, node_child_1->get_endpoint(node_child_2->get_id()));
+
+            fwd_ep->set_flag(atbus::endpoint::flag_t::CONN_SYN_FORWARD, true);
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::msg_handler::send_conn_syn(*node_parent_2, node_child_1->get_id(), *target_ep));
+            for (int i = 0; i < 512 && node_child_1->get_shortcut().empty(); ++i) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+            CASE_EXPECT_EQ(1, node_child_1->get_shortcut().size());
+        }
     }
 
     node_msg_test_setup_exit(&ev_loop);
 }
 
-// 兄弟节点通过父节点转发消息并建立直连测试（测试路由）
-CASE_TEST(atbus_node_reg, transfer_and_connect)
+static bool node_msg_test_wait_endpoint(atbus::node::ptr_t* nodes, size_t sz, time_t& proc_t, uv_loop_t* ev,
+    const atbus::node::ptr_t& from, const atbus::node::ptr_t& to) {
+    for (int i = 0; i < 512; ++i) {
+        atbus::endpoint* ep1 = from->get_endpoint(to->get_id());
+        atbus::endpoint* ep2 = to->get_endpoint(from->get_id());
+        if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+            return true;
+        }
+
+        for (size_t j = 0; j < sz; ++j) {
+            nodes[j]->proc(proc_t, 0);
+        }
+        uv_run(ev, UV_RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(4);
+        ++ proc_t;
+    }
+
+    return false;
+}
+
+// 兄弟节点的下级的直连，和已经直连的兄弟节点子域重叠时按跨子树直连处理
+// F(0x12345678)
+//   - B(0x12346789)
+//       - C(0x12346701)
+//   - S1(0x12343301)
+//   - S2(0x12343401)
+CASE_TEST(atbus_node_reg, transfer_shortcut_nested)
 {
     atbus::node::conf_t conf;
     atbus::node::default_conf(&conf);
     conf.children_mask = 16;
+    conf.shortcut_threshold = 4;
     uv_loop_t ev_loop;
     uv_loop_init(&ev_loop);
 
-    conf.ev_loop = &ev_loop;
-    
-    // 只有发生冲突才会注册不成功，否则会无限重试注册父节点，直到其上线
+    conf.ev_loop = &ev_loop;
+
     {
-        atbus::node::ptr_t node_parent = atbus::node::create();
-        atbus::node::ptr_t node_child_1 = atbus::node::create();
-        atbus::node::ptr_t node_child_2 = atbus::node::create();
-        node_parent->on_debug = node_msg_test_on_debug;
-        node_child_1->on_debug = node_msg_test_on_debug;
-        node_child_2->on_debug = node_msg_test_on_debug;
+        atbus::node::ptr_t nodes[5];
+        for (size_t i = 0; i < 5; ++i) {
+            nodes[i] = atbus::node::create();
+            nodes[i]->on_debug = node_msg_test_on_debug;
+        }
+
+        atbus::node::ptr_t& node_f = nodes[0];
+        atbus::node::ptr_t& node_b = nodes[1];
+        atbus::node::ptr_t& node_c = nodes[2];
+        atbus::node::ptr_t& node_s1 = nodes[3];
+        atbus::node::ptr_t& node_s2 = nodes[4];
+
+        node_f->init(0x12345678, &conf);
 
-        node_parent->init(0x12345678, &conf);
-        
         conf.children_mask = 8;
         conf.father_address = "ipv4://127.0.0.1:16387";
-        node_child_1->init(0x12346789, &conf);
-        node_child_2->init(0x12346890, &conf);
-        
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->listen("ipv4://127.0.0.1:16389"));
+        node_b->init(0x12346789, &conf);
 
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
-        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_2->start());
+        conf.children_mask = 0;
+        node_s1->init(0x12343301, &conf);
+        node_s2->init(0x12343401, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_c->init(0x12346701, &conf);
 
-        time_t proc_t = time(NULL) + 1;
-        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
-        node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
-        
-        // wait for register finished
-        for (int i = 0; i < 256; ++i) {
-            node_parent->proc(proc_t, 0);
-            node_child_1->proc(proc_t, 0);
-            node_child_2->proc(proc_t, 0);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_f->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_b->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s1->listen("ipv4://127.0.0.1:16390"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s2->listen("ipv4://127.0.0.1:16391"));
 
-            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent->get_id());
-            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_1->get_id());
-            atbus::endpoint* ep3 = node_parent->get_endpoint(node_child_2->get_id());
+        for (size_t i = 0; i < 5; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, nodes[i]->start());
+        }
 
-            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep3)) {
-                break;
-            }
-            
-            uv_run(conf.ev_loop, UV_RUN_ONCE);
-            ++ proc_t;
+        time_t proc_t = time(NULL) + 1;
+        node_c->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_b, node_f));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_c, node_b));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s1, node_f));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s2, node_f));
+
+        // 先直连兄弟节点B，再直连B的子节点C
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s1->connect("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s1, node_b));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s1->connect("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s1, node_c));
+
+        CASE_EXPECT_EQ(1, node_s1->get_shortcut().size());
+        atbus::endpoint* ep_c = node_s1->get_endpoint(node_c->get_id());
+        CASE_EXPECT_NE(NULL, ep_c);
+        if (NULL != ep_c) {
+            CASE_EXPECT_TRUE(ep_c->get_flag(atbus::endpoint::flag_t::SHORTCUT));
         }
-        
-        // 转发消息
+        atbus::endpoint* ep_b = node_s1->get_endpoint(node_b->get_id());
+        CASE_EXPECT_NE(NULL, ep_b);
+        if (NULL != ep_b) {
+            CASE_EXPECT_FALSE(ep_b->get_flag(atbus::endpoint::flag_t::SHORTCUT));
+        }
+
+        // 发往C的消息走直连而不是经过B转发
+        atbus::endpoint* route_ep = NULL;
+        atbus::connection* route_conn = NULL;
+        bool cache_hit = false;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s1->find_route(node_c->get_id(), &atbus::endpoint::get_data_connection, false,
+            route_ep, route_conn, cache_hit));
+        CASE_EXPECT_EQ(ep_c, route_ep);
+
         std::string send_data;
-        send_data.assign("transfer through parent\n", sizeof("transfer through parent\n") - 1);
-        
+        send_data.assign("transfer through nested shortcut\n", sizeof("transfer through nested shortcut\n") - 1);
         int count = recv_msg_history.count;
-        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
-        for (int i = 0; i < 256; ++i) {
-            uv_run(conf.ev_loop, UV_RUN_ONCE);
-            CASE_THREAD_SLEEP_MS(16);
-            if (count != recv_msg_history.count) {
-                break;
-            }
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s1->send_data(node_c->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 512 && count == recv_msg_history.count; ++i) {
+            uv_run(&ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(4);
         }
-
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
         CASE_EXPECT_EQ(send_data, recv_msg_history.data);
-        
-        // 自动直连测试
-        for (int i = 0; i < 512 && NULL == node_child_1->get_endpoint(node_child_2->get_id()); ++i) {
-            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
-            CASE_THREAD_SLEEP_MS(8);
+        CASE_EXPECT_EQ(node_c->get_endpoint(node_s1->get_id()), recv_msg_history.ep);
+
+        // 先直连C，再直连C的父节点B时，C改为跨子树直连
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s2->connect("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s2, node_c));
+        CASE_EXPECT_TRUE(node_s2->get_shortcut().empty());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_s2->connect("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_TRUE(node_msg_test_wait_endpoint(nodes, 5, proc_t, &ev_loop, node_s2, node_b));
+
+        CASE_EXPECT_EQ(1, node_s2->get_shortcut().size());
+        ep_c = node_s2->get_endpoint(node_c->get_id());
+        CASE_EXPECT_NE(NULL, ep_c);
+        if (NULL != ep_c) {
+            CASE_EXPECT_TRUE(ep_c->get_flag(atbus::endpoint::flag_t::SHORTCUT));
         }
-        atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
-        CASE_EXPECT_NE(NULL, ep1);
+        CASE_EXPECT_NE(NULL, node_s2->get_endpoint(node_b->get_id()));
     }
 
     node_msg_test_setup_exit(&ev_loop);
 }
 
-// 兄弟节点通过多层父节点转发消息并不会建立直连测试
-CASE_TEST(atbus_node_reg, transfer_only)
+// 超过单个消息长度限制的数据分片转发测试
+CASE_TEST(atbus_node_reg, transfer_fragment)
 {
     atbus::node::conf_t conf;
     atbus::node::default_conf(&conf);
     conf.children_mask = 16;
+    conf.msg_size = 4096;
+    conf.send_buffer_size = 0;
     uv_loop_t ev_loop;
     uv_loop_init(&ev_loop);
 
     conf.ev_loop = &ev_loop;
-    
-    // 只有发生冲突才会注册不成功，否则会无限重试注册父节点，直到其上线
+
     {
         atbus::node::ptr_t node_parent_1 = atbus::node::create();
         atbus::node::ptr_t node_parent_2 = atbus::node::create();
@@ -507,13 +2687,13 @@ CASE_TEST(atbus_node_reg, transfer_only)
 
         node_parent_1->init(0x12345678, &conf);
         node_parent_2->init(0x12356789, &conf);
-        
+
         conf.children_mask = 8;
         conf.father_address = "ipv4://127.0.0.1:16387";
         node_child_1->init(0x12346789, &conf);
         conf.father_address = "ipv4://127.0.0.1:16388";
         node_child_2->init(0x12354678, &conf);
-        
+
         CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_1->listen("ipv4://127.0.0.1:16387"));
         CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent_2->listen("ipv4://127.0.0.1:16388"));
         CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16389"));
@@ -528,7 +2708,7 @@ CASE_TEST(atbus_node_reg, transfer_only)
         node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
         node_child_2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
         node_parent_1->connect("ipv4://127.0.0.1:16388");
-        
+
         // wait for register finished
         for (int i = 0; i < 512; ++i) {
             node_parent_1->proc(proc_t, 0);
@@ -542,23 +2722,36 @@ CASE_TEST(atbus_node_reg, transfer_only)
             atbus::endpoint* ep4 = node_parent_2->get_endpoint(node_child_2->get_id());
             atbus::endpoint* ep5 = node_parent_1->get_endpoint(node_parent_2->get_id());
 
-            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep4 && NULL != ep5 && 
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep4 && NULL != ep5 &&
                 NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1) &&
                 NULL != ep3->get_data_connection(ep4) && NULL != ep4->get_data_connection(ep3) &&
                 NULL != ep5->get_data_connection(ep3)) {
                 break;
             }
-            
+
             uv_run(conf.ev_loop, UV_RUN_ONCE);
             ++ proc_t;
         }
-        
-        // 转发消息
+
         std::string send_data;
-        send_data.assign("transfer through parent only\n", sizeof("transfer through parent only\n") - 1);
-        
+        for (size_t i = 0; send_data.size() < 5 * conf.msg_size; ++i) {
+            send_data += static_cast<char>('a' + i % 26);
+        }
+
+        // 发给自己的不需要分片
         int count = recv_msg_history.count;
-        node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size());
+        CASE_EXPECT_EQ(0, node_child_1->send_data(node_child_1->get_id(), 0, send_data.data(), send_data.size()));
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+
+        // 超出分片限制
+        atbus::node::conf_t small_conf = node_child_1->get_conf();
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), small_conf.fragment_max_size + 1));
+
+        // 经过两个父节点转发分片
+        recv_msg_history.data.clear();
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node_child_1->send_data(node_child_2->get_id(), 0, send_data.data(), send_data.size()));
         for (int i = 0; i < 512; ++i) {
             uv_run(conf.ev_loop, UV_RUN_NOWAIT);
             CASE_THREAD_SLEEP_MS(8);
@@ -567,15 +2760,178 @@ CASE_TEST(atbus_node_reg, transfer_only)
             }
         }
 
+        // 重组后只回调一次
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
         CASE_EXPECT_EQ(send_data, recv_msg_history.data);
-        for (int i = 0; i < 128; ++i) {
+        CASE_EXPECT_TRUE(node_child_2->get_id() == recv_msg_history.n->get_id());
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+// 默认配置下最大的分片数据能一次发完，发送缓冲区放不下时一个分片都不发
+CASE_TEST(atbus_node_reg, transfer_fragment_default_conf)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        atbus::node::ptr_t node2 = atbus::node::create();
+        atbus::node::ptr_t node3 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node2->on_debug = node_msg_test_on_debug;
+        node3->on_debug = node_msg_test_on_debug;
+
+        node1->init(0x12345678, &conf);
+        node2->init(0x12356789, &conf);
+
+        atbus::node::conf_t small_conf = conf;
+        small_conf.send_buffer_size = small_conf.msg_size * 4;
+        node3->init(0x12367890, &small_conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node2->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node3->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        node2->proc(proc_t, 0);
+        node2->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node1->connect("ipv4://127.0.0.1:16388");
+        node3->connect("ipv4://127.0.0.1:16388");
+
+        for (int i = 0; i < 256; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+            CASE_THREAD_SLEEP_MS(16);
+
+            atbus::endpoint* ep1 = node2->get_endpoint(node1->get_id());
+            atbus::endpoint* ep2 = node1->get_endpoint(node2->get_id());
+            atbus::endpoint* ep3 = node3->get_endpoint(node2->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep3 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1) &&
+                NULL != node3->get_self_endpoint()->get_data_connection(ep3)) {
+                break;
+            }
+        }
+
+        CASE_EXPECT_LE(conf.fragment_max_size, conf.send_buffer_size);
+        std::string send_data;
+        for (size_t i = 0; send_data.size() < conf.fragment_max_size; ++i) {
+            send_data += static_cast<char>('a' + i % 26);
+        }
+
+        recv_msg_history.data.clear();
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node1->send_data(node2->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 512 && count == recv_msg_history.count; ++i) {
             uv_run(conf.ev_loop, UV_RUN_NOWAIT);
-            CASE_THREAD_SLEEP_MS(4);
+            CASE_THREAD_SLEEP_MS(8);
         }
-        
-        // 非直接子节点互相不建立直连
-        atbus::endpoint* ep1 = node_child_1->get_endpoint(node_child_2->get_id());
-        CASE_EXPECT_EQ(NULL, ep1);
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_TRUE(send_data == recv_msg_history.data);
+
+        // 发送缓冲区放不下所有分片时在发送前失败
+        uint64_t route_times = node3->get_stat().route_cache_hit_times + node3->get_stat().route_cache_miss_times;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BUFF_LIMIT, node3->send_data(node2->get_id(), 0, send_data.data(), small_conf.msg_size * 8));
+        CASE_EXPECT_EQ(route_times, node3->get_stat().route_cache_hit_times + node3->get_stat().route_cache_miss_times);
+
+        // 能放下时正常发送
+        recv_msg_history.data.clear();
+        count = recv_msg_history.count;
+        CASE_EXPECT_EQ(0, node3->send_data(node2->get_id(), 0, send_data.data(), small_conf.msg_size * 2));
+        for (int i = 0; i < 512 && count == recv_msg_history.count; ++i) {
+            uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_TRUE(send_data.substr(0, small_conf.msg_size * 2) == recv_msg_history.data);
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
+static int node_msg_test_recv_fragment(atbus::node& n, uint32_t sequence, const std::string& data, size_t offset, size_t len) {
+    std::vector<unsigned char> content(atbus::protocol::fragment_encoding_t::HEAD_SIZE + len);
+    atbus::protocol::fragment_pack_head(&content[0], static_cast<uint32_t>(data.size()), static_cast<uint32_t>(offset));
+    memcpy(&content[atbus::protocol::fragment_encoding_t::HEAD_SIZE], data.data() + offset, len);
+
+    atbus::protocol::msg m;
+    m.init(0x12356789, ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, sequence);
+    m.body.make_body<atbus::protocol::forward_data>();
+    m.body.forward()->from = 0x12356789;
+    m.body.forward()->to = n.get_id();
+    m.body.forward()->content.ptr = &content[0];
+    m.body.forward()->content.size = content.size();
+    m.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_FRAGMENT);
+
+    return n.on_recv_fragment(NULL, NULL, m);
+}
+
+// 重复、重叠的分片和序号复用后旧的超时定时器不能破坏重组
+CASE_TEST(atbus_node_reg, transfer_fragment_duplicated)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.fragment_timeout = 10;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node1 = atbus::node::create();
+        node1->on_debug = node_msg_test_on_debug;
+        node1->init(0x12345678, &conf);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node1->start());
+        node1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+
+        std::string send_data;
+        for (int i = 0; i < 300; ++i) {
+            send_data += static_cast<char>('a' + i % 26);
+        }
+
+        time_t proc_t = time(NULL) + 1;
+        node1->proc(proc_t, 0);
+        int count = recv_msg_history.count;
+
+        // 重复的分片忽略，重叠的分片丢弃整个重组，之后的分片也不再接受
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 0, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 0, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BAD_DATA, node_msg_test_recv_fragment(*node1, 1, send_data, 50, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BAD_DATA, node_msg_test_recv_fragment(*node1, 1, send_data, 100, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BAD_DATA, node_msg_test_recv_fragment(*node1, 1, send_data, 200, 100));
+        CASE_EXPECT_EQ(count, recv_msg_history.count);
+
+        // 同一个序号的新重组不受前一次的超时定时器影响
+        node1->proc(proc_t + 5, 0);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 0, 100));
+        node1->proc(proc_t + 11, 0);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 100, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 100, 100));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 1, send_data, 200, 100));
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+
+        // 已完成重组后迟到的分片不会再次回调
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BAD_DATA, node_msg_test_recv_fragment(*node1, 1, send_data, 200, 100));
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+
+        // 超时后未完成的重组被清理
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_msg_test_recv_fragment(*node1, 2, send_data, 0, 100));
+        node1->proc(proc_t + 22, 0);
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_BAD_DATA, node_msg_test_recv_fragment(*node1, 2, send_data, 100, 100));
     }
 
     node_msg_test_setup_exit(&ev_loop);
@@ -690,6 +3046,106 @@ CASE_TEST(atbus_node_reg, transfer_failed)
     }
 }
 
+// router的容量固定为ATBUS_MACRO_ROUTER_MAX_DEPTH，填满以后转发按ttl超限回复通知
+CASE_TEST(atbus_node_reg, transfer_router_full)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    // ttl大于router的容量，只有router满了才会拒绝转发
+    conf.ttl = ATBUS_MACRO_ROUTER_MAX_DEPTH + 8;
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t node_parent = atbus::node::create();
+        atbus::node::ptr_t node_child_1 = atbus::node::create();
+        node_parent->on_debug = node_msg_test_on_debug;
+        node_child_1->on_debug = node_msg_test_on_debug;
+
+        node_parent->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_child_1->init(0x12346789, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->listen("ipv4://127.0.0.1:16388"));
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_parent->start());
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_child_1->start());
+
+        time_t proc_t = time(NULL) + 1;
+        node_child_1->set_on_recv_handle(node_msg_test_recv_msg_test_record_fn);
+        node_child_1->set_on_send_data_failed_handle(node_msg_test_send_data_failed_fn);
+
+        // wait for register finished
+        for (int i = 0; i < 256; ++i) {
+            node_parent->proc(proc_t, 0);
+            node_child_1->proc(proc_t, 0);
+
+            atbus::endpoint* ep1 = node_child_1->get_endpoint(node_parent->get_id());
+            atbus::endpoint* ep2 = node_parent->get_endpoint(node_child_1->get_id());
+
+            if (NULL != ep1 && NULL != ep2 && NULL != ep1->get_data_connection(ep2) && NULL != ep2->get_data_connection(ep1)) {
+                break;
+            }
+
+            uv_run(conf.ev_loop, UV_RUN_ONCE);
+
+            ++ proc_t;
+        }
+
+        atbus::endpoint* child_ep = node_parent->get_endpoint(node_child_1->get_id());
+        atbus::connection* conn = NULL;
+        CASE_EXPECT_NE(NULL, child_ep);
+        if (NULL != child_ep) {
+            conn = node_parent->get_self_endpoint()->get_data_connection(child_ep);
+        }
+        CASE_EXPECT_NE(NULL, conn);
+
+        std::string send_data;
+        send_data.assign("transfer with full router\n", sizeof("transfer with full router\n") - 1);
+
+        // 还剩一个位置时，父节点追加自己以后正常转发
+        for (int full = 0; NULL != conn && full < 2; ++full) {
+            // 模拟经过多次转发以后从其他节点收到的消息
+            atbus::protocol::msg m;
+            m.init(0x12356789, ATBUS_CMD_DATA_TRANSFORM_REQ, 0, 0, node_child_1->alloc_msg_seq());
+            atbus::protocol::forward_data* fwd = m.body.make_forward(node_child_1->get_id(), node_child_1->get_id(),
+                send_data.data(), send_data.size());
+            CASE_EXPECT_NE(NULL, fwd);
+            if (NULL == fwd) {
+                break;
+            }
+            while (fwd->router.size() + (full ? 0 : 1) < fwd->router.max_size()) {
+                fwd->router.push_back(0x12346700 + fwd->router.size());
+            }
+            CASE_EXPECT_EQ(1 == full, fwd->router.full());
+
+            int count = recv_msg_history.count;
+            recv_msg_history.status = 0;
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, atbus::msg_handler::on_recv_data_transfer_req(*node_parent, conn, m, 0, 0));
+            for (int i = 0; i < 512 && count == recv_msg_history.count; ++i) {
+                uv_run(conf.ev_loop, UV_RUN_NOWAIT);
+                CASE_THREAD_SLEEP_MS(4);
+            }
+
+            CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+            CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+            if (full) {
+                CASE_EXPECT_EQ(EN_ATBUS_ERR_ATNODE_TTL, recv_msg_history.status);
+            } else {
+                CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, recv_msg_history.status);
+            }
+        }
+    }
+
+    node_msg_test_setup_exit(&ev_loop);
+}
+
 // TODO 发送给已下线兄弟节点并失败的回复通知测试（网络失败）
 
 
@@ -22,8 +22,10 @@
 
 #include <stdarg.h>
 
-#if 0
-static void node_nodesync_test_on_debug(const char* file_path, size_t line, const atbus::node& n, const atbus::endpoint* ep, const atbus::connection* conn, const char* fmt, ...) {
+static void node_nodesync_test_on_debug(const char* file_path, size_t line, 
+    const atbus::node& n, const atbus::endpoint* ep, const atbus::connection* conn, 
+    const atbus::protocol::msg* m,
+    const char* fmt, ...) {
     size_t offset = 0;
     for (size_t i = 0; file_path[i]; ++i) {
         if ('/' == file_path[i] || '\\' == file_path[i]) {
@@ -62,11 +64,11 @@ struct node_nodesync_test_recv_msg_record_t {
 
 static node_nodesync_test_recv_msg_record_t recv_msg_history;
 
-static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node& n, const atbus::endpoint& ep, const atbus::connection& conn, 
+static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node& n, const atbus::endpoint* ep, const atbus::connection* conn, 
     int status, const void* buffer, size_t len) {
     recv_msg_history.n = &n;
-    recv_msg_history.ep = &ep;
-    recv_msg_history.conn = &conn;
+    recv_msg_history.ep = ep;
+    recv_msg_history.conn = conn;
     recv_msg_history.status = status;
     ++recv_msg_history.count;
 
@@ -79,7 +81,237 @@ static int node_nodesync_test_recv_msg_test_record_fn(const atbus::node& n, cons
     return 0;
 }
 
-// TODO 全量表第一次拉取测试
-// TODO 全量表通知给父节点和子节点测试
+static void node_nodesync_test_setup_exit(uv_loop_t* ev) {
+    size_t left_tick = 128 * 30; // 30s
+    while (left_tick > 0 && UV_EBUSY == uv_loop_close(ev)) {
+        uv_run(ev, UV_RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+        
+        -- left_tick;
+    }
+    
+    CASE_EXPECT_NE(left_tick, 0);
+}
 
-#endif
+static void node_nodesync_test_procs(atbus::node::ptr_t* nodes, size_t sz, time_t sec, uv_loop_t* ev) {
+    for (size_t i = 0; i < sz; ++i) {
+        if (nodes[i]) {
+            nodes[i]->proc(sec, 0);
+        }
+    }
+
+    uv_run(ev, UV_RUN_NOWAIT);
+    CASE_THREAD_SLEEP_MS(4);
+}
+
+static bool node_nodesync_test_has_node(const atbus::node::ptr_t& n, atbus::node::bus_id_t id) {
+    const atbus::node::sync_node_t* sn = n->get_sync_node(id);
+    return NULL != sn && false == sn->removed;
+}
+
+// 全量表第一次拉取测试
+// R(0x12345678, 全局)
+//   - F1(0x12346789, 全局)
+//       - C11(0x12346701)
+//   - F2(0x12347890, 全局)
+//       - C21(0x12347801)
+CASE_TEST(atbus_node_nodesync, full_sync)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t nodes[5];
+        for (size_t i = 0; i < 5; ++i) {
+            nodes[i] = atbus::node::create();
+            nodes[i]->on_debug = node_nodesync_test_on_debug;
+        }
+
+        atbus::node::ptr_t& node_root = nodes[0];
+        atbus::node::ptr_t& node_f1 = nodes[1];
+        atbus::node::ptr_t& node_f2 = nodes[2];
+        atbus::node::ptr_t& node_c11 = nodes[3];
+        atbus::node::ptr_t& node_c21 = nodes[4];
+
+        node_root->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_f1->init(0x12346789, &conf);
+        node_f2->init(0x12347890, &conf);
+
+        conf.children_mask = 0;
+        conf.flags.reset(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+        conf.father_address = "ipv4://127.0.0.1:16388";
+        node_c11->init(0x12346701, &conf);
+        conf.father_address = "ipv4://127.0.0.1:16389";
+        node_c21->init(0x12347801, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_root->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_f1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_f2->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c11->listen("ipv4://127.0.0.1:16390"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c21->listen("ipv4://127.0.0.1:16391"));
+
+        for (size_t i = 0; i < 5; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, nodes[i]->start());
+        }
+
+        // 每个节点一开始都只有自己
+        CASE_EXPECT_EQ(1, node_root->get_sync_node_count());
+        CASE_EXPECT_EQ(1, node_c11->get_sync_node_count());
+
+        time_t proc_t = time(NULL) + 1;
+        node_c21->set_on_recv_handle(node_nodesync_test_recv_msg_test_record_fn);
+
+        // 等待全局路由表同步完成并且兄弟节点直连
+        for (int i = 0; i < 512; ++i) {
+            node_nodesync_test_procs(nodes, 5, proc_t, &ev_loop);
+
+            if (5 == node_root->get_sync_node_count() && 5 == node_f1->get_sync_node_count() &&
+                5 == node_f2->get_sync_node_count() && NULL != node_f1->get_endpoint(node_f2->get_id())) {
+                break;
+            }
+
+            ++ proc_t;
+        }
+
+        // 父节点收到子树上报
+        CASE_EXPECT_EQ(5, node_root->get_sync_node_count());
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_root, node_c11->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_root, node_c21->get_id()));
+
+        // 子节点拉取到全量表
+        CASE_EXPECT_EQ(5, node_f1->get_sync_node_count());
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_f1, node_c21->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_f1, node_f2->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_f2, node_c11->get_id()));
+        if (NULL != node_f1->get_sync_node(node_c21->get_id())) {
+            CASE_EXPECT_EQ(node_root->get_id(), node_f1->get_sync_node(node_c21->get_id())->source);
+        }
+        CASE_EXPECT_GT(node_f1->get_stat().node_sync_recv_times, 0);
+        CASE_EXPECT_GT(node_root->get_stat().node_sync_full_times, 0);
+
+        // 有全局路由表的兄弟节点直接连接
+        CASE_EXPECT_NE(NULL, node_f1->get_endpoint(node_f2->get_id()));
+
+        // 没有全局路由表的节点只有自己
+        CASE_EXPECT_EQ(1, node_c11->get_sync_node_count());
+        CASE_EXPECT_EQ(1, node_c21->get_sync_node_count());
+
+        // 跨子树发送
+        std::string send_data;
+        send_data.assign("nodesync full sync\n", sizeof("nodesync full sync\n") - 1);
+
+        int count = recv_msg_history.count;
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c11->send_data(node_c21->get_id(), 0, send_data.data(), send_data.size()));
+        for (int i = 0; i < 256 && count == recv_msg_history.count; ++i) {
+            node_nodesync_test_procs(nodes, 5, proc_t, &ev_loop);
+        }
+
+        CASE_EXPECT_EQ(count + 1, recv_msg_history.count);
+        CASE_EXPECT_EQ(send_data, recv_msg_history.data);
+    }
+
+    node_nodesync_test_setup_exit(&ev_loop);
+}
+
+// 全量表通知给父节点和子节点测试
+CASE_TEST(atbus_node_nodesync, delta_sync)
+{
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 16;
+    conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    conf.ev_loop = &ev_loop;
+
+    {
+        atbus::node::ptr_t nodes[5];
+        for (size_t i = 0; i < 5; ++i) {
+            nodes[i] = atbus::node::create();
+            nodes[i]->on_debug = node_nodesync_test_on_debug;
+        }
+
+        atbus::node::ptr_t& node_root = nodes[0];
+        atbus::node::ptr_t& node_f1 = nodes[1];
+        atbus::node::ptr_t& node_f2 = nodes[2];
+        atbus::node::ptr_t& node_c21 = nodes[3];
+        atbus::node::ptr_t& node_c22 = nodes[4];
+
+        node_root->init(0x12345678, &conf);
+
+        conf.children_mask = 8;
+        conf.father_address = "ipv4://127.0.0.1:16387";
+        node_f1->init(0x12346789, &conf);
+        node_f2->init(0x12347890, &conf);
+
+        conf.children_mask = 0;
+        conf.flags.reset(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+        conf.father_address = "ipv4://127.0.0.1:16389";
+        node_c21->init(0x12347801, &conf);
+        node_c22->init(0x12347802, &conf);
+
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_root->listen("ipv4://127.0.0.1:16387"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_f1->listen("ipv4://127.0.0.1:16388"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_f2->listen("ipv4://127.0.0.1:16389"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c21->listen("ipv4://127.0.0.1:16390"));
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c22->listen("ipv4://127.0.0.1:16391"));
+
+        // C22稍后再上线
+        for (size_t i = 0; i < 4; ++i) {
+            CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, nodes[i]->start());
+        }
+
+        time_t proc_t = time(NULL) + 1;
+        for (int i = 0; i < 512; ++i) {
+            node_nodesync_test_procs(nodes, 4, proc_t, &ev_loop);
+
+            if (4 == node_root->get_sync_node_count() && 4 == node_f1->get_sync_node_count()) {
+                break;
+            }
+
+            ++ proc_t;
+        }
+        CASE_EXPECT_EQ(4, node_f1->get_sync_node_count());
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_f1, node_c21->get_id()));
+
+        uint64_t full_times = node_root->get_stat().node_sync_full_times;
+        uint64_t version = node_f1->get_sync_version();
+
+        // 新增节点以增量同步下发
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_SUCCESS, node_c22->start());
+        for (int i = 0; i < 512 && false == node_nodesync_test_has_node(node_f1, node_c22->get_id()); ++i) {
+            node_nodesync_test_procs(nodes, 5, proc_t, &ev_loop);
+            ++ proc_t;
+        }
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_root, node_c22->get_id()));
+        CASE_EXPECT_TRUE(node_nodesync_test_has_node(node_f1, node_c22->get_id()));
+        CASE_EXPECT_EQ(5, node_f1->get_sync_node_count());
+        CASE_EXPECT_GT(node_f1->get_sync_version(), version);
+        CASE_EXPECT_EQ(full_times, node_root->get_stat().node_sync_full_times);
+
+        // 移除节点以增量同步下发
+        version = node_f1->get_sync_version();
+        node_c21->reset();
+        for (int i = 0; i < 512 && node_nodesync_test_has_node(node_f1, node_c21->get_id()); ++i) {
+            node_nodesync_test_procs(nodes, 5, proc_t, &ev_loop);
+            ++ proc_t;
+        }
+        CASE_EXPECT_FALSE(node_nodesync_test_has_node(node_root, node_c21->get_id()));
+        CASE_EXPECT_FALSE(node_nodesync_test_has_node(node_f1, node_c21->get_id()));
+        CASE_EXPECT_EQ(4, node_f1->get_sync_node_count());
+        CASE_EXPECT_GT(node_f1->get_sync_version(), version);
+        CASE_EXPECT_EQ(full_times, node_root->get_stat().node_sync_full_times);
+    }
+
+    node_nodesync_test_setup_exit(&ev_loop);
+}
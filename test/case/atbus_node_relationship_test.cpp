@@ -16,6 +16,7 @@
 #include <atbus_node.h>
 
 #include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
 
 #include "frame/test_macros.h"
 
@@ -28,7 +29,7 @@ CASE_TEST(atbus_node_rela, basic_test)
     {
         m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 123, 0, 13);
         m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
-        m_src.body.forward->router.push_back(210);
+        m_src.body.forward()->router.push_back(210);
 
         std::stringstream ss;
         msgpack::pack(ss, m_src);
@@ -53,13 +54,105 @@ CASE_TEST(atbus_node_rela, basic_test)
         CASE_EXPECT_EQ(13, m_dst.head.sequence);
         CASE_EXPECT_EQ(0x12345678, m_dst.head.src_bus_id);
 
-        CASE_EXPECT_EQ(456, m_dst.body.forward->from);
-        CASE_EXPECT_EQ(789, m_dst.body.forward->to);
-        CASE_EXPECT_EQ(210, m_dst.body.forward->router.front());
-        CASE_EXPECT_EQ(0, UTIL_STRFUNC_STRNCMP(test_buffer, reinterpret_cast<const char*>(m_dst.body.forward->content.ptr), sizeof(test_buffer)));
+        CASE_EXPECT_EQ(456, m_dst.body.forward()->from);
+        CASE_EXPECT_EQ(789, m_dst.body.forward()->to);
+        CASE_EXPECT_EQ(210, m_dst.body.forward()->router.front());
+        CASE_EXPECT_EQ(0, UTIL_STRFUNC_STRNCMP(test_buffer, reinterpret_cast<const char*>(m_dst.body.forward()->content.ptr), sizeof(test_buffer)));
     }
 }
 
+CASE_TEST(atbus_node_rela, binary_encoding)
+{
+    atbus::protocol::msg m_src, m_dst;
+    char test_buffer[] = "hello world!";
+    char packed_buffer[256];
+
+    m_src.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_RSP, 123, -5, 13);
+    m_src.body.make_forward(456, 789, test_buffer, sizeof(test_buffer));
+    m_src.body.forward()->router.push_back(210);
+    m_src.body.forward()->router.push_back(0x1234567890ULL);
+    m_src.body.forward()->set_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP);
+    CASE_EXPECT_TRUE(atbus::protocol::binary_support(m_src));
+
+    size_t packed_size = atbus::protocol::binary_pack(m_src, packed_buffer, sizeof(packed_buffer));
+    CASE_EXPECT_EQ(atbus::protocol::binary_packed_size(m_src), packed_size);
+    CASE_EXPECT_EQ(48 + 2 * 8 + sizeof(test_buffer), packed_size);
+    CASE_EXPECT_EQ(0, atbus::protocol::binary_pack(m_src, packed_buffer, packed_size - 1));
+    CASE_EXPECT_TRUE(atbus::protocol::binary_is_packed(packed_buffer, packed_size));
+
+    CASE_EXPECT_TRUE(atbus::protocol::binary_unpack(m_dst, packed_buffer, packed_size));
+    CASE_EXPECT_EQ(ATBUS_CMD_DATA_TRANSFORM_RSP, m_dst.head.cmd);
+    CASE_EXPECT_EQ(123, m_dst.head.type);
+    CASE_EXPECT_EQ(-5, m_dst.head.ret);
+    CASE_EXPECT_EQ(13, m_dst.head.sequence);
+    CASE_EXPECT_EQ(0x12345678, m_dst.head.src_bus_id);
+    CASE_EXPECT_EQ(456, m_dst.body.forward()->from);
+    CASE_EXPECT_EQ(789, m_dst.body.forward()->to);
+    CASE_EXPECT_EQ(2, m_dst.body.forward()->router.size());
+    CASE_EXPECT_EQ(0x1234567890ULL, m_dst.body.forward()->router.back());
+    CASE_EXPECT_TRUE(m_dst.body.forward()->check_flag(atbus::protocol::forward_data::FLAG_REQUIRE_RSP));
+    CASE_EXPECT_EQ(sizeof(test_buffer), m_dst.body.forward()->content.size);
+    CASE_EXPECT_EQ(0, UTIL_STRFUNC_STRNCMP(test_buffer, reinterpret_cast<const char*>(m_dst.body.forward()->content.ptr), sizeof(test_buffer)));
+
+    // 长度不匹配
+    CASE_EXPECT_FALSE(atbus::protocol::binary_unpack(m_dst, packed_buffer, packed_size - 1));
+
+    // msgpack编码的消息不会被识别为二进制编码
+    std::stringstream ss;
+    msgpack::pack(ss, m_src);
+    std::string msgpack_buffer = ss.str();
+    CASE_EXPECT_FALSE(atbus::protocol::binary_is_packed(msgpack_buffer.data(), msgpack_buffer.size()));
+
+    // 控制协议不使用二进制编码
+    m_src.head.cmd = ATBUS_CMD_NODE_PING;
+    CASE_EXPECT_FALSE(atbus::protocol::binary_support(m_src));
+}
+
+CASE_TEST(atbus_node_rela, msg_body_inline)
+{
+    atbus::protocol::msg m;
+    CASE_EXPECT_EQ(atbus::protocol::msg_body_type_t::NONE, m.body.get_type());
+    CASE_EXPECT_TRUE(NULL == m.body.forward());
+
+    atbus::protocol::reg_data* reg = m.body.make_body<atbus::protocol::reg_data>();
+    CASE_EXPECT_TRUE(NULL != reg);
+    reg->hostname = "localhost";
+    CASE_EXPECT_TRUE(reg == m.body.make_body<atbus::protocol::reg_data>());
+    CASE_EXPECT_EQ(atbus::protocol::msg_body_type_t::REG, m.body.get_type());
+
+    // 切换消息体类型后旧的消息体被销毁
+    m.body.make_forward(456, 789, NULL, 0);
+    CASE_EXPECT_EQ(atbus::protocol::msg_body_type_t::FORWARD, m.body.get_type());
+    CASE_EXPECT_TRUE(NULL == m.body.reg());
+    CASE_EXPECT_TRUE(NULL != m.body.forward());
+    CASE_EXPECT_EQ(0, m.body.forward()->router.size());
+
+    // router超出容量时解包失败
+    for (size_t i = 0; i < m.body.forward()->router.max_size(); ++i) {
+        CASE_EXPECT_TRUE(m.body.forward()->router.push_back(i));
+    }
+    CASE_EXPECT_FALSE(m.body.forward()->router.push_back(0));
+
+    std::vector<ATBUS_MACRO_BUSID_TYPE> router;
+    router.resize(m.body.forward()->router.max_size() + 1, 0);
+    std::stringstream ss;
+    msgpack::pack(ss, router);
+    std::string packed_buffer = ss.str();
+
+    msgpack::unpacked result;
+    msgpack::unpack(result, packed_buffer.data(), packed_buffer.size());
+    bool has_error = false;
+    try {
+        result.get().convert(m.body.forward()->router);
+    } catch (const msgpack::type_error&) {
+        has_error = true;
+    }
+    CASE_EXPECT_TRUE(has_error);
+
+    m.body.reset();
+    CASE_EXPECT_EQ(atbus::protocol::msg_body_type_t::NONE, m.body.get_type());
+}
+
 CASE_TEST(atbus_node_rela, child_endpoint_opr)
 {
     atbus::node::conf_t conf;
@@ -268,6 +268,311 @@ CASE_TEST(channel, io_stream_tcp_basic)
     uv_loop_close(&loop);
 }
 
+static int g_written_count = 0;
+static void written_callback_check_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void* input,                        // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_NE(NULL, input);
+    CASE_EXPECT_GT(s, 0);
+
+    ++g_written_count;
+}
+
+// 批量提交发送和逐个提交发送
+CASE_TEST(channel, io_stream_tcp_send_batch)
+{
+    for (int batch_number = 0; batch_number <= 16; batch_number += 16) {
+        atbus::channel::io_stream_channel svr, cli;
+        atbus::channel::io_stream_conf conf;
+        atbus::channel::io_stream_init_configure(&conf);
+        conf.send_batch_number = static_cast<size_t>(batch_number);
+
+        atbus::channel::io_stream_init(&svr, NULL, &conf);
+        atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+        int check_flag = g_check_flag = 0;
+        int inited_fds = 0;
+        inited_fds += setup_channel(svr, "ipv6://:::16387", NULL);
+        CASE_EXPECT_EQ(1, g_check_flag);
+        if (0 == inited_fds) {
+            return;
+        }
+
+        inited_fds = 0;
+        inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+        while (g_check_flag - check_flag < 2 * inited_fds + 1) {
+            atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+            atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(8);
+        }
+        CASE_EXPECT_NE(0, cli.conn_pool.size());
+
+        svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+        cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = written_callback_check_fn;
+        char* buf = get_test_buffer();
+
+        atbus::channel::io_stream_connection* conn = cli.conn_pool.begin()->second.get();
+        check_flag = g_check_flag;
+        g_written_count = 0;
+        g_check_buff_sequence.clear();
+        for (int i = 0; i < 200; ++i) {
+            size_t s = static_cast<size_t>(rand() % 2048);
+            size_t l = static_cast<size_t>(rand() % 256) + 1;
+            CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf + s, l));
+            g_check_buff_sequence.push_back(std::make_pair(s, l));
+        }
+
+        // 合并提交时第一个数据包立即提交，后续每16个数据包合并成一个写请求
+        if (batch_number > 1) {
+            CASE_EXPECT_EQ(1 + 199 / 16, conn->write_inflight);
+            CASE_EXPECT_EQ(199 % 16, conn->write_batch.size());
+        } else {
+            CASE_EXPECT_EQ(200, conn->write_inflight);
+            CASE_EXPECT_EQ(0, conn->write_batch.size());
+        }
+
+        while (g_check_flag - check_flag < 200 || g_written_count < 200) {
+            atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+            atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+            CASE_THREAD_SLEEP_MS(1);
+        }
+
+        CASE_EXPECT_EQ(200, g_written_count);
+        CASE_EXPECT_TRUE(g_check_buff_sequence.empty());
+        CASE_EXPECT_EQ(0, conn->write_inflight);
+        CASE_EXPECT_EQ(0, conn->write_batch.size());
+
+        atbus::channel::io_stream_close(&cli);
+        atbus::channel::io_stream_close(&svr);
+        CASE_EXPECT_EQ(0, svr.conn_pool.size());
+        CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    }
+}
+
+// 大数据包使用MSG_ZEROCOPY发送，和普通发送的数据包交错时也要保证顺序和回调
+CASE_TEST(channel, io_stream_tcp_zero_copy)
+{
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_zero_copy_threshold = 4096;
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    int check_flag = g_check_flag = 0;
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+    if (0 == inited_fds) {
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+    while (g_check_flag - check_flag < 2 * inited_fds + 1) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = written_callback_check_fn;
+    char* buf = get_test_buffer();
+
+    atbus::channel::io_stream_connection* conn = cli.conn_pool.begin()->second.get();
+    check_flag = g_check_flag;
+    g_written_count = 0;
+    g_check_buff_sequence.clear();
+    for (int i = 0; i < 64; ++i) {
+        size_t s = static_cast<size_t>(rand() % 2048);
+        size_t l = (i & 0x01) ? static_cast<size_t>(rand() % 256) + 1 : static_cast<size_t>(rand() % 32768) + 4096;
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf + s, l));
+        g_check_buff_sequence.push_back(std::make_pair(s, l));
+
+        if (0 == i % 8) {
+            atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        }
+    }
+
+    while (g_check_flag - check_flag < 64 || g_written_count < 64) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(1);
+    }
+
+    CASE_EXPECT_EQ(64, g_written_count);
+    CASE_EXPECT_TRUE(g_check_buff_sequence.empty());
+    CASE_EXPECT_EQ(0, conn->write_inflight);
+    CASE_EXPECT_EQ(0, conn->write_batch.size());
+    CASE_EXPECT_EQ(0, conn->write_buffers.limit().cost_number_);
+
+    // 不支持SO_ZEROCOPY的系统会全部走普通发送流程
+    if (ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, atbus::channel::io_stream_connection::EN_CF_ZERO_COPY)) {
+        CASE_EXPECT_NE(0, conn->zero_copy.send_times);
+    } else {
+        CASE_EXPECT_EQ(0, conn->zero_copy.send_times);
+    }
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+}
+
+
+static int g_written_failed_count = 0;
+static void written_callback_count_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void* input,                        // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_NE(NULL, input);
+    CASE_EXPECT_GT(s, 0);
+
+    if (EN_ATBUS_ERR_WRITE_FAILED == status) {
+        ++g_written_failed_count;
+    }
+    ++g_written_count;
+}
+
+// 零拷贝发送还没有完成时关闭连接，每个数据块都要通知一次，不能丢失也不能重复
+CASE_TEST(channel, io_stream_tcp_zero_copy_close)
+{
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.send_zero_copy_threshold = 4096;
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, &conf);
+
+    int check_flag = g_check_flag = 0;
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr, "ipv4://127.0.0.1:16387", NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+    if (0 == inited_fds) {
+        return;
+    }
+
+    inited_fds = 0;
+    inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+    while (g_check_flag - check_flag < 2 * inited_fds + 1) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_NE(0, cli.conn_pool.size());
+
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_WRITEN] = written_callback_count_fn;
+    char* buf = get_test_buffer();
+
+    // 第一个大数据包零拷贝发送，后面的数据包排在它后面暂存
+    atbus::channel::io_stream_connection* conn = cli.conn_pool.begin()->second.get();
+    g_written_count = 0;
+    g_written_failed_count = 0;
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf, 8192));
+    for (int i = 0; i < 8; ++i) {
+        CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(conn, buf + i, 128));
+    }
+
+    bool zero_copy_pending = NULL != conn->zero_copy.block;
+    if (ATBUS_CHANNEL_IOS_CHECK_FLAG(conn->flags, atbus::channel::io_stream_connection::EN_CF_ZERO_COPY)) {
+        CASE_EXPECT_TRUE(zero_copy_pending);
+    }
+    CASE_EXPECT_EQ(0, g_written_count);
+
+    check_flag = g_check_flag;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_DISCONNECTED] = disconnected_callback_test_fn;
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_disconnect(&cli, conn, NULL));
+    for (int i = 0; i < 256 && !cli.conn_pool.empty(); ++i) {
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(1);
+    }
+
+    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+    CASE_EXPECT_EQ(9, g_written_count);
+    // 零拷贝数据块和排在它后面的数据块都通知失败
+    if (zero_copy_pending) {
+        CASE_EXPECT_EQ(9, g_written_failed_count);
+    }
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+}
+
+
+// 多个channel通过SO_REUSEPORT监听同一个地址
+CASE_TEST(channel, io_stream_tcp_reuse_port)
+{
+    atbus::channel::io_stream_channel svr1, svr2, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.is_reuse_port = true;
+
+    atbus::channel::io_stream_init(&svr1, NULL, &conf);
+    atbus::channel::io_stream_init(&svr2, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    int check_flag = g_check_flag = 0;
+    int inited_fds = 0;
+    inited_fds += setup_channel(svr1, "ipv4://127.0.0.1:16387", NULL);
+    inited_fds += setup_channel(svr2, "ipv4://127.0.0.1:16387", NULL);
+    if (2 != inited_fds) {
+        atbus::channel::io_stream_close(&svr1);
+        atbus::channel::io_stream_close(&svr2);
+        atbus::channel::io_stream_close(&cli);
+        return;
+    }
+    CASE_EXPECT_EQ(2, g_check_flag);
+
+    // 未开启SO_REUSEPORT的监听要失败
+    {
+        atbus::channel::io_stream_channel svr3;
+        atbus::channel::io_stream_init(&svr3, NULL, NULL);
+        atbus::channel::channel_address_t addr;
+        atbus::channel::make_address("ipv4://127.0.0.1:16387", addr);
+        int res = atbus::channel::io_stream_listen(&svr3, addr, NULL, NULL, 0);
+        CASE_EXPECT_TRUE(EN_ATBUS_ERR_SOCK_BIND_FAILED == res || EN_ATBUS_ERR_SOCK_LISTEN_FAILED == res);
+        atbus::channel::io_stream_close(&svr3);
+    }
+
+    check_flag = g_check_flag;
+    inited_fds = 0;
+    for (int i = 0; i < 16; ++i) {
+        inited_fds += setup_channel(cli, NULL, "ipv4://127.0.0.1:16387");
+    }
+
+    while (g_check_flag - check_flag < 2 * inited_fds) {
+        atbus::channel::io_stream_run(&svr1, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&svr2, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    // 每个channel都有一个listen连接，新连接由内核分配
+    CASE_EXPECT_EQ(static_cast<size_t>(inited_fds + 2), svr1.conn_pool.size() + svr2.conn_pool.size());
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr1);
+    atbus::channel::io_stream_close(&svr2);
+}
+
 
 // reset by peer(client)
 CASE_TEST(channel, io_stream_tcp_reset_by_client)
@@ -0,0 +1,372 @@
+﻿#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <memory>
+
+#include <detail/libatbus_error.h>
+#include "detail/libatbus_channel_export.h"
+#include "frame/test_macros.h"
+
+#if defined(__linux__)
+
+static const size_t MAX_TEST_BUFFER_LEN = 1024 * 256;
+static int g_check_flag = 0;
+static std::pair<size_t, size_t> g_recv_rec = std::make_pair(0, 0);
+static std::list<std::pair<size_t, size_t> > g_check_buff_sequence;
+
+#define UNIT_TEST_LISTEN_PATH "unit_test.pkt.sock"
+#define UNIT_TEST_LISTEN_ADDR "unixpkt://" UNIT_TEST_LISTEN_PATH
+
+static void disconnected_callback_test_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+
+    ++g_check_flag;
+}
+
+static void accepted_callback_test_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_EQ(0, channel->error_code);
+
+    if (NULL != connection) {
+        CASE_EXPECT_TRUE(ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, atbus::channel::io_stream_connection::EN_CF_PACKET));
+    }
+
+    ++g_check_flag;
+}
+
+static void listen_callback_test_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_EQ(0, channel->error_code);
+
+    // listen accepted event
+    connection->evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_ACCEPTED] = accepted_callback_test_fn;
+
+    ++g_check_flag;
+}
+
+static void connected_callback_test_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_EQ(0, channel->error_code);
+
+    if (NULL != connection) {
+        CASE_EXPECT_TRUE(ATBUS_CHANNEL_IOS_CHECK_FLAG(connection->flags, atbus::channel::io_stream_connection::EN_CF_PACKET));
+    }
+
+    ++g_check_flag;
+}
+
+static void setup_channel(atbus::channel::io_stream_channel& channel, const char* listen, const char* conn) {
+    atbus::channel::channel_address_t addr;
+
+    int res = 0;
+    if (NULL != listen) {
+        // 上一次测试残留的socket文件会导致bind失败
+        remove(UNIT_TEST_LISTEN_PATH);
+        atbus::channel::make_address(listen, addr);
+        res = atbus::channel::io_stream_listen(&channel, addr, listen_callback_test_fn, NULL, 0);
+    } else {
+        atbus::channel::make_address(conn, addr);
+        res = atbus::channel::io_stream_connect(&channel, addr, connected_callback_test_fn, NULL, 0);
+    }
+
+    CASE_EXPECT_EQ(0, res);
+    if (0 != res) {
+        CASE_MSG_INFO() << uv_err_name(channel.error_code) << ":" << uv_strerror(channel.error_code) << std::endl;
+    }
+}
+
+static char* get_test_buffer() {
+    static char ret[MAX_TEST_BUFFER_LEN] = {0};
+    if (0 != ret[0]) {
+        return ret;
+    }
+
+    for (size_t i = 0; i < MAX_TEST_BUFFER_LEN - 1; ++ i) {
+        ret[i] = 'A' + rand() % 26;
+    }
+
+    return ret;
+}
+
+static void recv_callback_check_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void* input,                        // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+
+    if (status < 0) {
+        CASE_EXPECT_EQ(NULL, input);
+        CASE_EXPECT_EQ(0, s);
+
+        CASE_EXPECT_TRUE(UV_EOF == channel->error_code || UV_ECONNRESET == channel->error_code);
+        return;
+    }
+
+    CASE_EXPECT_NE(NULL, input);
+    CASE_EXPECT_EQ(0, status);
+    CASE_EXPECT_EQ(0, channel->error_code);
+
+    CASE_EXPECT_FALSE(g_check_buff_sequence.empty());
+    if (g_check_buff_sequence.empty()) {
+        return;
+    }
+
+    ++ g_recv_rec.first;
+    g_recv_rec.second += s;
+
+    CASE_EXPECT_EQ(s, g_check_buff_sequence.front().second);
+    char* buff = get_test_buffer();
+    char* input_buff = reinterpret_cast<char*>(input);
+    for (size_t i = 0; i < g_check_buff_sequence.front().second; ++ i) {
+        CASE_EXPECT_EQ(buff[i + g_check_buff_sequence.front().first], input_buff[i]);
+        if (buff[i + g_check_buff_sequence.front().first] != input_buff[i]) {
+            break;
+        }
+    }
+    g_check_buff_sequence.pop_front();
+
+    ++g_check_flag;
+}
+
+CASE_TEST(channel, io_stream_unixpkt_basic)
+{
+    atbus::adapter::loop_t loop;
+    uv_loop_init(&loop);
+
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, &loop, NULL);
+    atbus::channel::io_stream_init(&cli, &loop, NULL);
+
+    g_check_flag = 0;
+
+    setup_channel(svr, UNIT_TEST_LISTEN_ADDR, NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+
+    int check_flag = g_check_flag;
+    while (g_check_flag - check_flag < 6) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+    CASE_EXPECT_EQ(3, cli.conn_pool.size());
+    CASE_EXPECT_EQ(4, svr.conn_pool.size());
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    cli.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback_check_fn;
+    char* buf = get_test_buffer();
+
+    // 空数据包和连接关闭无法区分
+    atbus::channel::io_stream_connection* cli_conn = cli.conn_pool.begin()->second.get();
+    CASE_EXPECT_EQ(EN_ATBUS_ERR_INVALID_SIZE, atbus::channel::io_stream_send(cli_conn, buf, 0));
+
+    check_flag = g_check_flag;
+    // small buffer
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, buf, 13));
+    g_check_buff_sequence.push_back(std::make_pair(0, 13));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, buf + 13, 28));
+    g_check_buff_sequence.push_back(std::make_pair(13, 28));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, buf + 13 + 28, 100));
+    g_check_buff_sequence.push_back(std::make_pair(13 + 28, 100));
+
+    // big buffer
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, buf + 1024, 56 * 1024 + 3));
+    g_check_buff_sequence.push_back(std::make_pair(1024, 56 * 1024 + 3));
+
+    // 数据包在可写事件里才发送
+    CASE_EXPECT_EQ(4, cli_conn->write_batch.size());
+
+    while (g_check_flag - check_flag < 4) {
+        uv_run(&loop, UV_RUN_ONCE);
+    }
+    CASE_EXPECT_EQ(0, cli_conn->write_batch.size());
+    CASE_EXPECT_EQ(0, cli_conn->write_buffers.limit().cost_number_);
+
+    // many big buffer, 超出socket发送缓冲区后要等可写事件
+    {
+        check_flag = g_check_flag;
+        atbus::channel::io_stream_channel::conn_pool_t::iterator it = svr.conn_pool.begin();
+        // 跳过listen的socket
+        if (ATBUS_CHANNEL_IOS_CHECK_FLAG(it->second->flags, atbus::channel::io_stream_connection::EN_CF_LISTEN)) {
+            ++it;
+        }
+
+        size_t sum_size = 0;
+        g_recv_rec = std::make_pair(0, 0);
+        for (int i = 0; i < 153; ++ i) {
+            size_t s = static_cast<size_t>(rand() % 2048);
+            size_t l = static_cast<size_t>(rand() % 10240) + 20 * 1024;
+            CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(it->second.get(), buf + s, l));
+            g_check_buff_sequence.push_back(std::make_pair(s, l));
+            sum_size += l;
+        }
+
+        CASE_MSG_INFO() << "send " << sum_size << " bytes data with " << g_check_buff_sequence.size() << " packages done." << std::endl;
+
+        while (g_check_flag - check_flag < 153) {
+            uv_run(&loop, UV_RUN_ONCE);
+        }
+
+        CASE_MSG_INFO() << "recv " << g_recv_rec.second << " bytes data with " << g_recv_rec.first << " packages and checked done." << std::endl;
+    }
+
+    atbus::channel::io_stream_close(&svr);
+    atbus::channel::io_stream_close(&cli);
+    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+
+    uv_loop_close(&loop);
+    remove(UNIT_TEST_LISTEN_PATH);
+}
+
+// reset by peer(client)
+CASE_TEST(channel, io_stream_unixpkt_reset_by_client)
+{
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_init(&svr, NULL, NULL);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_DISCONNECTED] = disconnected_callback_test_fn;
+
+    int check_flag = g_check_flag = 0;
+
+    setup_channel(svr, UNIT_TEST_LISTEN_ADDR, NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+    setup_channel(cli, NULL, UNIT_TEST_LISTEN_ADDR);
+
+    while (g_check_flag - check_flag < 7) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_EQ(3, cli.conn_pool.size());
+
+    check_flag = g_check_flag;
+    atbus::channel::io_stream_close(&cli);
+    CASE_EXPECT_EQ(0, cli.conn_pool.size());
+
+    // 服务端通过长度为0的数据包感知连接断开
+    while (g_check_flag - check_flag < 3) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_EQ(1, svr.conn_pool.size());
+
+    atbus::channel::io_stream_close(&svr);
+    CASE_EXPECT_EQ(0, svr.conn_pool.size());
+    remove(UNIT_TEST_LISTEN_PATH);
+}
+
+static void recv_size_err_callback_check_fn(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void* input,                        // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    CASE_EXPECT_NE(NULL, channel);
+    CASE_EXPECT_NE(NULL, connection);
+    CASE_EXPECT_NE(NULL, input);
+
+    // 内核保留了消息边界，超长的数据包被截断后不影响后续的数据包
+    if (0 == g_check_flag) {
+        CASE_EXPECT_EQ(EN_ATBUS_ERR_INVALID_SIZE, status);
+        CASE_EXPECT_EQ(channel->conf.recv_buffer_limit_size, s);
+    } else {
+        CASE_EXPECT_EQ(0, status);
+        CASE_EXPECT_EQ(64, s);
+    }
+
+    ++g_check_flag;
+}
+
+// buffer recv size limit
+CASE_TEST(channel, io_stream_unixpkt_size_extended)
+{
+    atbus::channel::io_stream_channel svr, cli;
+    atbus::channel::io_stream_conf conf;
+    atbus::channel::io_stream_init_configure(&conf);
+    conf.recv_buffer_limit_size = 1024;
+
+    atbus::channel::io_stream_init(&svr, NULL, &conf);
+    atbus::channel::io_stream_init(&cli, NULL, NULL);
+
+    svr.evt.callbacks[atbus::channel::io_stream_callback_evt_t::EN_FN_RECVED] = recv_size_err_callback_check_fn;
+
+    g_check_flag = 0;
+    setup_channel(svr, UNIT_TEST_LISTEN_ADDR, NULL);
+    CASE_EXPECT_EQ(1, g_check_flag);
+
+    atbus::channel::channel_address_t addr;
+    atbus::channel::make_address(UNIT_TEST_LISTEN_ADDR, addr);
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_connect(&cli, addr, NULL, NULL, 0));
+
+    while (cli.conn_pool.empty() || svr.conn_pool.size() < 2) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+
+    g_check_flag = 0;
+    atbus::channel::io_stream_connection* cli_conn = cli.conn_pool.begin()->second.get();
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, get_test_buffer(), conf.recv_buffer_limit_size + 1));
+    CASE_EXPECT_EQ(0, atbus::channel::io_stream_send(cli_conn, get_test_buffer(), 64));
+
+    while (g_check_flag < 2) {
+        atbus::channel::io_stream_run(&svr, atbus::adapter::RUN_NOWAIT);
+        atbus::channel::io_stream_run(&cli, atbus::adapter::RUN_NOWAIT);
+        CASE_THREAD_SLEEP_MS(8);
+    }
+    CASE_EXPECT_EQ(1, cli.conn_pool.size());
+    CASE_EXPECT_EQ(2, svr.conn_pool.size());
+
+    atbus::channel::io_stream_close(&cli);
+    atbus::channel::io_stream_close(&svr);
+    remove(UNIT_TEST_LISTEN_PATH);
+}
+
+#endif
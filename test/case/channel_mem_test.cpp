@@ -288,3 +288,45 @@ CASE_TEST(channel, mem_miso)
     delete read_thread;
     delete []buffer;
 }
+
+CASE_TEST(channel, mem_send_v)
+{
+    using namespace atbus::channel;
+    const size_t buffer_len = 64 * 1024; // 64KB
+    char* buffer = new char[buffer_len];
+
+    mem_channel* channel = NULL;
+    CASE_EXPECT_EQ(0, mem_init(buffer, buffer_len, &channel, NULL));
+    CASE_EXPECT_NE(NULL, channel);
+
+    char head[48];
+    char body[1000];
+    char recv_buffer[2048];
+    for (size_t i = 0; i < sizeof(body); ++i) {
+        body[i] = static_cast<char>(i & 0xFF);
+    }
+
+    // 循环多次，保证有数据回绕
+    size_t check_times = 0;
+    for (size_t i = 0; i < 1024; ++i) {
+        memset(head, static_cast<int>(i & 0xFF), sizeof(head));
+        size_t body_len = (i * 37) % sizeof(body);
+
+        const void* bufs[3] = { head, body, head };
+        size_t lens[3] = { sizeof(head), body_len, 1 };
+        CASE_EXPECT_EQ(0, mem_send_v(channel, bufs, lens, 3));
+
+        size_t recv_len = 0;
+        CASE_EXPECT_EQ(0, mem_recv(channel, recv_buffer, sizeof(recv_buffer), &recv_len));
+        CASE_EXPECT_EQ(sizeof(head) + body_len + 1, recv_len);
+        if (sizeof(head) + body_len + 1 == recv_len &&
+            0 == memcmp(recv_buffer, head, sizeof(head)) &&
+            0 == memcmp(recv_buffer + sizeof(head), body, body_len) &&
+            head[0] == recv_buffer[recv_len - 1]) {
+            ++check_times;
+        }
+    }
+    CASE_EXPECT_EQ(1024, check_times);
+
+    delete []buffer;
+}
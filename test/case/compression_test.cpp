@@ -0,0 +1,83 @@
+﻿#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <detail/libatbus_error.h>
+#include <detail/libatbus_compression.h>
+#include <detail/libatbus_protocol_binary.h>
+
+#include "frame/test_macros.h"
+
+static void compression_test_round_trip(const std::string& in) {
+    const atbus::compression::codec_t* codec = atbus::compression::lz_codec();
+    std::vector<char> compressed(in.size() + in.size() / 255 + 16);
+    size_t compressed_size = codec->compress(in.data(), in.size(), &compressed[0], compressed.size());
+    CASE_EXPECT_NE(0, compressed_size);
+
+    std::string out;
+    out.resize(in.size());
+    CASE_EXPECT_TRUE(codec->decompress(&compressed[0], compressed_size, &out[0], out.size()));
+    CASE_EXPECT_TRUE(in == out);
+
+    // 长度不对或数据截断都要能检测出来
+    if (compressed_size > 1) {
+        CASE_EXPECT_FALSE(codec->decompress(&compressed[0], compressed_size - 1, &out[0], out.size()));
+    }
+    CASE_EXPECT_FALSE(codec->decompress(&compressed[0], compressed_size, &out[0], out.size() - 1));
+}
+
+CASE_TEST(compression, lz_round_trip)
+{
+    compression_test_round_trip("a");
+    compression_test_round_trip("hello world!");
+
+    // 重复较多的类JSON数据
+    std::string json;
+    for (int i = 0; i < 256; ++i) {
+        json += "{\"id\":";
+        json += static_cast<char>('0' + i % 10);
+        json += ",\"name\":\"player\",\"level\":100,\"items\":[1,2,3]},";
+    }
+    compression_test_round_trip(json);
+
+    // 重叠匹配
+    compression_test_round_trip(std::string(70000, 'x'));
+
+    // 随机数据
+    std::string random_data;
+    srand(12345);
+    for (int i = 0; i < 8192; ++i) {
+        random_data += static_cast<char>(rand() & 0xFF);
+    }
+    compression_test_round_trip(random_data);
+
+    const atbus::compression::codec_t* codec = atbus::compression::lz_codec();
+    std::vector<char> compressed(json.size());
+    size_t compressed_size = codec->compress(json.data(), json.size(), &compressed[0], compressed.size());
+    CASE_EXPECT_LT(compressed_size * 4, json.size());
+
+    // 输出缓冲区不足时放弃压缩
+    CASE_EXPECT_EQ(0, codec->compress(random_data.data(), random_data.size(), &compressed[0], random_data.size() / 2));
+}
+
+CASE_TEST(compression, pack_head)
+{
+    char head[atbus::protocol::compress_encoding_t::MAX_HEAD_SIZE + 4];
+    size_t head_size = atbus::protocol::compress_pack_head(head, sizeof(head), atbus::compression::algorithm_t::LZ, 65536);
+    CASE_EXPECT_NE(0, head_size);
+    CASE_EXPECT_LE(head_size, static_cast<size_t>(atbus::protocol::compress_encoding_t::MAX_HEAD_SIZE));
+
+    uint32_t algorithm = 0;
+    size_t origin_size = 0;
+    const void* data = NULL;
+    size_t data_len = 0;
+    CASE_EXPECT_TRUE(atbus::protocol::compress_unpack_head(head, sizeof(head), algorithm, origin_size, data, data_len));
+    CASE_EXPECT_EQ(static_cast<uint32_t>(atbus::compression::algorithm_t::LZ), algorithm);
+    CASE_EXPECT_EQ(65536, origin_size);
+    CASE_EXPECT_EQ(static_cast<const void*>(head + head_size), data);
+    CASE_EXPECT_EQ(sizeof(head) - head_size, data_len);
+
+    CASE_EXPECT_FALSE(atbus::protocol::compress_unpack_head(head, 1, algorithm, origin_size, data, data_len));
+}
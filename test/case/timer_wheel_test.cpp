@@ -0,0 +1,106 @@
+﻿#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <detail/timer_wheel.h>
+
+#include "frame/test_macros.h"
+
+typedef atbus::detail::timer_wheel<size_t> timer_wheel_test_t;
+
+// 每个定时器都必须在第一次推进到不小于触发时间的tick时触发，且只触发一次
+static void timer_wheel_test_advance(timer_wheel_test_t& tw, uint64_t tick, const std::vector<uint64_t>& expires,
+    std::vector<uint64_t>& fired, std::vector<timer_wheel_test_t::value_type>& expired) {
+    uint64_t last_tick = tw.get_current_tick();
+    tw.advance(tick, expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+        size_t idx = expired[i].second;
+        CASE_EXPECT_EQ(expires[idx], expired[i].first);
+        CASE_EXPECT_EQ(0, fired[idx]);
+        CASE_EXPECT_LE(expires[idx], tick);
+        CASE_EXPECT_GT(expires[idx], last_tick);
+        fired[idx] = tick;
+    }
+}
+
+CASE_TEST(timer_wheel, advance)
+{
+    timer_wheel_test_t tw(4, 3);
+    std::vector<timer_wheel_test_t::value_type> expired;
+    std::vector<uint64_t> expires;
+    std::vector<uint64_t> fired;
+
+    uint64_t base = 1000;
+    tw.reset(base);
+
+    // 覆盖每一层和超出最高层范围的定时器
+    uint64_t offsets[] = { 1, 2, 15, 16, 17, 255, 256, 257, 4095, 4096, 4097, 10000, 70000 };
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+        expires.push_back(base + offsets[i]);
+        tw.add(expires.back(), expires.size() - 1);
+    }
+
+    srand(20260101);
+    for (size_t i = 0; i < 2048; ++i) {
+        expires.push_back(base + 1 + static_cast<uint64_t>(rand() % 20000));
+        tw.add(expires.back(), expires.size() - 1);
+    }
+    fired.resize(expires.size(), 0);
+    CASE_EXPECT_EQ(expires.size(), tw.size());
+
+    uint64_t tick = base;
+    while (tick < base + 80000) {
+        tick += 1 + static_cast<uint64_t>(rand() % 300);
+        timer_wheel_test_advance(tw, tick, expires, fired, expired);
+    }
+
+    CASE_EXPECT_TRUE(tw.empty());
+    for (size_t i = 0; i < fired.size(); ++i) {
+        CASE_EXPECT_NE(0, fired[i]);
+    }
+
+    // 已过期的定时器下一个tick触发
+    tw.add(tick - 10, 0);
+    expires[0] = tick + 1;
+    fired[0] = 0;
+    timer_wheel_test_advance(tw, tick + 1, expires, fired, expired);
+    CASE_EXPECT_EQ(1, expired.size());
+    CASE_EXPECT_TRUE(tw.empty());
+}
+
+CASE_TEST(timer_wheel, jump)
+{
+    timer_wheel_test_t tw(4, 2);
+    std::vector<timer_wheel_test_t::value_type> expired;
+    std::vector<uint64_t> expires;
+    std::vector<uint64_t> fired;
+
+    // 初始tick是0时第一次推进会跨越整个时间轮
+    expires.push_back(1700000000000ULL);
+    expires.push_back(1700000000100ULL);
+    expires.push_back(1700000005000ULL);
+    for (size_t i = 0; i < expires.size(); ++i) {
+        tw.add(expires[i], i);
+    }
+    fired.resize(expires.size(), 0);
+
+    timer_wheel_test_advance(tw, 1700000000000ULL, expires, fired, expired);
+    CASE_EXPECT_EQ(1, expired.size());
+    CASE_EXPECT_EQ(2, tw.size());
+
+    timer_wheel_test_advance(tw, 1700000000099ULL, expires, fired, expired);
+    CASE_EXPECT_EQ(0, expired.size());
+
+    timer_wheel_test_advance(tw, 1700000001000ULL, expires, fired, expired);
+    CASE_EXPECT_EQ(1, expired.size());
+
+    timer_wheel_test_advance(tw, 1700000009000ULL, expires, fired, expired);
+    CASE_EXPECT_EQ(1, expired.size());
+    CASE_EXPECT_TRUE(tw.empty());
+
+    // 清空后不再触发
+    tw.add(1700000010000ULL, 0);
+    tw.reset(1700000009000ULL);
+    CASE_EXPECT_EQ(0, tw.advance(1700000020000ULL, expired));
+}
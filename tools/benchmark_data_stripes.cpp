@@ -0,0 +1,160 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <uv.h>
+
+#include "atbus_node.h"
+
+/**
+ * @brief 多条并行数据连接(conf.data_conn_count)在回环地址上的吞吐量
+ *        两个节点互相注册后，一端持续发送到发送缓冲区满，另一端统计收到的数据量
+ *        消息分布在多个类型上，按(来源,类型)分流到不同的连接；unordered为开启EN_CONF_DATA_UNORDERED后的轮流发送
+ *        单个事件循环驱动两端，结果反映的是多条连接分摊发送缓冲区和内核队列的效果
+ */
+
+typedef std::chrono::steady_clock clock_type;
+
+static size_t recv_count = 0;
+static size_t recv_bytes = 0;
+
+static int on_recv_count(const atbus::node&, const atbus::endpoint*, const atbus::connection*, int, const void*, size_t s) {
+    ++recv_count;
+    recv_bytes += s;
+    return 0;
+}
+
+static std::string make_address(int port) {
+    char buf[64] = {0};
+    sprintf(buf, "ipv4://127.0.0.1:%d", port);
+    return buf;
+}
+
+static size_t count_connected(const atbus::endpoint* ep) {
+    size_t ret = 0;
+    if (NULL == ep) {
+        return ret;
+    }
+
+    for (std::list<atbus::connection::ptr_t>::const_iterator iter = ep->get_data_connections().begin(); iter != ep->get_data_connections().end(); ++iter) {
+        if (atbus::connection::state_t::CONNECTED == (*iter)->get_status()) {
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+static void run_bench(size_t conn_count, bool unordered, int base_port, size_t times, size_t payload_size, int type_count) {
+    uv_loop_t ev_loop;
+    uv_loop_init(&ev_loop);
+
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.ev_loop = &ev_loop;
+    conf.children_mask = 16;
+    conf.data_conn_count = conn_count;
+    conf.send_buffer_size = 1024 * 1024;
+    if (unordered) {
+        conf.flags.set(atbus::node::conf_flag_t::EN_CONF_DATA_UNORDERED);
+    }
+
+    {
+        atbus::node::ptr_t sender = atbus::node::create();
+        atbus::node::ptr_t receiver = atbus::node::create();
+        receiver->set_on_recv_handle(on_recv_count);
+
+        bool ok = sender->init(0x12345678, &conf) >= 0 && receiver->init(0x12356789, &conf) >= 0 &&
+            sender->listen(make_address(base_port).c_str()) >= 0 && receiver->listen(make_address(base_port + 1).c_str()) >= 0 &&
+            sender->start() >= 0 && receiver->start() >= 0;
+
+        time_t proc_t = time(NULL) + 1;
+        if (ok) {
+            sender->proc(proc_t, 0);
+            receiver->proc(proc_t, 0);
+            ok = sender->connect(make_address(base_port + 1).c_str()) >= 0;
+        }
+
+        // 等待所有的数据连接建立
+        for (int i = 0; ok && i < 4096; ++i) {
+            uv_run(&ev_loop, UV_RUN_NOWAIT);
+            if (conn_count == count_connected(sender->get_endpoint(receiver->get_id())) &&
+                conn_count == count_connected(receiver->get_endpoint(sender->get_id()))) {
+                break;
+            }
+            uv_sleep(1);
+        }
+        ok = ok && conn_count == count_connected(sender->get_endpoint(receiver->get_id()));
+
+        std::string data(payload_size, 'a');
+        size_t sent = 0;
+        recv_count = 0;
+        recv_bytes = 0;
+        clock_type::time_point begin = clock_type::now();
+        while (ok && recv_count < times) {
+            // 发送缓冲区满了以后驱动事件循环
+            while (sent < times && sender->send_data(receiver->get_id(), static_cast<int>(sent % type_count), data.data(), data.size()) >= 0) {
+                ++sent;
+            }
+            uv_run(&ev_loop, UV_RUN_NOWAIT);
+        }
+        double cost_s = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - begin).count()) / 1000000.0;
+        if (cost_s <= 0) {
+            cost_s = 0.000001;
+        }
+
+        printf("%12llu %10s %14.1f %14.1f%s\n", static_cast<unsigned long long>(conn_count), unordered ? "unordered" : "ordered",
+            static_cast<double>(recv_count) / cost_s / 1000.0, static_cast<double>(recv_bytes) / cost_s / 1024.0 / 1024.0, ok ? "" : " (failed)");
+
+        sender->reset();
+        receiver->reset();
+    }
+
+    while (UV_EBUSY == uv_loop_close(&ev_loop)) {
+        uv_run(&ev_loop, UV_RUN_NOWAIT);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [message number] [payload size] [type number] [base port]\n", argv[0]);
+        return 0;
+    }
+
+    size_t times = 200000;
+    size_t payload_size = 4096;
+    int type_count = 16;
+    int base_port = 16600;
+    if (argc > 1)
+        times = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        payload_size = (size_t)strtol(argv[2], NULL, 10);
+    if (argc > 3)
+        type_count = (int)strtol(argv[3], NULL, 10);
+    if (argc > 4)
+        base_port = (int)strtol(argv[4], NULL, 10);
+
+    if (0 == times) {
+        times = 1;
+    }
+    if (type_count <= 0) {
+        type_count = 1;
+    }
+
+    printf("payload size: %llu, messages: %llu, types: %d\n", static_cast<unsigned long long>(payload_size),
+        static_cast<unsigned long long>(times), type_count);
+    printf("%12s %10s %14s %14s\n", "conn count", "mode", "kmsg/s", "MB/s");
+    size_t conn_counts[] = { 1, 2, 4 };
+    for (size_t i = 0; i < sizeof(conn_counts) / sizeof(conn_counts[0]); ++i) {
+        run_bench(conn_counts[i], false, base_port + static_cast<int>(i) * 10, times, payload_size, type_count);
+    }
+    for (size_t i = 1; i < sizeof(conn_counts) / sizeof(conn_counts[0]); ++i) {
+        run_bench(conn_counts[i], true, base_port + 40 + static_cast<int>(i) * 10, times, payload_size, type_count);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <random>
+
+#include "atbus_node.h"
+#include "atbus_endpoint.h"
+
+/**
+ * @brief 子节点路由查找的性能对比
+ *        map  : 原来的std::map<子域上界, endpoint::ptr_t>，lower_bound后检查是否是子节点
+ *        index: node使用的endpoint_index，连续数组上的无分支二分查找
+ *        子节点数量不指定时依次测试100/10000/100000，查找的目标随机分布在所有子节点的子域里
+ */
+
+typedef std::chrono::steady_clock clock_type;
+typedef std::map<atbus::endpoint::bus_id_t, atbus::endpoint::ptr_t> map_collection_t;
+
+static volatile size_t checksum = 0;
+
+static double cost_ns(clock_type::time_point begin, size_t times) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - begin).count()) / times;
+}
+
+static atbus::endpoint* map_find_child(map_collection_t& coll, atbus::endpoint::bus_id_t id) {
+    map_collection_t::iterator iter = coll.lower_bound(id);
+    if (iter == coll.end()) {
+        return NULL;
+    }
+
+    if (iter->second->get_id() == id || iter->second->is_child_node(id)) {
+        return iter->second.get();
+    }
+
+    return NULL;
+}
+
+static void run_bench(atbus::node& owner, size_t endpoint_num, size_t times) {
+    const uint32_t child_mask = 4;
+    atbus::endpoint::bus_id_t base_id = owner.get_id() & ~((static_cast<atbus::endpoint::bus_id_t>(1) << 24) - 1);
+
+    // 只有子节点的集合，先释放集合再释放node
+    {
+        map_collection_t map_coll;
+        atbus::node::endpoint_collection_t index_coll;
+        for (size_t i = 0; i < endpoint_num; ++i) {
+            atbus::endpoint::bus_id_t id = base_id + (static_cast<atbus::endpoint::bus_id_t>(i + 1) << child_mask);
+            atbus::endpoint::ptr_t ep = atbus::endpoint::create(&owner, id, child_mask, owner.get_pid(), owner.get_hostname());
+            map_coll[atbus::endpoint::get_children_max_id(id, child_mask)] = ep;
+            index_coll.insert(atbus::endpoint::get_children_min_id(id, child_mask), atbus::endpoint::get_children_max_id(id, child_mask), ep);
+        }
+
+        std::mt19937_64 rnd(endpoint_num);
+        std::vector<atbus::endpoint::bus_id_t> targets(times);
+        for (size_t i = 0; i < times; ++i) {
+            targets[i] = base_id + (static_cast<atbus::endpoint::bus_id_t>(rnd() % endpoint_num + 1) << child_mask) + rnd() % (1 << child_mask);
+        }
+
+        clock_type::time_point begin = clock_type::now();
+        for (size_t i = 0; i < times; ++i) {
+            checksum += reinterpret_cast<size_t>(map_find_child(map_coll, targets[i]));
+        }
+        double map_ns = cost_ns(begin, times);
+
+        begin = clock_type::now();
+        for (size_t i = 0; i < times; ++i) {
+            checksum += reinterpret_cast<size_t>(index_coll.find(targets[i]));
+        }
+        double index_ns = cost_ns(begin, times);
+
+        // 两种查找的结果必须一致
+        for (size_t i = 0; i < times && i < 1000; ++i) {
+            if (map_find_child(map_coll, targets[i]) != index_coll.find(targets[i])) {
+                fprintf(stderr, "lookup 0x%08llx mismatch\n", static_cast<unsigned long long>(targets[i]));
+                break;
+            }
+        }
+
+        printf("%12llu %14.1f %14.1f\n", static_cast<unsigned long long>(endpoint_num), map_ns, index_ns);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [endpoint number, 0 for 100/10000/100000] [times]\n", argv[0]);
+        return 0;
+    }
+
+    size_t endpoint_num = 0;
+    size_t times = 10000000;
+    if (argc > 1)
+        endpoint_num = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        times = (size_t)strtol(argv[2], NULL, 10);
+
+    if (0 == times) {
+        times = 1;
+    }
+
+    // 子节点的子域是16个id，父节点的子域最多放下2^20个子节点
+    if (endpoint_num >= (1 << 20)) {
+        endpoint_num = (1 << 20) - 1;
+    }
+
+    atbus::node::conf_t conf;
+    atbus::node::default_conf(&conf);
+    conf.children_mask = 24;
+
+    atbus::node::ptr_t owner = atbus::node::create();
+    if (owner->init(0x12000000, &conf) < 0) {
+        fprintf(stderr, "init node failed\n");
+        return 1;
+    }
+
+    printf("%12s %14s %14s\n", "endpoints", "map(ns/op)", "index(ns/op)");
+    if (0 != endpoint_num) {
+        run_bench(*owner, endpoint_num, times);
+    } else {
+        size_t nums[] = { 100, 10000, 100000 };
+        for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+            run_bench(*owner, nums[i], times);
+        }
+    }
+
+    printf("checksum: %llu\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <signal.h>
+
+#include <uv.h>
+
+#include "atbus_node.h"
+#include "detail/libatbus_protocol.h"
+
+/**
+ * @brief 发布给N个订阅者时，逐个send_data和send_to_group的对比
+ *        两层节点: P -> C0, C1 ... Cn，C0发布，C1到Cn订阅
+ *        unicast: C0对每个订阅者调用一次send_data，开始经过父节点转发，父节点通知直连以后C0直接发给订阅者
+ *        group  : C0调用一次send_to_group，父节点扇出给订阅的子节点
+ *        pub send: 发布方的链路发送次数，relay send: 父节点的链路发送次数
+ */
+
+typedef std::chrono::steady_clock clock_type;
+
+static size_t pub_sends = 0;
+static size_t relay_sends = 0;
+static size_t recv_count = 0;
+static atbus::node::bus_id_t parent_id = 0;
+static atbus::node::bus_id_t publisher_id = 0;
+
+static void on_debug_count_sends(const char*, size_t, const atbus::node& n, const atbus::endpoint*, const atbus::connection*,
+    const atbus::protocol::msg* m, const char* fmt, ...) {
+    if (NULL == m || 0 != strncmp(fmt, "node send", 9)) {
+        return;
+    }
+
+    if (ATBUS_CMD_DATA_TRANSFORM_REQ != m->head.cmd && ATBUS_CMD_GROUP_DATA != m->head.cmd) {
+        return;
+    }
+
+    if (n.get_id() == parent_id) {
+        ++relay_sends;
+    } else if (n.get_id() == publisher_id) {
+        ++pub_sends;
+    }
+}
+
+static int on_recv_count(const atbus::node&, const atbus::endpoint*, const atbus::connection*, int, const void*, size_t) {
+    ++recv_count;
+    return 0;
+}
+
+static int on_recv_group_count(const atbus::node&, const atbus::endpoint*, const atbus::connection*, uint64_t, atbus::node::bus_id_t,
+    int, const void*, size_t) {
+    ++recv_count;
+    return 0;
+}
+
+struct bench_tree_t {
+    uv_loop_t ev_loop;
+    std::vector<atbus::node::ptr_t> nodes;
+    time_t proc_t;
+
+    void proc() {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            nodes[i]->proc(proc_t, 0);
+        }
+        uv_run(&ev_loop, UV_RUN_NOWAIT);
+    }
+};
+
+static std::string make_address(int port) {
+    char buf[64] = {0};
+    sprintf(buf, "ipv4://127.0.0.1:%d", port);
+    return buf;
+}
+
+static bool setup_tree(bench_tree_t& tree, size_t subscribers, uint64_t gid, int base_port) {
+    uv_loop_init(&tree.ev_loop);
+    tree.proc_t = time(NULL) + 1;
+
+    parent_id = 0x12340000;
+    publisher_id = 0x12340100;
+    for (size_t i = 0; i <= subscribers + 1; ++i) {
+        atbus::node::conf_t conf;
+        atbus::node::default_conf(&conf);
+        conf.ev_loop = &tree.ev_loop;
+        conf.children_mask = 0 == i ? 16 : 8;
+        // 发布方一次写入所有数据
+        conf.send_buffer_size = 64 * 1024 * 1024;
+        atbus::node::bus_id_t id = parent_id;
+        if (i > 0) {
+            conf.father_address = make_address(base_port);
+            id = publisher_id + (static_cast<atbus::node::bus_id_t>(i - 1) << 8);
+        }
+
+        atbus::node::ptr_t n = atbus::node::create();
+        n->on_debug = on_debug_count_sends;
+        n->set_on_recv_handle(on_recv_count);
+        n->set_on_recv_group_handle(on_recv_group_count);
+        if (n->init(id, &conf) < 0 || n->listen(make_address(base_port + static_cast<int>(i)).c_str()) < 0 || n->start() < 0) {
+            fprintf(stderr, "setup node 0x%08llx failed\n", static_cast<unsigned long long>(id));
+            return false;
+        }
+        if (i > 1) {
+            n->join_group(gid);
+        }
+        tree.nodes.push_back(n);
+    }
+
+    // 等待注册和组关注的上报完成
+    for (int i = 0; i < 8192; ++i) {
+        tree.proc();
+
+        atbus::node::ptr_t& parent = tree.nodes[0];
+        bool ready = 1 == parent->get_group_count();
+        for (size_t j = 1; ready && j < tree.nodes.size(); ++j) {
+            atbus::endpoint* ep = parent->get_endpoint(tree.nodes[j]->get_id());
+            atbus::endpoint* father = tree.nodes[j]->get_endpoint(parent_id);
+            ready = NULL != ep && NULL != parent->get_self_endpoint()->get_data_connection(ep) &&
+                NULL != father && NULL != tree.nodes[j]->get_self_endpoint()->get_data_connection(father);
+        }
+
+        if (ready) {
+            return true;
+        }
+
+        ++tree.proc_t;
+        uv_sleep(1);
+    }
+
+    fprintf(stderr, "wait for tree ready timeout\n");
+    return false;
+}
+
+static void cleanup_tree(bench_tree_t& tree) {
+    for (size_t i = 0; i < tree.nodes.size(); ++i) {
+        tree.nodes[i]->reset();
+    }
+    tree.nodes.clear();
+
+    while (UV_EBUSY == uv_loop_close(&tree.ev_loop)) {
+        uv_run(&tree.ev_loop, UV_RUN_NOWAIT);
+    }
+}
+
+static bool wait_recv(bench_tree_t& tree, size_t expect) {
+    for (int i = 0; i < 10000000 && recv_count < expect; ++i) {
+        uv_run(&tree.ev_loop, UV_RUN_NOWAIT);
+    }
+
+    return recv_count >= expect;
+}
+
+static void run_bench(size_t subscribers, size_t times, size_t payload_size, int base_port) {
+    const uint64_t gid = 0x100;
+    bench_tree_t tree;
+    if (!setup_tree(tree, subscribers, gid, base_port)) {
+        cleanup_tree(tree);
+        return;
+    }
+
+    atbus::node::ptr_t& publisher = tree.nodes[1];
+    std::string data(payload_size, 'a');
+
+    for (int mode = 0; mode < 2; ++mode) {
+        pub_sends = 0;
+        relay_sends = 0;
+        recv_count = 0;
+
+        bool ok = true;
+        clock_type::time_point begin = clock_type::now();
+        for (size_t i = 0; ok && i < times; ++i) {
+            if (0 == mode) {
+                for (size_t j = 2; ok && j < tree.nodes.size(); ++j) {
+                    ok = publisher->send_data(tree.nodes[j]->get_id(), 0, data.data(), data.size()) >= 0;
+                }
+            } else {
+                ok = publisher->send_to_group(gid, 0, data.data(), data.size()) >= 0;
+            }
+
+            ok = ok && wait_recv(tree, (i + 1) * subscribers);
+        }
+        double cost_us = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - begin).count()) / times / 1000.0;
+
+        printf("%-8s %12llu %10.2f %10.2f %14.2f%s\n", 0 == mode ? "unicast" : "group",
+            static_cast<unsigned long long>(subscribers), static_cast<double>(pub_sends) / times,
+            static_cast<double>(relay_sends) / times, cost_us, ok ? "" : " (failed)");
+    }
+
+    cleanup_tree(tree);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [subscribers] [publish times] [payload size] [base port]\n", argv[0]);
+        return 0;
+    }
+
+    size_t subscribers = 64;
+    size_t times = 1000;
+    size_t payload_size = 1024;
+    int base_port = 16600;
+    if (argc > 1)
+        subscribers = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        times = (size_t)strtol(argv[2], NULL, 10);
+    if (argc > 3)
+        payload_size = (size_t)strtol(argv[3], NULL, 10);
+    if (argc > 4)
+        base_port = (int)strtol(argv[4], NULL, 10);
+
+    if (0 == times) {
+        times = 1;
+    }
+
+#ifndef _WIN32
+    // 结束时大量连接同时关闭，对端已关闭的连接上的写入不能终止进程
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    // 子节点的子域是256个id，父节点的子域最多放下255个子节点
+    if (0 == subscribers) {
+        subscribers = 1;
+    } else if (subscribers > 254) {
+        subscribers = 254;
+    }
+
+    printf("payload size: %llu, publish times: %llu\n",
+        static_cast<unsigned long long>(payload_size), static_cast<unsigned long long>(times));
+    printf("%-8s %12s %10s %10s %14s\n", "mode", "subscribers", "pub send", "relay send", "cost(us/pub)");
+    run_bench(subscribers, times, payload_size, base_port);
+    return 0;
+}
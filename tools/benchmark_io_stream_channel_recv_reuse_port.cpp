@@ -0,0 +1,231 @@
+﻿#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <assert.h>
+
+#include <detail/libatbus_error.h>
+#include "detail/libatbus_channel_export.h"
+
+/**
+ * @brief 多个线程各自运行一个uv_loop和io_stream_channel，通过SO_REUSEPORT监听同一个地址
+ *        收到的数据包通过无锁的mem channel转交给主线程(相当于node所在的线程)处理
+ */
+
+struct run_config {
+    size_t max_n;
+    size_t limit_size;
+    size_t limit_static_num;
+    size_t thread_num;
+
+    atbus::channel::mem_channel* node_channel;
+};
+
+struct shard_stat {
+    std::atomic<size_t> sum_recv_len;
+    std::atomic<size_t> sum_recv_times;
+    std::atomic<size_t> sum_recv_err;
+    std::atomic<size_t> sum_queue_full;
+};
+
+run_config conf;
+
+static void recv_callback(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                                                 // libuv传入的转态码
+    void* buff,                                                 // 额外参数(不同事件不同含义)
+    size_t s                                                    // 额外参数长度
+    ) {
+    assert(channel);
+    assert(connection);
+    shard_stat* stat = reinterpret_cast<shard_stat*>(channel->data);
+
+    if (0 != status) {
+        fprintf(stderr, "recv callback error, ret code: %d. %s: %s\n",
+            status, uv_err_name(channel->error_code), uv_strerror(channel->error_code)
+            );
+
+        ++stat->sum_recv_err;
+        return;
+    }
+
+    ++stat->sum_recv_times;
+    stat->sum_recv_len += s;
+
+    // 转交给node线程，队列满时丢弃并计数
+    int res = atbus::channel::mem_send(conf.node_channel, buff, s);
+    if (EN_ATBUS_ERR_BUFF_LIMIT == res) {
+        ++stat->sum_queue_full;
+    } else if (0 != res) {
+        ++stat->sum_recv_err;
+    }
+}
+
+static void closed_callback(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    assert(channel);
+    assert(connection);
+}
+
+static void shard_main(const char* address, shard_stat* stat) {
+    using namespace atbus::channel;
+
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    io_stream_conf cfg;
+    io_stream_init_configure(&cfg);
+    cfg.is_reuse_port = true;
+    cfg.recv_buffer_max_size = conf.limit_size +
+        atbus::detail::buffer_block::full_size(cfg.recv_buffer_limit_size) * conf.limit_static_num +
+        atbus::detail::buffer_block::padding_size(1); // 预留一个对齐单位的空区域
+    cfg.recv_buffer_static = conf.limit_static_num;
+
+    io_stream_channel channel;
+    io_stream_init(&channel, &loop, &cfg);
+    channel.data = stat;
+    channel.evt.callbacks[io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback;
+    channel.evt.callbacks[io_stream_callback_evt_t::EN_FN_DISCONNECTED] = closed_callback;
+
+    channel_address_t addr;
+    make_address(address, addr);
+
+    if(io_stream_listen(&channel, addr, NULL, NULL, 0) < 0) {
+        std::cerr << "listen to " << address << " failed." << uv_err_name(channel.error_code) << ":" << uv_strerror(channel.error_code) << std::endl;
+        io_stream_close(&channel);
+        uv_loop_close(&loop);
+        return;
+    }
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+    io_stream_close(&channel);
+    uv_loop_close(&loop);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("usage: %s <address> [max unit size] [thread number] [node channel size]\n", argv[0]);
+        return 0;
+    }
+
+    using namespace atbus::channel;
+
+    if (argc > 2)
+        conf.max_n = (size_t)strtol(argv[2], NULL, 10);
+    else
+        conf.max_n = 1024;
+
+    conf.limit_size = sizeof(size_t) * conf.max_n;
+    conf.limit_static_num = 2;
+
+    if (argc > 3)
+        conf.thread_num = (size_t)strtol(argv[3], NULL, 10);
+    else
+        conf.thread_num = 4;
+
+    if (0 == conf.thread_num) {
+        conf.thread_num = 1;
+    }
+
+    size_t node_channel_size = 64 * 1024 * 1024; // 64MB
+    if (argc > 4)
+        node_channel_size = (size_t)strtol(argv[4], NULL, 10);
+
+    void* node_channel_buffer = malloc(node_channel_size);
+    int res = mem_init(node_channel_buffer, node_channel_size, &conf.node_channel, NULL);
+    if (res < 0) {
+        fprintf(stderr, "mem_init failed, ret: %d\n", res);
+        free(node_channel_buffer);
+        return res;
+    }
+
+    std::vector<shard_stat> stats(conf.thread_num);
+    std::vector<std::thread*> shards;
+    for (size_t i = 0; i < conf.thread_num; ++i) {
+        stats[i].sum_recv_len = 0;
+        stats[i].sum_recv_times = 0;
+        stats[i].sum_recv_err = 0;
+        stats[i].sum_queue_full = 0;
+        shards.push_back(new std::thread(shard_main, argv[1], &stats[i]));
+    }
+
+    // 主线程相当于node，从无锁队列中取出所有线程收到的数据包并校验
+    size_t* buf_pool = new size_t[conf.max_n];
+    size_t sum_node_len = 0;
+    size_t sum_node_times = 0;
+    size_t sum_node_err = 0;
+
+    int secs = 0;
+    char unit_desc[][4] = { "B", "KB", "MB", "GB" };
+    size_t unit_devi[] = { 1UL, 1UL << 10, 1UL << 20, 1UL << 30 };
+    size_t unit_index = 0;
+    time_t next_stat = time(NULL) + 60;
+
+    while (true) {
+        size_t n = 0;
+        res = mem_recv(conf.node_channel, buf_pool, conf.max_n * sizeof(size_t), &n);
+        if (EN_ATBUS_ERR_NO_DATA == res) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } else if (0 != res) {
+            ++sum_node_err;
+        } else {
+            bool passed = true;
+            for (size_t i = 1; passed && i < n / sizeof(size_t); ++i) {
+                passed = buf_pool[i] == buf_pool[0];
+            }
+
+            if (passed) {
+                ++sum_node_times;
+                sum_node_len += n;
+            } else {
+                ++sum_node_err;
+            }
+        }
+
+        if (time(NULL) < next_stat) {
+            continue;
+        }
+        next_stat += 60;
+        ++secs;
+
+        while (sum_node_len / unit_devi[unit_index] > 1024 && unit_index < sizeof(unit_devi) / sizeof(size_t) - 1)
+            ++unit_index;
+
+        while (sum_node_len / unit_devi[unit_index] <= 1024 && unit_index > 0)
+            --unit_index;
+
+        std::cout << "[ RUNNING  ] NO." << secs << " m" << std::endl;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            std::cout << "[ RUNNING  ] thread " << i << " recv(" << stats[i].sum_recv_times.load() << " times, " <<
+                (stats[i].sum_recv_len.load() >> 20) << " MB) " <<
+                "queue full " << stats[i].sum_queue_full.load() << " times, err " << stats[i].sum_recv_err.load() << " times" << std::endl;
+        }
+        std::cout << "[ RUNNING  ] node recv(" << sum_node_times << " times, " << (sum_node_len / unit_devi[unit_index]) << " " << unit_desc[unit_index] << ") " <<
+            "err " << sum_node_err << " times" << std::endl << std::endl;
+
+        std::cout.flush();
+        std::cerr.flush();
+    }
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        shards[i]->join();
+        delete shards[i];
+    }
+
+    delete[] buf_pool;
+    free(node_channel_buffer);
+    return 0;
+}
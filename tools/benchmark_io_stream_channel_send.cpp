@@ -14,6 +14,7 @@ struct run_config {
     size_t max_n;
     size_t limit_size;
     size_t limit_static_num;
+    size_t send_batch_num;
     size_t* buff_pool;
 
     // stats
@@ -113,7 +114,7 @@ static void stat_callback(uv_timer_t* handle) {
 int main(int argc, char* argv[])
 {
     if (argc < 2) {
-        printf("usage: %s <address> [max unit size] [limit size] [limit number]\n", argv[0]);
+        printf("usage: %s <address> [max unit size] [limit size] [limit number] [send batch number]\n", argv[0]);
         return 0;
     }
 
@@ -137,6 +138,12 @@ int main(int argc, char* argv[])
     else
         conf.limit_static_num = 0; // dynamic
 
+    // 0 或 1 表示每个数据包单独提交给libuv，用于对比合并提交的效果
+    if (argc > 5)
+        conf.send_batch_num = (size_t)strtol(argv[5], NULL, 10);
+    else
+        conf.send_batch_num = 64;
+
     srand(static_cast<unsigned>(time(NULL)));
     conf.pending_send = 0;
     conf.sum_send_len = 0;
@@ -150,6 +157,7 @@ int main(int argc, char* argv[])
     io_stream_init_configure(&cfg);
     cfg.send_buffer_max_size = conf.limit_size;
     cfg.send_buffer_static = conf.limit_static_num;
+    cfg.send_batch_number = conf.send_batch_num;
 
     io_stream_channel channel;
     io_stream_init(&channel, uv_default_loop(), &cfg);
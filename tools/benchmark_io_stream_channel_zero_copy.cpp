@@ -0,0 +1,199 @@
+﻿#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <assert.h>
+
+#include <detail/libatbus_error.h>
+#include "detail/libatbus_channel_export.h"
+
+/**
+ * @brief 同一个进程内通过回环地址收发，对每种数据包长度分别测试普通发送和MSG_ZEROCOPY发送的吞吐量
+ *        并输出零拷贝开始比普通发送快的数据包长度(交叉点)
+ *        注意: 本地回环时内核总是会回退为拷贝发送(SO_EE_CODE_ZEROCOPY_COPIED)，所以交叉点要在真实网卡上测
+ */
+
+struct run_config {
+    size_t total_size;          // 每轮测试发送的总数据量
+    size_t window_number;       // 最多允许未收到的数据包数量，零拷贝只在写缓冲区为空时生效，所以窗口越大零拷贝的比例越低
+    size_t recv_len;
+    size_t recv_times;
+    size_t recv_err;
+    atbus::channel::io_stream_connection* sender;
+};
+
+run_config conf;
+
+static void recv_callback(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    assert(channel);
+    assert(connection);
+
+    if (0 != status) {
+        ++conf.recv_err;
+        return;
+    }
+
+    ++conf.recv_times;
+    conf.recv_len += s;
+}
+
+static void connected_callback(
+    atbus::channel::io_stream_channel* channel,         // 事件触发的channel
+    atbus::channel::io_stream_connection* connection,   // 事件触发的连接
+    int status,                         // libuv传入的转态码
+    void*,                              // 额外参数(不同事件不同含义)
+    size_t s                            // 额外参数长度
+    ) {
+    if (0 != status) {
+        std::cerr << "connect failed, status: " << status << std::endl;
+        std::cerr << uv_err_name(channel->error_code) << ":" << uv_strerror(channel->error_code) << std::endl;
+        return;
+    }
+
+    conf.sender = connection;
+}
+
+// 返回每秒发送的MB数，失败返回负数
+static double run_once(uv_loop_t* loop, atbus::channel::io_stream_channel* cli, const char* buf, size_t unit_size, bool zero_copy) {
+    cli->conf.send_zero_copy_threshold = zero_copy ? unit_size : 0;
+
+    conf.recv_len = 0;
+    conf.recv_times = 0;
+    size_t send_len = 0;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    while (send_len < conf.total_size) {
+        if (send_len - conf.recv_len >= conf.window_number * unit_size) {
+            uv_run(loop, UV_RUN_ONCE);
+            continue;
+        }
+
+        int res = atbus::channel::io_stream_send(conf.sender, buf, unit_size);
+        if (EN_ATBUS_ERR_BUFF_LIMIT == res) {
+            uv_run(loop, UV_RUN_ONCE);
+            continue;
+        }
+
+        if (0 != res) {
+            std::cerr << "io_stream_send failed, res: " << res << std::endl;
+            return -1.0;
+        }
+        send_len += unit_size;
+    }
+
+    while (conf.recv_len < send_len && 0 == conf.recv_err) {
+        uv_run(loop, UV_RUN_ONCE);
+    }
+
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+    if (0 != conf.recv_err || cost.count() <= 0.0) {
+        return -1.0;
+    }
+
+    return static_cast<double>(send_len) / (1024.0 * 1024.0) / cost.count();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && (0 == strcmp("-h", argv[1]) || 0 == strcmp("--help", argv[1]))) {
+        printf("usage: %s [address] [total MB per round] [max unit size(KB)] [window number]\n", argv[0]);
+        return 0;
+    }
+
+    using namespace atbus::channel;
+
+    const char* address = argc > 1 ? argv[1] : "ipv4://127.0.0.1:16389";
+    conf.total_size = (argc > 2 ? static_cast<size_t>(strtol(argv[2], NULL, 10)) : 256) << 20;
+    size_t max_unit_size = (argc > 3 ? static_cast<size_t>(strtol(argv[3], NULL, 10)) : 256) << 10;
+    conf.window_number = argc > 4 ? static_cast<size_t>(strtol(argv[4], NULL, 10)) : 1;
+    if (0 == conf.window_number) {
+        conf.window_number = 1;
+    }
+    conf.recv_len = conf.recv_times = conf.recv_err = 0;
+    conf.sender = NULL;
+
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    io_stream_conf cfg;
+    io_stream_init_configure(&cfg);
+    cfg.send_buffer_limit_size = max_unit_size;
+    cfg.recv_buffer_limit_size = max_unit_size;
+    cfg.recv_buffer_max_size = max_unit_size * cfg.recv_buffer_static;
+    cfg.send_buffer_max_size = 0;
+    // 非0时连接上才会开启SO_ZEROCOPY，每轮测试前再修改
+    cfg.send_zero_copy_threshold = 1;
+
+    io_stream_channel svr, cli;
+    io_stream_init(&svr, &loop, &cfg);
+    io_stream_init(&cli, &loop, &cfg);
+    svr.evt.callbacks[io_stream_callback_evt_t::EN_FN_RECVED] = recv_callback;
+
+    channel_address_t addr;
+    make_address(address, addr);
+    if (io_stream_listen(&svr, addr, NULL, NULL, 0) < 0) {
+        std::cerr << "listen to " << address << " failed." << uv_err_name(svr.error_code) << ":" << uv_strerror(svr.error_code) << std::endl;
+        return -1;
+    }
+
+    if (io_stream_connect(&cli, addr, connected_callback, NULL, 0) < 0) {
+        std::cerr << "connect to " << address << " failed." << uv_err_name(cli.error_code) << ":" << uv_strerror(cli.error_code) << std::endl;
+        return -1;
+    }
+
+    while (NULL == conf.sender && 0 != uv_run(&loop, UV_RUN_ONCE));
+    if (NULL == conf.sender) {
+        return -1;
+    }
+
+    if (!ATBUS_CHANNEL_IOS_CHECK_FLAG(conf.sender->flags, io_stream_connection::EN_CF_ZERO_COPY)) {
+        std::cout << "[ WARNING  ] SO_ZEROCOPY is not supported, all rounds will copy" << std::endl;
+    }
+
+    std::vector<char> buf(max_unit_size, 'z');
+    size_t cross_size = 0;
+
+    std::cout << std::setw(12) << "unit size" << std::setw(16) << "copy(MB/s)" << std::setw(16) << "zerocopy(MB/s)" << 
+        std::setw(12) << "zc sends" << std::setw(12) << "zc copied" << std::endl;
+    for (size_t unit_size = 1024; unit_size <= max_unit_size; unit_size <<= 1) {
+        double copy_speed = run_once(&loop, &cli, &buf[0], unit_size, false);
+
+        size_t send_times = conf.sender->zero_copy.send_times;
+        size_t copied_times = conf.sender->zero_copy.copied_times;
+        double zc_speed = run_once(&loop, &cli, &buf[0], unit_size, true);
+        if (copy_speed < 0 || zc_speed < 0) {
+            std::cerr << "benchmark failed at unit size " << unit_size << std::endl;
+            break;
+        }
+
+        std::cout << std::setw(12) << unit_size << std::setw(16) << std::fixed << std::setprecision(1) << copy_speed <<
+            std::setw(16) << zc_speed << std::setw(12) << (conf.sender->zero_copy.send_times - send_times) <<
+            std::setw(12) << (conf.sender->zero_copy.copied_times - copied_times) << std::endl;
+
+        if (0 == cross_size && zc_speed >= copy_speed) {
+            cross_size = unit_size;
+        } else if (zc_speed < copy_speed) {
+            cross_size = 0;
+        }
+    }
+
+    if (0 == cross_size) {
+        std::cout << "[ RESULT   ] zerocopy never wins up to " << max_unit_size << " bytes, keep send_zero_copy_threshold = 0" << std::endl;
+    } else {
+        std::cout << "[ RESULT   ] zerocopy wins from " << cross_size << " bytes, suggest send_zero_copy_threshold = " << cross_size << std::endl;
+    }
+
+    io_stream_close(&cli);
+    io_stream_close(&svr);
+    uv_loop_close(&loop);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <uv.h>
+
+#include "atbus_node.h"
+#include "detail/libatbus_protocol.h"
+
+/**
+ * @brief 全局路由表(NODE_SYNC)对跨子树消息的跳数和延迟的影响
+ *        三层七个节点: R -> F1, F2 -> C11, C12, C21, C22，叶子节点没有全局路由表
+ *        分别在中间节点关闭和开启EN_CONF_GLOBAL_ROUTER时测试C11发往C21
+ *        cold  : 第一条消息的跳数，这时兄弟节点之间还没有因为转发建立直连
+ *        steady: 转发触发的直连建立以后的跳数
+ *        rtt   : 同一个事件循环内发送到收到的平均耗时
+ */
+
+typedef std::chrono::steady_clock clock_type;
+
+static size_t data_hops = 0;
+static size_t recv_count = 0;
+
+static void on_debug_count_hops(const char*, size_t, const atbus::node&, const atbus::endpoint*, const atbus::connection*,
+    const atbus::protocol::msg* m, const char* fmt, ...) {
+    // 每一次数据转发消息的发送就是一跳
+    if (NULL != m && ATBUS_CMD_DATA_TRANSFORM_REQ == m->head.cmd && 0 == strncmp(fmt, "node send", 9)) {
+        ++data_hops;
+    }
+}
+
+static int on_recv_count(const atbus::node&, const atbus::endpoint*, const atbus::connection*, int, const void*, size_t) {
+    ++recv_count;
+    return 0;
+}
+
+struct bench_tree_t {
+    uv_loop_t ev_loop;
+    std::vector<atbus::node::ptr_t> nodes;
+    time_t proc_t;
+
+    void proc() {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            nodes[i]->proc(proc_t, 0);
+        }
+        uv_run(&ev_loop, UV_RUN_NOWAIT);
+    }
+};
+
+static std::string make_address(int port) {
+    char buf[64] = {0};
+    sprintf(buf, "ipv4://127.0.0.1:%d", port);
+    return buf;
+}
+
+static bool setup_tree(bench_tree_t& tree, bool global_router, int base_port) {
+    uv_loop_init(&tree.ev_loop);
+    tree.proc_t = time(NULL) + 1;
+
+    atbus::node::bus_id_t ids[] = { 0x12345678, 0x12346789, 0x12347890, 0x12346701, 0x12346702, 0x12347801, 0x12347802 };
+    uint32_t masks[] = { 16, 8, 8, 0, 0, 0, 0 };
+    int fathers[] = { -1, 0, 0, 1, 1, 2, 2 };
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        atbus::node::conf_t conf;
+        atbus::node::default_conf(&conf);
+        conf.ev_loop = &tree.ev_loop;
+        conf.children_mask = masks[i];
+        if (global_router && masks[i] > 0) {
+            conf.flags.set(atbus::node::conf_flag_t::EN_CONF_GLOBAL_ROUTER);
+        }
+        if (fathers[i] >= 0) {
+            conf.father_address = make_address(base_port + fathers[i]);
+        }
+
+        atbus::node::ptr_t n = atbus::node::create();
+        n->on_debug = on_debug_count_hops;
+        n->set_on_recv_handle(on_recv_count);
+        if (n->init(ids[i], &conf) < 0 || n->listen(make_address(base_port + static_cast<int>(i)).c_str()) < 0 || n->start() < 0) {
+            fprintf(stderr, "setup node 0x%08llx failed\n", static_cast<unsigned long long>(ids[i]));
+            return false;
+        }
+        tree.nodes.push_back(n);
+    }
+
+    // 等待注册完成，有全局路由表时还要等同步完成
+    for (int i = 0; i < 4096; ++i) {
+        tree.proc();
+
+        bool ready = true;
+        for (size_t j = 1; ready && j < tree.nodes.size(); ++j) {
+            atbus::node::ptr_t& father = tree.nodes[fathers[j]];
+            atbus::endpoint* ep = father->get_endpoint(tree.nodes[j]->get_id());
+            ready = NULL != ep && NULL != father->get_self_endpoint()->get_data_connection(ep);
+        }
+        if (ready && global_router) {
+            ready = tree.nodes.size() == tree.nodes[1]->get_sync_node_count() &&
+                tree.nodes.size() == tree.nodes[2]->get_sync_node_count();
+        }
+
+        if (ready) {
+            return true;
+        }
+
+        ++tree.proc_t;
+        uv_sleep(1);
+    }
+
+    fprintf(stderr, "wait for tree ready timeout\n");
+    return false;
+}
+
+static void cleanup_tree(bench_tree_t& tree) {
+    for (size_t i = 0; i < tree.nodes.size(); ++i) {
+        tree.nodes[i]->reset();
+    }
+    tree.nodes.clear();
+
+    while (UV_EBUSY == uv_loop_close(&tree.ev_loop)) {
+        uv_run(&tree.ev_loop, UV_RUN_NOWAIT);
+    }
+}
+
+static bool send_and_wait(bench_tree_t& tree, atbus::node::ptr_t& from, atbus::node::ptr_t& to, const std::string& data) {
+    size_t count = recv_count;
+    if (from->send_data(to->get_id(), 0, data.data(), data.size()) < 0) {
+        return false;
+    }
+
+    for (int i = 0; i < 1000000 && count == recv_count; ++i) {
+        uv_run(&tree.ev_loop, UV_RUN_NOWAIT);
+    }
+
+    return count != recv_count;
+}
+
+static void run_bench(bool global_router, int base_port, size_t times, size_t payload_size) {
+    bench_tree_t tree;
+    if (!setup_tree(tree, global_router, base_port)) {
+        cleanup_tree(tree);
+        return;
+    }
+
+    atbus::node::ptr_t& c11 = tree.nodes[3];
+    atbus::node::ptr_t& c21 = tree.nodes[5];
+    std::string data(payload_size, 'a');
+
+    data_hops = 0;
+    bool ok = send_and_wait(tree, c11, c21, data);
+    size_t cold_hops = data_hops;
+
+    // 等待转发触发的兄弟节点直连
+    for (int i = 0; i < 256; ++i) {
+        tree.proc();
+        uv_sleep(1);
+    }
+
+    data_hops = 0;
+    ok = send_and_wait(tree, c11, c21, data) && ok;
+    size_t steady_hops = data_hops;
+
+    clock_type::time_point begin = clock_type::now();
+    for (size_t i = 0; ok && i < times; ++i) {
+        ok = send_and_wait(tree, c11, c21, data) && send_and_wait(tree, c21, c11, data);
+    }
+    double rtt_us = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - begin).count()) / times / 1000.0;
+
+    uint64_t sync_send = 0, sync_full = 0, sync_recv = 0;
+    for (size_t i = 0; i < tree.nodes.size(); ++i) {
+        sync_send += tree.nodes[i]->get_stat().node_sync_send_times;
+        sync_full += tree.nodes[i]->get_stat().node_sync_full_times;
+        sync_recv += tree.nodes[i]->get_stat().node_sync_recv_times;
+    }
+
+    printf("%-14s %10llu %11llu %12.2f %10llu %10llu %10llu%s\n", global_router ? "global router" : "no sync",
+        static_cast<unsigned long long>(cold_hops), static_cast<unsigned long long>(steady_hops), rtt_us,
+        static_cast<unsigned long long>(sync_send), static_cast<unsigned long long>(sync_full),
+        static_cast<unsigned long long>(sync_recv), ok ? "" : " (failed)");
+
+    cleanup_tree(tree);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [round trip times] [payload size] [base port]\n", argv[0]);
+        return 0;
+    }
+
+    size_t times = 10000;
+    size_t payload_size = 256;
+    int base_port = 16500;
+    if (argc > 1)
+        times = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        payload_size = (size_t)strtol(argv[2], NULL, 10);
+    if (argc > 3)
+        base_port = (int)strtol(argv[3], NULL, 10);
+
+    if (0 == times) {
+        times = 1;
+    }
+
+    printf("C11 -> C21, payload size: %llu, round trip times: %llu\n",
+        static_cast<unsigned long long>(payload_size), static_cast<unsigned long long>(times));
+    printf("%-14s %10s %11s %12s %10s %10s %10s\n", "mode", "cold hops", "steady hops", "rtt(us/op)", "sync send", "sync full", "sync recv");
+    run_bench(false, base_port, times, payload_size);
+    run_bench(true, base_port + 10, times, payload_size);
+    return 0;
+}
@@ -0,0 +1,115 @@
+﻿#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <assert.h>
+
+#include "detail/libatbus_protocol.h"
+#include "detail/libatbus_protocol_binary.h"
+
+/**
+ * @brief 数据转发消息的打包/解包性能对比
+ *        msgpack: 当前pack<atbus::protocol::msg>的编码方式，打包到复用的msgpack::sbuffer，解包使用复用的msgpack::zone
+ *        binary : 固定格式的二进制编码(libatbus_protocol_binary.h)
+ */
+
+typedef std::chrono::steady_clock clock_type;
+
+static double cost_ns(clock_type::time_point begin, size_t times) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - begin).count()) / times;
+}
+
+static bool unpack_reference_buffer(msgpack::type::object_type, size_t, void*) {
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [payload size] [times] [router number]\n", argv[0]);
+        return 0;
+    }
+
+    size_t payload_size = 256;
+    size_t times = 1000000;
+    size_t router_num = 1;
+    if (argc > 1)
+        payload_size = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        times = (size_t)strtol(argv[2], NULL, 10);
+    if (argc > 3)
+        router_num = (size_t)strtol(argv[3], NULL, 10);
+
+    if (0 == times) {
+        times = 1;
+    }
+
+    if (router_num > ATBUS_MACRO_ROUTER_MAX_DEPTH) {
+        router_num = ATBUS_MACRO_ROUTER_MAX_DEPTH;
+    }
+
+    std::vector<char> payload(payload_size, 'a');
+    atbus::protocol::msg m;
+    m.init(0x12345678, ATBUS_CMD_DATA_TRANSFORM_REQ, 1, 0, 1);
+    m.body.make_forward(0x12345678, 0x12356789, payload.empty() ? NULL : &payload[0], payload.size());
+    for (size_t i = 0; i < router_num; ++i) {
+        m.body.forward()->router.push_back(0x12340000 + i);
+    }
+
+    volatile size_t checksum = 0;
+
+    // ============ msgpack ============
+    msgpack::sbuffer sbuf;
+    clock_type::time_point begin = clock_type::now();
+    for (size_t i = 0; i < times; ++i) {
+        sbuf.clear();
+        m.head.sequence = static_cast<uint32_t>(i);
+        msgpack::pack(sbuf, m);
+        checksum += sbuf.size();
+    }
+    double msgpack_pack_ns = cost_ns(begin, times);
+    size_t msgpack_size = sbuf.size();
+
+    msgpack::zone z;
+    begin = clock_type::now();
+    for (size_t i = 0; i < times; ++i) {
+        atbus::protocol::msg dst;
+        size_t offset = 0;
+        msgpack::object obj = msgpack::unpack(z, sbuf.data(), sbuf.size(), offset, unpack_reference_buffer);
+        obj.convert(dst);
+        checksum += dst.body.forward()->content.size;
+        z.clear();
+    }
+    double msgpack_unpack_ns = cost_ns(begin, times);
+
+    // ============ binary ============
+    std::vector<char> bbuf(atbus::protocol::binary_packed_size(m));
+    size_t binary_size = 0;
+    begin = clock_type::now();
+    for (size_t i = 0; i < times; ++i) {
+        m.head.sequence = static_cast<uint32_t>(i);
+        binary_size = atbus::protocol::binary_pack(m, &bbuf[0], bbuf.size());
+        checksum += binary_size;
+    }
+    double binary_pack_ns = cost_ns(begin, times);
+    assert(binary_size == bbuf.size());
+
+    begin = clock_type::now();
+    for (size_t i = 0; i < times; ++i) {
+        atbus::protocol::msg dst;
+        if (atbus::protocol::binary_unpack(dst, &bbuf[0], binary_size)) {
+            checksum += dst.body.forward()->content.size;
+        }
+    }
+    double binary_unpack_ns = cost_ns(begin, times);
+
+    printf("payload size: %llu, router number: %llu, times: %llu\n",
+        static_cast<unsigned long long>(payload_size), static_cast<unsigned long long>(router_num), static_cast<unsigned long long>(times));
+    printf("%-8s %12s %16s %16s\n", "codec", "packed size", "pack(ns/op)", "unpack(ns/op)");
+    printf("%-8s %12llu %16.1f %16.1f\n", "msgpack", static_cast<unsigned long long>(msgpack_size), msgpack_pack_ns, msgpack_unpack_ns);
+    printf("%-8s %12llu %16.1f %16.1f\n", "binary", static_cast<unsigned long long>(binary_size), binary_pack_ns, binary_unpack_ns);
+    printf("checksum: %llu\n", static_cast<unsigned long long>(checksum));
+    return 0;
+}
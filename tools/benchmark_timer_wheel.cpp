@@ -0,0 +1,129 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <list>
+#include <memory>
+#include <chrono>
+
+#include "detail/timer_wheel.h"
+
+/**
+ * @brief node的ping定时器的性能对比
+ *        list : 原来的按秒的std::list<std::pair<time_t, std::weak_ptr<T> > >，触发后从队首弹出再加到队尾
+ *        wheel: 现在的按毫秒的分层时间轮
+ *        每个端点一个ping定时器，模拟每16毫秒调用一次proc，统计总耗时和每次触发的平均耗时
+ */
+
+typedef std::chrono::steady_clock clock_type;
+
+struct bench_endpoint_t {
+    size_t ping_times;
+};
+
+static double cost_ms(clock_type::time_point begin) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - begin).count()) / 1000.0;
+}
+
+static void run_bench(size_t endpoint_num, uint64_t interval_ms, uint64_t duration_ms) {
+    const uint64_t step_ms = 16;
+    uint64_t begin_ms = static_cast<uint64_t>(1700000000) * 1000;
+
+    std::vector<std::shared_ptr<bench_endpoint_t> > endpoints;
+    for (size_t i = 0; i < endpoint_num; ++i) {
+        std::shared_ptr<bench_endpoint_t> ep = std::make_shared<bench_endpoint_t>();
+        ep->ping_times = 0;
+        endpoints.push_back(ep);
+    }
+
+    // std::list，只能按秒
+    size_t list_fired = 0;
+    double list_ms = 0;
+    {
+        typedef std::list<std::pair<time_t, std::weak_ptr<bench_endpoint_t> > > list_t;
+        list_t ping_list;
+        for (size_t i = 0; i < endpoint_num; ++i) {
+            ping_list.push_back(std::make_pair(static_cast<time_t>((begin_ms + interval_ms * i / endpoint_num) / 1000), endpoints[i]));
+        }
+
+        clock_type::time_point begin = clock_type::now();
+        for (uint64_t now = begin_ms; now < begin_ms + duration_ms; now += step_ms) {
+            time_t sec = static_cast<time_t>(now / 1000);
+            while (!ping_list.empty() && ping_list.front().first < sec) {
+                std::shared_ptr<bench_endpoint_t> ep = ping_list.front().second.lock();
+                ping_list.pop_front();
+                if (ep) {
+                    ++ep->ping_times;
+                    ++list_fired;
+                    ping_list.push_back(std::make_pair(sec + static_cast<time_t>(interval_ms / 1000), ep));
+                }
+            }
+        }
+        list_ms = cost_ms(begin);
+    }
+
+    size_t wheel_fired = 0;
+    double wheel_ms = 0;
+    {
+        atbus::detail::timer_wheel<std::weak_ptr<bench_endpoint_t> > ping_wheel;
+        std::vector<atbus::detail::timer_wheel<std::weak_ptr<bench_endpoint_t> >::value_type> expired;
+        ping_wheel.reset(begin_ms);
+        for (size_t i = 0; i < endpoint_num; ++i) {
+            ping_wheel.add(begin_ms + interval_ms * i / endpoint_num, endpoints[i]);
+        }
+
+        clock_type::time_point begin = clock_type::now();
+        for (uint64_t now = begin_ms; now < begin_ms + duration_ms; now += step_ms) {
+            if (ping_wheel.advance(now, expired) > 0) {
+                for (size_t i = 0; i < expired.size(); ++i) {
+                    std::shared_ptr<bench_endpoint_t> ep = expired[i].second.lock();
+                    if (ep) {
+                        ++ep->ping_times;
+                        ++wheel_fired;
+                        ping_wheel.add(now + interval_ms, ep);
+                    }
+                }
+            }
+        }
+        wheel_ms = cost_ms(begin);
+    }
+
+    printf("%12llu %12.2f %12.2f %14.1f %14.1f\n", static_cast<unsigned long long>(endpoint_num), list_ms, wheel_ms,
+        list_fired > 0 ? list_ms * 1000000.0 / list_fired : 0.0, wheel_fired > 0 ? wheel_ms * 1000000.0 / wheel_fired : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && 0 == strcmp("-h", argv[1])) {
+        printf("usage: %s [endpoint number, 0 for 1000/10000/100000] [ping interval(ms)] [duration(ms)]\n", argv[0]);
+        return 0;
+    }
+
+    size_t endpoint_num = 0;
+    uint64_t interval_ms = 60000;
+    uint64_t duration_ms = 600000;
+    if (argc > 1)
+        endpoint_num = (size_t)strtol(argv[1], NULL, 10);
+    if (argc > 2)
+        interval_ms = (uint64_t)strtol(argv[2], NULL, 10);
+    if (argc > 3)
+        duration_ms = (uint64_t)strtol(argv[3], NULL, 10);
+
+    if (interval_ms < 1000) {
+        interval_ms = 1000;
+    }
+
+    printf("ping interval: %llums, duration: %llums, proc every 16ms\n", static_cast<unsigned long long>(interval_ms), static_cast<unsigned long long>(duration_ms));
+    printf("%12s %12s %12s %14s %14s\n", "endpoints", "list(ms)", "wheel(ms)", "list(ns/ping)", "wheel(ns/ping)");
+    if (0 != endpoint_num) {
+        run_bench(endpoint_num, interval_ms, duration_ms);
+    } else {
+        size_t nums[] = { 1000, 10000, 100000 };
+        for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+            run_bench(nums[i], interval_ms, duration_ms);
+        }
+    }
+
+    return 0;
+}
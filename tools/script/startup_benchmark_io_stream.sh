@@ -4,6 +4,7 @@ ADDRESS="ipv6://::1:16389";
 UNIT_SIZE=1024 ;
 LIMIT_SIZE=4194304 ;
 STATIC_LIMIT_NUM=1024 ;
+SEND_BATCH_NUM=64 ;
 
 if [ $# -gt 1 ]; then
     ADDRESS="$1";
@@ -21,9 +22,14 @@ if [ $# -gt 4 ]; then
     STATIC_LIMIT_NUM=$4 ;
 fi
 
+# 设为0可以对比每个数据包单独提交给libuv的性能
+if [ $# -gt 5 ]; then
+    SEND_BATCH_NUM=$5 ;
+fi
+
 ./benchmark_io_stream_channel_recv "$ADDRESS" $UNIT_SIZE > recv.log 2>&1 &
 
 sleep 2;
 
-./benchmark_io_stream_channel_send "$ADDRESS" $UNIT_SIZE $LIMIT_SIZE $STATIC_LIMIT_NUM > send.log 2>&1 &
+./benchmark_io_stream_channel_send "$ADDRESS" $UNIT_SIZE $LIMIT_SIZE $STATIC_LIMIT_NUM $SEND_BATCH_NUM > send.log 2>&1 &
 
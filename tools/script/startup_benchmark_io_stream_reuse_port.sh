@@ -0,0 +1,33 @@
+#!/bin/sh
+
+ADDRESS="ipv4://127.0.0.1:16389";
+UNIT_SIZE=1024 ;
+THREAD_NUM=4 ;
+SENDER_NUM=8 ;
+
+if [ $# -gt 1 ]; then
+    ADDRESS="$1";
+fi
+
+if [ $# -gt 2 ]; then
+    UNIT_SIZE=$2 ;
+fi
+
+if [ $# -gt 3 ]; then
+    THREAD_NUM=$3 ;
+fi
+
+if [ $# -gt 4 ]; then
+    SENDER_NUM=$4 ;
+fi
+
+./benchmark_io_stream_channel_recv_reuse_port "$ADDRESS" $UNIT_SIZE $THREAD_NUM > recv.log 2>&1 &
+
+sleep 2;
+
+# 每个发送进程一个连接，由内核分配到不同的接收线程
+i=0;
+while [ $i -lt $SENDER_NUM ]; do
+    ./benchmark_io_stream_channel_send "$ADDRESS" $UNIT_SIZE > send.$i.log 2>&1 &
+    i=$((i+1));
+done